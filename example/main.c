@@ -17,38 +17,41 @@ int main()
     memset(&context, 0, sizeof(CoreEngineContext));
 
     // Initialise Core Engine
-    CoreEngine_Init(&context, 0.5, 1024);
+    CoreEngine_Init(&context, 0.5, DEFAULT_HEAP_ARENA_SIZE_KB);
 
     // Create sin osc
-    Oscillator sinOsc;
-    u16 sinOscId = Oscillator_Create(&sinOsc, &context, WAVEFORM_SIN, 440.0, 0.0, 0.5);
+    Oscillator* sinOsc = CoreEngine_New(&context, Oscillator);
+    u16 sinOscId = Oscillator_Create(sinOsc, &context, WAVEFORM_SIN, 440.0, 0.0, 0.5);
     CoreEngine_AddSource(&context, sinOscId);
 
     // Create squarewave osc
-    Oscillator sqOsc;
-    u16 sqOscId = Oscillator_Create(&sqOsc, &context, WAVEFORM_SQUARE, 440.0, 0.0, 0.015);
+    Oscillator* sqOsc = CoreEngine_New(&context, Oscillator);
+    u16 sqOscId = Oscillator_Create(sqOsc, &context, WAVEFORM_SQUARE, 440.0, 0.0, 0.015);
     CoreEngine_AddSource(&context, sqOscId);
 
     // Create WAV Player
-    WavPlayer wavPlayer;
-    u16 wavPlayerId = WavPlayer_Create(&wavPlayer, &context, "example/Kings.wav", WAVPLAYER_LOOPING);
+    WavPlayer* wavPlayer = CoreEngine_New(&context, WavPlayer);
+    u16 wavPlayerId = WavPlayer_Create(wavPlayer, &context, "example/Kings.wav", WAVPLAYER_LOOPING);
     CoreEngine_AddSource(&context, wavPlayerId);
 
     // Create a lowpass IIR filter
-    IirFilter lowpass;
-    u16 filterId = IirFilter_Create(&lowpass, &context, SAMPLE_RATE_DEFAULT, IIR_LOWPASS, 100, 1, 1);
+    IirFilter* lowpass = CoreEngine_New(&context, IirFilter);
+    u16 filterId = IirFilter_Create(lowpass, &context, SAMPLE_RATE_DEFAULT, IIR_LOWPASS, 100, 1, 1);
 
     // Create a renderer to record the audio to a file
-    AudioRenderer renderer;
-    u16 rendererId = AudioRenderer_Create(&renderer, &context, "Example_Rendered.wav");
+    AudioRenderer* renderer = CoreEngine_New(&context, AudioRenderer);
+    u16 rendererId = AudioRenderer_Create(renderer, &context, "Example_Rendered.wav");
 
     // Create a channel fader for each audio source
-    Fader sqFader, sinFader, wavFader, recordFader;
+    Fader* sqFader = CoreEngine_New(&context, Fader);
+    Fader* sinFader = CoreEngine_New(&context, Fader);
+    Fader* wavFader = CoreEngine_New(&context, Fader);
+    Fader* recordFader = CoreEngine_New(&context, Fader);
     u16 channelSquareWave, channelSineWave, channelWavPlayer, channelRenderer;
-    channelSquareWave = Fader_Create(&sqFader, -1.0f, 0.0f, &context);
-    channelSineWave = Fader_Create(&sinFader, 1.0f, 0.0f, &context);
-    channelWavPlayer = Fader_Create(&wavFader, 0.0f, 0.0f, &context);
-    channelRenderer = Fader_Create(&recordFader, 0.0f, 1.0f, &context);
+    channelSquareWave = Fader_Create(sqFader, -1.0f, 0.0f, &context);
+    channelSineWave = Fader_Create(sinFader, 1.0f, 0.0f, &context);
+    channelWavPlayer = Fader_Create(wavFader, 0.0f, 0.0f, &context);
+    channelRenderer = Fader_Create(recordFader, 0.0f, 1.0f, &context);
 
     // Route the sin signal to mixer control
     CoreEngine_Route(&context, sinOscId, channelSineWave, true);
@@ -67,8 +70,12 @@ int main()
     // Connect Fader 4 output to Renderer
     CoreEngine_Route(&context, channelRenderer, rendererId, true);
 
+    // Under overload the filter is the only thing to go, it's the one processor here that opts
+    // in. Everything else, the oscillators and player included, stays critical.
+    CoreEngine_SetPriority(&context, filterId, PROCESSOR_PRIORITY_LOW);
+
     // Start recording
-    AudioRenderer_StartRecord(&renderer);
+    AudioRenderer_StartRecord(renderer);
 
     // Start audio
     CoreEngine_Start(&context);
@@ -81,28 +88,32 @@ int main()
         remaining = windowMs;
         f32 scale = (0.3f / (f32)windowMs);
         while (remaining--) {
-            sinFader.vol += scale; 
-            sqFader.vol += scale; 
-            wavFader.vol += scale;
+            sinFader->vol += scale; 
+            sqFader->vol += scale; 
+            wavFader->vol += scale;
             usleep(1000);
         }
     }
 
-    { // Seek wav file
+    { // Seek wav file, cued up front so every jump lands straight away
+        u32 cues[5];
+        for (u32 i = 0; i < 5; i++) {
+            cues[i] = WavPlayer_AddCue(wavPlayer, 300000 * i);
+        }
+
         i32 twoSeconds = 5;
         while (twoSeconds--) {
-            u32 seekPosition = 300000 * twoSeconds;
-            LogInfo("Seeking wav file to %d", seekPosition);
-            WavPlayer_Seek(&wavPlayer, seekPosition);
-            if (lowpass.type == IIR_LOWPASS) {
-                lowpass.type = IIR_HIGHPASS;
-                lowpass.freq = 1000;
+            LogInfo("Seeking wav file to %d", 300000 * twoSeconds);
+            WavPlayer_SeekToCue(wavPlayer, cues[twoSeconds]);
+            if (lowpass->type == IIR_LOWPASS) {
+                lowpass->type = IIR_HIGHPASS;
+                lowpass->freq = 1000;
             }
             else {
-                lowpass.type = IIR_LOWPASS;
-                lowpass.freq = 100;
+                lowpass->type = IIR_LOWPASS;
+                lowpass->freq = 100;
             }
-            IirFilter_Recalculate(&lowpass);
+            IirFilter_Recalculate(lowpass);
             usleep(2000000);
         }
     }
@@ -113,10 +124,10 @@ int main()
         f32 scale = (2.0f / (f32)windowMs);
         f32 pitchScale = (440.0f / (f32) windowMs);
         while (remaining--) {
-            sinFader.pan -= scale; 
-            sqFader.pan += scale; 
-            sinOsc.frequency += pitchScale;
-            sqOsc.frequency -= pitchScale;
+            sinFader->pan -= scale; 
+            sqFader->pan += scale; 
+            sinOsc->frequency += pitchScale;
+            sqOsc->frequency -= pitchScale;
             usleep(1000);
         }
     }
@@ -126,10 +137,10 @@ int main()
         f32 scale = (2.0f / (f32)windowMs);
         f32 pitchScale = (440.0f / (f32) windowMs);
         while (remaining--) {
-            sinFader.pan += scale; 
-            sqFader.pan -= scale; 
-            sinOsc.frequency -= pitchScale;
-            sqOsc.frequency += pitchScale;
+            sinFader->pan += scale; 
+            sqFader->pan -= scale; 
+            sinOsc->frequency -= pitchScale;
+            sqOsc->frequency += pitchScale;
             usleep(1000);
         }
     }
@@ -138,8 +149,8 @@ int main()
         remaining = windowMs;
         f32 scale = (1.0f / (f32)windowMs);
         while (remaining--) {
-            sinFader.vol -= scale;
-            sinFader.vol = ClampLow(sinFader.vol, 0.0f);
+            sinFader->vol -= scale;
+            sinFader->vol = ClampLow(sinFader->vol, 0.0f);
             usleep(1000);
         }
     }
@@ -148,8 +159,8 @@ int main()
         remaining = windowMs;
         f32 scale = (1.0f / (f32)windowMs);
         while (remaining--) {
-            sqFader.vol -= scale; 
-            sqFader.vol = ClampLow(sqFader.vol, 0.0f);
+            sqFader->vol -= scale; 
+            sqFader->vol = ClampLow(sqFader->vol, 0.0f);
             usleep(1000);
         }
     }
@@ -158,14 +169,14 @@ int main()
         remaining = windowMs;
         f32 scale = (1.0f / (f32)windowMs);
         while (remaining--) {
-            wavFader.vol -= scale; 
-            wavFader.vol = ClampLow(wavFader.vol, 0.0f);
+            wavFader->vol -= scale; 
+            wavFader->vol = ClampLow(wavFader->vol, 0.0f);
             usleep(1000);
         }
     }
 
     // Stop recording
-    AudioRenderer_StopRecord(&renderer);
+    AudioRenderer_StopRecord(renderer);
 
     // Stop audio
     CoreEngine_Stop(&context);
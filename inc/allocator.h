@@ -2,12 +2,11 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include <logger.h>
 #include <types.h>
 
-// TODO: allocate from global arena or bump allocator
-
 #define AllocRange(type, size) (type*)calloc(size, sizeof(type))
 #define AllocOne(type) (type*)calloc(1, sizeof(type))
 #define Dealloc(data) Assert(data, "Tried to deallocate null data"); free(data); data = NULL
@@ -15,19 +14,56 @@
 // Utils
 #define ZeroMem(type, ptr, size) memset(ptr, 0, sizeof(type) * size)
 #define ZeroObj(type, ptr) memset(ptr, 0, sizeof(type))
+#define AlignUp(value, alignment) (((value) + ((alignment) - 1)) & ~((u64)(alignment) - 1))
 
 #define AssertMemZeroed(type, data, size, format, ...) {\
     unsigned char __zeros[sizeof(type) * size] = { 0, };\
     Assert(memcmp((const void*)__zeros, (const void*)data, sizeof(type) * size) == 0, format, ##__VA_ARGS__);\
 }
 
+#define ARENA_ALIGNMENT 64 // Cache line, also keeps SIMD loads aligned
+#define POOL_NULL_INDEX UINT32_MAX
+
 typedef struct {
     u8* base;
     u32 offset, size;
 } ScratchAllocator;
 
+// One contiguous, prefaulted region that pools and long lived buffers are carved out of.
+// Allocations are never returned individually, the whole region is released on deinit.
+typedef struct {
+    u8* base;
+    u64 size;
+    _Atomic(u64) offset;
+    bool locked; // Pages are pinned in physical memory
+} HeapArena;
+
+// Fixed size blocks with O(1) lock-free alloc/free, the free list head is tagged with
+// a generation counter in the upper 32 bits to avoid ABA when used from several threads.
+typedef struct {
+    const char* name;
+    u8* base;
+    atomic_u32* nextFree;
+    u32 blockSize;
+    u32 capacity;
+    _Atomic(u64) freeHead;
+    atomic_u32 numUsed;
+    atomic_u32 highWater;
+} PoolAllocator;
+
 void ScratchAllocator_Init(ScratchAllocator* alloc, u8* base, u32 size);
 void* ScratchAllocator_Alloc(ScratchAllocator* alloc, u32 size);
 void* ScratchAllocator_Calloc(ScratchAllocator* alloc, u32 size);
 void ScratchAllocator_Release(ScratchAllocator* alloc);
 
+void HeapArena_Init(HeapArena* arena, u64 size);
+void HeapArena_Deinit(HeapArena* arena);
+void* HeapArena_Alloc(HeapArena* arena, u64 size);
+u64 HeapArena_Remaining(HeapArena* arena);
+
+void PoolAllocator_Init(PoolAllocator* pool, HeapArena* arena, const char* name, u32 blockSize, u32 capacity);
+void* PoolAllocator_Alloc(PoolAllocator* pool);
+void* PoolAllocator_Calloc(PoolAllocator* pool);
+void PoolAllocator_Free(PoolAllocator* pool, void* ptr);
+bool PoolAllocator_Owns(PoolAllocator* pool, void* ptr);
+void PoolAllocator_LogStats(PoolAllocator* pool);
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+#include <types.h>
+#include <allocator.h>
+
+// Asynchronous file reads and writes. On Linux this is io_uring, with the buffers
+// registered up front so the kernel doesn't have to pin pages per request, and each
+// batch of requests goes in with one syscall. Elsewhere, or when io_uring isn't
+// available, a few threads run plain pread/pwrite.
+//
+// Submitting, flushing, reaping and the buffer functions all belong to whichever single
+// thread drives the AsyncIo, completion callbacks run on that thread from AsyncIo_Reap.
+//
+// On flush, back to back reads on the same descriptor that touch or overlap are merged
+// into one vectored read, so a streamed file's run of chunks reaches the device as one
+// request. Each read still completes on its own with its own result. Reads through
+// different descriptors are never merged, even of the same file.
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_HAVE_URING 1
+#endif
+#endif
+
+#define ASYNC_IO_QUEUE_DEPTH 256
+#define ASYNC_IO_NUM_THREADS 4 // Threaded backend only
+#define ASYNC_IO_ALIGNMENT 4096 // Satisfies O_DIRECT on every filesystem we care about
+#define ASYNC_IO_MAX_BUFFERS 1024
+#define ASYNC_IO_MAX_MERGE 16 // Reads folded into one vectored read
+#define ASYNC_IO_MAX_MERGES (ASYNC_IO_QUEUE_DEPTH / 2) // Each takes at least two reads
+
+typedef enum {
+    ASYNC_IO_BACKEND_AUTO, // io_uring if it's there, threads otherwise
+    ASYNC_IO_BACKEND_THREADED,
+    ASYNC_IO_BACKEND_URING,
+} AsyncIoBackend;
+
+typedef enum {
+    ASYNC_IO_READ,
+    ASYNC_IO_WRITE,
+} AsyncIoOp;
+
+typedef struct AsyncIoRequest AsyncIoRequest;
+typedef void (*AsyncIoCallback)(AsyncIoRequest* request);
+
+struct AsyncIoRequest {
+    AsyncIoOp op;
+    i32 fd;
+    void* buffer;
+    u32 size;
+    u64 offset;
+    i32 bufferIndex; // Registered buffer the data lives in, or -1
+
+    AsyncIoCallback OnComplete;
+    void* data;
+    i64 result; // Bytes transferred, or -errno
+
+    AsyncIoRequest* next; // Internal
+    u8 numMerged; // Internal, reads a merged request stands in for, 0 otherwise
+};
+
+// One vectored read standing in for a run of reads, the bytes a read shares with the one
+// before it aren't read twice but copied across when the merged read lands
+typedef struct {
+    AsyncIoRequest request;
+    AsyncIoRequest* first;
+    struct iovec iovecs[ASYNC_IO_MAX_MERGE];
+    u32 overlaps[ASYNC_IO_MAX_MERGE];
+} AsyncIoMerge;
+
+typedef struct {
+    AsyncIoBackend backend;
+    u32 numInFlight;
+    u32 numQueued;
+
+    // Registered buffers carved out of the engine heap arena
+    u8* buffers;
+    u32 bufferSize;
+    u32 numBuffers;
+    u16 freeBuffers[ASYNC_IO_MAX_BUFFERS];
+    u32 numFreeBuffers;
+
+    // Queued since the last flush, merged and handed to the backend on flush
+    AsyncIoRequest* batchHead;
+    AsyncIoRequest* batchTail;
+    AsyncIoMerge merges[ASYNC_IO_MAX_MERGES];
+    u16 freeMerges[ASYNC_IO_MAX_MERGES];
+    u32 numFreeMerges;
+
+#ifdef ASYNC_IO_HAVE_URING
+    struct {
+        i32 fd;
+        bool buffersRegistered;
+        void* sqRing;
+        void* cqRing;
+        u64 sqRingSize;
+        u64 cqRingSize;
+        void* sqes;
+        u64 sqesSize;
+        atomic_u32* sqHead;
+        atomic_u32* sqTail;
+        u32* sqMask;
+        u32* sqArray;
+        atomic_u32* cqHead;
+        atomic_u32* cqTail;
+        u32* cqMask;
+        void* cqes;
+        u32 sqPending;
+    } uring;
+#endif
+
+    struct {
+        pthread_t threads[ASYNC_IO_NUM_THREADS];
+        pthread_mutex_t mutex;
+        pthread_cond_t submitted;
+        pthread_cond_t completed;
+        AsyncIoRequest* pendingHead;
+        AsyncIoRequest* pendingTail;
+        AsyncIoRequest* completedHead;
+        bool running;
+    } threaded;
+
+    // Stats
+    u64 numSubmitted;
+    u64 numBatches;
+    u64 numMergedReads; // Folded into the read before them
+    u64 bytesRead;
+    u64 bytesWritten;
+    u64 numErrors;
+} AsyncIo;
+
+void AsyncIo_Init(AsyncIo* io, HeapArena* arena, AsyncIoBackend backend, u32 numBuffers, u32 bufferSize);
+void AsyncIo_Deinit(AsyncIo* io);
+const char* AsyncIo_BackendName(AsyncIo* io);
+
+// Open for streaming, direct asks the OS to bypass its page cache (O_DIRECT / F_NOCACHE)
+i32 AsyncIo_Open(const char* path, i32 flags, bool direct);
+
+// Returns -1 when every buffer is in use
+i32 AsyncIo_AcquireBuffer(AsyncIo* io);
+void AsyncIo_ReleaseBuffer(AsyncIo* io, i32 index);
+void* AsyncIo_GetBuffer(AsyncIo* io, i32 index);
+
+// Queue a request, nothing reaches the kernel until AsyncIo_Flush. Returns false when the
+// queue is full, flush and reap then try again.
+bool AsyncIo_Queue(AsyncIo* io, AsyncIoRequest* request);
+u32 AsyncIo_Flush(AsyncIo* io);
+
+// Run completion callbacks for whatever has finished, waiting up to timeoutMs for the
+// first one if nothing has. Returns the number completed.
+u32 AsyncIo_Reap(AsyncIo* io, u32 timeoutMs);
+
+void AsyncIo_LogStats(AsyncIo* io);
@@ -1,25 +1,69 @@
 #pragma once
 
-#include <AudioToolbox/AudioToolbox.h>
+#include <pthread.h>
 #include <types.h>
 #include "core_engine.h"
+#include "record_ring.h"
+#include "wav_writer.h"
 
 #define AUDIO_RENDERER_RECORDING (1 << 0)
 #define AUDIO_RENDERER_MUTE (1 << 1)
+#define AUDIO_RENDERER_CAPTURING (1 << 2) // Keeping a rolling history, nothing goes to disk
+#define AUDIO_RENDERER_COMMIT (1 << 3) // Capture handed to the writer on the next cycle
 
+// How often the writer wakes to drain whole blocks, well inside what the ring can hold
+#define AUDIO_RENDERER_WRITE_INTERVAL_MS 50
+
+// Room past a capture's history for live cycles while the writer works through it
+#define AUDIO_RENDERER_CAPTURE_HEADROOM_FRAMES (RECORD_RING_BLOCK_FRAMES * 2)
+
+// The audio thread copies every cycle into the ring, the writer thread drains it to a WAV
+// in RECORD_RING_BLOCK_FRAMES blocks and writes out the rest once recording stops. Integer
+// formats are converted, and dithered if asked, on the writer thread.
+//
+// A capture renderer is always recording into a ring sized to its history, dropping the
+// oldest cycle as each new one comes in. Committing hands the ring over to the writer as
+// it stands, so the file starts that far back and carries on live. The file is only
+// created by the writer once committed, a capture never committed leaves nothing on disk.
 typedef struct {
-    AudioStreamBasicDescription streamFormat;
-    ExtAudioFileRef outputFile;
-    AudioBufferList* coreAudioBuffers[2];
-    atomic_u8 currentBufferIndex;
+    WavWriter file; // Writer thread only once it's running
+    char* path;
+    PcmFormat format;
+    PcmDither dither;
+    u8* encoded; // A block converted to the file's format, unused for float
     atomic_u8 flags;
-    atomic_u16 seekPosition;
-    atomic_u16 numFramesToWrite;
-    u16 framesThisCycle;
-    ThreadPool* threadPool;
+    RecordRing ring;
+    u32 historyFrames; // Capture only
+
+    // Writer thread
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_bool running;
+    atomic_bool flushRequested; // Write out everything, not just whole blocks
+
+    // Stats
+    atomic_u64 framesWritten;
+    atomic_u64 numWrites;
+    atomic_u64 maxWriteNs;
 } AudioRenderer;
 
 u16 AudioRenderer_Create(AudioRenderer* renderer, CoreEngineContext* ctx, const char* filename);
+u16 AudioRenderer_CreateWithFormat(AudioRenderer* renderer, 
+                                   CoreEngineContext* ctx, 
+                                   const char* filename, 
+                                   PcmFormat format, 
+                                   PcmDitherMode dither);
+// Holds the last historySeconds of the bus until committed
+u16 AudioRenderer_CreateCapture(AudioRenderer* renderer,
+                                CoreEngineContext* ctx,
+                                const char* filename,
+                                PcmFormat format,
+                                PcmDitherMode dither,
+                                f64 historySeconds);
 void AudioRenderer_StartRecord(AudioRenderer* renderer);
+// Capture only, records from historySeconds ago onwards until stopped
+void AudioRenderer_Commit(AudioRenderer* renderer);
+// Whatever was recorded up to here is written out shortly after, without waiting on it
 void AudioRenderer_StopRecord(AudioRenderer* renderer);
-
+void AudioRenderer_LogStats(AudioRenderer* renderer);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <types.h>
+#include "core_engine.h"
+#include "fft.h"
+#include "thread_pool.h"
+
+// Non-uniformly partitioned convolution with a stereo impulse response, for reverbs and
+// cabinet IRs, with no added latency.
+//
+// The first CONVOLVER_HEAD_FRAMES of the IR run direct form, the next stretch as uniform
+// partitions of that size in the audio callback, and what's left in tail tiers of larger
+// partitions on ThreadPool workers. A tier with partitions of P frames starts 2P into the
+// IR, so its output for a block isn't needed until a whole block after the block is in, and
+// that block is the worker's to compute it in. Short IRs never leave the audio thread.
+//
+//   direct   [0, 128)
+//   head     [128, 2048)     128 frame partitions, audio thread
+//   tier 0   [2048, 16384)   1024 frame partitions, worker
+//   tier 1   [16384, ...)    8192 frame partitions, worker
+//
+// A worker running late costs a block of that tier's output rather than blocking, and is
+// counted. Create allocates from the engine arena, keep it off the audio thread.
+
+#define CONVOLVER_HEAD_FRAMES 128
+#define CONVOLVER_NUM_TIERS 2
+#define CONVOLVER_TIER_SLOTS 4 // Blocks in flight between the audio thread and a worker
+
+// One run of equal partitions, overlap save with a frequency domain delay line. Left and
+// right go through each transform together as its real and imaginary parts.
+typedef struct {
+    u32 blockFrames; // Partition size, transforms are twice it
+    u32 offset; // Into the IR of the first partition
+    u32 numPartitions;
+    u32 numBins; // blockFrames + 1, of each channel's half spectrum
+    Fft fft;
+
+    // Per partition, left bins then right, real and imaginary apart
+    f32* irRe;
+    f32* irIm;
+    f32* fdlRe; // Input spectra, the newest at fdlHead
+    f32* fdlIm;
+    u32 fdlHead;
+
+    f32* previous; // Last block in, left then right
+    f32* re;
+    f32* im;
+    f32* sumRe; // Left bins then right
+    f32* sumIm;
+} ConvolverSegment;
+
+typedef struct {
+    ConvolverSegment segment;
+    ThreadPool* threadPool;
+
+    // Interleaved blocks, the audio thread fills an input slot and hands it over, the worker
+    // writes the block's output to the output slot of the same number
+    f32* inSlots;
+    f32* outSlots;
+    u64 inBlocks[CONVOLVER_TIER_SLOTS]; // Which block each input slot holds
+    atomic_u64 outBlocks[CONVOLVER_TIER_SLOTS]; // Which block each output slot holds, set last
+    atomic_u64 numSubmitted;
+    atomic_u64 numConsumed;
+
+    // Audio thread
+    u64 block; // Being filled
+    bool filling; // Gets handed over when full, no slot was free if not
+    bool playing; // Output of block - 2 is ready and playing
+
+    // Worker
+    atomic_bool busy; // Tasks can land on two workers, only one runs the tier
+    u64 lastBlock;
+
+    // Stats
+    atomic_u64 numLateBlocks; // Not ready in time and went unplayed
+    atomic_u64 maxProcessNs;
+} ConvolverTier;
+
+typedef struct {
+    u32 irFrames;
+    u64 frame; // Audio thread, frames since the start
+
+    // Direct form, taps reversed and the history doubled up so every dot product is one run
+    f32* taps; // Left then right
+    f32* history;
+    u32 historyPos;
+
+    ConvolverSegment head;
+    f32* headIn; // Interleaved block being gathered
+    f32* headOut; // Interleaved output of the last block, playing now
+
+    ConvolverTier tiers[CONVOLVER_NUM_TIERS];
+    u32 numTiers;
+
+    atomic_f32 dry;
+    atomic_f32 wet;
+} Convolver;
+
+// The IR is read through WavFile and resampled to SAMPLE_RATE_DEFAULT if it isn't already,
+// a mono IR is used on both sides
+u16 Convolver_Create(Convolver* conv, CoreEngineContext* ctx, const char* irPath);
+// From interleaved stereo already at SAMPLE_RATE_DEFAULT, which isn't kept and can be freed after
+u16 Convolver_CreateFromFrames(Convolver* conv, CoreEngineContext* ctx, const f32* ir, u32 numFrames);
+// Fully wet by default
+void Convolver_SetMix(Convolver* conv, f32 dry, f32 wet);
+void Convolver_LogStats(Convolver* conv);
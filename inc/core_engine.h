@@ -11,6 +11,10 @@
 
 #include <types.h>
 #include <thread_pool.h>
+#include <load_monitor.h>
+#include <stream_scheduler.h>
+#include <async_io.h>
+#include <sample_cache.h>
 
 #define MAX_PROCESSORS 4096
 #define MAX_TASKS 256
@@ -18,6 +22,11 @@
 #define STACK_ARENA_SIZE_KB 512
 #define DEFAULT_HEAP_ARENA_SIZE_KB 30000
 
+#define MAX_POOLS 32
+#define DEFAULT_POOL_CAPACITY 16
+#define AUDIO_CHUNK_POOL_HEAP_SHARE 4 // A quarter of the heap arena backs streaming chunks
+#define ASYNC_IO_BUFFER_HEAP_SHARE 8 // And an eighth is registered for async reads into them
+
 #define BUFFER_SIZE 1024 // TODO: make configurable
 #define SAMPLE_RATE_DEFAULT 48000
 
@@ -38,6 +47,7 @@ typedef void (*DestroyFunc)(void* data);
 
 typedef struct {
     u16 inputRoutingMask, outputRoutingMask;
+    u8 priority; // ProcessorPriority, decides what gets bypassed under overload
     void* procData;
     ProcessFunc Process;
     OnNewAudioCycleFunc OnNewAudioCycle;
@@ -55,8 +65,11 @@ typedef struct {
     pthread_cond_t cond;
 
     // Allocators
-    void* heapArena;
-    // TODO: bucket arena allocator
+    HeapArena heapArena;
+    PoolAllocator pools[MAX_POOLS];
+    _Atomic(u8) numPools; // Added to under poolMutex, published so frees can look without it
+    pthread_mutex_t poolMutex;
+    PoolAllocator* chunkPool; // AUDIO_FILE_CHUNK_SIZE stereo streaming buffers
     u8 scratchArena[STACK_ARENA_SIZE_KB * 1024];
     ScratchAllocator scratchAllocator;
 
@@ -68,11 +81,28 @@ typedef struct {
     // Thread Pool
     ThreadPool threadPool;
 
+    // Disk streaming, shared by every streamed file
+    StreamScheduler streamScheduler;
+    AsyncIo asyncIo;
+
+    // Decoded short samples shared between players
+    SampleCache sampleCache;
+
+    // Deadline tracking and load shedding
+    LoadMonitor loadMonitor;
+
     // CoreAudio audio unit
     AudioUnit caUnit;
     AudioStreamBasicDescription streamFormat;
 } CoreEngineContext;
 
+// Allocate processor state from the engine heap arena, one pool per type
+#define CoreEngine_New(ctx, type) ((type*)CoreEngine_PoolAlloc(ctx, #type, sizeof(type)))
+#define CoreEngine_Delete(ctx, ptr) do {\
+    CoreEngine_PoolFree(ctx, ptr);\
+    (ptr) = NULL;\
+} while (0)
+
 // Core Engine Functions
 void CoreEngine_Init(CoreEngineContext* ctx, f32 masterVolumeScale, u64 heapArenaSizeKb);
 void CoreEngine_Deinit(CoreEngineContext* ctx);
@@ -82,7 +112,13 @@ void CoreEngine_AddSource(CoreEngineContext* ctx, u16 id);
 u16 CoreEngine_CreateProcessor(CoreEngineContext* ctx, ProcessFunc procFunc, DestroyFunc destroyFunc, OnNewAudioCycleFunc onNewAudioCycleFunc, void* data);
 void CoreEngine_RemoveProcessor(CoreEngineContext* ctx, u16 id);
 void CoreEngine_Route(CoreEngineContext* ctx, u16 inputId, u16 outputId, bool shouldRoute);
+void CoreEngine_SetPriority(CoreEngineContext* ctx, u16 id, ProcessorPriority priority);
 void CoreEngine_SubmitTask(CoreEngineContext* ctx, TaskInfo task);
 void CoreEngine_Panic(CoreEngineContext* ctx);
+PoolAllocator* CoreEngine_CreatePool(CoreEngineContext* ctx, const char* name, u32 blockSize, u32 capacity);
+PoolAllocator* CoreEngine_GetPool(CoreEngineContext* ctx, const char* name, u32 blockSize);
+void* CoreEngine_PoolAlloc(CoreEngineContext* ctx, const char* name, u32 size);
+void CoreEngine_PoolFree(CoreEngineContext* ctx, void* ptr);
+void CoreEngine_LogMemoryStats(CoreEngineContext* ctx);
 void CoreEngine_GlobalPanic(void);
 
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <types.h>
+#include "core_engine.h"
+#include "delay_line.h"
+
+// Delay, chorus and flanger processors over DelayLine. Settings are atomics, safe to set from
+// any thread, and picked up at the next cycle. Each works through its cycle in runs as long
+// as its shortest delay allows, reading every tap for a run before writing it. Dry and wet
+// start at 1 and 0.5. Create carves the line out of the engine arena, keep it off the audio
+// thread.
+//
+// Chorus and flanger lines have room for their longest sweep at DELAY_EFFECT_MAX_RATE_FACTOR
+// times the engine rate, so they sound the same inside an Oversampler. Past that the sweep is
+// scaled down to fit, as delay times are clamped to the maximum given at create.
+
+#define DELAY_EFFECT_GLIDE_SECONDS 0.05 // Time changes slide over about this long, tape style
+#define DELAY_EFFECT_MAX_FEEDBACK 0.98f
+#define DELAY_EFFECT_MAX_RATE_FACTOR 8 // An 8x Oversampler
+
+#define CHORUS_MAX_VOICES 8
+#define CHORUS_CENTRE_SECONDS 0.015
+#define CHORUS_MAX_DEPTH_SECONDS 0.01
+
+#define FLANGER_MIN_DELAY_SECONDS 0.0005 // The bottom of the sweep, runs stay a couple of dozen frames
+#define FLANGER_MAX_DEPTH_SECONDS 0.01
+#define FLANGER_MAX_FEEDBACK 0.95f
+
+// Feedback delay, each side its own time. Allpass reads keep repeats from dulling as they go
+// round, and the times glide when set so moving them bends the pitch rather than clicking.
+typedef struct {
+    DelayLine line;
+    DelayTapState tap;
+    f32 maxFrames;
+    f64 delayFrames[2]; // Audio thread, gliding toward the set times, f64 so the last of it isn't lost
+
+    atomic_f32 timeLeft; // Seconds
+    atomic_f32 timeRight;
+    atomic_f32 feedback;
+    atomic_f32 dry;
+    atomic_f32 wet;
+} DelayEffect;
+
+// A few voices each swept by its own LFO, phases spread evenly and the right side a quarter
+// cycle on from the left for width. Cubic reads, the sweep moves them between frames all the time.
+typedef struct {
+    DelayLine line;
+    f32 maxFrames;
+    u32 numVoices;
+    DelayLfo lfos[CHORUS_MAX_VOICES];
+
+    atomic_f32 rateHz;
+    atomic_f32 depthSeconds;
+    atomic_f32 dry;
+    atomic_f32 wet;
+} Chorus;
+
+// One short swept tap with feedback, negative feedback for the hollower sound. Linear reads,
+// the comb is what's heard and the sweep covers the softening.
+typedef struct {
+    DelayLine line;
+    f32 maxFrames;
+    DelayLfo lfo;
+
+    atomic_f32 rateHz;
+    atomic_f32 depthSeconds;
+    atomic_f32 feedback;
+    atomic_f32 dry;
+    atomic_f32 wet;
+} Flanger;
+
+u16 DelayEffect_Create(DelayEffect* delay, CoreEngineContext* ctx, f64 maxSeconds, f64 timeLeft, f64 timeRight, f32 feedback);
+// Times are clamped to the maximum given at create
+void DelayEffect_Set(DelayEffect* delay, f64 timeLeft, f64 timeRight, f32 feedback);
+void DelayEffect_SetMix(DelayEffect* delay, f32 dry, f32 wet);
+
+u16 Chorus_Create(Chorus* chorus, CoreEngineContext* ctx, u32 numVoices, f32 rateHz, f32 depthSeconds);
+void Chorus_Set(Chorus* chorus, f32 rateHz, f32 depthSeconds);
+void Chorus_SetMix(Chorus* chorus, f32 dry, f32 wet);
+
+u16 Flanger_Create(Flanger* flanger, CoreEngineContext* ctx, f32 rateHz, f32 depthSeconds, f32 feedback);
+void Flanger_Set(Flanger* flanger, f32 rateHz, f32 depthSeconds, f32 feedback);
+void Flanger_SetMix(Flanger* flanger, f32 dry, f32 wet);
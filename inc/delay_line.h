@@ -0,0 +1,65 @@
+#pragma once
+
+#include <types.h>
+#include <allocator.h>
+
+// Stereo delay line for time based effects. The ring is a power of two carved out of the
+// engine arena, so a write is a masked store and nothing allocates or faults on the audio
+// thread however long the delay.
+//
+// Reads come before the writes of the same frames and look back from them by a per frame,
+// per channel delay, fractional, so modulation is whatever fills the delays: an LFO, an
+// envelope, or another processor's output. Linear and cubic reads gather the neighbours
+// for a run of frames first and then interpolate the whole run with vector math. Allpass
+// reads are a recursion through the previous output, one frame at a time, and best kept to
+// delays that move slowly such as tuned feedback.
+//
+// A run read before its write has to keep clear of its own frames, DelayLine_MaxRun gives
+// how many frames that allows for the shortest delay in play.
+
+#define DELAY_LINE_MIN_DELAY_FRAMES 3.0f // Cubic reads need two frames past the read point
+#define DELAY_LINE_MAX_RUN_FRAMES 256 // Frames per read, bounds the gather scratch
+
+typedef enum {
+    DELAY_INTERP_LINEAR,
+    DELAY_INTERP_CUBIC, // Four point Hermite, flatter top end for chorus and pitch effects
+    DELAY_INTERP_ALLPASS, // First order Thiran, all pass so nothing is dulled in feedback
+
+    DELAY_INTERP_COUNT,
+} DelayInterp;
+
+typedef struct {
+    f32* left;
+    f32* right;
+    u32 capacity;
+    u32 mask;
+    u32 writePos; // Of the next frame, wraps through mask
+} DelayLine;
+
+// What an allpass read carries over from one run to the next, one per tap
+typedef struct {
+    f32 lastOut[2];
+} DelayTapState;
+
+// Sine LFO for modulating delay times, phase in cycles
+typedef struct {
+    f64 phase;
+} DelayLfo;
+
+// Room for delays up to maxDelayFrames, arena memory for the life of the engine
+void DelayLine_Init(DelayLine* line, HeapArena* arena, u32 maxDelayFrames);
+void DelayLine_Clear(DelayLine* line);
+
+// Longest run a read then write can take with minDelayFrames the shortest delay in it
+u32 DelayLine_MaxRun(f32 minDelayFrames);
+
+// numFrames of interleaved output for the frames about to be written, delays are interleaved
+// too and between DELAY_LINE_MIN_DELAY_FRAMES and the line's maximum. state is only used by
+// allpass reads and may be NULL otherwise.
+void DelayLine_Read(const DelayLine* line, DelayInterp interp, const f32* delays, u32 numFrames, DelayTapState* state, f32* output);
+// Interleaved, numFrames of input after the reads for them
+void DelayLine_Write(DelayLine* line, const f32* input, u32 numFrames);
+
+// Fills interleaved delays swinging depthFrames either side of centreFrames, the right
+// channel phaseOffset cycles ahead of the left
+void DelayLfo_Fill(DelayLfo* lfo, f64 rateHz, f64 sampleRate, f32 centreFrames, f32 depthFrames, f64 phaseOffset, u32 numFrames, f32* delays);
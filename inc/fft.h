@@ -0,0 +1,40 @@
+#pragma once
+
+#include <types.h>
+#include <allocator.h>
+
+// Radix-2 complex FFT on split real and imaginary arrays, with the first two stages done as
+// radix 4 and the rest vectorised. The bit reversal and twiddles are tabulated at init for
+// one size, in arena memory, so keep init off the audio thread.
+//
+// Neither direction scales, Fft_Inverse(Fft_Forward(x)) is x * size.
+//
+// A real signal of twice the size goes through a transform of size by way of
+// Fft_ForwardReal, for size + 1 bins, and Fft_InverseReal(Fft_ForwardReal(x)) is x * size.
+//
+// Two real signals go through one transform packed as re + i * im, Fft_SplitReal takes
+// their half spectra back apart and Fft_JoinReal puts two half spectra back together so
+// one inverse gives both signals.
+
+typedef struct {
+    u32 size;
+    u32* bitReverse;
+    f32* cosTable; // Each stage's twiddles in a row, the stage of half size h at h - 1, up to size
+    f32* sinTable;
+} Fft;
+
+// size must be a power of two, arena memory for the life of the engine
+void Fft_Init(Fft* fft, HeapArena* arena, u32 size);
+
+void Fft_Forward(const Fft* fft, f32* re, f32* im);
+void Fft_Inverse(const Fft* fft, f32* re, f32* im);
+
+// size * 2 real samples in, re and im need room for size + 1 bins
+void Fft_ForwardReal(const Fft* fft, const f32* input, f32* re, f32* im);
+// Back from size + 1 bins to size * 2 samples, re and im are used as scratch
+void Fft_InverseReal(const Fft* fft, f32* re, f32* im, f32* output);
+
+// From the transform of a + i * b, the size / 2 + 1 bins of each of a and b scaled by two
+void Fft_SplitReal(const Fft* fft, const f32* re, const f32* im, f32* aRe, f32* aIm, f32* bRe, f32* bIm);
+// The other way, the whole spectrum of a + i * b from the half spectra of a and b
+void Fft_JoinReal(const Fft* fft, const f32* aRe, const f32* aIm, const f32* bRe, const f32* bIm, f32* re, f32* im);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <types.h>
+
+// Reads interleaved stereo f32 at fractional positions, for playback at any speed. The read
+// position moves on by a rate which can itself ramp, one step per output frame.
+//
+// Every mode reads the same span around a position so a caller's buffer works for all of
+// them: INTERPOLATOR_HISTORY frames before the integer part and INTERPOLATOR_AHEAD after.
+
+typedef enum {
+    INTERPOLATION_LINEAR,
+    INTERPOLATION_CUBIC, // Catmull-Rom Hermite over 4 frames
+    INTERPOLATION_SINC, // 8 tap windowed sinc, for pitching down without dulling
+
+    INTERPOLATION_COUNT,
+} Interpolation;
+
+#define INTERPOLATOR_HISTORY 3
+#define INTERPOLATOR_AHEAD 4
+#define INTERPOLATOR_SPAN (INTERPOLATOR_HISTORY + 1 + INTERPOLATOR_AHEAD)
+
+// Builds the sinc table, once per process, keep it off the audio thread
+void Interpolator_Init(void);
+
+// Adds numFrames into dst, the first read at position in src. Returns the position after.
+f64 Interpolator_Process(Interpolation mode, 
+                         const f32* src, 
+                         f64 position, 
+                         f64 rate, 
+                         f64 rateStep, 
+                         u32 numFrames, 
+                         f32* dst);
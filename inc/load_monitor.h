@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <types.h>
+
+#define LOAD_NEAR_MISS_RATIO 0.8f // Cycles using more than this much of the budget count as near misses
+#define LOAD_SHED_RATIO 0.9f // Smoothed load above this sheds the next priority class
+#define LOAD_RESTORE_RATIO 0.6f // Smoothed load below this for a while restores one class
+#define LOAD_RESTORE_CYCLES 500
+#define LOAD_ESCALATE_HOLD_CYCLES 16 // Give shedding time to take effect before shedding more
+#define LOAD_SMOOTHING 0.05f
+
+// Lower values are more important, CRITICAL processors are never shed. A shed processor is
+// bypassed, its input passing through untouched, so gain and mix stages must be CRITICAL or a
+// muted channel jumps to unity gain under overload. Processors start CRITICAL, so sources and
+// the main signal path keep playing however far shedding goes, and only those that opt in
+// with a lower priority, effects the mix can do without for a while, are ever shed.
+typedef enum {
+    PROCESSOR_PRIORITY_CRITICAL,
+    PROCESSOR_PRIORITY_HIGH,
+    PROCESSOR_PRIORITY_NORMAL,
+    PROCESSOR_PRIORITY_LOW,
+
+    NUM_PROCESSOR_PRIORITIES,
+} ProcessorPriority;
+
+typedef struct {
+    // Stats, written by the audio thread and safe to read from anywhere
+    atomic_u64 numCycles;
+    atomic_u64 numXruns; // Cycles that overran their budget
+    atomic_u64 numNearMisses;
+    atomic_u64 numDeviceXruns; // Gaps in the device sample clock
+    atomic_f32 load; // Smoothed ratio of cycle time to budget
+    atomic_f32 peakLoad;
+
+    // Number of priority classes currently bypassed, counted from the lowest
+    atomic_u8 shedLevel;
+
+    // Audio thread only
+    u32 calmCycles;
+    u32 holdCycles;
+    f64 expectedSampleTime;
+    bool haveSampleTime;
+} LoadMonitor;
+
+void LoadMonitor_Init(LoadMonitor* monitor);
+bool LoadMonitor_EndCycle(LoadMonitor* monitor, u64 elapsedNs, u64 budgetNs);
+bool LoadMonitor_CheckTimestamp(LoadMonitor* monitor, f64 sampleTime, u32 numFrames);
+bool LoadMonitor_ShouldBypass(LoadMonitor* monitor, u8 priority);
+void LoadMonitor_LogStats(LoadMonitor* monitor);
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <types.h>
 
 #define ANSI_COLOR_RED     "\x1b[31m"
@@ -13,24 +14,75 @@
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+// Numeric levels so they can be compared by the preprocessor
+#define LOG_LEVEL_TEST 0
+#define LOG_LEVEL_TRACE 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_ERROR 4
+
+// Anything below this level is compiled out completely, e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TEST
+#endif
+
+#define LOG_MAX_THREADS 32
+#define LOG_RING_CAPACITY 256 // Records per thread, must be a power of two
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_BYTES 96 // Inline storage for %s arguments
+#define LOG_FLUSH_INTERVAL_MS 10
+
 typedef enum {
-    LOG_TEST,
-    LOG_TRACE,
-    LOG_INFO,
-    LOG_WARNING,
-    LOG_ERROR,
+    LOG_TEST = LOG_LEVEL_TEST,
+    LOG_TRACE = LOG_LEVEL_TRACE,
+    LOG_INFO = LOG_LEVEL_INFO,
+    LOG_WARNING = LOG_LEVEL_WARNING,
+    LOG_ERROR = LOG_LEVEL_ERROR,
     LOG_SUPPRESSED,
 
     LOG_NUM_LEVELS,
 } LogLevel;
 
-// TODO: filename/line etc
+// Everything about a log statement that is known at compile time, one static instance per call site
+typedef struct {
+    LogLevel level;
+    bool raw;
+    const char* file;
+    i32 line;
+    const char* format;
+} LogSite;
+
+// Compact binary record, formatting into text is deferred to the logger thread
+typedef struct {
+    const LogSite* site;
+    u64 timestampNs;
+    u8 numArgs;
+    u8 stringBytes;
+    u8 argTypes[LOG_MAX_ARGS];
+    u64 args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES];
+} LogRecord;
+
+// Single producer (owning thread), single consumer (logger thread)
+typedef struct {
+    LogRecord records[LOG_RING_CAPACITY];
+    atomic_u64 head;
+    atomic_u64 tail;
+    atomic_u64 dropped;
+    u64 droppedReported;
+    atomic_u8 state;
+} LogRing;
+
+#define _LogAt(level, isRaw, format, ...) do {\
+    static const LogSite __logSite = { level, isRaw, __FILE__, __LINE__, format };\
+    _LogMessage(&__logSite, ##__VA_ARGS__);\
+} while (0)
 
 #define LogOnce(level, format, ...) {\
     static bool __init = false;\
     if (!__init) {\
         __init = true;\
-        _LogMessage(level, __FILE__, __LINE__, format, ##__VA_ARGS__);\
+        _LogAt(level, false, format, ##__VA_ARGS__);\
     }\
 }
 
@@ -40,39 +92,70 @@ long long GetTimeMs();
     static long long next = 0;\
     long long current = GetTimeMs();\
     if (current >= next) {\
-        _LogMessage(level, __FILE__, __LINE__, format, ##__VA_ARGS__);\
+        _LogAt(level, false, format, ##__VA_ARGS__);\
         next = current + periodMs;\
     }\
 }
 
-
-#define LogTest(format, ...) _LogMessage(LOG_TEST, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define LogTrace(format, ...) _LogMessage(LOG_TRACE, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define LogInfo(format, ...) _LogMessage(LOG_INFO, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define LogWarn(format, ...) _LogMessage(LOG_WARNING, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define LogError(format, ...) _LogMessage(LOG_ERROR, __FILE__, __LINE__, format, ##__VA_ARGS__)
-
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TEST
+#define LogTest(format, ...) _LogAt(LOG_TEST, false, format, ##__VA_ARGS__)
 #define LogTestOnce(format, ...) LogOnce(LOG_TEST, format, ##__VA_ARGS__)
-#define LogTraceOnce(format, ...) LogOnce(LOG_TRACE, format, ##__VA_ARGS__)
-#define LogInfoOnce(format, ...) LogOnce(LOG_INFO, format, ##__VA_ARGS__)
-#define LogWarnOnce(format, ...) LogOnce(LOG_WARNING, format, ##__VA_ARGS__)
-#define LogErrorOnce(format, ...) LogOnce(LOG_ERROR, format, ##__VA_ARGS__)
-
 #define LogTestPeriodic(periodMs, format, ...) LogPeriodic(LOG_TEST, periodMs, format, ##__VA_ARGS__)
+#else
+#define LogTest(format, ...) do {} while (0)
+#define LogTestOnce(format, ...) do {} while (0)
+#define LogTestPeriodic(periodMs, format, ...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+#define LogTrace(format, ...) _LogAt(LOG_TRACE, false, format, ##__VA_ARGS__)
+#define LogTraceOnce(format, ...) LogOnce(LOG_TRACE, format, ##__VA_ARGS__)
 #define LogDebugPeriodic(periodMs, format, ...) LogPeriodic(LOG_TRACE, periodMs, format, ##__VA_ARGS__)
+#else
+#define LogTrace(format, ...) do {} while (0)
+#define LogTraceOnce(format, ...) do {} while (0)
+#define LogDebugPeriodic(periodMs, format, ...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LogInfo(format, ...) _LogAt(LOG_INFO, false, format, ##__VA_ARGS__)
+#define LogInfoOnce(format, ...) LogOnce(LOG_INFO, format, ##__VA_ARGS__)
 #define LogInfoPeriodic(periodMs, format, ...) LogPeriodic(LOG_INFO, periodMs, format, ##__VA_ARGS__)
+#define LogInfoRaw(format, ...) _LogAt(LOG_INFO, true, format, ##__VA_ARGS__)
+#else
+#define LogInfo(format, ...) do {} while (0)
+#define LogInfoOnce(format, ...) do {} while (0)
+#define LogInfoPeriodic(periodMs, format, ...) do {} while (0)
+#define LogInfoRaw(format, ...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARNING
+#define LogWarn(format, ...) _LogAt(LOG_WARNING, false, format, ##__VA_ARGS__)
+#define LogWarnOnce(format, ...) LogOnce(LOG_WARNING, format, ##__VA_ARGS__)
 #define LogWarnPeriodic(periodMs, format, ...) LogPeriodic(LOG_WARNING, periodMs, format, ##__VA_ARGS__)
+#define LogWarnRaw(format, ...) _LogAt(LOG_WARNING, true, format, ##__VA_ARGS__)
+#else
+#define LogWarn(format, ...) do {} while (0)
+#define LogWarnOnce(format, ...) do {} while (0)
+#define LogWarnPeriodic(periodMs, format, ...) do {} while (0)
+#define LogWarnRaw(format, ...) do {} while (0)
+#endif
+
+#define LogError(format, ...) _LogAt(LOG_ERROR, false, format, ##__VA_ARGS__)
+#define LogErrorOnce(format, ...) LogOnce(LOG_ERROR, format, ##__VA_ARGS__)
 #define LogErrorPeriodic(periodMs, format, ...) LogPeriodic(LOG_ERROR, periodMs, format, ##__VA_ARGS__)
-
-#define LogInfoRaw(format, ...) _LogRaw(LOG_INFO, format, ##__VA_ARGS__)
-#define LogWarnRaw(format, ...) _LogRaw(LOG_WARNING, format, ##__VA_ARGS__)
-#define LogErrorRaw(format, ...) _LogRaw(LOG_ERROR, format, ##__VA_ARGS__)
+#define LogErrorRaw(format, ...) _LogAt(LOG_ERROR, true, format, ##__VA_ARGS__)
 
 #define Assert(cond, format, ...) _Assert(cond, #cond, __FILE__, __LINE__, format, ##__VA_ARGS__)
 
 void _Assert(bool condition, const char* condString, const char* file, i32 line, const char* format, ...);
-void _LogRaw(LogLevel level, const char* format, ...);
-void _LogMessage(LogLevel level, const char* file, i32 line, const char* format, ...);
+void _LogMessage(const LogSite* site, ...);
 
 void RegisterAssertHandler(void (*handler)(char const*, const char*, i32));
 void SetLogLevel(LogLevel level);
+
+// Background formatting and output, until started every message is written synchronously
+void Logger_Start(void);
+void Logger_Stop(void);
+void Logger_Flush(void);
+u64 Logger_GetDroppedCount(void);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <pthread.h>
+#include <types.h>
+#include "core_engine.h"
+#include "record_ring.h"
+#include "wav_writer.h"
+
+#define MULTITRACK_MAX_TRACKS 64
+#define MULTITRACK_MAX_PATH 1024
+#define MULTITRACK_RING_FRAMES (1 << 17) // 1 MB a track, about 2.7 seconds at 48 kHz
+#define MULTITRACK_BATCH_BYTES (4 * 1024 * 1024) // Most an interleaved write gathers at once
+
+// How often the writer wakes to drain whole blocks, well inside what a ring can hold
+#define MULTITRACK_WRITE_INTERVAL_MS 50
+
+typedef enum {
+    MULTITRACK_FILE_PER_TRACK, // A stereo file for each track
+    MULTITRACK_INTERLEAVED, // One file with a channel pair per track, in the order they were added
+} MultitrackLayout;
+
+typedef struct MultitrackRecorder MultitrackRecorder;
+
+typedef struct {
+    MultitrackRecorder* recorder;
+    RecordRing ring;
+    WavWriter file; // Per track layout only
+    PcmDither dither;
+    u32 index;
+    atomic_u64 framesWritten;
+} MultitrackTrack;
+
+// Records stems with one writer thread for every track. Each track is a tap processor that
+// copies its bus into its own ring, the writer visits the rings in turn and writes whole
+// blocks, so a session of many stems is a few large sequential writes a wake rather than a
+// stream per bus. Taps latch recording at the start of each cycle so every track starts
+// and stops on the same frame. A cycle goes into every ring or none of them, if one track
+// has fallen too far behind the cycle is dropped from all and counted once, so the stems
+// stay the same length and in line with each other.
+//
+// Tracks are added before the first StartRecord, and the taps removed or the engine
+// stopped before Deinit.
+struct MultitrackRecorder {
+    MultitrackLayout layout;
+    PcmFormat format;
+    PcmDitherMode ditherMode;
+    HeapArena arena; // Rings and staging, prefaulted so the taps never fault
+    MultitrackTrack tracks[MULTITRACK_MAX_TRACKS];
+    atomic_u32 numTracks;
+    u32 maxTracks;
+    char filename[MULTITRACK_MAX_PATH]; // Interleaved layout, opened on the first StartRecord
+    WavWriter file;
+    u32 batchFrames; // Interleaved frames gathered a write
+    u8* interleaved;
+    u8* encoded; // A track's block converted to the file's format, unused for float
+
+    atomic_bool recording;
+    bool cycleRecording; // Audio thread, what every tap goes by this cycle
+    bool cycleChecked; // Audio thread, every ring has been checked for room this cycle
+
+    // Writer thread
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_bool running;
+    atomic_bool flushRequested; // Write out everything, not just whole blocks
+
+    // Stats
+    atomic_u64 bytesWritten;
+    atomic_u64 numWrites;
+    atomic_u64 writeNs; // Time spent in writes
+    atomic_u64 maxWriteNs;
+    atomic_u64 numSkippedCycles; // Dropped from every track because one ring was full
+    atomic_u64 numSkippedFrames;
+    u64 startNs; // First StartRecord
+};
+
+// filename is the interleaved file, NULL for one file per track
+void MultitrackRecorder_Init(MultitrackRecorder* recorder,
+                             MultitrackLayout layout,
+                             const char* filename,
+                             PcmFormat format,
+                             PcmDitherMode dither,
+                             u32 maxTracks);
+// Drains and closes every file
+void MultitrackRecorder_Deinit(MultitrackRecorder* recorder);
+// Returns the tap processor to route the track's bus into, filename is the track's own
+// file and NULL when interleaved
+u16 MultitrackRecorder_AddTrack(MultitrackRecorder* recorder, CoreEngineContext* ctx, const char* filename);
+void MultitrackRecorder_StartRecord(MultitrackRecorder* recorder);
+// Whatever was recorded up to here is written out shortly after, without waiting on it
+void MultitrackRecorder_StopRecord(MultitrackRecorder* recorder);
+// Sustained MB/s since the first StartRecord
+f64 MultitrackRecorder_MegabytesPerSecond(MultitrackRecorder* recorder);
+// Aggregate throughput and how far behind the writer each track has been
+void MultitrackRecorder_LogStats(MultitrackRecorder* recorder);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <types.h>
+#include "core_engine.h"
+
+// Runs an inner ProcessFunc at 2, 4 or 8 times the engine rate so a nonlinearity has room
+// above the audio band for the harmonics it makes, which are filtered off on the way back
+// down rather than folding into it. Each doubling is a half-band FIR split into its two
+// polyphase branches: every other tap of a half-band filter is zero and the centre one is a
+// half, so one branch is a plain delay and only the other needs a dot product, vectorised
+// across the taps for both channels at once.
+//
+// Going up and back down delays the signal by Oversampler_LatencyFrames at the engine rate,
+// a whole number at 2x and a fraction past it higher up, for whoever lines things up.
+// Create allocates from the engine arena, keep it off the audio thread.
+
+#define OVERSAMPLER_MAX_STAGES 3 // Up to 8x
+#define OVERSAMPLER_BLOCK_FRAMES 256 // Engine frames per inner call, bounds the buffers
+#define OVERSAMPLER_FIRST_TAPS 32 // Nonzero taps of the first stage, which has to be steepest
+#define OVERSAMPLER_LATER_TAPS 16 // Later stages have more room between band and image
+
+// One doubling, the way up and the way back down. History is planar, left then right, and
+// doubled up so the taps always run over one contiguous stretch.
+typedef struct {
+    u32 numTaps;
+    f32* taps; // The nonzero odd taps doubled, reversed to run oldest first
+    f32* upHistory; // Lower rate input
+    f32* evenHistory; // Higher rate input, even frames
+    f32* oddHistory; // And odd frames
+    u32 upPos;
+    u32 downPos;
+    f32* buffer; // Interleaved at this stage's higher rate
+} OversamplerStage;
+
+typedef struct {
+    u32 factor;
+    u32 numStages;
+    ProcessFunc Inner;
+    void* innerData;
+    OversamplerStage stages[OVERSAMPLER_MAX_STAGES];
+    f32 latencyFrames;
+} Oversampler;
+
+// factor is 2, 4 or 8. The inner function sees the engine rate times factor and blocks of up
+// to OVERSAMPLER_BLOCK_FRAMES * factor, and processes in place like any processor.
+u16 Oversampler_Create(Oversampler* os, CoreEngineContext* ctx, u32 factor, ProcessFunc Inner, void* innerData);
+// Engine frames from a frame going in to it coming out
+f32 Oversampler_LatencyFrames(const Oversampler* os);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string.h>
+#include <types.h>
+
+// Sample format conversion between file PCM and the engine's interleaved stereo f32
+
+typedef enum {
+    PCM_FORMAT_S16,
+    PCM_FORMAT_S24,
+    PCM_FORMAT_S32,
+    PCM_FORMAT_F32,
+
+    PCM_FORMAT_COUNT,
+} PcmFormat;
+
+#define PCM_S16_SCALE (1.0f / 32768.0f)
+#define PCM_S24_SCALE (1.0f / 8388608.0f)
+#define PCM_S32_SCALE (1.0f / 2147483648.0f)
+
+// Dither added when quantising to integer PCM, in steps of the target format
+typedef enum {
+    PCM_DITHER_NONE,
+    PCM_DITHER_TPDF, // Triangular +-1 step, leaves the error as flat noise unrelated to the signal
+    PCM_DITHER_SHAPED, // TPDF with the error fed back, moves the noise up out of the low end
+
+    PCM_DITHER_COUNT,
+} PcmDitherMode;
+
+// Noise and error feedback carried from one block to the next, one per stream being encoded
+typedef struct {
+    PcmDitherMode mode;
+    u32 random;
+    f32 error[2]; // Per channel, last quantisation error in steps
+} PcmDither;
+
+// Little endian loads, file data has no alignment guarantees
+
+static inline f32 Pcm_LoadS16(const u8* src)
+{
+    return (f32)(i16)((u16)src[0] | ((u16)src[1] << 8)) * PCM_S16_SCALE;
+}
+
+static inline f32 Pcm_LoadS24(const u8* src)
+{
+    // Shift into the top of an i32 so the sign comes along
+    i32 value = (i32)(((u32)src[0] << 8) | ((u32)src[1] << 16) | ((u32)src[2] << 24)) >> 8;
+    return (f32)value * PCM_S24_SCALE;
+}
+
+static inline f32 Pcm_LoadS32(const u8* src)
+{
+    i32 value = (i32)((u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24));
+    return (f32)value * PCM_S32_SCALE;
+}
+
+static inline f32 Pcm_LoadF32(const u8* src)
+{
+    f32 value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+u16 Pcm_BytesPerSample(PcmFormat format);
+const char* Pcm_FormatName(PcmFormat format);
+
+// Convert numFrames interleaved frames of numChannels to stereo f32, mono is copied to both
+// sides and anything past the first two channels is dropped
+void Pcm_DecodeStereo(PcmFormat format, const u8* src, u16 numChannels, u32 numFrames, f32* dst);
+
+// Samples held in memory can stay in their source width rather than being widened to f32,
+// anything without a smaller lossless form is kept as f32
+PcmFormat Pcm_CompactFormat(PcmFormat sourceFormat);
+
+// Interleaved stereo f32 to the given format, rounded to the nearest step and saturated at
+// full scale, values already exact in that format round trip unchanged
+void Pcm_EncodeStereo(PcmFormat format, const f32* src, u32 numFrames, u8* dst);
+
+// As above with dither, for bouncing down to 16 or 24 bit masters. Float output is copied.
+void PcmDither_Init(PcmDither* dither, PcmDitherMode mode, u32 seed);
+void Pcm_EncodeStereoDithered(PcmFormat format, const f32* src, u32 numFrames, PcmDither* dither, u8* dst);
+
+// Adds numFrames of interleaved stereo in the given format into dst, used on the audio
+// thread to play compact samples without expanding them anywhere first
+void Pcm_MixStereo(PcmFormat format, const u8* src, u32 numFrames, f32* dst);
+
+// As above with a gain that starts at gain and moves by gainStep every frame, for fades
+void Pcm_MixStereoRamp(PcmFormat format, const u8* src, u32 numFrames, f32 gain, f32 gainStep, f32* dst);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include <types.h>
+#include <allocator.h>
+
+// Single producer single consumer ring of interleaved stereo f32 frames, the audio thread
+// copies each cycle in and a writer thread takes it out in large blocks. Cycles go in
+// whole or not at all, so a writer that falls behind drops whole cycles and counts them
+// rather than tearing one.
+
+#define RECORD_RING_DEFAULT_FRAMES (1 << 19) // 4 MB, about 11 seconds at 48 kHz
+#define RECORD_RING_BLOCK_FRAMES (1 << 15) // 256 KB, what the writer drains at a time
+#define RECORD_RING_ALIGNMENT 4096 // Blocks start on a page so they can go straight to disk
+
+typedef struct {
+    f32* frames;
+    u32 capacity; // Power of two multiple of RECORD_RING_BLOCK_FRAMES, unless made exact
+    atomic_u64 writeIndex;
+    atomic_u64 readIndex;
+
+    // Stats
+    atomic_u64 numOverruns; // Cycles dropped because the ring was full
+    atomic_u64 numOverrunFrames;
+    atomic_u32 maxLagFrames; // Most frames ever waiting on the writer
+} RecordRing;
+
+// Carves the ring out of the arena so the audio thread never touches an unfaulted page
+void RecordRing_Init(RecordRing* ring, HeapArena* arena, u32 numFrames);
+// Holds exactly numFrames, for a ring sized to a length of time rather than to whole blocks
+void RecordRing_InitExact(RecordRing* ring, HeapArena* arena, u32 numFrames);
+
+// Audio thread, frames that can be written before the ring is full
+u32 RecordRing_Space(RecordRing* ring);
+// Audio thread, copies numFrames in or drops them all if they don't fit. NULL records silence.
+bool RecordRing_Write(RecordRing* ring, const f32* frames, u32 numFrames);
+// Audio thread, and only while nothing consumes, drops the oldest frames past numFrames so
+// the ring keeps a rolling history. Whoever consumes next must be handed the ring after.
+void RecordRing_Trim(RecordRing* ring, u32 numFrames);
+
+// Writer only, frames waiting to be taken
+u32 RecordRing_Available(RecordRing* ring);
+// Writer only, points at up to maxFrames contiguous frames from the read position, a run
+// stops at the end of the ring so two peeks may be needed across the wrap
+u32 RecordRing_Peek(RecordRing* ring, u32 maxFrames, const f32** frames);
+void RecordRing_Consume(RecordRing* ring, u32 numFrames);
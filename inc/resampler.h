@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+#include <allocator.h>
+
+// Polyphase windowed sinc sample rate conversion of interleaved stereo f32. The kernel is
+// tabulated at init for the pair of rates, each output frame interpolates between the two
+// nearest phases so any ratio works. Init allocates from the arena it's given, keep it off the
+// audio thread.
+//
+// Output frame k lines up with input position k * inRate / outRate once the first
+// RESAMPLER_LATENCY(numTaps) input frames have gone in, callers prime it with the frames
+// before where they want to start (zeros before the start of a file).
+
+typedef enum {
+    RESAMPLER_QUALITY_LOW, // 16 taps, around 60dB of stopband, fine for previewing
+    RESAMPLER_QUALITY_MEDIUM, // 64 taps, around 80dB
+    RESAMPLER_QUALITY_HIGH, // 128 taps, around 100dB, for offline conversion
+
+    RESAMPLER_QUALITY_COUNT,
+} ResamplerQuality;
+
+#define RESAMPLER_LATENCY(numTaps) ((numTaps) / 2 - 1)
+
+typedef struct {
+    u32 inRate;
+    u32 outRate;
+    ResamplerQuality quality;
+    f64 step; // Input frames per output frame
+
+    // Kernel, numPhases + 1 rows of numTaps so the last phase can interpolate upwards
+    u32 numTaps;
+    u32 numPhases;
+    f32* table;
+
+    // Input not yet fully used, planar so the taps run over contiguous samples
+    f32* left;
+    f32* right;
+    u32 numBuffered;
+    u32 capacity;
+    f64 position; // Of the next output frame, relative to the first buffered frame
+} Resampler;
+
+// maxOutFrames bounds a single Resampler_Process call. The table and input live in arena for
+// as long as it does.
+void Resampler_Init(Resampler* resampler, HeapArena* arena, u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames);
+// Most input frames one Resampler_Process call can take
+u32 Resampler_Capacity(u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames);
+// What Init takes from the arena, for sizing one just for it
+u64 Resampler_ArenaBytes(u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames);
+
+// Forgets all input, the next output frame lands fraction of a frame after the first new one
+void Resampler_Reset(Resampler* resampler, f64 fraction);
+
+// How many more input frames the next numOutFrames need
+u32 Resampler_InputNeeded(const Resampler* resampler, u32 numOutFrames);
+
+// Takes exactly Resampler_InputNeeded frames of input and writes numOutFrames
+void Resampler_Process(Resampler* resampler, const f32* input, u32 numInFrames, f32* output, u32 numOutFrames);
+
+// Length of a whole file once converted
+u64 Resampler_OutputFrames(u32 inRate, u32 outRate, u64 numInFrames);
+
+// Converts a whole file in one go, latency compensated and zero padded at both ends. For
+// moving the cost of conversion to load time.
+void Resampler_ConvertAll(ResamplerQuality quality, 
+                          u32 inRate, 
+                          u32 outRate, 
+                          const f32* input, 
+                          u64 numInFrames, 
+                          f32* output, 
+                          u64 numOutFrames);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+
+// Realtime safety checker, built with make RTCHECK=1.
+// While a thread is marked realtime, any call it makes to the allocator, mutex/condition
+// variable functions or file/console I/O is counted and reported with a backtrace.
+// In normal builds every function here is a no-op.
+
+#define RTCHECK_MAX_REPORTS 32 // Backtraces printed, later violations are only counted
+#define RTCHECK_MAX_FRAMES 32
+
+typedef enum {
+    RT_VIOLATION_ALLOC,
+    RT_VIOLATION_LOCK,
+    RT_VIOLATION_CONDITION,
+    RT_VIOLATION_IO,
+
+    NUM_RT_VIOLATION_TYPES,
+} RtViolationType;
+
+void RtCheck_EnterRealtime(void);
+void RtCheck_ExitRealtime(void);
+
+// Exempt a section of realtime code, e.g. test fakes or a one-off shutdown handshake
+void RtCheck_BeginAllow(void);
+void RtCheck_EndAllow(void);
+
+bool RtCheck_IsCompiled(void);
+u64 RtCheck_GetViolationCount(void);
+u64 RtCheck_GetViolationCountByType(RtViolationType type);
+void RtCheck_ResetCounts(void);
+void RtCheck_Report(void);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <types.h>
+#include <pcm.h>
+
+// Fully decoded short samples, shared read only between every player of the same file.
+// Entries are keyed by path, modification time and the rate they were decoded for, and
+// live until they're both unreferenced and the least recently used when space is needed.
+// Files at another rate are resampled as they're loaded, at the highest quality.
+// A compact cache keeps 16 and 24 bit sources at their own width, around half the memory of
+// f32, and players convert as they mix.
+//
+// Acquire and release may decode or free, keep them off the audio thread. A miss decodes
+// without holding the lock, so a long load doesn't hold up anyone else's acquire or release.
+// The frames of an acquired entry never change, the audio thread reads them freely.
+
+#define SAMPLE_CACHE_MAX_ENTRIES 256
+#define SAMPLE_CACHE_MAX_PATH 256
+#define SAMPLE_CACHE_DEFAULT_BUDGET_MB 256
+#define SAMPLE_CACHE_MAX_SECONDS 10 // Anything longer is streamed
+
+typedef struct {
+    char path[SAMPLE_CACHE_MAX_PATH];
+    u64 pathHash;
+    u64 modifiedNs;
+    u32 sampleRate; // The rate it was decoded and converted for
+
+    u8* data; // Interleaved stereo, f32 or the compact format of the source
+    PcmFormat format;
+    u64 numFrames;
+    u64 sizeBytes;
+
+    u32 refCount;
+    u64 lastUsed;
+    bool stale; // File changed on disk, kept only until its last player lets go
+} SampleCacheEntry;
+
+typedef struct {
+    SampleCacheEntry entries[SAMPLE_CACHE_MAX_ENTRIES];
+    u32 numEntries;
+    u64 budgetBytes;
+    u64 usedBytes;
+    bool compact; // Keep integer sources in their own width rather than as f32
+    u64 clock; // Ticks on every acquire, orders entries for eviction
+    pthread_mutex_t mutex;
+
+    // Stats
+    u64 numHits;
+    u64 numMisses;
+    u64 numEvictions;
+    u64 numRejected; // Too long, unreadable or no room even after evicting
+    u64 savedBytes; // By compact entries currently held, against their f32 size
+} SampleCache;
+
+void SampleCache_Init(SampleCache* cache, u64 budgetBytes, bool compact);
+void SampleCache_Deinit(SampleCache* cache);
+
+// Shrinking the budget evicts straight away, as far as unreferenced entries allow
+void SampleCache_SetBudget(SampleCache* cache, u64 budgetBytes);
+
+// Decodes the file on a miss, returns NULL if it can't or shouldn't be cached
+const SampleCacheEntry* SampleCache_Acquire(SampleCache* cache, const char* path, u32 sampleRate);
+void SampleCache_Release(SampleCache* cache, const SampleCacheEntry* entry);
+
+void SampleCache_LogStats(SampleCache* cache);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+#include <pcm.h>
+
+// A set of samples too big to hold in memory, each with just its first preloadMs decoded
+// up front. Players created from a library start from that head straight away and stream
+// the rest in the background, so a note-on never waits on the disk.
+//
+// Adding samples reads from disk, keep it off the audio thread. The library must outlive
+// every player created from it. A compact library keeps heads at the source's own width.
+
+#define SAMPLE_LIBRARY_MAX_NAME 64
+#define SAMPLE_LIBRARY_MAX_PATH 256
+#define SAMPLE_LIBRARY_DEFAULT_PRELOAD_MS 250
+
+typedef struct {
+    char path[SAMPLE_LIBRARY_MAX_PATH];
+    u8* head; // Interleaved stereo in headFormat
+    PcmFormat headFormat;
+    u32 numHeadFrames;
+    u64 totalFrames;
+    u32 sampleRate;
+} LibrarySample;
+
+typedef struct {
+    char name[SAMPLE_LIBRARY_MAX_NAME];
+    u32 preloadMs;
+    bool compact;
+    LibrarySample* samples;
+    u32 numSamples;
+    u32 capacity;
+
+    // Stats
+    u64 residentBytes;
+    u64 diskBytes; // Full size of the sample data, for comparison
+    u64 savedBytes; // By compact heads, against their f32 size
+    u64 loadNs;
+} SampleLibrary;
+
+void SampleLibrary_Init(SampleLibrary* library, const char* name, u32 preloadMs, bool compact);
+void SampleLibrary_Deinit(SampleLibrary* library);
+
+// Decodes the head of the file, returns the index players refer to it by
+u32 SampleLibrary_Add(SampleLibrary* library, const char* path);
+const LibrarySample* SampleLibrary_Get(const SampleLibrary* library, u32 index);
+
+void SampleLibrary_LogStats(const SampleLibrary* library);
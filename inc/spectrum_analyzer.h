@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <types.h>
+#include "core_engine.h"
+#include "stft.h"
+
+// Magnitude spectra of whatever passes through it, for meters and displays. The audio passes
+// untouched, the analysis runs in the callback a hop at a time and every finished spectrum is
+// published through a triple buffer: the audio thread always has a buffer of its own to
+// write, the reader always has one of its own to read, and the third holds the newest,
+// swapped in or out with one atomic exchange either side. Neither side ever waits and the
+// reader only ever sees whole spectra, missing some if it reads slower than they come.
+//
+// Runs at PROCESSOR_PRIORITY_LOW, so it's the first thing to go under load.
+
+#define SPECTRUM_ANALYZER_FRESH 0x4 // Set on latest until the reader takes it
+
+typedef struct {
+    Stft stft;
+    u32 numBins;
+    f32 magnitudeScale; // So a full scale sine on a bin reads 1
+
+    // Each numBins of left then right
+    f32* spectra[3];
+    u64 sequences[3]; // Which spectrum each holds, from 1, written before it's handed over
+    atomic_u8 latest; // Index of the newest, swapped on both sides
+    u8 writing; // Audio thread
+    u8 reading; // Reader
+    u64 numPublished; // Audio thread
+} SpectrumAnalyzer;
+
+// frameFrames must be a power of two, and the hop anything up to it
+u16 SpectrumAnalyzer_Create(SpectrumAnalyzer* analyzer, CoreEngineContext* ctx, u32 frameFrames, u32 hopFrames);
+// From the one reader thread, the newest spectrum and its sequence or NULL before the first.
+// Stays put until the next read, bin k is k * sampleRate / frameFrames.
+const f32* SpectrumAnalyzer_Read(SpectrumAnalyzer* analyzer, u64* sequence);
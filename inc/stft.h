@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+#include <allocator.h>
+#include "fft.h"
+
+// Short time Fourier transform of interleaved stereo, for analysis and spectral effects that
+// work a frame at a time while the engine hands over blocks of whatever size. Every hop the
+// last frameFrames of each channel are windowed and transformed and handed to OnFrame. With
+// synthesis on, the spectra OnFrame leaves behind go back through an inverse and are
+// overlap added into the output, which comes out frameFrames late.
+//
+// Analysis alone uses a Hann window and any hop up to the frame size. Synthesis uses a
+// square root Hann on both sides, so the pair multiply to a Hann, and needs the hop to
+// divide half the frame for the overlaps to add up flat.
+//
+// Init takes its buffers from the arena, keep it off the audio thread. Process doesn't.
+
+typedef void (*StftFrameFunc)(u32 channel, f32* re, f32* im, void* data);
+
+typedef struct {
+    u32 frameFrames;
+    u32 hopFrames;
+    u32 numBins; // frameFrames / 2 + 1
+    bool synthesis;
+    Fft fft;
+    StftFrameFunc OnFrame;
+    void* data;
+
+    f32* window;
+    f32 outputScale; // Undoes the overlap and the unscaled transforms
+
+    // Per channel, left then right
+    f32* input; // The last frameFrames in
+    f32* overlap; // Sum of the frames so far, from the start of the newest
+    f32* output; // A hop of finished output, playing out now
+    u32 pos; // Into input, a hop's worth short of the end until the next frame is due
+
+    f32* samples;
+    f32* re;
+    f32* im;
+    u64 numHops; // Frames transformed since init
+} Stft;
+
+// frameFrames must be a power of two, arena memory for the life of the engine
+void Stft_Init(Stft* stft, HeapArena* arena, u32 frameFrames, u32 hopFrames, bool synthesis, StftFrameFunc OnFrame, void* data);
+// Interleaved stereo in place, left as it is without synthesis
+void Stft_Process(Stft* stft, f32* buffer, u32 numFrames);
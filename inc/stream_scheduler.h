@@ -0,0 +1,96 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <types.h>
+#include <async_io.h>
+
+// Services disk streams earliest deadline first. Streams say how much audio they have
+// buffered and how fast it's being used, the scheduler works out when each one will run
+// dry and spends its I/O on whichever is closest, with a cap on reads per device.
+//
+// With an AsyncIo attached a single thread does all of it instead, streams queue their
+// reads on the scheduler's AsyncIo and report back through StreamScheduler_Complete.
+// A stream's back to back reads of one file are merged into one request there, reads
+// of different streams never are, even when they share a file.
+
+#define STREAM_MAX_SOURCES 512
+#define STREAM_MAX_DEVICES 16
+#define STREAM_NUM_IO_THREADS 4
+#define STREAM_MAX_IO_PER_DEVICE 2
+#define STREAM_MAX_ASYNC_PER_DEVICE 32 // Streams, each may have several reads queued
+#define STREAM_POLL_INTERVAL_MS 2
+
+// Reads as much as the stream has room for in one go, returns bytes read, or
+// STREAM_FILL_ASYNC if the reads were queued on the scheduler's AsyncIo
+typedef u64 (*StreamFillFunc)(void* data);
+#define STREAM_FILL_ASYNC UINT64_MAX
+
+typedef struct {
+    StreamFillFunc Fill;
+    void* data;
+    atomic_u32 framesPerSecond; // Consumption rate, may change as the stream plays
+
+    // Written by the audio thread
+    atomic_bool pending; // Wants a fill, cleared by the scheduler when it dispatches
+    atomic_u32 bufferedFrames;
+
+    // Scheduler only
+    u8 device;
+    bool inFlight;
+} StreamSource;
+
+typedef struct {
+    u64 id;
+    u8 numInFlight;
+    u64 bytesRead;
+} StreamDevice;
+
+typedef struct {
+    StreamSource* sources[STREAM_MAX_SOURCES];
+    u32 numSources;
+    StreamDevice devices[STREAM_MAX_DEVICES];
+    u8 numDevices;
+    u8 maxIoPerDevice;
+
+    AsyncIo* asyncIo; // Owned by whoever attached it, driven only by the scheduler
+    u8 numThreads;
+    pthread_t threads[STREAM_NUM_IO_THREADS];
+    atomic_bool running;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    // Stats, under the mutex
+    u64 startNs;
+    u64 numReads;
+    u64 bytesRead;
+    u64 numLateReads; // Dispatched with nothing left buffered
+    i64 minSlackNs; // Time left before underrun when a read was issued
+    i64 totalSlackNs;
+} StreamScheduler;
+
+void StreamScheduler_Init(StreamScheduler* scheduler, u8 numThreads, u8 maxIoPerDevice);
+void StreamScheduler_Deinit(StreamScheduler* scheduler);
+void StreamScheduler_Start(StreamScheduler* scheduler);
+// Before starting, swaps the I/O threads for one thread driving the AsyncIo
+void StreamScheduler_AttachAsyncIo(StreamScheduler* scheduler, AsyncIo* asyncIo, u8 maxStreamsPerDevice);
+void StreamScheduler_Stop(StreamScheduler* scheduler);
+
+// The file descriptor is only used to find which device the stream reads from
+void StreamScheduler_Register(StreamScheduler* scheduler, StreamSource* source, i32 fd);
+void StreamScheduler_Unregister(StreamScheduler* scheduler, StreamSource* source);
+
+// Request a fill, realtime safe
+static inline void StreamScheduler_Request(StreamSource* source)
+{
+    atomic_store_explicit(&source->pending, true, memory_order_release);
+}
+
+// Finishes a fill that returned STREAM_FILL_ASYNC, call from the AsyncIo completion
+void StreamScheduler_Complete(StreamScheduler* scheduler, StreamSource* source, u64 bytesRead);
+
+// Services every pending stream on the calling thread and waits for any async reads, for
+// when the I/O threads aren't running
+u32 StreamScheduler_RunOnce(StreamScheduler* scheduler);
+void StreamScheduler_LogStats(StreamScheduler* scheduler);
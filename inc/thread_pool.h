@@ -5,28 +5,51 @@
 #include <stdbool.h>
 #include "types.h"
 
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
 typedef void (*TaskCallback)(void*);
 
 typedef struct {
     TaskCallback callback;
     void* data;
+    const char* name; // For tracing
 } TaskInfo;
 
+// Tasks queue in a ring, deferred from the audio thread alone and taken by the workers
+// under the mutex, so a slot is only reused once a worker has copied it out. Flushing wakes
+// the workers with a semaphore post, which unlike a condition variable never takes a lock
+// and is safe from the audio thread.
 typedef struct {
     TaskInfo* tasks;
     u64 capacity;
+    u64 head; // Next slot to defer into, audio thread only
+    u64 flushedHead; // Head as of the last flush, audio thread only
+    u64 tail; // Next slot to take, under the mutex
     _Atomic(u64) numPendingTasks;
     _Atomic(bool) running;
     u8 numThreads;
     pthread_t* threads;
     pthread_mutex_t mutex;
-    pthread_cond_t cond;
+#if defined(__APPLE__)
+    dispatch_semaphore_t wake;
+#else
+    sem_t wake;
+#endif
 } ThreadPool;
 
 void ThreadPool_Init(ThreadPool* pool, u8 numThreads, u64 capacity);
 void ThreadPool_Deinit(ThreadPool* pool);
 void ThreadPool_Start(ThreadPool* pool);
 void ThreadPool_Stop(ThreadPool* pool);
-void ThreadPool_DeferTask(ThreadPool* pool, TaskCallback callback, void* data);
+#define ThreadPool_DeferTask(pool, callback, data) _ThreadPool_DeferTask(pool, callback, data, #callback)
+// Returns false instead of asserting when the queue is full
+#define ThreadPool_TryDeferTask(pool, callback, data) _ThreadPool_TryDeferTask(pool, callback, data, #callback)
+
+void _ThreadPool_DeferTask(ThreadPool* pool, TaskCallback callback, void* data, const char* name);
+bool _ThreadPool_TryDeferTask(ThreadPool* pool, TaskCallback callback, void* data, const char* name);
 void ThreadPool_FlushTasks(ThreadPool* pool);
 
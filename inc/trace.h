@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <types.h>
+
+// Compile out all trace points with -DTRACE_COMPILED=0 (make TRACE=0)
+#ifndef TRACE_COMPILED
+#define TRACE_COMPILED 1
+#endif
+
+#define TRACE_MAX_THREADS 32
+#ifndef TRACE_RING_CAPACITY
+#define TRACE_RING_CAPACITY 8192 // Events per thread, must be a power of two
+#endif
+#define TRACE_DUMP_COOLDOWN_MS 5000
+#define TRACE_DUMP_STALE_MS 30000 // A dump pending this long never ran, a new trigger takes over
+#define TRACE_DEFAULT_DUMP_PATH "jamcore_trace.json"
+
+typedef enum {
+    TRACE_BEGIN,
+    TRACE_END,
+    TRACE_COUNTER,
+    TRACE_INSTANT,
+} TraceEventType;
+
+typedef struct {
+    const char* name; // Must be a string literal or otherwise outlive the trace
+    u64 timestampNs;
+    i64 value; // Counter value, or an id for spans, -1 when unused
+    u8 type;
+} TraceEvent;
+
+// Flight recorder, the owning thread overwrites the oldest events once full
+typedef struct {
+    TraceEvent events[TRACE_RING_CAPACITY];
+    atomic_u64 head;
+    u64 startIndex;
+    u32 threadId;
+    char threadName[32];
+    atomic_u8 state;
+} TraceRing;
+
+#if TRACE_COMPILED
+#define TraceBegin(name) _TraceEvent(TRACE_BEGIN, name, -1)
+#define TraceBeginId(name, id) _TraceEvent(TRACE_BEGIN, name, (i64)(id))
+#define TraceEnd(name) _TraceEvent(TRACE_END, name, -1)
+#define TraceCounter(name, value) _TraceEvent(TRACE_COUNTER, name, (i64)(value))
+#define TraceInstant(name) _TraceEvent(TRACE_INSTANT, name, -1)
+#else
+#define TraceBegin(name) do {} while (0)
+#define TraceBeginId(name, id) do {} while (0)
+#define TraceEnd(name) do {} while (0)
+#define TraceCounter(name, value) do {} while (0)
+#define TraceInstant(name) do {} while (0)
+#endif
+
+void _TraceEvent(TraceEventType type, const char* name, i64 value);
+
+u64 Trace_NowNs(void);
+void Trace_SetEnabled(bool enabled);
+bool Trace_IsEnabled(void);
+void Trace_SetThreadName(const char* name);
+void Trace_SetDumpPath(const char* path);
+
+// Realtime safe, marks the timeline and returns true if the caller should schedule Trace_DumpTask
+bool Trace_Trigger(const char* reason);
+// Realtime safe, for a caller that couldn't schedule the dump, the next trigger goes ahead
+void Trace_CancelDump(void);
+// Non-realtime, writes every thread's recorded events as Chrome/Perfetto trace JSON
+bool Trace_Dump(const char* path);
+void Trace_DumpTask(void* data);
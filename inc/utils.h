@@ -9,4 +9,6 @@ void BufferParallelSum(f32* bufferOut, f32* bufferIn, u16 size);
 f32 ClampHigh(f32 value, f32 max);
 f32 ClampLow(f32 value, f32 min);
 f32 Clamp(f32 value, f32 min, f32 max);
+// Zeroth order modified Bessel function of the first kind, for Kaiser windows
+f64 BesselI0(f64 x);
 
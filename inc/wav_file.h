@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+#include <pcm.h>
+
+// RIFF/WAVE reader. The whole file is memory mapped read only, sample data can either be
+// converted out with WavFile_ReadFrames or, for float stereo files, used in place. RF64 files
+// are read the same, with the sizes past 4 GB taken from their ds64 chunk.
+
+#define WAV_FORMAT_TAG_PCM 0x0001
+#define WAV_FORMAT_TAG_FLOAT 0x0003
+#define WAV_FORMAT_TAG_EXTENSIBLE 0xFFFE
+
+typedef struct {
+    i32 fd;
+    const u8* map;
+    u64 mapSize;
+
+    // Sample data
+    const u8* data;
+    u64 dataOffset; // Into the file, for reading it other than through the mapping
+    u64 dataSize;
+    u64 totalFrames;
+
+    // Format
+    PcmFormat format;
+    u32 sampleRate;
+    u16 numChannels;
+    u16 bytesPerFrame;
+} WavFile;
+
+void WavFile_Open(WavFile* file, const char* path);
+// Logs why and returns false rather than asserting, for files that may not be valid
+bool WavFile_TryOpen(WavFile* file, const char* path);
+void WavFile_Close(WavFile* file);
+
+// Convert up to numFrames from startFrame into interleaved stereo f32, returns frames read
+u32 WavFile_ReadFrames(const WavFile* file, u64 startFrame, u32 numFrames, f32* dst);
+
+// True when the file data already is interleaved stereo f32 at the given rate
+bool WavFile_CanMap(const WavFile* file, u32 sampleRate);
+const f32* WavFile_MapFrames(const WavFile* file, u64 frame);
+
+// Ask the kernel to start paging in a range ahead of use, doesn't block
+void WavFile_Prefetch(const WavFile* file, u64 startFrame, u64 numFrames);
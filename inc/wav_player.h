@@ -2,30 +2,203 @@
 
 #include <stdbool.h>
 #include <stdatomic.h>
-#include <AudioToolbox/AudioToolbox.h>
 
 #include "core_engine.h"
-#include "thread_pool.h"
+#include "stream_scheduler.h"
+#include "sample_cache.h"
+#include "sample_library.h"
+#include "resampler.h"
+#include "interpolator.h"
+#include "wav_file.h"
 
 #define WAVPLAYER_LOOPING (1 << 0)
 #define WAVPLAYER_FINISHED (1 << 1)
 #define WAVPLAYER_SEEK (1 << 2)
+#define WAVPLAYER_DIRECT_IO (1 << 3) // Stream reads skip the OS page cache where the platform allows
+#define WAVPLAYER_CACHED (1 << 4) // Share a fully decoded copy through the sample cache if it fits
+#define WAVPLAYER_HIGH_QUALITY (1 << 5) // Resample streamed files at the offline quality
+#define WAVPLAYER_RATE (1 << 6) // A new playback rate to ramp to, picked up next cycle
+
+// Fastest playback either way, bounds how much one cycle reads
+#define WAVPLAYER_MAX_RATE 4.0f
+
+// How far ahead of the play head mapped files are paged in
+#define WAVPLAYER_PREFETCH_FRAMES (AUDIO_FILE_CHUNK_SIZE * 8)
+
+// Streamed files are buffered in a ring of AUDIO_FILE_CHUNK_SIZE slots
+#define WAVPLAYER_DEFAULT_READAHEAD_MS 500
+#define WAVPLAYER_MIN_SLOTS 3
+#define WAVPLAYER_MAX_SLOTS 32
+
+// Cue points keep the audio just after them resident so a seek there plays in the very
+// next cycle, long enough to cover the stream catching up behind it
+#define WAVPLAYER_MAX_CUES 16
+#define WAVPLAYER_CUE_CHUNKS 2
+
+// Audio held in memory from a given frame on: the whole file, a library head or a cue
+typedef struct {
+    u64 frame;
+    u64 numFrames;
+    PcmFormat format;
+    u64 blockFrames; // Each block is contiguous interleaved stereo, only cues use more than one
+    const u8* blocks[WAVPLAYER_CUE_CHUNKS];
+} WavRegion;
+
+typedef struct {
+    f32* frames;
+    u64 startFrame;
+    u32 numFrames; // 0 marks the end of a non-looping file
+    u16 generation; // Slots loaded before a seek are dropped
+
+    // Async reads land out of order, slots are only published once everything before is in
+    u32 readSkip; // From the aligned read start to the first frame
+    bool ready;
+} WavStreamSlot;
+
+// Conversion state for reading a file at another rate, picks up where the last read left off
+typedef struct {
+    Resampler resampler;
+    f32* input;
+    u64 nextFrame; // Output frame the resampler carries on from
+    i64 fileFrame; // Next one it takes from the file, negative while priming before the start
+} WavResample;
+
+typedef struct {
+    WavStreamSlot slots[WAVPLAYER_MAX_SLOTS];
+    u32 numSlots;
+    u32 lowWaterSlots; // Refill is requested once the ring drains to this
+
+    // SPSC ring, the stream scheduler produces and the audio thread consumes
+    atomic_u64 writeIndex;
+    atomic_u64 readIndex;
+    StreamSource source;
+
+    // Where the loader should read from, generation in the top 16 bits and frame below
+    atomic_u64 request;
+
+    // Audio thread only
+    u16 generation;
+    u32 readOffset;
+    u64 requestNs;
+
+    // Stream scheduler only
+    u16 loaderGeneration;
+    u64 loaderFrame; // Reading backwards, the chunk before this is next
+    bool loaderReverse;
+    bool endQueued;
+    WavResample resample;
+
+    // Async reads through the scheduler's AsyncIo, slots from writeIndex up to submitIndex
+    // are being read into
+    bool asyncRead;
+    i32 fd;
+    u64 submitIndex;
+    AsyncIoRequest reads[WAVPLAYER_MAX_SLOTS];
+    u32 numReadsInFlight;
+    u64 bytesInFlight;
+} WavStream;
+
+// Frames read ahead of a play position that doesn't land on whole frames. Audio thread only.
+typedef struct {
+    f32* frames; // Interleaved stereo in the order they play, so backwards they're reversed
+    u32 numFrames;
+    u32 capacity;
+    f64 position; // Of the next output frame, into frames
+
+    f64 rate; // Negative plays backwards
+    f64 targetRate;
+    f64 rateStep; // Per frame while ramping
+    u32 rampFrames; // Left to ramp
+    bool active; // Off at exactly normal speed, frames then just keeps the last few played
+} WavVarispeed;
 
 typedef struct {
+    WavFile file;
     u64 totalFrames;
-    atomic_u32 currentFrame;
-    atomic_u32 seekPosition;
+    atomic_u64 currentFrame;
+    atomic_u64 seekPosition;
     atomic_u8 flags;
-    atomic_u8 currentBufferIndex;
-    atomic_u32 currentNumFrames[2];
-    f32 buffers[AUDIO_FILE_CHUNK_SIZE][2];
-    ExtAudioFileRef audioFile;
     u32 id; // For debug
-    ThreadPool* threadPool;
 
-    AudioBufferList* coreAudioBuffers[2];
+    // Zero copy playback straight out of the file mapping, only used when the file is
+    // already interleaved stereo f32 at the engine rate
+    bool mapped;
+    u64 prefetchFrame; // Audio thread only
+
+    // Files at another rate than the engine are converted as they stream in, every frame
+    // count on the player is at the engine rate
+    bool resampling;
+    ResamplerQuality resampleQuality;
+
+    // Or out of a decoded copy shared with every other player of the same file
+    const SampleCacheEntry* cached;
+    SampleCache* sampleCache;
+
+    // Set for either of the above, the whole file
+    WavRegion memory;
+
+    // Players from a sample library start on its preloaded head while the rest streams
+    WavRegion head;
+
+    // Written before numCues is bumped, read only by the audio thread after that
+    WavRegion cues[WAVPLAYER_MAX_CUES];
+    atomic_u32 numCues;
+
+    // Audio thread only, the region being played from instead of the stream
+    const WavRegion* playing;
+
+    // Loop region, the last loopCrossfade frames before loopEnd fade into those after
+    // loopStart and playback carries on from loopStart + loopCrossfade
+    atomic_u64 loopStart;
+    atomic_u64 loopEnd;
+    atomic_u32 loopCrossfade;
+
+    // Playback rate, ramped to once WAVPLAYER_RATE is set. Away from normal speed the file is
+    // read one to one into the varispeed window and interpolated out of it, backwards the
+    // stream and the read paths run the other way. currentFrame is how far it's been read.
+    atomic_f32 targetRate;
+    atomic_u32 rateRampFrames;
+    atomic_u8 interpolation;
+    bool reverse; // Audio thread only, the loader gets it with each request
+    WavVarispeed varispeed;
+
+    // Otherwise chunks are converted by the stream scheduler into the ring
+    WavStream stream;
+    StreamScheduler* scheduler;
+    AsyncIo* asyncIo; // The scheduler's, if it has one
+    PoolAllocator* chunkPool;
+
+    // Stats
+    atomic_u64 numUnderruns; // Cycles which ran out of buffered audio
+    atomic_u64 numUnderrunFrames;
+    atomic_u64 numLoads;
+    atomic_u64 lastLoadNs; // From the refill request to the ring being topped up
+    atomic_u64 maxLoadNs;
+    atomic_u32 minFillFrames;
 } WavPlayer;
 
 u16 WavPlayer_Create(WavPlayer* player, CoreEngineContext* ctx, const char* filename, u8 flags);
+u16 WavPlayer_CreateWithReadahead(WavPlayer* player, 
+                                  CoreEngineContext* ctx, 
+                                  const char* filename, 
+                                  u8 flags, 
+                                  u32 readaheadMs);
+// Starts from the library's preloaded head without touching the disk, the rest streams
+u16 WavPlayer_CreateFromLibrary(WavPlayer* player, 
+                                CoreEngineContext* ctx, 
+                                const SampleLibrary* library, 
+                                u32 sampleIndex, 
+                                u8 flags);
 void WavPlayer_Seek(WavPlayer* player, u32 seekPosition);
-
+// Preloads from frame so later seeks to it are instant, returns the cue's index
+u32 WavPlayer_AddCue(WavPlayer* player, u32 frame);
+void WavPlayer_SeekToCue(WavPlayer* player, u32 cueIndex);
+// Loops between two frames, wrapping in the same cycle it gets there. The loop start is kept
+// resident so a wrap never waits on the stream. WAVPLAYER_LOOPING loops the whole file.
+void WavPlayer_SetLoop(WavPlayer* player, u32 startFrame, u32 endFrame, u32 crossfadeFrames);
+void WavPlayer_ClearLoop(WavPlayer* player);
+// Ramps linearly to rate over rampMs, negative plays backwards. Tape stops are a ramp to 0,
+// scrubbing sets a new rate with a short ramp every control tick.
+void WavPlayer_SetRate(WavPlayer* player, f32 rate, u32 rampMs);
+void WavPlayer_SetInterpolation(WavPlayer* player, Interpolation interpolation);
+void WavPlayer_LogStats(WavPlayer* player);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <types.h>
+#include <pcm.h>
+
+// Streaming RIFF/WAVE writer for long recordings. The header takes up the whole first page
+// so sample data starts page aligned and block writes stay aligned on disk. Space is
+// preallocated ahead in large extents and the header is rewritten as the data grows, so
+// a recording cut off at any point still opens with everything up to the last rewrite.
+//
+// Files switch to RF64 once they pass 4 GB, the space for its ds64 chunk is held by a
+// JUNK chunk until then.
+
+#define WAV_WRITER_HEADER_SIZE 4096
+#define WAV_WRITER_PREALLOCATE_BYTES (64 * 1024 * 1024)
+#define WAV_WRITER_HEADER_INTERVAL_BYTES (1024 * 1024)
+
+typedef struct {
+    i32 fd;
+    PcmFormat format;
+    u16 numChannels;
+    u32 sampleRate;
+    u16 bytesPerFrame;
+
+    u64 dataBytes;
+    u64 headerDataBytes; // dataBytes as of the last header rewrite
+    u64 headerIntervalBytes;
+    u64 allocatedBytes; // Of the file, preallocated past what's been written
+    bool canPreallocate; // Cleared the first time the filesystem refuses
+
+    // Stats
+    u64 numWrites;
+    u64 numHeaderWrites;
+    u64 numPreallocations;
+    u64 numErrors;
+} WavWriter;
+
+void WavWriter_Open(WavWriter* writer, const char* path, PcmFormat format, u16 numChannels, u32 sampleRate);
+// Rewrites the header, trims the preallocation and closes the file
+void WavWriter_Close(WavWriter* writer);
+
+// Appends interleaved frames already in the file's format, best kept to whole pages
+bool WavWriter_Write(WavWriter* writer, const void* frames, u32 numFrames);
+
+// Brings the sizes in the header up to date, done every headerIntervalBytes anyway
+bool WavWriter_WriteHeader(WavWriter* writer);
+
+u64 WavWriter_NumFrames(const WavWriter* writer);
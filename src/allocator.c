@@ -1,5 +1,7 @@
 #include "logger.h"
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <allocator.h>
 
 void ScratchAllocator_Init(ScratchAllocator* alloc, u8* base, u32 size)
@@ -29,3 +31,159 @@ void ScratchAllocator_Release(ScratchAllocator* alloc)
 {
     alloc->offset = 0;
 }
+
+void HeapArena_Init(HeapArena* arena, u64 size)
+{
+    Assert(arena, "HeapArena is null");
+    Assert(size > 0, "HeapArena size must be greater than zero");
+
+    u64 pageSize = (u64)sysconf(_SC_PAGESIZE);
+    size = AlignUp(size, pageSize);
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    Assert(base != MAP_FAILED, "Failed to map %llu bytes for heap arena", size);
+
+    // Prefault every page now so nothing takes a page fault on the audio thread later
+    for (u64 offset = 0; offset < size; offset += pageSize) {
+        ((volatile u8*)base)[offset] = 0;
+    }
+
+    // Best effort, may exceed RLIMIT_MEMLOCK
+    arena->locked = (mlock(base, size) == 0);
+    if (!arena->locked) {
+        LogWarn("Could not lock %llu bytes of heap arena in memory", size);
+    }
+
+    arena->base = (u8*)base;
+    arena->size = size;
+    atomic_store(&arena->offset, 0);
+}
+
+void HeapArena_Deinit(HeapArena* arena)
+{
+    Assert(arena, "HeapArena is null");
+    Assert(arena->base, "HeapArena not initialised");
+
+    if (arena->locked) {
+        munlock(arena->base, arena->size);
+    }
+    munmap(arena->base, arena->size);
+
+    arena->base = NULL;
+    arena->size = 0;
+    arena->locked = false;
+    atomic_store(&arena->offset, 0);
+}
+
+void* HeapArena_Alloc(HeapArena* arena, u64 size)
+{
+    Assert(arena, "HeapArena is null");
+    Assert(arena->base, "HeapArena not initialised");
+
+    // Checked before the offset moves, so a failed allocation doesn't use the arena up
+    u64 alignedSize = AlignUp(size, ARENA_ALIGNMENT);
+    u64 offset = atomic_load(&arena->offset);
+    do {
+        Assert(alignedSize <= arena->size - offset, 
+               "Not enough heap arena space for allocation (requested %llu, only had %llu)", 
+               alignedSize, 
+               arena->size - offset);
+    } while (!atomic_compare_exchange_weak(&arena->offset, &offset, offset + alignedSize));
+
+    return (void*)(arena->base + offset);
+}
+
+u64 HeapArena_Remaining(HeapArena* arena)
+{
+    u64 offset = atomic_load(&arena->offset);
+    return (offset < arena->size) ? arena->size - offset : 0;
+}
+
+void PoolAllocator_Init(PoolAllocator* pool, HeapArena* arena, const char* name, u32 blockSize, u32 capacity)
+{
+    Assert(pool, "PoolAllocator is null");
+    Assert(blockSize > 0, "Pool block size must be greater than zero");
+    Assert(capacity > 0 && capacity < POOL_NULL_INDEX, "Invalid pool capacity %d", capacity);
+
+    pool->name = name;
+    pool->blockSize = (u32)AlignUp(blockSize, ARENA_ALIGNMENT);
+    pool->capacity = capacity;
+    pool->base = HeapArena_Alloc(arena, (u64)pool->blockSize * capacity);
+    pool->nextFree = HeapArena_Alloc(arena, sizeof(atomic_u32) * capacity);
+
+    // Thread every block onto the free list in address order
+    for (u32 i = 0; i < capacity; i++) {
+        atomic_store_explicit(&pool->nextFree[i], (i + 1 < capacity) ? i + 1 : POOL_NULL_INDEX, memory_order_relaxed);
+    }
+
+    atomic_store(&pool->freeHead, 0);
+    atomic_store(&pool->numUsed, 0);
+    atomic_store(&pool->highWater, 0);
+}
+
+void* PoolAllocator_Alloc(PoolAllocator* pool)
+{
+    Assert(pool, "PoolAllocator is null");
+
+    u64 head = atomic_load_explicit(&pool->freeHead, memory_order_acquire);
+    u64 newHead;
+    u32 index;
+
+    do {
+        index = (u32)head;
+        Assert(index != POOL_NULL_INDEX, "Pool %s exhausted (capacity %d)", pool->name, pool->capacity);
+        u32 next = atomic_load_explicit(&pool->nextFree[index], memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | next;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->freeHead, &head, newHead,
+                                                    memory_order_acq_rel, memory_order_acquire));
+
+    u32 used = atomic_fetch_add(&pool->numUsed, 1) + 1;
+    u32 highWater = atomic_load(&pool->highWater);
+    while (used > highWater && !atomic_compare_exchange_weak(&pool->highWater, &highWater, used));
+
+    return (void*)(pool->base + (u64)index * pool->blockSize);
+}
+
+void* PoolAllocator_Calloc(PoolAllocator* pool)
+{
+    void* ptr = PoolAllocator_Alloc(pool);
+    memset(ptr, 0, pool->blockSize);
+    return ptr;
+}
+
+void PoolAllocator_Free(PoolAllocator* pool, void* ptr)
+{
+    Assert(pool, "PoolAllocator is null");
+    Assert(PoolAllocator_Owns(pool, ptr), "Pointer %p does not belong to pool %s", ptr, pool->name);
+
+    u64 byteOffset = (u64)((u8*)ptr - pool->base);
+    Assert(byteOffset % pool->blockSize == 0, "Pointer %p is not the start of a block in pool %s", ptr, pool->name);
+    u32 index = (u32)(byteOffset / pool->blockSize);
+
+    u64 head = atomic_load_explicit(&pool->freeHead, memory_order_acquire);
+    u64 newHead;
+
+    do {
+        atomic_store_explicit(&pool->nextFree[index], (u32)head, memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | index;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->freeHead, &head, newHead,
+                                                    memory_order_acq_rel, memory_order_acquire));
+
+    atomic_fetch_sub(&pool->numUsed, 1);
+}
+
+bool PoolAllocator_Owns(PoolAllocator* pool, void* ptr)
+{
+    u8* bytePtr = (u8*)ptr;
+    return (bytePtr >= pool->base) && (bytePtr < pool->base + (u64)pool->blockSize * pool->capacity);
+}
+
+void PoolAllocator_LogStats(PoolAllocator* pool)
+{
+    LogInfo("Pool %s: %d/%d blocks of %d bytes in use (high water %d)",
+            pool->name,
+            atomic_load(&pool->numUsed),
+            pool->capacity,
+            pool->blockSize,
+            atomic_load(&pool->highWater));
+}
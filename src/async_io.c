@@ -0,0 +1,677 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT
+#endif
+
+#include <async_io.h>
+#include <logger.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#ifdef ASYNC_IO_HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+static const char* backendNames_[] = {
+    "auto",
+    "threaded",
+    "io_uring",
+};
+
+static u32 CompleteMerge(AsyncIo* io, AsyncIoMerge* merge);
+
+// Returns the number of requests completed, a merged read completes every read it stands in for
+static u32 CompleteRequest(AsyncIo* io, AsyncIoRequest* request)
+{
+    if (request->numMerged > 0) {
+        return CompleteMerge(io, (AsyncIoMerge*)request->data);
+    }
+
+    io->numInFlight--;
+    if (request->result < 0) {
+        io->numErrors++;
+    }
+    else if (request->op == ASYNC_IO_READ) {
+        io->bytesRead += (u64)request->result;
+    }
+    else {
+        io->bytesWritten += (u64)request->result;
+    }
+
+    request->OnComplete(request);
+    return 1;
+}
+
+// ============================================================================
+// Merging
+// ============================================================================
+
+static bool CanMerge(const AsyncIoRequest* request, i32 fd, u64 prevOffset, u64 prevEnd)
+{
+    return request->op == ASYNC_IO_READ &&
+           request->fd == fd &&
+           request->numMerged == 0 &&
+           request->offset >= prevOffset &&
+           request->offset <= prevEnd &&
+           request->offset + request->size > prevEnd;
+}
+
+// Members stay chained through next, the last one's next must already be NULL
+static AsyncIoRequest* BuildMerge(AsyncIo* io, AsyncIoRequest* first)
+{
+    AsyncIoMerge* merge = &io->merges[io->freeMerges[--io->numFreeMerges]];
+    merge->first = first;
+
+    u8 numMerged = 0;
+    u32 size = 0;
+    u64 end = first->offset;
+    for (AsyncIoRequest* member = first; member != NULL; member = member->next) {
+        u32 overlap = (end > member->offset) ? (u32)(end - member->offset) : 0;
+        merge->overlaps[numMerged] = overlap;
+        merge->iovecs[numMerged] = (struct iovec) {
+            .iov_base = (u8*)member->buffer + overlap,
+            .iov_len = member->size - overlap,
+        };
+        size += member->size - overlap;
+        end = member->offset + member->size;
+        numMerged++;
+    }
+
+    merge->request = (AsyncIoRequest) {
+        .op = ASYNC_IO_READ,
+        .fd = first->fd,
+        .size = size,
+        .offset = first->offset,
+        .bufferIndex = -1,
+        .data = (void*)merge,
+        .numMerged = numMerged,
+    };
+    io->numMergedReads += numMerged - 1;
+    return &merge->request;
+}
+
+// Swaps each run of reads on one descriptor that touch or overlap for a single merged read
+static void MergeBatch(AsyncIo* io)
+{
+    AsyncIoRequest* head = NULL;
+    AsyncIoRequest* tail = NULL;
+    AsyncIoRequest* request = io->batchHead;
+
+    while (request != NULL) {
+        AsyncIoRequest* last = request;
+        u8 runLength = 1;
+        while (request->op == ASYNC_IO_READ &&
+               last->next != NULL &&
+               runLength < ASYNC_IO_MAX_MERGE &&
+               CanMerge(last->next, request->fd, last->offset, last->offset + last->size)) {
+            last = last->next;
+            runLength++;
+        }
+
+        AsyncIoRequest* submit = request;
+        AsyncIoRequest* next = request->next;
+        if (runLength > 1 && io->numFreeMerges > 0) {
+            next = last->next;
+            last->next = NULL;
+            submit = BuildMerge(io, request);
+        }
+
+        submit->next = NULL;
+        if (tail != NULL) {
+            tail->next = submit;
+        }
+        else {
+            head = submit;
+        }
+        tail = submit;
+        request = next;
+    }
+
+    io->batchHead = head;
+    io->batchTail = tail;
+}
+
+static u32 CompleteMerge(AsyncIo* io, AsyncIoMerge* merge)
+{
+    i64 result = merge->request.result;
+    u64 endOffset = merge->request.offset + ((result > 0) ? (u64)result : 0);
+
+    // Fill in every member before any callback runs, one may hand its buffer back
+    AsyncIoRequest* prev = NULL;
+    u8 index = 0;
+    for (AsyncIoRequest* member = merge->first; member != NULL; member = member->next, index++) {
+        if (merge->overlaps[index] > 0) {
+            memcpy(member->buffer, (u8*)prev->buffer + (member->offset - prev->offset), merge->overlaps[index]);
+        }
+
+        if (result < 0) {
+            member->result = result;
+        }
+        else {
+            u64 available = (endOffset > member->offset) ? endOffset - member->offset : 0;
+            member->result = (i64)((available < member->size) ? available : member->size);
+        }
+        prev = member;
+    }
+
+    AsyncIoRequest* member = merge->first;
+    io->freeMerges[io->numFreeMerges++] = (u16)(merge - io->merges);
+    while (member != NULL) {
+        AsyncIoRequest* next = member->next;
+        CompleteRequest(io, member);
+        member = next;
+    }
+    return index;
+}
+
+// ============================================================================
+// Threaded backend
+// ============================================================================
+
+static void* IoThread(void* data)
+{
+    AsyncIo* io = (AsyncIo*)data;
+
+    pthread_mutex_lock(&io->threaded.mutex);
+    while (true) {
+        while (io->threaded.pendingHead == NULL && io->threaded.running) {
+            pthread_cond_wait(&io->threaded.submitted, &io->threaded.mutex);
+        }
+        if (io->threaded.pendingHead == NULL) {
+            break;
+        }
+
+        AsyncIoRequest* request = io->threaded.pendingHead;
+        io->threaded.pendingHead = request->next;
+        if (io->threaded.pendingHead == NULL) {
+            io->threaded.pendingTail = NULL;
+        }
+        pthread_mutex_unlock(&io->threaded.mutex);
+
+        ssize_t result;
+        if (request->numMerged > 0) {
+            AsyncIoMerge* merge = (AsyncIoMerge*)request->data;
+            result = preadv(request->fd, merge->iovecs, request->numMerged, (off_t)request->offset);
+        }
+        else if (request->op == ASYNC_IO_READ) {
+            result = pread(request->fd, request->buffer, request->size, (off_t)request->offset);
+        }
+        else {
+            result = pwrite(request->fd, request->buffer, request->size, (off_t)request->offset);
+        }
+        request->result = (result < 0) ? -errno : result;
+
+        pthread_mutex_lock(&io->threaded.mutex);
+        request->next = io->threaded.completedHead;
+        io->threaded.completedHead = request;
+        pthread_cond_signal(&io->threaded.completed);
+    }
+    pthread_mutex_unlock(&io->threaded.mutex);
+
+    return NULL;
+}
+
+static void InitThreaded(AsyncIo* io)
+{
+    Assert(pthread_mutex_init(&io->threaded.mutex, NULL) == 0, "Failed to create mutex");
+    Assert(pthread_cond_init(&io->threaded.submitted, NULL) == 0, "Failed to create condition variable");
+    Assert(pthread_cond_init(&io->threaded.completed, NULL) == 0, "Failed to create condition variable");
+    io->threaded.running = true;
+
+    for (u8 i = 0; i < ASYNC_IO_NUM_THREADS; i++) {
+        Assert(pthread_create(&io->threaded.threads[i], NULL, IoThread, (void*)io) == 0, "Failed to create I/O thread");
+    }
+}
+
+static void DeinitThreaded(AsyncIo* io)
+{
+    pthread_mutex_lock(&io->threaded.mutex);
+    io->threaded.running = false;
+    pthread_cond_broadcast(&io->threaded.submitted);
+    pthread_mutex_unlock(&io->threaded.mutex);
+
+    for (u8 i = 0; i < ASYNC_IO_NUM_THREADS; i++) {
+        pthread_join(io->threaded.threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&io->threaded.mutex);
+    pthread_cond_destroy(&io->threaded.submitted);
+    pthread_cond_destroy(&io->threaded.completed);
+}
+
+static void FlushThreaded(AsyncIo* io)
+{
+    pthread_mutex_lock(&io->threaded.mutex);
+    if (io->threaded.pendingTail != NULL) {
+        io->threaded.pendingTail->next = io->batchHead;
+    }
+    else {
+        io->threaded.pendingHead = io->batchHead;
+    }
+    io->threaded.pendingTail = io->batchTail;
+    pthread_cond_broadcast(&io->threaded.submitted);
+    pthread_mutex_unlock(&io->threaded.mutex);
+
+    io->batchHead = NULL;
+    io->batchTail = NULL;
+}
+
+static u32 ReapThreaded(AsyncIo* io, u32 timeoutMs)
+{
+    pthread_mutex_lock(&io->threaded.mutex);
+    if (io->threaded.completedHead == NULL && timeoutMs > 0 && io->numInFlight > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += (i64)timeoutMs * 1000000;
+        ts.tv_sec += ts.tv_nsec / 1000000000;
+        ts.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&io->threaded.completed, &io->threaded.mutex, &ts);
+    }
+    AsyncIoRequest* completed = io->threaded.completedHead;
+    io->threaded.completedHead = NULL;
+    pthread_mutex_unlock(&io->threaded.mutex);
+
+    u32 numCompleted = 0;
+    while (completed != NULL) {
+        AsyncIoRequest* next = completed->next;
+        numCompleted += CompleteRequest(io, completed);
+        completed = next;
+    }
+
+    return numCompleted;
+}
+
+// ============================================================================
+// io_uring backend, raw syscalls so there's no liburing dependency
+// ============================================================================
+
+#ifdef ASYNC_IO_HAVE_URING
+
+// user_data of the timeout used to bound waits, never a valid request pointer
+#define URING_TIMEOUT_TAG 1ull
+
+static bool InitUring(AsyncIo* io)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    i32 fd = (i32)syscall(__NR_io_uring_setup, ASYNC_IO_QUEUE_DEPTH, &params);
+    if (fd < 0) {
+        LogWarn("io_uring unavailable (%s), falling back to threaded I/O", strerror(errno));
+        return false;
+    }
+
+    io->uring.fd = fd;
+    io->uring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+    io->uring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        u64 size = (io->uring.sqRingSize > io->uring.cqRingSize) ? io->uring.sqRingSize : io->uring.cqRingSize;
+        io->uring.sqRingSize = size;
+        io->uring.cqRingSize = size;
+    }
+
+    io->uring.sqRing = mmap(NULL, io->uring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    Assert(io->uring.sqRing != MAP_FAILED, "Failed to map io_uring submission ring");
+    io->uring.cqRing = singleMmap
+        ? io->uring.sqRing
+        : mmap(NULL, io->uring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    Assert(io->uring.cqRing != MAP_FAILED, "Failed to map io_uring completion ring");
+
+    io->uring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->uring.sqes = mmap(NULL, io->uring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    Assert(io->uring.sqes != MAP_FAILED, "Failed to map io_uring submission entries");
+
+    u8* sq = (u8*)io->uring.sqRing;
+    u8* cq = (u8*)io->uring.cqRing;
+    io->uring.sqHead = (atomic_u32*)(sq + params.sq_off.head);
+    io->uring.sqTail = (atomic_u32*)(sq + params.sq_off.tail);
+    io->uring.sqMask = (u32*)(sq + params.sq_off.ring_mask);
+    io->uring.sqArray = (u32*)(sq + params.sq_off.array);
+    io->uring.cqHead = (atomic_u32*)(cq + params.cq_off.head);
+    io->uring.cqTail = (atomic_u32*)(cq + params.cq_off.tail);
+    io->uring.cqMask = (u32*)(cq + params.cq_off.ring_mask);
+    io->uring.cqes = cq + params.cq_off.cqes;
+    io->uring.sqPending = 0;
+
+    // Saves pinning pages on every request, not fatal if RLIMIT_MEMLOCK won't allow it
+    io->uring.buffersRegistered = false;
+    if (io->numBuffers > 0) {
+        struct iovec iovecs[ASYNC_IO_MAX_BUFFERS];
+        for (u32 i = 0; i < io->numBuffers; i++) {
+            iovecs[i].iov_base = io->buffers + (u64)i * io->bufferSize;
+            iovecs[i].iov_len = io->bufferSize;
+        }
+        io->uring.buffersRegistered =
+            syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs, io->numBuffers) == 0;
+        if (!io->uring.buffersRegistered) {
+            LogWarn("Couldn't register io_uring buffers (%s)", strerror(errno));
+        }
+    }
+
+    return true;
+}
+
+static void DeinitUring(AsyncIo* io)
+{
+    munmap(io->uring.sqes, io->uring.sqesSize);
+    if (io->uring.cqRing != io->uring.sqRing) {
+        munmap(io->uring.cqRing, io->uring.cqRingSize);
+    }
+    munmap(io->uring.sqRing, io->uring.sqRingSize);
+    close(io->uring.fd);
+}
+
+static struct io_uring_sqe* NextSqe(AsyncIo* io)
+{
+    u32 head = atomic_load_explicit(io->uring.sqHead, memory_order_acquire);
+    u32 tail = atomic_load_explicit(io->uring.sqTail, memory_order_relaxed) + io->uring.sqPending;
+    if (tail - head >= ASYNC_IO_QUEUE_DEPTH) {
+        return NULL;
+    }
+
+    u32 index = tail & *io->uring.sqMask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*)io->uring.sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    io->uring.sqArray[index] = index;
+    io->uring.sqPending++;
+    return sqe;
+}
+
+static bool QueueUring(AsyncIo* io, AsyncIoRequest* request)
+{
+    struct io_uring_sqe* sqe = NextSqe(io);
+    if (sqe == NULL) {
+        return false;
+    }
+
+    // Merged reads scatter across several buffers, so they can't be fixed buffer reads
+    bool fixed = io->uring.buffersRegistered && (request->bufferIndex >= 0);
+    if (request->numMerged > 0) {
+        sqe->opcode = IORING_OP_READV;
+    }
+    else if (request->op == ASYNC_IO_READ) {
+        sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    }
+    else {
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    }
+    sqe->fd = request->fd;
+    sqe->addr = (request->numMerged > 0)
+        ? (u64)(uintptr_t)((AsyncIoMerge*)request->data)->iovecs
+        : (u64)(uintptr_t)request->buffer;
+    sqe->len = (request->numMerged > 0) ? request->numMerged : request->size;
+    sqe->off = request->offset;
+    sqe->buf_index = fixed ? (u16)request->bufferIndex : 0;
+    sqe->user_data = (u64)(uintptr_t)request;
+    return true;
+}
+
+static void FlushUring(AsyncIo* io)
+{
+    u32 toSubmit = io->uring.sqPending;
+    if (toSubmit == 0) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(io->uring.sqTail, toSubmit, memory_order_release);
+    io->uring.sqPending = 0;
+
+    i32 submitted = (i32)syscall(__NR_io_uring_enter, io->uring.fd, toSubmit, 0, 0, NULL, 0);
+    Assert(submitted == (i32)toSubmit, "io_uring took %d of %d requests (%s)", submitted, toSubmit, strerror(errno));
+}
+
+static u32 ReapUring(AsyncIo* io, u32 timeoutMs)
+{
+    u32 head = atomic_load_explicit(io->uring.cqHead, memory_order_relaxed);
+    u32 tail = atomic_load_explicit(io->uring.cqTail, memory_order_acquire);
+
+    if (head == tail && timeoutMs > 0 && io->numInFlight > 0) {
+        // Wait for one completion, bounded by a timeout that itself completes if nothing else does
+        struct __kernel_timespec timeout = {
+            .tv_sec = timeoutMs / 1000,
+            .tv_nsec = (timeoutMs % 1000) * 1000000ll,
+        };
+        struct io_uring_sqe* sqe = NextSqe(io);
+        if (sqe != NULL) {
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->addr = (u64)(uintptr_t)&timeout;
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = URING_TIMEOUT_TAG;
+            FlushUring(io);
+            syscall(__NR_io_uring_enter, io->uring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        }
+        tail = atomic_load_explicit(io->uring.cqTail, memory_order_acquire);
+    }
+
+    u32 numCompleted = 0;
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &((struct io_uring_cqe*)io->uring.cqes)[head & *io->uring.cqMask];
+        u64 userData = cqe->user_data;
+        i32 result = cqe->res;
+
+        // Hand the entry back before the callback, it may well queue more work
+        head++;
+        atomic_store_explicit(io->uring.cqHead, head, memory_order_release);
+
+        if (userData == URING_TIMEOUT_TAG) {
+            continue;
+        }
+        AsyncIoRequest* request = (AsyncIoRequest*)(uintptr_t)userData;
+        request->result = result;
+        numCompleted += CompleteRequest(io, request);
+    }
+
+    return numCompleted;
+}
+
+#endif // ASYNC_IO_HAVE_URING
+
+// ============================================================================
+// API
+// ============================================================================
+
+void AsyncIo_Init(AsyncIo* io, HeapArena* arena, AsyncIoBackend backend, u32 numBuffers, u32 bufferSize)
+{
+    Assert(io, "AsyncIo is null");
+    Assert(numBuffers <= ASYNC_IO_MAX_BUFFERS, "Too many I/O buffers %d, max is %d", numBuffers, ASYNC_IO_MAX_BUFFERS);
+
+    memset(io, 0, sizeof(AsyncIo));
+
+    // O_DIRECT wants the memory, the file offset and the length all aligned
+    io->bufferSize = (u32)AlignUp(bufferSize, ASYNC_IO_ALIGNMENT);
+    io->numBuffers = numBuffers;
+    if (numBuffers > 0) {
+        Assert(arena, "Need an arena for the I/O buffers");
+        u8* block = HeapArena_Alloc(arena, (u64)numBuffers * io->bufferSize + ASYNC_IO_ALIGNMENT);
+        Assert(block, "Failed to allocate %d I/O buffers", numBuffers);
+        io->buffers = (u8*)AlignUp((uintptr_t)block, ASYNC_IO_ALIGNMENT);
+    }
+    for (u32 i = 0; i < numBuffers; i++) {
+        io->freeBuffers[i] = (u16)(numBuffers - 1 - i);
+    }
+    io->numFreeBuffers = numBuffers;
+    for (u32 i = 0; i < ASYNC_IO_MAX_MERGES; i++) {
+        io->freeMerges[i] = (u16)i;
+    }
+    io->numFreeMerges = ASYNC_IO_MAX_MERGES;
+
+    io->backend = ASYNC_IO_BACKEND_THREADED;
+#ifdef ASYNC_IO_HAVE_URING
+    if (backend != ASYNC_IO_BACKEND_THREADED && InitUring(io)) {
+        io->backend = ASYNC_IO_BACKEND_URING;
+    }
+#else
+    if (backend == ASYNC_IO_BACKEND_URING) {
+        LogWarn("io_uring isn't available on this platform, falling back to threaded I/O");
+    }
+#endif
+
+    if (io->backend == ASYNC_IO_BACKEND_THREADED) {
+        InitThreaded(io);
+    }
+
+    LogInfo("Async I/O { backend: %s, buffers: %d x %d bytes }", AsyncIo_BackendName(io), numBuffers, io->bufferSize);
+}
+
+void AsyncIo_Deinit(AsyncIo* io)
+{
+    Assert(io, "AsyncIo is null");
+
+    // Everything outstanding has to land before the buffers it points at go away
+    while (io->numInFlight > 0 || io->numQueued > 0) {
+        AsyncIo_Flush(io);
+        AsyncIo_Reap(io, 10);
+    }
+
+#ifdef ASYNC_IO_HAVE_URING
+    if (io->backend == ASYNC_IO_BACKEND_URING) {
+        DeinitUring(io);
+    }
+#endif
+    if (io->backend == ASYNC_IO_BACKEND_THREADED) {
+        DeinitThreaded(io);
+    }
+}
+
+const char* AsyncIo_BackendName(AsyncIo* io)
+{
+    return backendNames_[io->backend];
+}
+
+i32 AsyncIo_Open(const char* path, i32 flags, bool direct)
+{
+#ifdef O_DIRECT
+    if (direct) {
+        i32 fd = open(path, flags | O_DIRECT, 0644);
+        if (fd >= 0) {
+            return fd;
+        }
+        LogWarn("Can't open %s with O_DIRECT (%s), going through the page cache", path, strerror(errno));
+    }
+#endif
+
+    i32 fd = open(path, flags, 0644);
+
+#ifdef F_NOCACHE
+    if (direct && fd >= 0) {
+        fcntl(fd, F_NOCACHE, 1);
+    }
+#endif
+
+    return fd;
+}
+
+i32 AsyncIo_AcquireBuffer(AsyncIo* io)
+{
+    if (io->numFreeBuffers == 0) {
+        return -1;
+    }
+    return io->freeBuffers[--io->numFreeBuffers];
+}
+
+void AsyncIo_ReleaseBuffer(AsyncIo* io, i32 index)
+{
+    Assert(index >= 0 && (u32)index < io->numBuffers, "Invalid I/O buffer %d", index);
+    Assert(io->numFreeBuffers < io->numBuffers, "I/O buffer %d released twice", index);
+    io->freeBuffers[io->numFreeBuffers++] = (u16)index;
+}
+
+void* AsyncIo_GetBuffer(AsyncIo* io, i32 index)
+{
+    Assert(index >= 0 && (u32)index < io->numBuffers, "Invalid I/O buffer %d", index);
+    return io->buffers + (u64)index * io->bufferSize;
+}
+
+bool AsyncIo_Queue(AsyncIo* io, AsyncIoRequest* request)
+{
+    Assert(request && request->OnComplete, "I/O request needs a completion callback");
+
+    if (io->numInFlight + io->numQueued >= ASYNC_IO_QUEUE_DEPTH) {
+        return false;
+    }
+
+    request->numMerged = 0;
+    request->next = NULL;
+    if (io->batchTail != NULL) {
+        io->batchTail->next = request;
+    }
+    else {
+        io->batchHead = request;
+    }
+    io->batchTail = request;
+    io->numQueued++;
+    return true;
+}
+
+u32 AsyncIo_Flush(AsyncIo* io)
+{
+    u32 numQueued = io->numQueued;
+    if (numQueued == 0) {
+        return 0;
+    }
+
+    // Counted as in flight first, completions can come back before this returns
+    io->numInFlight += numQueued;
+    io->numQueued = 0;
+    MergeBatch(io);
+
+#ifdef ASYNC_IO_HAVE_URING
+    if (io->backend == ASYNC_IO_BACKEND_URING) {
+        // Nothing else is in the submission ring between flushes, the depth check on queue
+        // leaves room for the whole batch
+        AsyncIoRequest* request = io->batchHead;
+        while (request != NULL) {
+            AsyncIoRequest* next = request->next;
+            bool queued = QueueUring(io, request);
+            Assert(queued, "io_uring submission ring full");
+            request = next;
+        }
+        io->batchHead = NULL;
+        io->batchTail = NULL;
+        FlushUring(io);
+    }
+#endif
+    if (io->backend == ASYNC_IO_BACKEND_THREADED) {
+        FlushThreaded(io);
+    }
+
+    io->numSubmitted += numQueued;
+    io->numBatches++;
+    return numQueued;
+}
+
+u32 AsyncIo_Reap(AsyncIo* io, u32 timeoutMs)
+{
+#ifdef ASYNC_IO_HAVE_URING
+    if (io->backend == ASYNC_IO_BACKEND_URING) {
+        return ReapUring(io, timeoutMs);
+    }
+#endif
+    return ReapThreaded(io, timeoutMs);
+}
+
+void AsyncIo_LogStats(AsyncIo* io)
+{
+    LogInfo("Async I/O { backend: %s, requests: %llu, batches: %llu, mean batch: %.1f, merged reads: %llu, "
+            "read: %.1fMB, written: %.1fMB, errors: %llu }",
+            AsyncIo_BackendName(io),
+            io->numSubmitted,
+            io->numBatches,
+            (io->numBatches > 0) ? (f64)io->numSubmitted / io->numBatches : 0.0,
+            io->numMergedReads,
+            (f64)io->bytesRead / (1024.0 * 1024.0),
+            (f64)io->bytesWritten / (1024.0 * 1024.0),
+            io->numErrors);
+
+    if (io->numErrors > 0) {
+        LogWarn("%llu async I/O requests failed", io->numErrors);
+    }
+}
@@ -1,190 +1,262 @@
-#include <AudioToolbox/AudioToolbox.h>
-#include <CoreAudioTypes/CoreAudioBaseTypes.h>
 #include <audio_renderer.h>
 #include <stdatomic.h>
+#include <string.h>
+#include <trace.h>
 
 #ifndef MIN
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #endif
 
-static void WriteNextChunk(void* data)
+static void WriteFrames(AudioRenderer* renderer, const f32* frames, u32 numFrames)
 {
-    AudioRenderer* renderer = (AudioRenderer*)data;
-    Assert(renderer, "Renderer is null");
-
-    LogInfo("Rendering %d bytes", renderer->numFramesToWrite);
-
-    ExtAudioFileWrite(renderer->outputFile, 
-                      renderer->numFramesToWrite, 
-                      renderer->coreAudioBuffers[atomic_load(&renderer->currentBufferIndex) == 0 ? 1 : 0]); 
+    u64 startNs = Trace_NowNs();
+    if (renderer->file.format != PCM_FORMAT_F32) {
+        Pcm_EncodeStereoDithered(renderer->file.format, frames, numFrames, &renderer->dither, renderer->encoded);
+        frames = (const f32*)renderer->encoded;
+    }
+    WavWriter_Write(&renderer->file, frames, numFrames);
+    u64 writeNs = Trace_NowNs() - startNs;
 
-    renderer->numFramesToWrite = 0;
+    atomic_fetch_add(&renderer->framesWritten, numFrames);
+    atomic_fetch_add(&renderer->numWrites, 1);
+    if (writeNs > atomic_load(&renderer->maxWriteNs)) {
+        atomic_store(&renderer->maxWriteNs, writeNs);
+    }
 }
 
-static void ScheduleWrite(AudioRenderer* renderer)
+// A capture's file is only created once it's committed, nothing is left behind otherwise
+static void OpenFile(AudioRenderer* renderer)
 {
-    u16 bufferToPassToWriteChunk = atomic_load(&renderer->currentBufferIndex);
-    atomic_store(&renderer->currentBufferIndex,
-                 (bufferToPassToWriteChunk == 0 ? 1 : 0));
-    atomic_store(&renderer->seekPosition, 0);
-    memset(renderer->coreAudioBuffers[atomic_load(&renderer->currentBufferIndex)]->mBuffers[0].mData,
-           0,
-           AUDIO_FILE_CHUNK_SIZE * renderer->streamFormat.mBytesPerFrame);
-    ThreadPool_DeferTask(renderer->threadPool, WriteNextChunk, renderer);
+    if (renderer->file.fd < 0) {
+        WavWriter_Open(&renderer->file, renderer->path, renderer->format, 2, SAMPLE_RATE_DEFAULT);
+    }
 }
 
-static void ProcessRenderer(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+// Writes whole blocks straight out of the ring, or everything waiting if flushing
+static void Drain(AudioRenderer* renderer, bool flush)
 {
-    (void)sampleRate;
-
-    AudioRenderer* renderer = (AudioRenderer*)data;
-    Assert(renderer, "Renderer is null");
-
-    if ((atomic_load(&renderer->flags) & AUDIO_RENDERER_RECORDING) == 0) {
-        return;
+    u32 available = RecordRing_Available(&renderer->ring);
+    if (!flush) {
+        available -= available % RECORD_RING_BLOCK_FRAMES;
     }
 
-    u16 currentBufferIndex = atomic_load(&renderer->currentBufferIndex);
-    u16 seekPosition = atomic_load(&renderer->seekPosition);
-
-    f32* outputBuffer = (f32*)renderer->coreAudioBuffers[currentBufferIndex]->mBuffers[0].mData;
-    u16 channelsPerFrame = renderer->streamFormat.mChannelsPerFrame;
-
-    // TODO: how to start filling into the next buffer if it spills over?
-    u16 framesToProcess = MIN(numFrames, AUDIO_FILE_CHUNK_SIZE - seekPosition);
+    while (available > 0) {
+        const f32* frames;
+        u32 numFrames = RecordRing_Peek(&renderer->ring, MIN(available, RECORD_RING_BLOCK_FRAMES), &frames);
+        WriteFrames(renderer, frames, numFrames);
+        RecordRing_Consume(&renderer->ring, numFrames);
+        available -= numFrames;
+    }
 
-    for (u16 i = 0; i < framesToProcess; ++i) {
-        u32 outputSampleOffset = (seekPosition + i) * channelsPerFrame;
-        u32 inputSampleOffset = i * 2;
+    // A stopped recording is complete on disk without waiting for the next header rewrite
+    if (flush) {
+        WavWriter_WriteHeader(&renderer->file);
+    }
+}
 
-        outputBuffer[outputSampleOffset] += buffer[inputSampleOffset];     // Left channel
-        outputBuffer[outputSampleOffset + 1] += buffer[inputSampleOffset + 1]; // Right channel
+static void* Writer(void* data)
+{
+    AudioRenderer* renderer = (AudioRenderer*)data;
+    Assert(renderer, "Renderer is null");
 
-        if (atomic_load(&renderer->flags) & AUDIO_RENDERER_MUTE) {
-            outputBuffer[outputSampleOffset] = 0.0f;
-            outputBuffer[outputSampleOffset + 1] = 0.0f;
+    Trace_SetThreadName("Renderer Writer");
+
+    pthread_mutex_lock(&renderer->mutex);
+    while (atomic_load(&renderer->running)) {
+        // The ring is still the audio thread's until it hands over a committed capture
+        bool capturing = (atomic_load(&renderer->flags) & AUDIO_RENDERER_CAPTURING) != 0;
+        bool flush = !capturing && atomic_exchange(&renderer->flushRequested, false);
+        pthread_mutex_unlock(&renderer->mutex);
+        if (!capturing) {
+            OpenFile(renderer);
+            Drain(renderer, flush);
+        }
+        pthread_mutex_lock(&renderer->mutex);
+
+        if (atomic_load(&renderer->running) && (capturing || !atomic_load(&renderer->flushRequested))) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += AUDIO_RENDERER_WRITE_INTERVAL_MS * 1000000;
+            ts.tv_sec += ts.tv_nsec / 1000000000;
+            ts.tv_nsec %= 1000000000;
+            pthread_cond_timedwait(&renderer->cond, &renderer->mutex, &ts);
         }
     }
+    pthread_mutex_unlock(&renderer->mutex);
 
-    renderer->framesThisCycle = numFrames;
+    return NULL;
 }
 
-static void DestroyRenderer(void* data)
+static void ProcessRenderer(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
 {
+    (void)sampleRate;
+
     AudioRenderer* renderer = (AudioRenderer*)data;
     Assert(renderer, "Renderer is null");
 
-    // If the renderer is still running on shutdown, flush the remaining data
-    if ((renderer->flags & AUDIO_RENDERER_RECORDING) && (renderer->seekPosition > 0)) {
-        renderer->numFramesToWrite = renderer->seekPosition;
-        renderer->currentBufferIndex = (renderer->currentBufferIndex == 0) ? 1 : 0;
-        WriteNextChunk((void*)renderer);    
-    }
-
-    renderer->flags &= ~AUDIO_RENDERER_RECORDING;
+    u8 flags = atomic_load(&renderer->flags);
+    if (flags & AUDIO_RENDERER_CAPTURING) {
+        RecordRing_Write(&renderer->ring, (flags & AUDIO_RENDERER_MUTE) ? NULL : buffer, numFrames);
+        if ((flags & AUDIO_RENDERER_COMMIT) == 0) {
+            RecordRing_Trim(&renderer->ring, renderer->historyFrames);
+            return;
+        }
 
-    LogInfo("Destroying AudioRenderer");
+        // Done with the ring, from here on the writer takes what's in it
+        atomic_fetch_and(&renderer->flags, ~(AUDIO_RENDERER_CAPTURING | AUDIO_RENDERER_COMMIT));
+        return;
+    }
 
-    for (u8 i = 0; i < 2; i++) {
-        free(renderer->coreAudioBuffers[i]->mBuffers[0].mData);
-        free(renderer->coreAudioBuffers[i]);
+    if ((flags & AUDIO_RENDERER_RECORDING) == 0) {
+        return;
     }
 
-    ExtAudioFileDispose(renderer->outputFile);
+    // Muted keeps time in the recording with silence
+    RecordRing_Write(&renderer->ring, (flags & AUDIO_RENDERER_MUTE) ? NULL : buffer, numFrames);
 }
 
-static void RendererOnNewAudioCycle(void* data)
+static void DestroyRenderer(void* data)
 {
     AudioRenderer* renderer = (AudioRenderer*)data;
     Assert(renderer, "Renderer is null");
 
-    u16 oldSeekPosition = atomic_fetch_add(&renderer->seekPosition, renderer->framesThisCycle);
-    u16 newCalculatedSeekPosition = oldSeekPosition + renderer->framesThisCycle; // This is the logical end position
+    atomic_fetch_and(&renderer->flags, ~AUDIO_RENDERER_RECORDING);
+
+    pthread_mutex_lock(&renderer->mutex);
+    atomic_store(&renderer->running, false);
+    pthread_cond_signal(&renderer->cond);
+    pthread_mutex_unlock(&renderer->mutex);
+    pthread_join(renderer->writer, NULL);
 
-    if (newCalculatedSeekPosition >= AUDIO_FILE_CHUNK_SIZE) {
-        atomic_store(&renderer->numFramesToWrite, AUDIO_FILE_CHUNK_SIZE);
-        LogInfo("Scheduling Write (Full Chunk, previous seek %u, frames processed %u)", oldSeekPosition, renderer->framesThisCycle);
-        ScheduleWrite(renderer);
+    // Anything recorded up to shutdown still makes it into the file, a capture never
+    // committed doesn't
+    if ((atomic_load(&renderer->flags) & AUDIO_RENDERER_CAPTURING) == 0) {
+        OpenFile(renderer);
+        Drain(renderer, true);
     }
+
+    LogInfo("Destroying AudioRenderer");
+    AudioRenderer_LogStats(renderer);
+
+    pthread_mutex_destroy(&renderer->mutex);
+    pthread_cond_destroy(&renderer->cond);
+    WavWriter_Close(&renderer->file);
 }
 
 u16 AudioRenderer_Create(AudioRenderer* renderer, CoreEngineContext* ctx, const char* filename)
+{
+    return AudioRenderer_CreateWithFormat(renderer, ctx, filename, PCM_FORMAT_F32, PCM_DITHER_NONE);
+}
+
+static u16 Create(AudioRenderer* renderer, 
+                  CoreEngineContext* ctx, 
+                  const char* filename, 
+                  PcmFormat format, 
+                  PcmDitherMode dither,
+                  u32 historyFrames)
 {
     Assert(renderer, "Renderer is null");
     Assert(ctx, "Engine is null");
 
     LogInfo("Creating AudioRenderer for %s", filename);
 
-    OSStatus status;
-
-    CFURLRef url = CFURLCreateFromFileSystemRepresentation(
-        NULL/*TODO: use custom heap*/,
-        (const u8*)filename,
-        strlen(filename),
-        false // IsDirectory
-    );
-
-    CFShow(url);
-
-    memset(&renderer->streamFormat, 0, sizeof(AudioStreamBasicDescription));
-    renderer->streamFormat = (AudioStreamBasicDescription) {
-        .mSampleRate = SAMPLE_RATE_DEFAULT,
-        .mFormatID = kAudioFormatLinearPCM,
-        .mBytesPerPacket = 4 * 2,
-        .mFramesPerPacket = 1,
-        .mBytesPerFrame = 4 * 2,
-        .mChannelsPerFrame = 2,
-        .mBitsPerChannel = 32,
-        .mFormatFlags = kLinearPCMFormatFlagIsFloat |
-                        kLinearPCMFormatFlagIsPacked,
-    };
-
-    status = ExtAudioFileCreateWithURL(url, 
-                                       kAudioFileWAVEType, 
-                                       &renderer->streamFormat, 
-                                       NULL, // Default channel layout
-                                       kAudioFileFlags_EraseFile,
-                                       &renderer->outputFile);
-    Assert(status == noErr, "Failed to create output file for renderer %s, %d", filename, status);
-
-    status = ExtAudioFileSetProperty(renderer->outputFile,
-                                     kExtAudioFileProperty_ClientDataFormat,
-                                     sizeof(renderer->streamFormat),
-                                     &renderer->streamFormat);
-    Assert(status == noErr, "Failed to set data format for renderer %s, %d", filename, status);
-
-    u32 dataByteSize = AUDIO_FILE_CHUNK_SIZE * renderer->streamFormat.mBytesPerFrame;
-    for (u8 i = 0; i < 2; i++) {
-        renderer->coreAudioBuffers[i] = malloc(sizeof(AudioBufferList) + (sizeof(AudioBuffer)));
-        renderer->coreAudioBuffers[i]->mNumberBuffers = 1;
-        renderer->coreAudioBuffers[i]->mBuffers[0].mNumberChannels = 2;
-        renderer->coreAudioBuffers[i]->mBuffers[0].mDataByteSize = dataByteSize;
-        renderer->coreAudioBuffers[i]->mBuffers[0].mData = malloc(dataByteSize);
+    u64 pathSize = strlen(filename) + 1;
+    renderer->path = (char*)HeapArena_Alloc(&ctx->heapArena, pathSize);
+    memcpy(renderer->path, filename, pathSize);
+    renderer->format = format;
+    renderer->file.fd = -1;
+    if (historyFrames == 0) {
+        OpenFile(renderer);
     }
 
-    renderer->currentBufferIndex = 0;
-    renderer->flags = 0;
-    renderer->seekPosition = 0;
-    renderer->framesThisCycle = 0;
-    renderer->threadPool = &ctx->threadPool;
+    renderer->historyFrames = historyFrames;
+    if (historyFrames > 0) {
+        // Exactly the history, and only enough past it to stream it out once committed
+        RecordRing_InitExact(&renderer->ring, &ctx->heapArena, historyFrames + AUDIO_RENDERER_CAPTURE_HEADROOM_FRAMES);
+    }
+    else {
+        RecordRing_Init(&renderer->ring, &ctx->heapArena, RECORD_RING_DEFAULT_FRAMES);
+    }
+    PcmDither_Init(&renderer->dither, dither, (u32)Trace_NowNs());
+    renderer->encoded = NULL;
+    if (format != PCM_FORMAT_F32) {
+        u64 size = (u64)RECORD_RING_BLOCK_FRAMES * Pcm_BytesPerSample(format) * 2;
+        renderer->encoded = (u8*)AlignUp((u64)HeapArena_Alloc(&ctx->heapArena, size + RECORD_RING_ALIGNMENT), RECORD_RING_ALIGNMENT);
+    }
 
-    CFRelease(url);
+    atomic_store(&renderer->flags, historyFrames > 0 ? AUDIO_RENDERER_CAPTURING : 0);
+    atomic_store(&renderer->framesWritten, 0);
+    atomic_store(&renderer->numWrites, 0);
+    atomic_store(&renderer->maxWriteNs, 0);
+    atomic_store(&renderer->flushRequested, false);
+    atomic_store(&renderer->running, true);
+    Assert(pthread_mutex_init(&renderer->mutex, NULL) == 0, "Failed to create mutex");
+    Assert(pthread_cond_init(&renderer->cond, NULL) == 0, "Failed to create condition variable");
+    Assert(pthread_create(&renderer->writer, NULL, Writer, (void*)renderer) == 0, "Failed to create thread");
+
+    // A shed renderer would drop the cycle from the recording, and the copy is cheap
+    u16 id = CoreEngine_CreateProcessor(ctx, ProcessRenderer, DestroyRenderer, NULL, (void*)renderer);
+    CoreEngine_SetPriority(ctx, id, PROCESSOR_PRIORITY_CRITICAL);
+    return id;
+}
 
-    return CoreEngine_CreateProcessor(ctx, ProcessRenderer, DestroyRenderer, RendererOnNewAudioCycle, (void*)renderer);
+u16 AudioRenderer_CreateWithFormat(AudioRenderer* renderer, 
+                                   CoreEngineContext* ctx, 
+                                   const char* filename, 
+                                   PcmFormat format, 
+                                   PcmDitherMode dither)
+{
+    return Create(renderer, ctx, filename, format, dither, 0);
+}
+
+u16 AudioRenderer_CreateCapture(AudioRenderer* renderer,
+                                CoreEngineContext* ctx,
+                                const char* filename,
+                                PcmFormat format,
+                                PcmDitherMode dither,
+                                f64 historySeconds)
+{
+    u32 historyFrames = (u32)(historySeconds * SAMPLE_RATE_DEFAULT);
+    Assert(historyFrames > 0, "Capture of %.2fs holds no frames", historySeconds);
+    return Create(renderer, ctx, filename, format, dither, historyFrames);
 }
 
 void AudioRenderer_StartRecord(AudioRenderer* renderer)
 {
-    renderer->flags |= AUDIO_RENDERER_RECORDING;
+    atomic_fetch_or(&renderer->flags, AUDIO_RENDERER_RECORDING);
+}
+
+void AudioRenderer_Commit(AudioRenderer* renderer)
+{
+    Assert(renderer->historyFrames > 0, "Only a capture renderer can commit");
+
+    // Recording as soon as the audio thread hands over, a stop before then keeps just the history
+    atomic_fetch_or(&renderer->flags, AUDIO_RENDERER_RECORDING | AUDIO_RENDERER_COMMIT);
+
+    pthread_mutex_lock(&renderer->mutex);
+    pthread_cond_signal(&renderer->cond);
+    pthread_mutex_unlock(&renderer->mutex);
 }
 
 void AudioRenderer_StopRecord(AudioRenderer* renderer)
 {
-    renderer->flags &= ~AUDIO_RENDERER_RECORDING;
-    
-    if (atomic_load(&renderer->seekPosition) > 0) {
-        renderer->numFramesToWrite = renderer->seekPosition;
-        ScheduleWrite(renderer);
-    }
+    atomic_fetch_and(&renderer->flags, ~AUDIO_RENDERER_RECORDING);
+
+    pthread_mutex_lock(&renderer->mutex);
+    atomic_store(&renderer->flushRequested, true);
+    pthread_cond_signal(&renderer->cond);
+    pthread_mutex_unlock(&renderer->mutex);
 }
 
+void AudioRenderer_LogStats(AudioRenderer* renderer)
+{
+    LogInfo("AudioRenderer { written: %llu frames in %llu writes, worst write: %.2fms, "
+            "overruns: %llu (%llu frames), most waiting: %u of %u frames }",
+            atomic_load(&renderer->framesWritten),
+            atomic_load(&renderer->numWrites),
+            atomic_load(&renderer->maxWriteNs) / 1000000.0,
+            atomic_load(&renderer->ring.numOverruns),
+            atomic_load(&renderer->ring.numOverrunFrames),
+            atomic_load(&renderer->ring.maxLagFrames),
+            renderer->ring.capacity);
+}
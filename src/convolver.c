@@ -0,0 +1,470 @@
+#include <convolver.h>
+#include <logger.h>
+#include <resampler.h>
+#include <trace.h>
+#include <wav_file.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+// Partition size of each tier, each starts twice its size into the IR where the last ends
+static const u32 tierFrames_[CONVOLVER_NUM_TIERS] = { 1024, 8192 };
+
+// ============================================================================
+// Segments
+// ============================================================================
+
+static void InitSegment(ConvolverSegment* seg, HeapArena* arena, const f32* ir, u32 irFrames, u32 blockFrames, u32 offset, u32 end)
+{
+    end = MIN(end, irFrames);
+    seg->blockFrames = blockFrames;
+    seg->offset = offset;
+    seg->numPartitions = (end > offset) ? (end - offset + blockFrames - 1) / blockFrames : 0;
+    seg->numBins = blockFrames + 1;
+    seg->fdlHead = 0;
+    if (seg->numPartitions == 0) {
+        return;
+    }
+
+    u32 fftSize = blockFrames * 2;
+    u64 spectrumFloats = (u64)seg->numPartitions * 2 * seg->numBins;
+    u64 numFloats = spectrumFloats * 4 + blockFrames * 2 + fftSize * 2 + seg->numBins * 4;
+
+    f32* memory = HeapArena_Alloc(arena, numFloats * sizeof(f32));
+    memset(memory, 0, numFloats * sizeof(f32));
+
+    seg->irRe = memory;
+    seg->irIm = seg->irRe + spectrumFloats;
+    seg->fdlRe = seg->irIm + spectrumFloats;
+    seg->fdlIm = seg->fdlRe + spectrumFloats;
+    seg->previous = seg->fdlIm + spectrumFloats;
+    seg->re = seg->previous + blockFrames * 2;
+    seg->im = seg->re + fftSize;
+    seg->sumRe = seg->im + fftSize;
+    seg->sumIm = seg->sumRe + seg->numBins * 2;
+
+    Fft_Init(&seg->fft, arena, fftSize);
+
+    // Splitting doubles both the input and IR spectra and the inverse doesn't divide by its
+    // size, all taken out of the IR once here
+    f32 scale = 0.25f / fftSize;
+    for (u32 p = 0; p < seg->numPartitions; p++) {
+        memset(seg->re, 0, fftSize * sizeof(f32));
+        memset(seg->im, 0, fftSize * sizeof(f32));
+        u32 start = offset + p * blockFrames;
+        u32 numFrames = MIN(blockFrames, end - start);
+        for (u32 i = 0; i < numFrames; i++) {
+            seg->re[i] = ir[(start + i) * 2];
+            seg->im[i] = ir[(start + i) * 2 + 1];
+        }
+        Fft_Forward(&seg->fft, seg->re, seg->im);
+
+        f32* irRe = seg->irRe + p * 2 * seg->numBins;
+        f32* irIm = seg->irIm + p * 2 * seg->numBins;
+        Fft_SplitReal(&seg->fft, seg->re, seg->im, irRe, irIm, irRe + seg->numBins, irIm + seg->numBins);
+        for (u32 k = 0; k < seg->numBins * 2; k++) {
+            irRe[k] *= scale;
+            irIm[k] *= scale;
+        }
+    }
+}
+
+// Forgets all input, for picking up again after blocks went missing
+static void ResetSegment(ConvolverSegment* seg)
+{
+    u64 spectrumFloats = (u64)seg->numPartitions * 2 * seg->numBins;
+    memset(seg->fdlRe, 0, spectrumFloats * sizeof(f32));
+    memset(seg->fdlIm, 0, spectrumFloats * sizeof(f32));
+    memset(seg->previous, 0, seg->blockFrames * 2 * sizeof(f32));
+}
+
+static void MultiplyAdd(const f32* xRe, const f32* xIm, const f32* hRe, const f32* hIm, f32* sumRe, f32* sumIm, u32 numBins)
+{
+    for (u32 k = 0; k < numBins; k++) {
+        sumRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+        sumIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+    }
+}
+
+// Takes a block of interleaved input and gives the block of output it completes, which
+// belongs offset frames after the block that went in
+static void ProcessSegment(ConvolverSegment* seg, const f32* input, f32* output)
+{
+    u32 blockFrames = seg->blockFrames;
+    u32 numBins = seg->numBins;
+    f32* previousLeft = seg->previous;
+    f32* previousRight = seg->previous + blockFrames;
+
+    // Overlap save, the last block then this one
+    for (u32 i = 0; i < blockFrames; i++) {
+        seg->re[i] = previousLeft[i];
+        seg->im[i] = previousRight[i];
+        previousLeft[i] = seg->re[blockFrames + i] = input[i * 2];
+        previousRight[i] = seg->im[blockFrames + i] = input[i * 2 + 1];
+    }
+    Fft_Forward(&seg->fft, seg->re, seg->im);
+
+    seg->fdlHead = (seg->fdlHead + 1) % seg->numPartitions;
+    f32* xRe = seg->fdlRe + seg->fdlHead * 2 * numBins;
+    f32* xIm = seg->fdlIm + seg->fdlHead * 2 * numBins;
+    Fft_SplitReal(&seg->fft, seg->re, seg->im, xRe, xIm, xRe + numBins, xIm + numBins);
+
+    // Partition p against the input p blocks back, both channels in one run
+    memset(seg->sumRe, 0, numBins * 2 * sizeof(f32));
+    memset(seg->sumIm, 0, numBins * 2 * sizeof(f32));
+    for (u32 p = 0; p < seg->numPartitions; p++) {
+        u32 slot = (seg->fdlHead + seg->numPartitions - p) % seg->numPartitions;
+        MultiplyAdd(seg->fdlRe + slot * 2 * numBins,
+                    seg->fdlIm + slot * 2 * numBins,
+                    seg->irRe + p * 2 * numBins,
+                    seg->irIm + p * 2 * numBins,
+                    seg->sumRe,
+                    seg->sumIm,
+                    numBins * 2);
+    }
+
+    Fft_JoinReal(&seg->fft, seg->sumRe, seg->sumIm, seg->sumRe + numBins, seg->sumIm + numBins, seg->re, seg->im);
+    Fft_Inverse(&seg->fft, seg->re, seg->im);
+    for (u32 i = 0; i < blockFrames; i++) {
+        output[i * 2] = seg->re[blockFrames + i];
+        output[i * 2 + 1] = seg->im[blockFrames + i];
+    }
+}
+
+// ============================================================================
+// Tiers
+// ============================================================================
+
+static void ProcessTier(void* data)
+{
+    ConvolverTier* tier = (ConvolverTier*)data;
+    Assert(tier, "Tier is null");
+
+    u32 blockSamples = tier->segment.blockFrames * 2;
+
+    // Whoever holds the tier takes every block waiting, in order
+    while (!atomic_exchange(&tier->busy, true)) {
+        u64 consumed = atomic_load(&tier->numConsumed);
+        while (consumed < atomic_load(&tier->numSubmitted)) {
+            u32 slot = consumed % CONVOLVER_TIER_SLOTS;
+            u64 block = tier->inBlocks[slot];
+            if (block != tier->lastBlock + 1) {
+                ResetSegment(&tier->segment);
+            }
+
+            u64 startNs = Trace_NowNs();
+            ProcessSegment(&tier->segment, tier->inSlots + slot * blockSamples, tier->outSlots + (block % CONVOLVER_TIER_SLOTS) * blockSamples);
+            u64 processNs = Trace_NowNs() - startNs;
+            if (processNs > atomic_load(&tier->maxProcessNs)) {
+                atomic_store(&tier->maxProcessNs, processNs);
+            }
+
+            atomic_store(&tier->outBlocks[block % CONVOLVER_TIER_SLOTS], block);
+            tier->lastBlock = block;
+            atomic_store(&tier->numConsumed, ++consumed);
+        }
+        atomic_store(&tier->busy, false);
+
+        // A block handed over since the last look, whose task found the tier busy
+        if (atomic_load(&tier->numConsumed) == atomic_load(&tier->numSubmitted)) {
+            break;
+        }
+    }
+}
+
+// Audio thread, decides whether the new block has a slot to fill and whether the output
+// from two blocks back made it
+static void BeginTierBlock(ConvolverTier* tier)
+{
+    u64 numSubmitted = atomic_load_explicit(&tier->numSubmitted, memory_order_relaxed);
+    tier->filling = (numSubmitted - atomic_load(&tier->numConsumed)) < CONVOLVER_TIER_SLOTS;
+
+    tier->playing = false;
+    if (tier->block >= 2) {
+        u64 playBlock = tier->block - 2;
+        tier->playing = (atomic_load(&tier->outBlocks[playBlock % CONVOLVER_TIER_SLOTS]) == playBlock);
+        if (!tier->playing) {
+            atomic_fetch_add(&tier->numLateBlocks, 1);
+        }
+    }
+}
+
+static void EndTierBlock(ConvolverTier* tier)
+{
+    if (tier->filling) {
+        u64 numSubmitted = atomic_load_explicit(&tier->numSubmitted, memory_order_relaxed);
+        tier->inBlocks[numSubmitted % CONVOLVER_TIER_SLOTS] = tier->block;
+        atomic_store(&tier->numSubmitted, numSubmitted + 1);
+        ThreadPool_DeferTask(tier->threadPool, ProcessTier, (void*)tier);
+    }
+
+    tier->block++;
+    BeginTierBlock(tier);
+}
+
+// Audio thread, gathers input into the slot being filled and adds in what's playing
+static void ExchangeTier(ConvolverTier* tier, u64 frame, const f32* input, u32 numFrames, f32* output)
+{
+    u32 blockSamples = tier->segment.blockFrames * 2;
+    u32 pos = (u32)(frame & (tier->segment.blockFrames - 1));
+
+    if (tier->filling) {
+        u64 numSubmitted = atomic_load_explicit(&tier->numSubmitted, memory_order_relaxed);
+        f32* slot = tier->inSlots + (numSubmitted % CONVOLVER_TIER_SLOTS) * blockSamples;
+        memcpy(slot + pos * 2, input, numFrames * 2 * sizeof(f32));
+    }
+
+    if (tier->playing) {
+        const f32* slot = tier->outSlots + ((tier->block - 2) % CONVOLVER_TIER_SLOTS) * blockSamples;
+        for (u32 i = 0; i < numFrames * 2; i++) {
+            output[i] += slot[pos * 2 + i];
+        }
+    }
+}
+
+static void InitTier(ConvolverTier* tier, ThreadPool* threadPool, HeapArena* arena, const f32* ir, u32 irFrames, u32 blockFrames, u32 end)
+{
+    InitSegment(&tier->segment, arena, ir, irFrames, blockFrames, blockFrames * 2, end);
+    tier->threadPool = threadPool;
+
+    u64 slotBytes = (u64)CONVOLVER_TIER_SLOTS * blockFrames * 2 * sizeof(f32);
+    tier->inSlots = HeapArena_Alloc(arena, slotBytes * 2);
+    memset(tier->inSlots, 0, slotBytes * 2);
+    tier->outSlots = tier->inSlots + CONVOLVER_TIER_SLOTS * blockFrames * 2;
+
+    for (u32 i = 0; i < CONVOLVER_TIER_SLOTS; i++) {
+        tier->inBlocks[i] = 0;
+        atomic_store(&tier->outBlocks[i], UINT64_MAX);
+    }
+    atomic_store(&tier->numSubmitted, 0);
+    atomic_store(&tier->numConsumed, 0);
+    atomic_store(&tier->busy, false);
+    tier->lastBlock = UINT64_MAX;
+    tier->block = 0;
+    atomic_store(&tier->numLateBlocks, 0);
+    atomic_store(&tier->maxProcessNs, 0);
+    BeginTierBlock(tier);
+}
+
+// ============================================================================
+// Direct form head
+// ============================================================================
+
+// Both channels' output for the frame just written at historyPos
+static void DirectFrame(const Convolver* conv, f32* output)
+{
+    const f32* left = conv->history + conv->historyPos + 1;
+    const f32* right = left + CONVOLVER_HEAD_FRAMES * 2;
+    const f32* tapsLeft = conv->taps;
+    const f32* tapsRight = conv->taps + CONVOLVER_HEAD_FRAMES;
+
+#if defined(__ARM_NEON)
+    float32x4_t sumLeft = vdupq_n_f32(0.0f);
+    float32x4_t sumRight = vdupq_n_f32(0.0f);
+    for (u32 tap = 0; tap < CONVOLVER_HEAD_FRAMES; tap += 4) {
+        sumLeft = vmlaq_f32(sumLeft, vld1q_f32(tapsLeft + tap), vld1q_f32(left + tap));
+        sumRight = vmlaq_f32(sumRight, vld1q_f32(tapsRight + tap), vld1q_f32(right + tap));
+    }
+    float32x2_t pairs = vpadd_f32(vadd_f32(vget_low_f32(sumLeft), vget_high_f32(sumLeft)),
+                                  vadd_f32(vget_low_f32(sumRight), vget_high_f32(sumRight)));
+    vst1_f32(output, pairs);
+#elif defined(__SSE2__)
+    __m128 sumLeft = _mm_setzero_ps();
+    __m128 sumRight = _mm_setzero_ps();
+    for (u32 tap = 0; tap < CONVOLVER_HEAD_FRAMES; tap += 4) {
+        sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(_mm_loadu_ps(tapsLeft + tap), _mm_loadu_ps(left + tap)));
+        sumRight = _mm_add_ps(sumRight, _mm_mul_ps(_mm_loadu_ps(tapsRight + tap), _mm_loadu_ps(right + tap)));
+    }
+    f32 lanes[8];
+    _mm_storeu_ps(lanes, sumLeft);
+    _mm_storeu_ps(lanes + 4, sumRight);
+    output[0] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    output[1] = (lanes[4] + lanes[5]) + (lanes[6] + lanes[7]);
+#else
+    f32 sumLeft = 0.0f;
+    f32 sumRight = 0.0f;
+    for (u32 tap = 0; tap < CONVOLVER_HEAD_FRAMES; tap++) {
+        sumLeft += tapsLeft[tap] * left[tap];
+        sumRight += tapsRight[tap] * right[tap];
+    }
+    output[0] = sumLeft;
+    output[1] = sumRight;
+#endif
+}
+
+// ============================================================================
+// Processor
+// ============================================================================
+
+static void ProcessConvolver(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    (void)sampleRate;
+
+    Convolver* conv = (Convolver*)data;
+    Assert(conv, "Convolver is null");
+
+    f32 dry = atomic_load_explicit(&conv->dry, memory_order_relaxed);
+    f32 wet = atomic_load_explicit(&conv->wet, memory_order_relaxed);
+    f32 output[CONVOLVER_HEAD_FRAMES * 2];
+
+    // A head block at a time, tier blocks are whole numbers of them so their edges line up
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 pos = (u32)(conv->frame % CONVOLVER_HEAD_FRAMES);
+        u32 chunkFrames = MIN((u32)numFrames - done, CONVOLVER_HEAD_FRAMES - pos);
+        f32* io = buffer + done * 2;
+
+        for (u32 i = 0; i < chunkFrames; i++) {
+            f32* left = conv->history + conv->historyPos;
+            f32* right = left + CONVOLVER_HEAD_FRAMES * 2;
+            left[0] = left[CONVOLVER_HEAD_FRAMES] = io[i * 2];
+            right[0] = right[CONVOLVER_HEAD_FRAMES] = io[i * 2 + 1];
+            DirectFrame(conv, output + i * 2);
+            conv->historyPos = (conv->historyPos + 1) % CONVOLVER_HEAD_FRAMES;
+        }
+
+        if (conv->head.numPartitions > 0) {
+            memcpy(conv->headIn + pos * 2, io, chunkFrames * 2 * sizeof(f32));
+            for (u32 i = 0; i < chunkFrames * 2; i++) {
+                output[i] += conv->headOut[pos * 2 + i];
+            }
+        }
+
+        for (u32 t = 0; t < conv->numTiers; t++) {
+            ExchangeTier(&conv->tiers[t], conv->frame, io, chunkFrames, output);
+        }
+
+        for (u32 i = 0; i < chunkFrames * 2; i++) {
+            io[i] = io[i] * dry + output[i] * wet;
+        }
+
+        conv->frame += chunkFrames;
+        done += chunkFrames;
+
+        if (conv->head.numPartitions > 0 && (conv->frame % CONVOLVER_HEAD_FRAMES) == 0) {
+            ProcessSegment(&conv->head, conv->headIn, conv->headOut);
+        }
+        for (u32 t = 0; t < conv->numTiers; t++) {
+            if ((conv->frame & (conv->tiers[t].segment.blockFrames - 1)) == 0) {
+                EndTierBlock(&conv->tiers[t]);
+            }
+        }
+    }
+}
+
+static void DestroyConvolver(void* data)
+{
+    Convolver* conv = (Convolver*)data;
+    Assert(conv, "Convolver is null");
+
+    LogInfo("Destroying Convolver");
+    Convolver_LogStats(conv);
+}
+
+u16 Convolver_CreateFromFrames(Convolver* conv, CoreEngineContext* ctx, const f32* ir, u32 numFrames)
+{
+    Assert(conv, "Convolver is null");
+    Assert(ctx, "Engine is null");
+    Assert(ir && numFrames > 0, "Convolver needs an impulse response");
+
+    conv->irFrames = numFrames;
+    conv->frame = 0;
+
+    // Taps, doubled history, and the head's gathering and output blocks
+    u32 headSamples = CONVOLVER_HEAD_FRAMES * 2;
+    u64 numFloats = headSamples + headSamples * 2 + headSamples * 2;
+    conv->taps = HeapArena_Alloc(&ctx->heapArena, numFloats * sizeof(f32));
+    memset(conv->taps, 0, numFloats * sizeof(f32));
+    conv->history = conv->taps + headSamples;
+    conv->headIn = conv->history + headSamples * 2;
+    conv->headOut = conv->headIn + headSamples;
+    conv->historyPos = 0;
+
+    for (u32 tap = 0; tap < CONVOLVER_HEAD_FRAMES; tap++) {
+        u32 frame = CONVOLVER_HEAD_FRAMES - 1 - tap;
+        if (frame < numFrames) {
+            conv->taps[tap] = ir[frame * 2];
+            conv->taps[CONVOLVER_HEAD_FRAMES + tap] = ir[frame * 2 + 1];
+        }
+    }
+
+    InitSegment(&conv->head, &ctx->heapArena, ir, numFrames, CONVOLVER_HEAD_FRAMES, CONVOLVER_HEAD_FRAMES, tierFrames_[0] * 2);
+
+    conv->numTiers = 0;
+    for (u32 t = 0; t < CONVOLVER_NUM_TIERS && numFrames > tierFrames_[t] * 2; t++) {
+        u32 end = (t + 1 < CONVOLVER_NUM_TIERS) ? tierFrames_[t + 1] * 2 : numFrames;
+        InitTier(&conv->tiers[t], &ctx->threadPool, &ctx->heapArena, ir, numFrames, tierFrames_[t], end);
+        conv->numTiers++;
+    }
+
+    atomic_store(&conv->dry, 0.0f);
+    atomic_store(&conv->wet, 1.0f);
+
+    LogInfo("Creating Convolver { ir: %u frames, head partitions: %u, tiers: %u (%u, %u partitions) }",
+            numFrames,
+            conv->head.numPartitions,
+            conv->numTiers,
+            conv->numTiers > 0 ? conv->tiers[0].segment.numPartitions : 0,
+            conv->numTiers > 1 ? conv->tiers[1].segment.numPartitions : 0);
+
+    return CoreEngine_CreateProcessor(ctx, ProcessConvolver, DestroyConvolver, NULL, (void*)conv);
+}
+
+u16 Convolver_Create(Convolver* conv, CoreEngineContext* ctx, const char* irPath)
+{
+    WavFile file;
+    WavFile_Open(&file, irPath);
+    Assert(file.totalFrames > 0 && file.totalFrames <= UINT32_MAX, "Impulse response %s has %llu frames", irPath, file.totalFrames);
+
+    u32 numFrames = (u32)file.totalFrames;
+    f32* frames = malloc((u64)numFrames * 2 * sizeof(f32));
+    Assert(frames, "Failed to allocate %u frames for %s", numFrames, irPath);
+    WavFile_ReadFrames(&file, 0, numFrames, frames);
+
+    // Converted once here, the IR has to be at the rate it'll be played at
+    if (file.sampleRate != SAMPLE_RATE_DEFAULT) {
+        u64 numConverted = Resampler_OutputFrames(file.sampleRate, SAMPLE_RATE_DEFAULT, numFrames);
+        f32* converted = malloc(numConverted * 2 * sizeof(f32));
+        Assert(converted, "Failed to allocate %llu frames for %s", numConverted, irPath);
+        Resampler_ConvertAll(RESAMPLER_QUALITY_HIGH, file.sampleRate, SAMPLE_RATE_DEFAULT, frames, numFrames, converted, numConverted);
+        free(frames);
+        frames = converted;
+        numFrames = (u32)numConverted;
+    }
+    WavFile_Close(&file);
+
+    u16 id = Convolver_CreateFromFrames(conv, ctx, frames, numFrames);
+    free(frames);
+    return id;
+}
+
+void Convolver_SetMix(Convolver* conv, f32 dry, f32 wet)
+{
+    atomic_store(&conv->dry, dry);
+    atomic_store(&conv->wet, wet);
+}
+
+void Convolver_LogStats(Convolver* conv)
+{
+    for (u32 t = 0; t < conv->numTiers; t++) {
+        ConvolverTier* tier = &conv->tiers[t];
+        LogInfo("Convolver tier %u { partitions: %u of %u frames, blocks: %llu, late: %llu, worst block: %.2fms of %.2fms }",
+                t,
+                tier->segment.numPartitions,
+                tier->segment.blockFrames,
+                atomic_load(&tier->numConsumed),
+                atomic_load(&tier->numLateBlocks),
+                atomic_load(&tier->maxProcessNs) / 1000000.0,
+                tier->segment.blockFrames * 1000.0 / SAMPLE_RATE_DEFAULT);
+    }
+}
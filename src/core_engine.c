@@ -9,7 +9,10 @@
 #include <allocator.h>
 #include <core_engine.h>
 #include <logger.h>
+#include <rt_check.h>
 #include <stdint.h>
+#include <string.h>
+#include <trace.h>
 #include <utils.h>
 
 static CoreEngineContext* instance_ = NULL;
@@ -49,14 +52,19 @@ static void Traverse(AudioProcessor* processors,
                         f32* inputBuffer, 
                         f32* outputBuffer, 
                         u8 stackDepth, 
-                        ScratchAllocator* alloc)
+                        ScratchAllocator* alloc,
+                        LoadMonitor* monitor)
 {
     LogTrace("Traverse %d", stackDepth);
     Assert(stackDepth < 128, "Stack depth limit exceeded");
 
-    // Do DSP
+    // Do DSP, unless shed due to overload in which case audio passes straight through
     AudioProcessor* processor = &processors[processorId];
-    processor->Process(sampleRate, numFrames, inputBuffer, processor->procData);
+    if (!LoadMonitor_ShouldBypass(monitor, processor->priority)) {
+        TraceBeginId("Process", processorId);
+        processor->Process(sampleRate, numFrames, inputBuffer, processor->procData);
+        TraceEnd("Process");
+    }
 
     // End of branch, write to master buffer then exit
     if (processor->outputRoutingMask == 0) {
@@ -71,7 +79,7 @@ static void Traverse(AudioProcessor* processors,
         currentMask &= ~(1 << nextId); 
         f32* nextBuffer = ScratchAllocator_Alloc(alloc, BUFFER_SIZE * sizeof(f32));
         memcpy(nextBuffer, inputBuffer, BUFFER_SIZE * sizeof(f32));
-        Traverse(processors, nextId, sampleRate, numFrames, nextBuffer, outputBuffer, stackDepth + 1, alloc);
+        Traverse(processors, nextId, sampleRate, numFrames, nextBuffer, outputBuffer, stackDepth + 1, alloc, monitor);
     }
 }
 
@@ -84,12 +92,20 @@ static OSStatus AudioRenderCallback(void* args,
 {
     // Unused
     (void)busNumber;
-    (void)timestamp; // TODO: probably want to use this
-    (void)busNumber;
     (void)ioActionFlags;
 
     LogTrace("< -- NEW AUDIO CYCLE -->");
 
+    static _Thread_local bool threadNamed = false;
+    if (!threadNamed) {
+        Trace_SetThreadName("Audio");
+        threadNamed = true;
+    }
+
+    RtCheck_EnterRealtime();
+    u64 cycleStartNs = Trace_NowNs();
+    TraceBegin("AudioCycle");
+
     CoreEngineContext* ctx = (CoreEngineContext*)args;
     AudioBuffer* masterBuffer = &ioData->mBuffers[0];
 
@@ -106,6 +122,8 @@ static OSStatus AudioRenderCallback(void* args,
 
     // Note: this must come after the buffers are zeroed out above to prevent horrible glitching!
     if (!IsFlagSet(ctx, ENGINE_STARTED)) {
+        TraceEnd("AudioCycle");
+        RtCheck_ExitRealtime();
         return noErr;
     }
 
@@ -118,14 +136,25 @@ static OSStatus AudioRenderCallback(void* args,
         ctx->masterVolumeScale = 0.0;
         
         // Signal the main thread to continue
+        // One-off shutdown handshake, the output is already silent
         SetFlag(ctx, ENGINE_AUDIO_THREAD_SILENCED);
+        RtCheck_BeginAllow();
         Assert(pthread_cond_signal(&ctx->cond) == 0, "Failed to signal condition variable");
+        RtCheck_EndAllow();
 
+        TraceEnd("AudioCycle");
+        RtCheck_ExitRealtime();
         return noErr;
     }
 
     Assert(ioData->mNumberBuffers == 1, "Error expected single interleaved audio stream");
 
+    if (timestamp && (timestamp->mFlags & kAudioTimeStampSampleTimeValid)) {
+        if (LoadMonitor_CheckTimestamp(&ctx->loadMonitor, timestamp->mSampleTime, numFrames)) {
+            TraceInstant("DeviceXrun");
+        }
+    }
+
     // ========================================================================
     // Notify all active processors of new audio cycle
     // ========================================================================
@@ -162,7 +191,8 @@ static OSStatus AudioRenderCallback(void* args,
                 inputBuffer, 
                 masterBuffer->mData,
                 0, // Stack depth
-                &ctx->scratchAllocator
+                &ctx->scratchAllocator,
+                &ctx->loadMonitor
             );
         }
     }
@@ -171,12 +201,24 @@ static OSStatus AudioRenderCallback(void* args,
     LogInfoPeriodic(5000, "Used buffer space %d/%d",ctx->scratchAllocator.offset, ctx->scratchAllocator.size);
     ScratchAllocator_Release(&ctx->scratchAllocator);
 
+    // ========================================================================
+    // Check the deadline, adjust load shedding and snapshot the trace on a miss
+    // ========================================================================
+
+    u64 budgetNs = (u64)((f64)numFrames * 1e9 / ctx->sampleRate);
+    bool missed = LoadMonitor_EndCycle(&ctx->loadMonitor, Trace_NowNs() - cycleStartNs, budgetNs);
+    if (missed && Trace_Trigger("DeadlineMiss") && !ThreadPool_TryDeferTask(&ctx->threadPool, Trace_DumpTask, NULL)) {
+        Trace_CancelDump();
+    }
+
     // ========================================================================
     // Execute any deferred non-realtime tasks (e.g. file IO)
     // ========================================================================
 
     ThreadPool_FlushTasks(&ctx->threadPool); 
 
+    TraceEnd("AudioCycle");
+    RtCheck_ExitRealtime();
     return noErr;
 }
 
@@ -188,8 +230,15 @@ void CoreEngine_Init(CoreEngineContext *ctx, float masterVolumeScale, u64 heapAr
     Assert(heapArenaSizeKb > 0, "Provided heap size must be greater than zero");
     Assert(instance_ == NULL, "Error, already existing instance of engine");
 
-    ctx->heapArena = malloc(heapArenaSizeKb * 1024); 
-    Assert(ctx->heapArena, "Failed to allocate %d kilobytes for heap arena");
+    Logger_Start();
+
+    HeapArena_Init(&ctx->heapArena, heapArenaSizeKb * 1024);
+    Assert(pthread_mutex_init(&ctx->poolMutex, NULL) == 0, "Failed to initialise pool mutex");
+    atomic_store(&ctx->numPools, 0);
+    u32 chunkSize = AUDIO_FILE_CHUNK_SIZE * 2 * sizeof(f32);
+    u32 numChunks = (u32)((heapArenaSizeKb * 1024) / AUDIO_CHUNK_POOL_HEAP_SHARE / chunkSize);
+    Assert(numChunks > 0, "Heap arena of %lluKB too small for any audio chunks", heapArenaSizeKb);
+    ctx->chunkPool = CoreEngine_CreatePool(ctx, "AudioChunk", chunkSize, numChunks);
 
     memset(ctx->scratchArena, 0, STACK_ARENA_SIZE_KB * 1024);
     ScratchAllocator_Init(&ctx->scratchAllocator, ctx->scratchArena, STACK_ARENA_SIZE_KB * 1024);
@@ -204,6 +253,18 @@ void CoreEngine_Init(CoreEngineContext *ctx, float masterVolumeScale, u64 heapAr
     ctx->sampleRate = 0;
 
     ThreadPool_Init(&ctx->threadPool, 4/* TODO: base this on number of cores? */, MAX_TASKS);
+    StreamScheduler_Init(&ctx->streamScheduler, STREAM_NUM_IO_THREADS, STREAM_MAX_IO_PER_DEVICE);
+
+    // Each I/O buffer holds a chunk's worth of float stereo plus slack for aligning the read
+    u32 ioBufferSize = chunkSize + ASYNC_IO_ALIGNMENT;
+    u64 numIoBuffers = (heapArenaSizeKb * 1024) / ASYNC_IO_BUFFER_HEAP_SHARE / ioBufferSize;
+    numIoBuffers = (numIoBuffers > ASYNC_IO_MAX_BUFFERS) ? ASYNC_IO_MAX_BUFFERS : numIoBuffers;
+    AsyncIo_Init(&ctx->asyncIo, &ctx->heapArena, ASYNC_IO_BACKEND_AUTO, (u32)numIoBuffers, ioBufferSize);
+    if (numIoBuffers > 0) {
+        StreamScheduler_AttachAsyncIo(&ctx->streamScheduler, &ctx->asyncIo, STREAM_MAX_ASYNC_PER_DEVICE);
+    }
+    SampleCache_Init(&ctx->sampleCache, (u64)SAMPLE_CACHE_DEFAULT_BUDGET_MB * 1024 * 1024, true);
+    LoadMonitor_Init(&ctx->loadMonitor);
 
     instance_ = ctx;
     SetFlag(ctx, ENGINE_INITIALIZED);
@@ -230,7 +291,18 @@ void CoreEngine_Deinit(CoreEngineContext* ctx)
     ctx->flags = 0;
     ScratchAllocator_Release(&ctx->scratchAllocator);
     ThreadPool_Deinit(&ctx->threadPool);
+    StreamScheduler_Deinit(&ctx->streamScheduler);
+    AsyncIo_Deinit(&ctx->asyncIo);
+    SampleCache_Deinit(&ctx->sampleCache);
+
+    CoreEngine_LogMemoryStats(ctx);
+    Assert(pthread_mutex_destroy(&ctx->poolMutex) == 0, "Failed to destroy pool mutex");
+    HeapArena_Deinit(&ctx->heapArena);
+    atomic_store(&ctx->numPools, 0);
+    ctx->chunkPool = NULL;
+
     instance_ = NULL;
+    Logger_Stop();
 }
 
 void CoreEngine_Start(CoreEngineContext* ctx)
@@ -314,6 +386,7 @@ void CoreEngine_Start(CoreEngineContext* ctx)
     sa.sa_flags = 0;
 
     ThreadPool_Start(&ctx->threadPool);
+    StreamScheduler_Start(&ctx->streamScheduler);
 
     // Must set this first before the next line in case of panic so we can close it
     instance_ = ctx;
@@ -329,6 +402,7 @@ void CoreEngine_Stop(CoreEngineContext* ctx)
 
     // Stop remaining non-realtime tasks
     ThreadPool_Stop(&ctx->threadPool);
+    StreamScheduler_Stop(&ctx->streamScheduler);
 
     OSStatus status;
     SetFlag(ctx, ENGINE_STOP_REQUESTED);
@@ -340,6 +414,9 @@ void CoreEngine_Stop(CoreEngineContext* ctx)
     Assert(pthread_cond_wait(&ctx->cond, &ctx->mutex) == 0, "Failed to wait for condition variable");
     Assert(pthread_mutex_unlock(&ctx->mutex) == 0, "Failed to unlock mutex");
     UnsetFlag(ctx, ENGINE_STARTED);
+    LoadMonitor_LogStats(&ctx->loadMonitor);
+    StreamScheduler_LogStats(&ctx->streamScheduler);
+    SampleCache_LogStats(&ctx->sampleCache);
 
     status = AudioOutputUnitStop(ctx->caUnit);
     Assert(status == noErr, "Failed to stop audio unit. Status: %d", status);
@@ -376,6 +453,7 @@ u16 CoreEngine_CreateProcessor(CoreEngineContext* ctx,
     AudioProcessor* processor = &ctx->processors[freeSlot];
     processor->inputRoutingMask = 0;
     processor->outputRoutingMask = 0;
+    processor->priority = PROCESSOR_PRIORITY_CRITICAL; // Only shed once it opts in
     processor->Process = procFunc;
     processor->Destroy = destFunc;
     processor->OnNewAudioCycle = onNewAudioCycleFunc;
@@ -414,8 +492,113 @@ void CoreEngine_Route(CoreEngineContext *ctx, u16 srcId, u16 dstId, bool shouldR
     }
 }
 
+void CoreEngine_SetPriority(CoreEngineContext* ctx, u16 id, ProcessorPriority priority)
+{
+    Assert(ctx, "Context is null");
+    Assert(id < MAX_PROCESSORS, "Invalid processor id %d", id);
+    Assert(ctx->processorMask & (1 << id), "Tried to set priority of non-existing processor %d", id);
+    Assert(priority < NUM_PROCESSOR_PRIORITIES, "Invalid priority %d", priority);
+
+    ctx->processors[id].priority = (u8)priority;
+}
+
+// Must hold the pool mutex
+static PoolAllocator* FindPool(CoreEngineContext* ctx, const char* name)
+{
+    u8 numPools = atomic_load_explicit(&ctx->numPools, memory_order_relaxed);
+    for (u8 i = 0; i < numPools; i++) {
+        if (strcmp(ctx->pools[i].name, name) == 0) {
+            return &ctx->pools[i];
+        }
+    }
+    return NULL;
+}
+
+// Must hold the pool mutex
+static PoolAllocator* AddPool(CoreEngineContext* ctx, const char* name, u32 blockSize, u32 capacity)
+{
+    u8 numPools = atomic_load_explicit(&ctx->numPools, memory_order_relaxed);
+    Assert(numPools < MAX_POOLS, "Reached maximum number of pools (%d)", MAX_POOLS);
+
+    // Released once initialised, so anyone who acquires the new count sees a whole pool
+    PoolAllocator* pool = &ctx->pools[numPools];
+    PoolAllocator_Init(pool, &ctx->heapArena, name, blockSize, capacity);
+    atomic_store_explicit(&ctx->numPools, numPools + 1, memory_order_release);
+
+    LogInfo("Created pool %s { blockSize: %d, capacity: %d }", name, pool->blockSize, capacity);
+    return pool;
+}
+
+PoolAllocator* CoreEngine_CreatePool(CoreEngineContext* ctx, const char* name, u32 blockSize, u32 capacity)
+{
+    Assert(ctx, "Context is null");
+    Assert(name, "Pool name is null");
+
+    Assert(pthread_mutex_lock(&ctx->poolMutex) == 0, "Failed to lock pool mutex");
+    Assert(FindPool(ctx, name) == NULL, "Pool %s already exists", name);
+    PoolAllocator* pool = AddPool(ctx, name, blockSize, capacity);
+    Assert(pthread_mutex_unlock(&ctx->poolMutex) == 0, "Failed to unlock pool mutex");
+
+    return pool;
+}
+
+PoolAllocator* CoreEngine_GetPool(CoreEngineContext* ctx, const char* name, u32 blockSize)
+{
+    Assert(ctx, "Context is null");
+    Assert(name, "Pool name is null");
+
+    // Looked up and created under the one lock, so two threads asking for a new type share a pool
+    Assert(pthread_mutex_lock(&ctx->poolMutex) == 0, "Failed to lock pool mutex");
+    PoolAllocator* pool = FindPool(ctx, name);
+
+    // Types that weren't registered up front get a default sized pool on first use
+    if (pool == NULL) {
+        pool = AddPool(ctx, name, blockSize, DEFAULT_POOL_CAPACITY);
+    }
+    Assert(pthread_mutex_unlock(&ctx->poolMutex) == 0, "Failed to unlock pool mutex");
+
+    Assert(pool->blockSize >= blockSize, "Pool %s blocks are too small (%d < %d)", name, pool->blockSize, blockSize);
+    return pool;
+}
+
+void* CoreEngine_PoolAlloc(CoreEngineContext* ctx, const char* name, u32 size)
+{
+    return PoolAllocator_Calloc(CoreEngine_GetPool(ctx, name, size));
+}
+
+void CoreEngine_PoolFree(CoreEngineContext* ctx, void* ptr)
+{
+    Assert(ctx, "Context is null");
+    Assert(ptr, "Tried to free null pointer");
+
+    // Pools are never removed, so the published count is a safe bound without the lock
+    u8 numPools = atomic_load_explicit(&ctx->numPools, memory_order_acquire);
+    for (u8 i = 0; i < numPools; i++) {
+        if (PoolAllocator_Owns(&ctx->pools[i], ptr)) {
+            PoolAllocator_Free(&ctx->pools[i], ptr);
+            return;
+        }
+    }
+
+    Assert(false, "Pointer %p was not allocated from any engine pool", ptr);
+}
+
+void CoreEngine_LogMemoryStats(CoreEngineContext* ctx)
+{
+    Assert(ctx, "Context is null");
+
+    LogInfo("Heap arena: %llu/%llu bytes reserved", 
+            ctx->heapArena.size - HeapArena_Remaining(&ctx->heapArena), 
+            ctx->heapArena.size);
+
+    u8 numPools = atomic_load_explicit(&ctx->numPools, memory_order_acquire);
+    for (u8 i = 0; i < numPools; i++) {
+        PoolAllocator_LogStats(&ctx->pools[i]);
+    }
+}
+
 void CoreEngine_Panic(CoreEngineContext* ctx)
-{   
+{
     static u8 numPanics = 0;
     LogError("CoreEngine Panic %d", numPanics);
 
@@ -0,0 +1,258 @@
+#include <delay_effects.h>
+#include <logger.h>
+
+#include <math.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+#ifndef MAX
+#define MAX(A, B) ((A) > (B) ? (A) : (B))
+#endif
+
+static f32 Clamp(f32 value, f32 low, f32 high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+// Dry and wet mixed back into the buffer
+static void Mix(f32* io, const f32* wetSignal, u32 numSamples, f32 dry, f32 wet)
+{
+    for (u32 i = 0; i < numSamples; i++) {
+        io[i] = io[i] * dry + wetSignal[i] * wet;
+    }
+}
+
+// ============================================================================
+// Delay
+// ============================================================================
+
+static void ProcessDelay(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    DelayEffect* delay = (DelayEffect*)data;
+    Assert(delay, "DelayEffect is null");
+
+    f32 targets[2] = {
+        Clamp((f32)(atomic_load_explicit(&delay->timeLeft, memory_order_relaxed) * sampleRate), DELAY_LINE_MIN_DELAY_FRAMES, delay->maxFrames),
+        Clamp((f32)(atomic_load_explicit(&delay->timeRight, memory_order_relaxed) * sampleRate), DELAY_LINE_MIN_DELAY_FRAMES, delay->maxFrames),
+    };
+    f32 feedback = atomic_load_explicit(&delay->feedback, memory_order_relaxed);
+    f32 dry = atomic_load_explicit(&delay->dry, memory_order_relaxed);
+    f32 wet = atomic_load_explicit(&delay->wet, memory_order_relaxed);
+    f64 glide = 1.0 - exp(-1.0 / (DELAY_EFFECT_GLIDE_SECONDS * sampleRate));
+
+    // The glide only ever closes in on the targets, so the shortest of either end bounds a run
+    f32 minDelay = MIN(MIN((f32)delay->delayFrames[0], (f32)delay->delayFrames[1]), MIN(targets[0], targets[1]));
+    u32 maxRun = DelayLine_MaxRun(minDelay);
+
+    f32 delays[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 output[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 input[DELAY_LINE_MAX_RUN_FRAMES * 2];
+
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 runFrames = MIN((u32)numFrames - done, maxRun);
+        f32* io = buffer + done * 2;
+
+        for (u32 i = 0; i < runFrames; i++) {
+            for (u32 c = 0; c < 2; c++) {
+                delay->delayFrames[c] += (targets[c] - delay->delayFrames[c]) * glide;
+                delays[i * 2 + c] = (f32)delay->delayFrames[c];
+            }
+        }
+
+        DelayLine_Read(&delay->line, DELAY_INTERP_ALLPASS, delays, runFrames, &delay->tap, output);
+        for (u32 i = 0; i < runFrames * 2; i++) {
+            input[i] = io[i] + output[i] * feedback;
+        }
+        DelayLine_Write(&delay->line, input, runFrames);
+        Mix(io, output, runFrames * 2, dry, wet);
+
+        done += runFrames;
+    }
+}
+
+u16 DelayEffect_Create(DelayEffect* delay, CoreEngineContext* ctx, f64 maxSeconds, f64 timeLeft, f64 timeRight, f32 feedback)
+{
+    Assert(delay, "DelayEffect is null");
+    Assert(ctx, "Engine is null");
+
+    delay->maxFrames = MAX((f32)(maxSeconds * SAMPLE_RATE_DEFAULT), DELAY_LINE_MIN_DELAY_FRAMES);
+    DelayLine_Init(&delay->line, &ctx->heapArena, (u32)ceilf(delay->maxFrames));
+    delay->tap = (DelayTapState){ 0 };
+
+    DelayEffect_Set(delay, timeLeft, timeRight, feedback);
+    DelayEffect_SetMix(delay, 1.0f, 0.5f);
+
+    // Starts at the set times rather than gliding up to them
+    delay->delayFrames[0] = Clamp((f32)(atomic_load(&delay->timeLeft) * SAMPLE_RATE_DEFAULT), DELAY_LINE_MIN_DELAY_FRAMES, delay->maxFrames);
+    delay->delayFrames[1] = Clamp((f32)(atomic_load(&delay->timeRight) * SAMPLE_RATE_DEFAULT), DELAY_LINE_MIN_DELAY_FRAMES, delay->maxFrames);
+
+    LogInfo("Creating DelayEffect { max: %.2fs, line: %u frames }", maxSeconds, delay->line.capacity);
+
+    return CoreEngine_CreateProcessor(ctx, ProcessDelay, NULL, NULL, (void*)delay);
+}
+
+void DelayEffect_Set(DelayEffect* delay, f64 timeLeft, f64 timeRight, f32 feedback)
+{
+    atomic_store(&delay->timeLeft, (f32)timeLeft);
+    atomic_store(&delay->timeRight, (f32)timeRight);
+    atomic_store(&delay->feedback, Clamp(feedback, 0.0f, DELAY_EFFECT_MAX_FEEDBACK));
+}
+
+void DelayEffect_SetMix(DelayEffect* delay, f32 dry, f32 wet)
+{
+    atomic_store(&delay->dry, dry);
+    atomic_store(&delay->wet, wet);
+}
+
+// ============================================================================
+// Chorus
+// ============================================================================
+
+static void ProcessChorus(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    Chorus* chorus = (Chorus*)data;
+    Assert(chorus, "Chorus is null");
+
+    f64 rateHz = atomic_load_explicit(&chorus->rateHz, memory_order_relaxed);
+    f32 centre = (f32)(CHORUS_CENTRE_SECONDS * sampleRate);
+    f32 depth = (f32)(atomic_load_explicit(&chorus->depthSeconds, memory_order_relaxed) * sampleRate);
+    f32 dry = atomic_load_explicit(&chorus->dry, memory_order_relaxed);
+    f32 wet = atomic_load_explicit(&chorus->wet, memory_order_relaxed) / chorus->numVoices;
+    // Past the rate the line has room for, the whole sweep shrinks to fit
+    f32 fit = MIN(chorus->maxFrames / (centre + depth), 1.0f);
+    centre *= fit;
+    depth *= fit;
+    u32 maxRun = DelayLine_MaxRun(centre - depth);
+
+    f32 delays[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 voice[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 sum[DELAY_LINE_MAX_RUN_FRAMES * 2];
+
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 runFrames = MIN((u32)numFrames - done, maxRun);
+        f32* io = buffer + done * 2;
+
+        memset(sum, 0, runFrames * 2 * sizeof(f32));
+        for (u32 v = 0; v < chorus->numVoices; v++) {
+            DelayLfo_Fill(&chorus->lfos[v], rateHz, sampleRate, centre, depth, 0.25, runFrames, delays);
+            DelayLine_Read(&chorus->line, DELAY_INTERP_CUBIC, delays, runFrames, NULL, voice);
+            for (u32 i = 0; i < runFrames * 2; i++) {
+                sum[i] += voice[i];
+            }
+        }
+        DelayLine_Write(&chorus->line, io, runFrames);
+        Mix(io, sum, runFrames * 2, dry, wet);
+
+        done += runFrames;
+    }
+}
+
+u16 Chorus_Create(Chorus* chorus, CoreEngineContext* ctx, u32 numVoices, f32 rateHz, f32 depthSeconds)
+{
+    Assert(chorus, "Chorus is null");
+    Assert(ctx, "Engine is null");
+    Assert(numVoices > 0 && numVoices <= CHORUS_MAX_VOICES, "Chorus can't have %u voices", numVoices);
+
+    chorus->numVoices = numVoices;
+    chorus->maxFrames = (f32)((CHORUS_CENTRE_SECONDS + CHORUS_MAX_DEPTH_SECONDS) * SAMPLE_RATE_DEFAULT * DELAY_EFFECT_MAX_RATE_FACTOR);
+    DelayLine_Init(&chorus->line, &ctx->heapArena, (u32)ceilf(chorus->maxFrames) + 1);
+    for (u32 v = 0; v < numVoices; v++) {
+        chorus->lfos[v].phase = (f64)v / numVoices;
+    }
+
+    Chorus_Set(chorus, rateHz, depthSeconds);
+    Chorus_SetMix(chorus, 1.0f, 0.5f);
+
+    LogInfo("Creating Chorus { voices: %u, line: %u frames }", numVoices, chorus->line.capacity);
+
+    return CoreEngine_CreateProcessor(ctx, ProcessChorus, NULL, NULL, (void*)chorus);
+}
+
+void Chorus_Set(Chorus* chorus, f32 rateHz, f32 depthSeconds)
+{
+    atomic_store(&chorus->rateHz, rateHz);
+    atomic_store(&chorus->depthSeconds, Clamp(depthSeconds, 0.0f, (f32)CHORUS_MAX_DEPTH_SECONDS));
+}
+
+void Chorus_SetMix(Chorus* chorus, f32 dry, f32 wet)
+{
+    atomic_store(&chorus->dry, dry);
+    atomic_store(&chorus->wet, wet);
+}
+
+// ============================================================================
+// Flanger
+// ============================================================================
+
+static void ProcessFlanger(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    Flanger* flanger = (Flanger*)data;
+    Assert(flanger, "Flanger is null");
+
+    f64 rateHz = atomic_load_explicit(&flanger->rateHz, memory_order_relaxed);
+    f32 minDelay = (f32)(FLANGER_MIN_DELAY_SECONDS * sampleRate);
+    f32 swing = (f32)(atomic_load_explicit(&flanger->depthSeconds, memory_order_relaxed) * sampleRate) / 2.0f;
+    f32 feedback = atomic_load_explicit(&flanger->feedback, memory_order_relaxed);
+    f32 dry = atomic_load_explicit(&flanger->dry, memory_order_relaxed);
+    f32 wet = atomic_load_explicit(&flanger->wet, memory_order_relaxed);
+    // Past the rate the line has room for, the whole sweep shrinks to fit
+    f32 fit = MIN(flanger->maxFrames / (minDelay + swing * 2.0f), 1.0f);
+    minDelay *= fit;
+    swing *= fit;
+    u32 maxRun = DelayLine_MaxRun(minDelay);
+
+    f32 delays[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 output[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 input[DELAY_LINE_MAX_RUN_FRAMES * 2];
+
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 runFrames = MIN((u32)numFrames - done, maxRun);
+        f32* io = buffer + done * 2;
+
+        DelayLfo_Fill(&flanger->lfo, rateHz, sampleRate, minDelay + swing, swing, 0.0, runFrames, delays);
+        DelayLine_Read(&flanger->line, DELAY_INTERP_LINEAR, delays, runFrames, NULL, output);
+        for (u32 i = 0; i < runFrames * 2; i++) {
+            input[i] = io[i] + output[i] * feedback;
+        }
+        DelayLine_Write(&flanger->line, input, runFrames);
+        Mix(io, output, runFrames * 2, dry, wet);
+
+        done += runFrames;
+    }
+}
+
+u16 Flanger_Create(Flanger* flanger, CoreEngineContext* ctx, f32 rateHz, f32 depthSeconds, f32 feedback)
+{
+    Assert(flanger, "Flanger is null");
+    Assert(ctx, "Engine is null");
+
+    flanger->maxFrames = (f32)((FLANGER_MIN_DELAY_SECONDS + FLANGER_MAX_DEPTH_SECONDS) * SAMPLE_RATE_DEFAULT * DELAY_EFFECT_MAX_RATE_FACTOR);
+    DelayLine_Init(&flanger->line, &ctx->heapArena, (u32)ceilf(flanger->maxFrames) + 1);
+    flanger->lfo.phase = 0.0;
+
+    Flanger_Set(flanger, rateHz, depthSeconds, feedback);
+    Flanger_SetMix(flanger, 1.0f, 0.5f);
+
+    LogInfo("Creating Flanger { line: %u frames }", flanger->line.capacity);
+
+    return CoreEngine_CreateProcessor(ctx, ProcessFlanger, NULL, NULL, (void*)flanger);
+}
+
+void Flanger_Set(Flanger* flanger, f32 rateHz, f32 depthSeconds, f32 feedback)
+{
+    atomic_store(&flanger->rateHz, rateHz);
+    atomic_store(&flanger->depthSeconds, Clamp(depthSeconds, 0.0f, (f32)FLANGER_MAX_DEPTH_SECONDS));
+    atomic_store(&flanger->feedback, Clamp(feedback, -FLANGER_MAX_FEEDBACK, FLANGER_MAX_FEEDBACK));
+}
+
+void Flanger_SetMix(Flanger* flanger, f32 dry, f32 wet)
+{
+    atomic_store(&flanger->dry, dry);
+    atomic_store(&flanger->wet, wet);
+}
@@ -0,0 +1,200 @@
+#include <delay_line.h>
+#include <logger.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void DelayLine_Init(DelayLine* line, HeapArena* arena, u32 maxDelayFrames)
+{
+    Assert(line, "DelayLine is null");
+    Assert(arena, "Arena is null");
+
+    // Room past the longest delay for the frames a cubic read reaches behind it
+    u32 capacity = 1;
+    while (capacity < maxDelayFrames + 4) {
+        capacity <<= 1;
+    }
+
+    line->capacity = capacity;
+    line->mask = capacity - 1;
+    line->left = HeapArena_Alloc(arena, (u64)capacity * 2 * sizeof(f32));
+    line->right = line->left + capacity;
+    DelayLine_Clear(line);
+}
+
+void DelayLine_Clear(DelayLine* line)
+{
+    memset(line->left, 0, (u64)line->capacity * 2 * sizeof(f32));
+    line->writePos = 0;
+}
+
+u32 DelayLine_MaxRun(f32 minDelayFrames)
+{
+    Assert(minDelayFrames >= DELAY_LINE_MIN_DELAY_FRAMES, "Delay of %.2f frames is too short", minDelayFrames);
+
+    // Frame i reads up to two past i - ceil(delay), which has to be before the run
+    u32 maxRun = (u32)minDelayFrames - 2;
+    return (maxRun < DELAY_LINE_MAX_RUN_FRAMES) ? maxRun : DELAY_LINE_MAX_RUN_FRAMES;
+}
+
+static void InterpolateLinear(const f32* x0, const f32* x1, const f32* fracs, u32 numSamples, f32* output)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= numSamples; i += 4) {
+        float32x4_t a = vld1q_f32(x0 + i);
+        vst1q_f32(output + i, vmlaq_f32(a, vsubq_f32(vld1q_f32(x1 + i), a), vld1q_f32(fracs + i)));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 a = _mm_loadu_ps(x0 + i);
+        __m128 b = _mm_loadu_ps(x1 + i);
+        _mm_storeu_ps(output + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_loadu_ps(fracs + i))));
+    }
+#endif
+    for (; i < numSamples; i++) {
+        output[i] = x0[i] + (x1[i] - x0[i]) * fracs[i];
+    }
+}
+
+static void InterpolateCubic(const f32* xm1, const f32* x0, const f32* x1, const f32* x2, const f32* fracs, u32 numSamples, f32* output)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    float32x4_t half = vdupq_n_f32(0.5f);
+    float32x4_t oneAndHalf = vdupq_n_f32(1.5f);
+    float32x4_t two = vdupq_n_f32(2.0f);
+    float32x4_t twoAndHalf = vdupq_n_f32(2.5f);
+    for (; i + 4 <= numSamples; i += 4) {
+        float32x4_t a = vld1q_f32(xm1 + i);
+        float32x4_t b = vld1q_f32(x0 + i);
+        float32x4_t c = vld1q_f32(x1 + i);
+        float32x4_t d = vld1q_f32(x2 + i);
+        float32x4_t t = vld1q_f32(fracs + i);
+        float32x4_t c1 = vmulq_f32(half, vsubq_f32(c, a));
+        float32x4_t c2 = vsubq_f32(vmlaq_f32(vmlsq_f32(a, twoAndHalf, b), two, c), vmulq_f32(half, d));
+        float32x4_t c3 = vmlaq_f32(vmulq_f32(half, vsubq_f32(d, a)), oneAndHalf, vsubq_f32(b, c));
+        float32x4_t y = vmlaq_f32(c2, c3, t);
+        y = vmlaq_f32(c1, y, t);
+        vst1q_f32(output + i, vmlaq_f32(b, y, t));
+    }
+#elif defined(__SSE2__)
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 oneAndHalf = _mm_set1_ps(1.5f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 twoAndHalf = _mm_set1_ps(2.5f);
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 a = _mm_loadu_ps(xm1 + i);
+        __m128 b = _mm_loadu_ps(x0 + i);
+        __m128 c = _mm_loadu_ps(x1 + i);
+        __m128 d = _mm_loadu_ps(x2 + i);
+        __m128 t = _mm_loadu_ps(fracs + i);
+        __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(c, a));
+        __m128 c2 = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(a, _mm_mul_ps(twoAndHalf, b)), _mm_mul_ps(two, c)), _mm_mul_ps(half, d));
+        __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(d, a)), _mm_mul_ps(oneAndHalf, _mm_sub_ps(b, c)));
+        __m128 y = _mm_add_ps(_mm_mul_ps(c3, t), c2);
+        y = _mm_add_ps(_mm_mul_ps(y, t), c1);
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(y, t), b));
+    }
+#endif
+    for (; i < numSamples; i++) {
+        f32 c1 = 0.5f * (x1[i] - xm1[i]);
+        f32 c2 = xm1[i] - 2.5f * x0[i] + 2.0f * x1[i] - 0.5f * x2[i];
+        f32 c3 = 0.5f * (x2[i] - xm1[i]) + 1.5f * (x0[i] - x1[i]);
+        output[i] = ((c3 * fracs[i] + c2) * fracs[i] + c1) * fracs[i] + x0[i];
+    }
+}
+
+void DelayLine_Read(const DelayLine* line, DelayInterp interp, const f32* delays, u32 numFrames, DelayTapState* state, f32* output)
+{
+    Assert(line, "DelayLine is null");
+    Assert(numFrames <= DELAY_LINE_MAX_RUN_FRAMES, "Delay read of %u frames is too long", numFrames);
+
+    u32 numSamples = numFrames * 2;
+    u32 mask = line->mask;
+
+    if (interp == DELAY_INTERP_ALLPASS) {
+        Assert(state, "Allpass delay reads need tap state");
+
+        // Integer part chosen so the fraction sits in [0.5, 1.5), away from the pole at -1
+        for (u32 s = 0; s < numSamples; s++) {
+            u32 c = s & 1;
+            const f32* samples = c ? line->right : line->left;
+            f32 whole = floorf(delays[s] - 0.5f);
+            f32 fraction = delays[s] - whole;
+            f32 coeff = (1.0f - fraction) / (1.0f + fraction);
+            u32 idx = (line->writePos + (s >> 1) - (u32)whole) & mask;
+            f32 y = coeff * samples[idx] + samples[(idx - 1) & mask] - coeff * state->lastOut[c];
+            state->lastOut[c] = y;
+            output[s] = y;
+        }
+        return;
+    }
+
+    // Gather, neighbours of each read point side by side so the interpolation runs vectorised
+    f32 fracs[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 x0[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 x1[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 xm1[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    f32 x2[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    bool cubic = (interp == DELAY_INTERP_CUBIC);
+
+    for (u32 s = 0; s < numSamples; s++) {
+        const f32* samples = (s & 1) ? line->right : line->left;
+        f32 whole = ceilf(delays[s]);
+        u32 idx = (line->writePos + (s >> 1) - (u32)whole) & mask;
+        fracs[s] = whole - delays[s];
+        x0[s] = samples[idx];
+        x1[s] = samples[(idx + 1) & mask];
+        if (cubic) {
+            xm1[s] = samples[(idx - 1) & mask];
+            x2[s] = samples[(idx + 2) & mask];
+        }
+    }
+
+    if (cubic) {
+        InterpolateCubic(xm1, x0, x1, x2, fracs, numSamples, output);
+    } else {
+        InterpolateLinear(x0, x1, fracs, numSamples, output);
+    }
+}
+
+void DelayLine_Write(DelayLine* line, const f32* input, u32 numFrames)
+{
+    Assert(line, "DelayLine is null");
+
+    // Two runs at most, either side of the wrap
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 pos = line->writePos;
+        u32 runFrames = line->capacity - pos;
+        if (runFrames > numFrames - done) {
+            runFrames = numFrames - done;
+        }
+        for (u32 i = 0; i < runFrames; i++) {
+            line->left[pos + i] = input[(done + i) * 2];
+            line->right[pos + i] = input[(done + i) * 2 + 1];
+        }
+        line->writePos = (pos + runFrames) & line->mask;
+        done += runFrames;
+    }
+}
+
+void DelayLfo_Fill(DelayLfo* lfo, f64 rateHz, f64 sampleRate, f32 centreFrames, f32 depthFrames, f64 phaseOffset, u32 numFrames, f32* delays)
+{
+    f64 increment = rateHz / sampleRate;
+    for (u32 i = 0; i < numFrames; i++) {
+        delays[i * 2] = centreFrames + depthFrames * (f32)sin(2.0 * M_PI * lfo->phase);
+        delays[i * 2 + 1] = centreFrames + depthFrames * (f32)sin(2.0 * M_PI * (lfo->phase + phaseOffset));
+        lfo->phase += increment;
+        if (lfo->phase >= 1.0) {
+            lfo->phase -= 1.0;
+        }
+    }
+}
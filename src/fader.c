@@ -32,6 +32,11 @@ u16 Fader_Create(Fader* fader, f32 defaultPan, f32 defaultVol, CoreEngineContext
     Assert(fader, "Fader is null");
     fader->pan = defaultPan;
     fader->vol = defaultVol;
-    return CoreEngine_CreateProcessor(ctx, ProcessCallback, NULL, NULL, (void*)fader) ;
+    u16 id = CoreEngine_CreateProcessor(ctx, ProcessCallback, NULL, NULL, (void*)fader);
+
+    // Shed processors pass audio straight through, which for a fader means unity gain. One
+    // pulled down to silence must stay silent when the machine is overloaded.
+    CoreEngine_SetPriority(ctx, id, PROCESSOR_PRIORITY_CRITICAL);
+    return id;
 }
 
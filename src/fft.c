@@ -0,0 +1,259 @@
+#include <fft.h>
+#include <logger.h>
+
+#include <math.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// One stage of butterflies between runs of half, four at a time where the vector units allow
+static void Butterflies(f32* aRe, f32* aIm, u32 half, const f32* cosTable, const f32* sinTable)
+{
+    f32* bRe = aRe + half;
+    f32* bIm = aIm + half;
+    u32 k = 0;
+
+#if defined(__ARM_NEON)
+    for (; k + 4 <= half; k += 4) {
+        float32x4_t c = vld1q_f32(cosTable + k);
+        float32x4_t s = vld1q_f32(sinTable + k);
+        float32x4_t xRe = vld1q_f32(bRe + k);
+        float32x4_t xIm = vld1q_f32(bIm + k);
+        float32x4_t tRe = vmlaq_f32(vmulq_f32(xRe, c), xIm, s);
+        float32x4_t tIm = vmlsq_f32(vmulq_f32(xIm, c), xRe, s);
+        float32x4_t yRe = vld1q_f32(aRe + k);
+        float32x4_t yIm = vld1q_f32(aIm + k);
+        vst1q_f32(bRe + k, vsubq_f32(yRe, tRe));
+        vst1q_f32(bIm + k, vsubq_f32(yIm, tIm));
+        vst1q_f32(aRe + k, vaddq_f32(yRe, tRe));
+        vst1q_f32(aIm + k, vaddq_f32(yIm, tIm));
+    }
+#elif defined(__SSE2__)
+    for (; k + 4 <= half; k += 4) {
+        __m128 c = _mm_loadu_ps(cosTable + k);
+        __m128 s = _mm_loadu_ps(sinTable + k);
+        __m128 xRe = _mm_loadu_ps(bRe + k);
+        __m128 xIm = _mm_loadu_ps(bIm + k);
+        __m128 tRe = _mm_add_ps(_mm_mul_ps(xRe, c), _mm_mul_ps(xIm, s));
+        __m128 tIm = _mm_sub_ps(_mm_mul_ps(xIm, c), _mm_mul_ps(xRe, s));
+        __m128 yRe = _mm_loadu_ps(aRe + k);
+        __m128 yIm = _mm_loadu_ps(aIm + k);
+        _mm_storeu_ps(bRe + k, _mm_sub_ps(yRe, tRe));
+        _mm_storeu_ps(bIm + k, _mm_sub_ps(yIm, tIm));
+        _mm_storeu_ps(aRe + k, _mm_add_ps(yRe, tRe));
+        _mm_storeu_ps(aIm + k, _mm_add_ps(yIm, tIm));
+    }
+#endif
+
+    for (; k < half; k++) {
+        f32 tRe = bRe[k] * cosTable[k] + bIm[k] * sinTable[k];
+        f32 tIm = bIm[k] * cosTable[k] - bRe[k] * sinTable[k];
+        bRe[k] = aRe[k] - tRe;
+        bIm[k] = aIm[k] - tIm;
+        aRe[k] += tRe;
+        aIm[k] += tIm;
+    }
+}
+
+// Decimation in time, in place. The twiddles of each stage sit in a row so the butterfly
+// loop runs over contiguous memory and vectorises.
+static void Transform(const Fft* fft, f32* re, f32* im)
+{
+    u32 size = fft->size;
+    for (u32 i = 0; i < size; i++) {
+        u32 j = fft->bitReverse[i];
+        if (j > i) {
+            f32 tmpRe = re[i];
+            f32 tmpIm = im[i];
+            re[i] = re[j];
+            im[i] = im[j];
+            re[j] = tmpRe;
+            im[j] = tmpIm;
+        }
+    }
+
+    // The first two stages only twiddle by 1 and -i, done together as radix 4
+    u32 half = 1;
+    if (size >= 4) {
+        for (u32 start = 0; start < size; start += 4) {
+            f32* xRe = re + start;
+            f32* xIm = im + start;
+            f32 aRe0 = xRe[0] + xRe[1], aIm0 = xIm[0] + xIm[1];
+            f32 aRe1 = xRe[0] - xRe[1], aIm1 = xIm[0] - xIm[1];
+            f32 aRe2 = xRe[2] + xRe[3], aIm2 = xIm[2] + xIm[3];
+            f32 aRe3 = xRe[2] - xRe[3], aIm3 = xIm[2] - xIm[3];
+            xRe[0] = aRe0 + aRe2;
+            xIm[0] = aIm0 + aIm2;
+            xRe[2] = aRe0 - aRe2;
+            xIm[2] = aIm0 - aIm2;
+            xRe[1] = aRe1 + aIm3;
+            xIm[1] = aIm1 - aRe3;
+            xRe[3] = aRe1 - aIm3;
+            xIm[3] = aIm1 + aRe3;
+        }
+        half = 4;
+    }
+
+    for (; half < size; half <<= 1) {
+        const f32* cosTable = fft->cosTable + half - 1;
+        const f32* sinTable = fft->sinTable + half - 1;
+        for (u32 start = 0; start < size; start += half * 2) {
+            Butterflies(re + start, im + start, half, cosTable, sinTable);
+        }
+    }
+}
+
+void Fft_Init(Fft* fft, HeapArena* arena, u32 size)
+{
+    Assert(fft, "Fft is null");
+    Assert(arena, "Arena is null");
+    Assert(size >= 2 && (size & (size - 1)) == 0, "FFT size %u is not a power of two", size);
+
+    fft->size = size;
+    fft->bitReverse = HeapArena_Alloc(arena, size * sizeof(u32));
+    fft->cosTable = HeapArena_Alloc(arena, size * 2 * sizeof(f32));
+    fft->sinTable = HeapArena_Alloc(arena, size * 2 * sizeof(f32));
+
+    u32 numBits = (u32)__builtin_ctz(size);
+    for (u32 i = 0; i < size; i++) {
+        u32 reversed = 0;
+        for (u32 bit = 0; bit < numBits; bit++) {
+            reversed |= ((i >> bit) & 1) << (numBits - 1 - bit);
+        }
+        fft->bitReverse[i] = reversed;
+    }
+
+    // Up to half of size itself, which no stage uses but the real transforms' twiddles are
+    for (u32 half = 1; half <= size; half <<= 1) {
+        for (u32 k = 0; k < half; k++) {
+            f64 angle = M_PI * k / half;
+            fft->cosTable[half - 1 + k] = (f32)cos(angle);
+            fft->sinTable[half - 1 + k] = (f32)sin(angle);
+        }
+    }
+}
+
+void Fft_Forward(const Fft* fft, f32* re, f32* im)
+{
+    Transform(fft, re, im);
+}
+
+// Swapping the parts either side of a forward transform conjugates it into the inverse
+void Fft_Inverse(const Fft* fft, f32* re, f32* im)
+{
+    Transform(fft, im, re);
+}
+
+void Fft_SplitReal(const Fft* fft, const f32* re, const f32* im, f32* aRe, f32* aIm, f32* bRe, f32* bIm)
+{
+    u32 size = fft->size;
+    u32 half = size / 2;
+
+    // A real signal's spectrum mirrors as its conjugate, the packed one's parts are what
+    // agrees and disagrees with that
+    for (u32 k = 1; k < half; k++) {
+        f32 re0 = re[k];
+        f32 im0 = im[k];
+        f32 re1 = re[size - k];
+        f32 im1 = im[size - k];
+        aRe[k] = re0 + re1;
+        aIm[k] = im0 - im1;
+        bRe[k] = im0 + im1;
+        bIm[k] = re1 - re0;
+    }
+
+    aRe[0] = 2.0f * re[0];
+    bRe[0] = 2.0f * im[0];
+    aRe[half] = 2.0f * re[half];
+    bRe[half] = 2.0f * im[half];
+    aIm[0] = bIm[0] = aIm[half] = bIm[half] = 0.0f;
+}
+
+void Fft_JoinReal(const Fft* fft, const f32* aRe, const f32* aIm, const f32* bRe, const f32* bIm, f32* re, f32* im)
+{
+    u32 size = fft->size;
+    u32 half = size / 2;
+
+    for (u32 k = 0; k <= half; k++) {
+        re[k] = aRe[k] - bIm[k];
+        im[k] = aIm[k] + bRe[k];
+    }
+    for (u32 k = half + 1; k < size; k++) {
+        u32 mirror = size - k;
+        re[k] = aRe[mirror] + bIm[mirror];
+        im[k] = bRe[mirror] - aIm[mirror];
+    }
+}
+
+void Fft_ForwardReal(const Fft* fft, const f32* input, f32* re, f32* im)
+{
+    u32 size = fft->size;
+    const f32* cosTable = fft->cosTable + size - 1;
+    const f32* sinTable = fft->sinTable + size - 1;
+
+    // Even samples as the real part and odd as the imaginary, a transform of half the length
+    for (u32 i = 0; i < size; i++) {
+        re[i] = input[i * 2];
+        im[i] = input[i * 2 + 1];
+    }
+    Transform(fft, re, im);
+
+    // Then the evens' and odds' spectra taken apart and combined with one more twiddle, a
+    // pair of bins at a time from either end so it stays in place
+    f32 dc = re[0];
+    re[0] = dc + im[0];
+    re[size] = dc - im[0];
+    im[0] = im[size] = 0.0f;
+    for (u32 k = 1; k <= size / 2; k++) {
+        u32 m = size - k;
+        f32 evenRe = 0.5f * (re[k] + re[m]);
+        f32 evenIm = 0.5f * (im[k] - im[m]);
+        f32 oddRe = 0.5f * (im[k] + im[m]);
+        f32 oddIm = 0.5f * (re[m] - re[k]);
+        f32 tRe = oddRe * cosTable[k] + oddIm * sinTable[k];
+        f32 tIm = oddIm * cosTable[k] - oddRe * sinTable[k];
+
+        // Bin m from the same pair, its twiddle mirrored about a quarter turn
+        f32 mRe = evenRe - tRe;
+        f32 mIm = tIm - evenIm;
+        re[k] = evenRe + tRe;
+        im[k] = evenIm + tIm;
+        re[m] = mRe;
+        im[m] = mIm;
+    }
+}
+
+void Fft_InverseReal(const Fft* fft, f32* re, f32* im, f32* output)
+{
+    u32 size = fft->size;
+    const f32* cosTable = fft->cosTable + size - 1;
+    const f32* sinTable = fft->sinTable + size - 1;
+
+    f32 first = re[0];
+    re[0] = 0.5f * (first + re[size]);
+    im[0] = 0.5f * (first - re[size]);
+    for (u32 k = 1; k <= size / 2; k++) {
+        u32 m = size - k;
+        f32 evenRe = 0.5f * (re[k] + re[m]);
+        f32 evenIm = 0.5f * (im[k] - im[m]);
+        f32 diffRe = 0.5f * (re[k] - re[m]);
+        f32 diffIm = 0.5f * (im[k] + im[m]);
+        f32 oddRe = diffRe * cosTable[k] - diffIm * sinTable[k];
+        f32 oddIm = diffIm * cosTable[k] + diffRe * sinTable[k];
+
+        // Evens plus i times odds at k, and the same at m from the conjugate symmetry
+        re[k] = evenRe - oddIm;
+        im[k] = evenIm + oddRe;
+        re[m] = evenRe + oddIm;
+        im[m] = oddRe - evenIm;
+    }
+    Fft_Inverse(fft, re, im);
+
+    for (u32 i = 0; i < size; i++) {
+        output[i * 2] = re[i];
+        output[i * 2 + 1] = im[i];
+    }
+}
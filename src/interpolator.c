@@ -0,0 +1,161 @@
+#include <interpolator.h>
+#include <logger.h>
+#include <utils.h>
+
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SINC_TAPS 8
+#define SINC_PHASES 256
+#define SINC_BETA 6.0
+
+// Weights for frames position - 3 to position + 4, each one twice to line up with the
+// interleaved left and right it multiplies
+#define NUM_WEIGHTS (INTERPOLATOR_SPAN * 2)
+
+static f32 sincTable_[SINC_PHASES + 1][NUM_WEIGHTS];
+static pthread_once_t sincTableOnce_ = PTHREAD_ONCE_INIT;
+
+static void BuildSincTable(void)
+{
+    for (u32 phase = 0; phase <= SINC_PHASES; phase++) {
+        f64 fraction = (f64)phase / SINC_PHASES;
+        f64 taps[SINC_TAPS];
+        f64 sum = 0.0;
+
+        for (u32 tap = 0; tap < SINC_TAPS; tap++) {
+            f64 distance = (f64)tap - INTERPOLATOR_HISTORY - fraction;
+            f64 x = distance / (SINC_TAPS / 2.0);
+            f64 window = (fabs(x) < 1.0) ? BesselI0(SINC_BETA * sqrt(1.0 - x * x)) / BesselI0(SINC_BETA) : 0.0;
+            taps[tap] = (distance == 0.0) ? 1.0 : window * sin(M_PI * distance) / (M_PI * distance);
+            sum += taps[tap];
+        }
+
+        // Whole frame positions read the frame as is, in between keeps unity gain at DC
+        for (u32 tap = 0; tap < SINC_TAPS; tap++) {
+            f32 weight = (phase == 0 || phase == SINC_PHASES) ? (f32)(taps[tap] == 1.0) : (f32)(taps[tap] / sum);
+            sincTable_[phase][tap * 2] = weight;
+            sincTable_[phase][tap * 2 + 1] = weight;
+        }
+    }
+}
+
+void Interpolator_Init(void)
+{
+    pthread_once(&sincTableOnce_, BuildSincTable);
+}
+
+static inline void CubicWeights(f32 t, f32* weights)
+{
+    f32 t2 = t * t;
+    f32 t3 = t2 * t;
+    f32 cubic[4] = {
+        -0.5f * t3 + t2 - 0.5f * t,
+        1.5f * t3 - 2.5f * t2 + 1.0f,
+        -1.5f * t3 + 2.0f * t2 + 0.5f * t,
+        0.5f * t3 - 0.5f * t2,
+    };
+    for (u32 i = 0; i < 4; i++) {
+        weights[(INTERPOLATOR_HISTORY - 1 + i) * 2] = cubic[i];
+        weights[(INTERPOLATOR_HISTORY - 1 + i) * 2 + 1] = cubic[i];
+    }
+}
+
+// Weighted sum over the whole span, zero weights included, one shape of loop for every mode
+static inline void Dot(const f32* src, const f32* weights, f32* dst)
+{
+#if defined(__ARM_NEON)
+    float32x4_t sum = vmulq_f32(vld1q_f32(src), vld1q_f32(weights));
+    for (u32 i = 4; i < NUM_WEIGHTS; i += 4) {
+        sum = vmlaq_f32(sum, vld1q_f32(src + i), vld1q_f32(weights + i));
+    }
+    float32x2_t stereo = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    vst1_f32(dst, vadd_f32(vld1_f32(dst), stereo));
+#elif defined(__SSE2__)
+    __m128 sum = _mm_mul_ps(_mm_loadu_ps(src), _mm_loadu_ps(weights));
+    for (u32 i = 4; i < NUM_WEIGHTS; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(weights + i)));
+    }
+    f32 lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    dst[0] += lanes[0] + lanes[2];
+    dst[1] += lanes[1] + lanes[3];
+#else
+    f32 left = 0.0f;
+    f32 right = 0.0f;
+    for (u32 i = 0; i < NUM_WEIGHTS; i += 2) {
+        left += src[i] * weights[i];
+        right += src[i + 1] * weights[i + 1];
+    }
+    dst[0] += left;
+    dst[1] += right;
+#endif
+}
+
+// Sinc weights between the two nearest phases
+static inline void SincWeights(f32 t, f32* weights)
+{
+    f32 phase = t * SINC_PHASES;
+    u32 row = (u32)phase;
+    f32 blend = phase - (f32)row;
+    const f32* low = sincTable_[row];
+    const f32* high = sincTable_[(row < SINC_PHASES) ? row + 1 : row];
+#if defined(__ARM_NEON)
+    for (u32 i = 0; i < NUM_WEIGHTS; i += 4) {
+        float32x4_t a = vld1q_f32(low + i);
+        vst1q_f32(weights + i, vmlaq_n_f32(a, vsubq_f32(vld1q_f32(high + i), a), blend));
+    }
+#elif defined(__SSE2__)
+    __m128 amount = _mm_set1_ps(blend);
+    for (u32 i = 0; i < NUM_WEIGHTS; i += 4) {
+        __m128 a = _mm_loadu_ps(low + i);
+        _mm_storeu_ps(weights + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(high + i), a), amount)));
+    }
+#else
+    for (u32 i = 0; i < NUM_WEIGHTS; i++) {
+        weights[i] = low[i] + (high[i] - low[i]) * blend;
+    }
+#endif
+}
+
+f64 Interpolator_Process(Interpolation mode, 
+                         const f32* src, 
+                         f64 position, 
+                         f64 rate, 
+                         f64 rateStep, 
+                         u32 numFrames, 
+                         f32* dst)
+{
+    Assert(mode < INTERPOLATION_COUNT, "Unknown interpolation %d", mode);
+    Assert(position >= INTERPOLATOR_HISTORY, "Interpolating at %f without the frames before it", position);
+
+    f32 weights[NUM_WEIGHTS] = { 0 };
+    for (u32 i = 0; i < numFrames; i++) {
+        u64 frame = (u64)position;
+        f32 t = (f32)(position - (f64)frame);
+
+        switch (mode) {
+            case INTERPOLATION_LINEAR:
+                weights[INTERPOLATOR_HISTORY * 2] = weights[INTERPOLATOR_HISTORY * 2 + 1] = 1.0f - t;
+                weights[INTERPOLATOR_HISTORY * 2 + 2] = weights[INTERPOLATOR_HISTORY * 2 + 3] = t;
+                break;
+            case INTERPOLATION_CUBIC:
+                CubicWeights(t, weights);
+                break;
+            default:
+                SincWeights(t, weights);
+                break;
+        }
+
+        Dot(src + (frame - INTERPOLATOR_HISTORY) * 2, weights, dst + i * 2);
+        position += rate;
+        rate += rateStep;
+    }
+    return position;
+}
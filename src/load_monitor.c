@@ -0,0 +1,107 @@
+#include <load_monitor.h>
+#include <logger.h>
+#include <trace.h>
+
+#define MAX_SHED_LEVEL (NUM_PROCESSOR_PRIORITIES - 1)
+
+void LoadMonitor_Init(LoadMonitor* monitor)
+{
+    Assert(monitor, "LoadMonitor is null");
+
+    atomic_store(&monitor->numCycles, 0);
+    atomic_store(&monitor->numXruns, 0);
+    atomic_store(&monitor->numNearMisses, 0);
+    atomic_store(&monitor->numDeviceXruns, 0);
+    atomic_store(&monitor->load, 0.0f);
+    atomic_store(&monitor->peakLoad, 0.0f);
+    atomic_store(&monitor->shedLevel, 0);
+    monitor->calmCycles = 0;
+    monitor->holdCycles = 0;
+    monitor->expectedSampleTime = 0.0;
+    monitor->haveSampleTime = false;
+}
+
+bool LoadMonitor_EndCycle(LoadMonitor* monitor, u64 elapsedNs, u64 budgetNs)
+{
+    Assert(budgetNs > 0, "Cycle budget must be greater than zero");
+
+    f32 ratio = (f32)elapsedNs / (f32)budgetNs;
+    bool missed = elapsedNs > budgetNs;
+
+    atomic_fetch_add_explicit(&monitor->numCycles, 1, memory_order_relaxed);
+    if (missed) {
+        atomic_fetch_add_explicit(&monitor->numXruns, 1, memory_order_relaxed);
+    }
+    else if (ratio > LOAD_NEAR_MISS_RATIO) {
+        atomic_fetch_add_explicit(&monitor->numNearMisses, 1, memory_order_relaxed);
+    }
+
+    f32 load = atomic_load_explicit(&monitor->load, memory_order_relaxed);
+    load += LOAD_SMOOTHING * (ratio - load);
+    atomic_store_explicit(&monitor->load, load, memory_order_relaxed);
+
+    if (ratio > atomic_load_explicit(&monitor->peakLoad, memory_order_relaxed)) {
+        atomic_store_explicit(&monitor->peakLoad, ratio, memory_order_relaxed);
+    }
+
+    u8 shedLevel = atomic_load_explicit(&monitor->shedLevel, memory_order_relaxed);
+
+    if (monitor->holdCycles > 0) {
+        monitor->holdCycles--;
+    }
+
+    if ((missed || load > LOAD_SHED_RATIO) && shedLevel < MAX_SHED_LEVEL && monitor->holdCycles == 0) {
+        shedLevel++;
+        monitor->holdCycles = LOAD_ESCALATE_HOLD_CYCLES;
+        monitor->calmCycles = 0;
+        LogWarn("Audio thread overloaded (load %.2f), shedding priority level %d", load, NUM_PROCESSOR_PRIORITIES - shedLevel);
+    }
+    else if (load < LOAD_RESTORE_RATIO && shedLevel > 0) {
+        if (++monitor->calmCycles >= LOAD_RESTORE_CYCLES) {
+            LogInfo("Audio thread load recovered (load %.2f), restoring priority level %d", load, NUM_PROCESSOR_PRIORITIES - shedLevel);
+            shedLevel--;
+            monitor->calmCycles = 0;
+        }
+    }
+    else {
+        monitor->calmCycles = 0;
+    }
+
+    if (shedLevel != atomic_load_explicit(&monitor->shedLevel, memory_order_relaxed)) {
+        atomic_store(&monitor->shedLevel, shedLevel);
+        TraceCounter("ShedLevel", shedLevel);
+    }
+
+    return missed;
+}
+
+bool LoadMonitor_CheckTimestamp(LoadMonitor* monitor, f64 sampleTime, u32 numFrames)
+{
+    // The device clock jumping past where this cycle should start means it dropped cycles on us
+    bool gap = monitor->haveSampleTime && (sampleTime > monitor->expectedSampleTime + 0.5);
+    if (gap) {
+        atomic_fetch_add_explicit(&monitor->numDeviceXruns, 1, memory_order_relaxed);
+    }
+
+    monitor->expectedSampleTime = sampleTime + numFrames;
+    monitor->haveSampleTime = true;
+    return gap;
+}
+
+bool LoadMonitor_ShouldBypass(LoadMonitor* monitor, u8 priority)
+{
+    u8 shedLevel = atomic_load_explicit(&monitor->shedLevel, memory_order_relaxed);
+    return (priority != PROCESSOR_PRIORITY_CRITICAL) && (priority >= NUM_PROCESSOR_PRIORITIES - shedLevel);
+}
+
+void LoadMonitor_LogStats(LoadMonitor* monitor)
+{
+    LogInfo("Audio load: %.2f (peak %.2f), cycles %llu, xruns %llu, near misses %llu, device xruns %llu, shed level %d",
+            atomic_load(&monitor->load),
+            atomic_load(&monitor->peakLoad),
+            atomic_load(&monitor->numCycles),
+            atomic_load(&monitor->numXruns),
+            atomic_load(&monitor->numNearMisses),
+            atomic_load(&monitor->numDeviceXruns),
+            atomic_load(&monitor->shedLevel));
+}
@@ -1,13 +1,45 @@
 #include <logger.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include <sys/time.h>
+#include <pthread.h>
 #include <time.h>
 
 #include <core_engine.h>
 
+#define LOG_LINE_BYTES 1024
+#define LOG_SPEC_BYTES 32
+
+typedef enum {
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_INTMAX,
+    LOG_ARG_PTRDIFF,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING,
+} LogArgType;
+
+typedef enum {
+    LOG_RING_FREE,
+    LOG_RING_OWNED,
+    LOG_RING_ORPHANED, // Owning thread exited, free once drained
+} LogRingState;
+
+// A single conversion specification parsed out of a format string
+typedef struct {
+    const char* start;
+    const char* end;
+    u8 numStars;
+    char length; // 0, 'H' (hh), 'h', 'l', 'q' (ll), 'j', 'z', 't' or 'L'
+    char conversion;
+} LogSpec;
+
 static const char* levels_[LOG_NUM_LEVELS] = {
     "TEST",
     "TRACE",
@@ -29,6 +61,18 @@ static void DefaultAssertHandler(const char* message, const char* file, i32 line
 static LogLevel currentLevel_ = LOG_TEST;
 static void (*assertHandler_)(const char*, const char*, i32) = NULL;
 
+static LogRing rings_[LOG_MAX_THREADS];
+static atomic_u32 numRingsUsed_ = 0;
+static atomic_u64 unregisteredDropped_ = 0; // No ring left to take the thread
+static u64 unregisteredDroppedReported_ = 0;
+static _Thread_local LogRing* threadRing_ = NULL;
+static pthread_key_t ringKey_;
+static pthread_once_t ringKeyOnce_ = PTHREAD_ONCE_INIT;
+
+static _Atomic(bool) running_ = false;
+static pthread_t loggerThread_;
+static pthread_mutex_t consumerMutex_ = PTHREAD_MUTEX_INITIALIZER;
+
 static void DefaultAssertHandler(const char* message, const char* file, i32 line)
 {
     fprintf(stderr, "%s %s:%d\n", message, file , line);
@@ -36,6 +80,363 @@ static void DefaultAssertHandler(const char* message, const char* file, i32 line
     exit(1);
 }
 
+static u64 NowNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+static const char* ParseSpec(const char* format, LogSpec* spec)
+{
+    // format points at the '%'
+    const char* p = format + 1;
+    spec->start = format;
+    spec->numStars = 0;
+    spec->length = 0;
+
+    while (*p && strchr("-+ #0'", *p)) p++;
+
+    if (*p == '*') { spec->numStars++; p++; }
+    while (*p >= '0' && *p <= '9') p++;
+
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { spec->numStars++; p++; }
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    switch (*p) {
+        case 'h': spec->length = (p[1] == 'h') ? 'H' : 'h'; p += (p[1] == 'h') ? 2 : 1; break;
+        case 'l': spec->length = (p[1] == 'l') ? 'q' : 'l'; p += (p[1] == 'l') ? 2 : 1; break;
+        case 'q': case 'j': case 'z': case 't': case 'L': spec->length = *p; p++; break;
+        default: break;
+    }
+
+    spec->conversion = *p;
+    if (*p) p++;
+    spec->end = p;
+    return p;
+}
+
+static LogArgType IntegerArgType(char length)
+{
+    switch (length) {
+        case 'l': return LOG_ARG_LONG;
+        case 'q': return LOG_ARG_LLONG;
+        case 'j': return LOG_ARG_INTMAX;
+        case 'z': return LOG_ARG_SIZE;
+        case 't': return LOG_ARG_PTRDIFF;
+        default: return LOG_ARG_INT;
+    }
+}
+
+static void PushArg(LogRecord* record, LogArgType type, u64 value)
+{
+    record->argTypes[record->numArgs] = (u8)type;
+    record->args[record->numArgs] = value;
+    record->numArgs++;
+}
+
+// Pull the raw arguments out of the va_list without formatting anything.
+// Strings are copied inline since the caller's buffer may not outlive the call.
+static void CaptureArgs(LogRecord* record, const char* format, va_list args)
+{
+    record->numArgs = 0;
+    record->stringBytes = 0;
+
+    const char* p = format;
+    while (*p) {
+        if (*p != '%') {
+            p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+
+        LogSpec spec;
+        p = ParseSpec(p, &spec);
+
+        if (record->numArgs + spec.numStars + 1 > LOG_MAX_ARGS) {
+            return;
+        }
+
+        for (u8 i = 0; i < spec.numStars; i++) {
+            PushArg(record, LOG_ARG_INT, (u64)(i64)va_arg(args, int));
+        }
+
+        switch (spec.conversion) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': {
+                LogArgType type = IntegerArgType(spec.length);
+                u64 value;
+                switch (type) {
+                    case LOG_ARG_LONG: value = (u64)va_arg(args, long); break;
+                    case LOG_ARG_LLONG: value = (u64)va_arg(args, long long); break;
+                    case LOG_ARG_INTMAX: value = (u64)va_arg(args, intmax_t); break;
+                    case LOG_ARG_SIZE: value = (u64)va_arg(args, size_t); break;
+                    case LOG_ARG_PTRDIFF: value = (u64)va_arg(args, ptrdiff_t); break;
+                    default: value = (u64)(i64)va_arg(args, int); break;
+                }
+                PushArg(record, type, value);
+            } break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                f64 value = (spec.length == 'L') ? (f64)va_arg(args, long double) : va_arg(args, f64);
+                u64 bits;
+                memcpy(&bits, &value, sizeof(bits));
+                PushArg(record, LOG_ARG_DOUBLE, bits);
+            } break;
+
+            case 's': {
+                const char* string = va_arg(args, const char*);
+                if (string == NULL) {
+                    string = "(null)";
+                }
+                u32 available = LOG_STRING_BYTES - record->stringBytes;
+                if (available == 0) {
+                    return;
+                }
+                u32 length = (u32)strnlen(string, available - 1);
+                memcpy(record->strings + record->stringBytes, string, length);
+                record->strings[record->stringBytes + length] = '\0';
+                PushArg(record, LOG_ARG_STRING, record->stringBytes);
+                record->stringBytes += length + 1;
+            } break;
+
+            case 'p':
+                PushArg(record, LOG_ARG_POINTER, (u64)(uintptr_t)va_arg(args, void*));
+            break;
+
+            default:
+                // Unknown or unsupported conversion (e.g. %n), stop capturing here
+                return;
+        }
+    }
+}
+
+#define EMIT_SPEC(value)\
+    if (numStars == 0) written = snprintf(dst, remaining, specBuf, value);\
+    else if (numStars == 1) written = snprintf(dst, remaining, specBuf, stars[0], value);\
+    else written = snprintf(dst, remaining, specBuf, stars[0], stars[1], value)
+
+// Expand a record's format string with its captured arguments, runs on the logger thread
+static u32 FormatRecord(const LogRecord* record, char* out, u32 size)
+{
+    const char* p = record->site->format;
+    u32 offset = 0;
+    u8 argIndex = 0;
+
+    while (*p && offset + 1 < size) {
+        if (*p != '%') {
+            out[offset++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[offset++] = '%';
+            p += 2;
+            continue;
+        }
+
+        LogSpec spec;
+        p = ParseSpec(p, &spec);
+
+        u32 specLength = (u32)(spec.end - spec.start);
+        u8 numStars = spec.numStars;
+        bool haveArgs = (argIndex + numStars + 1) <= record->numArgs;
+
+        if (!haveArgs || specLength >= LOG_SPEC_BYTES) {
+            // Missing argument, emit the specifier as written
+            u32 count = (specLength < size - 1 - offset) ? specLength : size - 1 - offset;
+            memcpy(out + offset, spec.start, count);
+            offset += count;
+            continue;
+        }
+
+        // Long doubles were captured as doubles, drop the 'L' modifier
+        char specBuf[LOG_SPEC_BYTES];
+        u32 specBufLength = 0;
+        for (const char* c = spec.start; c < spec.end; c++) {
+            if (!(spec.length == 'L' && *c == 'L')) {
+                specBuf[specBufLength++] = *c;
+            }
+        }
+        specBuf[specBufLength] = '\0';
+
+        int stars[2] = { 0, 0 };
+        for (u8 i = 0; i < numStars; i++) {
+            stars[i] = (int)(i64)record->args[argIndex++];
+        }
+
+        u64 value = record->args[argIndex];
+        LogArgType type = (LogArgType)record->argTypes[argIndex];
+        argIndex++;
+
+        char* dst = out + offset;
+        u32 remaining = size - offset;
+        int written = 0;
+
+        switch (type) {
+            case LOG_ARG_INT: EMIT_SPEC((int)(i64)value); break;
+            case LOG_ARG_LONG: EMIT_SPEC((long)value); break;
+            case LOG_ARG_LLONG: EMIT_SPEC((long long)value); break;
+            case LOG_ARG_INTMAX: EMIT_SPEC((intmax_t)value); break;
+            case LOG_ARG_SIZE: EMIT_SPEC((size_t)value); break;
+            case LOG_ARG_PTRDIFF: EMIT_SPEC((ptrdiff_t)value); break;
+            case LOG_ARG_POINTER: EMIT_SPEC((void*)(uintptr_t)value); break;
+            case LOG_ARG_STRING: EMIT_SPEC(record->strings + value); break;
+            case LOG_ARG_DOUBLE: {
+                f64 real;
+                memcpy(&real, &value, sizeof(real));
+                EMIT_SPEC(real);
+            } break;
+        }
+
+        if (written > 0) {
+            offset += ((u32)written < remaining) ? (u32)written : (u32)remaining - 1;
+        }
+    }
+
+    out[offset] = '\0';
+    return offset;
+}
+
+static void WriteRecord(const LogRecord* record, FILE* stream)
+{
+    char message[LOG_LINE_BYTES];
+    FormatRecord(record, message, sizeof(message));
+
+    const LogSite* site = record->site;
+    if (site->raw) {
+        fputs(message, stream);
+        return;
+    }
+
+    // Format a timestamp
+    char timeBuf[30];
+    struct tm tmInfo;
+    time_t seconds = (time_t)(record->timestampNs / 1000000000ull);
+    int ms = (int)((record->timestampNs / 1000000ull) % 1000);
+    localtime_r(&seconds, &tmInfo);
+    strftime(timeBuf, 26, "%H:%M:%S", &tmInfo);
+    snprintf(timeBuf + strlen(timeBuf), sizeof(timeBuf) - strlen(timeBuf), ":%03d", ms);
+
+    fprintf(stream, "[%s%s%s] [%s] -- %s%s%s (%s:%d)\n", 
+            colors_[site->level], levels_[site->level], ANSI_COLOR_RESET, 
+            timeBuf, colors_[site->level], message, ANSI_COLOR_RESET, site->file, site->line);
+}
+
+static void ReleaseRing(void* data)
+{
+    LogRing* ring = (LogRing*)data;
+    atomic_store(&ring->state, LOG_RING_ORPHANED);
+}
+
+static void CreateRingKey(void)
+{
+    pthread_key_create(&ringKey_, ReleaseRing);
+}
+
+static LogRing* AcquireRing(void)
+{
+    if (threadRing_) {
+        return threadRing_;
+    }
+
+    // First message from this thread, claim a free ring and hand it back when the thread exits
+    pthread_once(&ringKeyOnce_, CreateRingKey);
+
+    for (u32 i = 0; i < LOG_MAX_THREADS; i++) {
+        u8 expected = LOG_RING_FREE;
+        if (atomic_compare_exchange_strong(&rings_[i].state, &expected, LOG_RING_OWNED)) {
+            threadRing_ = &rings_[i];
+            pthread_setspecific(ringKey_, threadRing_);
+
+            u32 used = atomic_load(&numRingsUsed_);
+            while (i + 1 > used && !atomic_compare_exchange_weak(&numRingsUsed_, &used, i + 1));
+            break;
+        }
+    }
+
+    return threadRing_;
+}
+
+// Write out everything pending across all rings in timestamp order, caller holds the consumer mutex
+static void DrainRings(void)
+{
+    u32 numRings = atomic_load(&numRingsUsed_);
+
+    while (true) {
+        LogRing* oldest = NULL;
+        u64 oldestTimestamp = UINT64_MAX;
+
+        for (u32 i = 0; i < numRings; i++) {
+            LogRing* ring = &rings_[i];
+            u64 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+                continue;
+            }
+            u64 timestamp = ring->records[tail & (LOG_RING_CAPACITY - 1)].timestampNs;
+            if (timestamp < oldestTimestamp) {
+                oldestTimestamp = timestamp;
+                oldest = ring;
+            }
+        }
+
+        if (oldest == NULL) {
+            break;
+        }
+
+        u64 tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+        WriteRecord(&oldest->records[tail & (LOG_RING_CAPACITY - 1)], stdout);
+        atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+    }
+
+    for (u32 i = 0; i < numRings; i++) {
+        LogRing* ring = &rings_[i];
+        u64 dropped = atomic_load(&ring->dropped);
+        if (dropped != ring->droppedReported) {
+            fprintf(stdout, "[%sWARN%s] -- %sDropped %llu log messages, ring full (%u)%s\n",
+                    ANSI_COLOR_YELLOW, ANSI_COLOR_RESET, ANSI_COLOR_YELLOW,
+                    (unsigned long long)(dropped - ring->droppedReported), i, ANSI_COLOR_RESET);
+            ring->droppedReported = dropped;
+        }
+
+        u8 expected = LOG_RING_ORPHANED;
+        if (atomic_load(&ring->tail) == atomic_load(&ring->head)) {
+            atomic_compare_exchange_strong(&ring->state, &expected, LOG_RING_FREE);
+        }
+    }
+
+    u64 unregisteredDropped = atomic_load(&unregisteredDropped_);
+    if (unregisteredDropped != unregisteredDroppedReported_) {
+        fprintf(stdout, "[%sWARN%s] -- %sDropped %llu log messages, no ring free for the thread%s\n",
+                ANSI_COLOR_YELLOW, ANSI_COLOR_RESET, ANSI_COLOR_YELLOW,
+                (unsigned long long)(unregisteredDropped - unregisteredDroppedReported_), ANSI_COLOR_RESET);
+        unregisteredDroppedReported_ = unregisteredDropped;
+    }
+
+    fflush(stdout);
+}
+
+static void* LoggerThread(void* data)
+{
+    (void)data;
+
+    struct timespec interval = {
+        .tv_sec = 0,
+        .tv_nsec = LOG_FLUSH_INTERVAL_MS * 1000000l,
+    };
+
+    while (atomic_load(&running_)) {
+        Logger_Flush();
+        nanosleep(&interval, NULL);
+    }
+
+    return NULL;
+}
+
 void RegisterAssertHandler(void (*handler)(const char *, const char *, i32))
 {
     // Once set, cannot be reset
@@ -51,53 +452,86 @@ void SetLogLevel(LogLevel level)
 
 long long GetTimeMs()
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (long long)tv.tv_sec * 1000 + (long long)tv.tv_usec / 1000;
+    return (long long)(NowNs(CLOCK_MONOTONIC) / 1000000ull);
 }
 
-void _LogMessage(LogLevel level, const char* file, i32 line, const char* format, ...)
+void Logger_Start(void)
 {
-    if (level < currentLevel_) {
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(&running_, &expected, true)) {
         return;
     }
 
-    // Format a timestamp
-    char timeBuf[30];
-    int ms;
-    struct tm* tmInfo;
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    ms = lrint(tv.tv_usec / 1000.0);
-    if (ms >= 1000.0) {
-        ms -= 1000.0;
-        tv.tv_sec++;
-    }
-    tmInfo = localtime(&tv.tv_sec);
-    strftime(timeBuf, 26, "%H:%M:%S", tmInfo);
-    snprintf(timeBuf + strlen(timeBuf), sizeof(timeBuf) - strlen(timeBuf), ":%03d", ms);
+    Assert(pthread_create(&loggerThread_, NULL, LoggerThread, NULL) == 0, "Failed to create logger thread");
+}
 
-    // Format the output buffer
-    char formatBuf[256];
-    va_list args;
-    va_start(args, format);
-    sprintf(formatBuf, "[%s%s%s] [%s] -- %s%s%s (%s:%d)\n", 
-            colors_[level], levels_[level], ANSI_COLOR_RESET, 
-            timeBuf, colors_[level], format, ANSI_COLOR_RESET, file, line);
-    vprintf(formatBuf, args);
-    va_end(args);
+void Logger_Stop(void)
+{
+    if (!atomic_exchange(&running_, false)) {
+        return;
+    }
+
+    pthread_join(loggerThread_, NULL);
+    Logger_Flush();
 }
 
-void _LogRaw(LogLevel level, const char *format, ...)
+void Logger_Flush(void)
 {
-    if (level < currentLevel_) {
+    pthread_mutex_lock(&consumerMutex_);
+    DrainRings();
+    pthread_mutex_unlock(&consumerMutex_);
+}
+
+u64 Logger_GetDroppedCount(void)
+{
+    u64 dropped = atomic_load(&unregisteredDropped_);
+    for (u32 i = 0; i < LOG_MAX_THREADS; i++) {
+        dropped += atomic_load(&rings_[i].dropped);
+    }
+    return dropped;
+}
+
+void _LogMessage(const LogSite* site, ...)
+{
+    if (site->level < currentLevel_) {
         return;
     }
 
     va_list args;
-    va_start(args, format);
-    vprintf(format, args);
+
+    if (!atomic_load_explicit(&running_, memory_order_relaxed)) {
+        // No logger thread yet, write synchronously
+        LogRecord record;
+        record.site = site;
+        record.timestampNs = NowNs(CLOCK_REALTIME);
+        va_start(args, site);
+        CaptureArgs(&record, site->format, args);
+        va_end(args);
+        WriteRecord(&record, stdout);
+        return;
+    }
+
+    LogRing* ring = AcquireRing();
+    if (ring == NULL) {
+        atomic_fetch_add(&unregisteredDropped_, 1);
+        return;
+    }
+
+    u64 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    u64 tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    LogRecord* record = &ring->records[head & (LOG_RING_CAPACITY - 1)];
+    record->site = site;
+    record->timestampNs = NowNs(CLOCK_REALTIME);
+    va_start(args, site);
+    CaptureArgs(record, site->format, args);
     va_end(args);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 }
 
 void _Assert(bool condition, const char* condString, const char* file, i32 line, const char *format, ...)
@@ -112,6 +546,13 @@ void _Assert(bool condition, const char* condString, const char* file, i32 line,
         va_start(args, format);
         vsprintf(outputBuf, formatBuf, args);
         va_end(args);
+
+        // Get anything already queued out before the handler tears things down,
+        // without waiting in case the assert fired on the logger thread itself
+        if (pthread_mutex_trylock(&consumerMutex_) == 0) {
+            DrainRings();
+            pthread_mutex_unlock(&consumerMutex_);
+        }
         
         if (assertHandler_) {
             assertHandler_(outputBuf, file, line);
@@ -121,4 +562,3 @@ void _Assert(bool condition, const char* condString, const char* file, i32 line,
         }
     }
 }
-
@@ -0,0 +1,386 @@
+#include <multitrack_recorder.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <trace.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+static void WriteFrames(MultitrackRecorder* recorder, WavWriter* file, const void* frames, u32 numFrames)
+{
+    u64 startNs = Trace_NowNs();
+    WavWriter_Write(file, frames, numFrames);
+    u64 writeNs = Trace_NowNs() - startNs;
+
+    atomic_fetch_add(&recorder->bytesWritten, (u64)numFrames * file->bytesPerFrame);
+    atomic_fetch_add(&recorder->numWrites, 1);
+    atomic_fetch_add(&recorder->writeNs, writeNs);
+    if (writeNs > atomic_load(&recorder->maxWriteNs)) {
+        atomic_store(&recorder->maxWriteNs, writeNs);
+    }
+}
+
+// Float goes straight from the ring, integer formats through the staging buffer
+static const u8* Encode(MultitrackRecorder* recorder, MultitrackTrack* track, const f32* frames, u32 numFrames)
+{
+    if (recorder->format == PCM_FORMAT_F32) {
+        return (const u8*)frames;
+    }
+    Pcm_EncodeStereoDithered(recorder->format, frames, numFrames, &track->dither, recorder->encoded);
+    return recorder->encoded;
+}
+
+// Writes the track's whole blocks to its own file, or everything waiting if flushing
+static void DrainTrack(MultitrackRecorder* recorder, MultitrackTrack* track, bool flush)
+{
+    u32 available = RecordRing_Available(&track->ring);
+    if (!flush) {
+        available -= available % RECORD_RING_BLOCK_FRAMES;
+    }
+
+    while (available > 0) {
+        const f32* frames;
+        u32 numFrames = RecordRing_Peek(&track->ring, MIN(available, RECORD_RING_BLOCK_FRAMES), &frames);
+        WriteFrames(recorder, &track->file, Encode(recorder, track, frames, numFrames), numFrames);
+        RecordRing_Consume(&track->ring, numFrames);
+        atomic_fetch_add(&track->framesWritten, numFrames);
+        available -= numFrames;
+    }
+
+    if (flush) {
+        WavWriter_WriteHeader(&track->file);
+    }
+}
+
+// Gathers the same frames from every track side by side and writes them as one, in whole
+// batches or everything every track has if flushing
+static void DrainInterleaved(MultitrackRecorder* recorder, u32 numTracks, bool flush)
+{
+    if (recorder->file.fd < 0) {
+        return;
+    }
+
+    // Taps all write the same cycles, so this is only short of the others mid cycle
+    u32 available = UINT32_MAX;
+    for (u32 t = 0; t < numTracks; t++) {
+        u32 trackAvailable = RecordRing_Available(&recorder->tracks[t].ring);
+        available = MIN(available, trackAvailable);
+    }
+    if (!flush) {
+        available -= available % recorder->batchFrames;
+    }
+
+    u32 pairBytes = 2 * Pcm_BytesPerSample(recorder->format);
+    u32 frameBytes = recorder->file.bytesPerFrame;
+    while (available > 0) {
+        u32 batchFrames = MIN(available, recorder->batchFrames);
+        for (u32 t = 0; t < numTracks; t++) {
+            MultitrackTrack* track = &recorder->tracks[t];
+            u8* dst = recorder->interleaved + t * pairBytes;
+
+            // Two runs across the wrap
+            u32 done = 0;
+            while (done < batchFrames) {
+                const f32* frames;
+                u32 numFrames = RecordRing_Peek(&track->ring, batchFrames - done, &frames);
+                const u8* src = Encode(recorder, track, frames, numFrames);
+                for (u32 f = 0; f < numFrames; f++) {
+                    memcpy(dst + (u64)(done + f) * frameBytes, src + f * pairBytes, pairBytes);
+                }
+                RecordRing_Consume(&track->ring, numFrames);
+                done += numFrames;
+            }
+            atomic_fetch_add(&track->framesWritten, batchFrames);
+        }
+
+        WriteFrames(recorder, &recorder->file, recorder->interleaved, batchFrames);
+        available -= batchFrames;
+    }
+
+    if (flush) {
+        WavWriter_WriteHeader(&recorder->file);
+    }
+}
+
+static void Drain(MultitrackRecorder* recorder, bool flush)
+{
+    u32 numTracks = atomic_load(&recorder->numTracks);
+    if (recorder->layout == MULTITRACK_INTERLEAVED) {
+        DrainInterleaved(recorder, numTracks, flush);
+        return;
+    }
+    for (u32 t = 0; t < numTracks; t++) {
+        DrainTrack(recorder, &recorder->tracks[t], flush);
+    }
+}
+
+static void* Writer(void* data)
+{
+    MultitrackRecorder* recorder = (MultitrackRecorder*)data;
+    Assert(recorder, "Recorder is null");
+
+    Trace_SetThreadName("Multitrack Writer");
+
+    pthread_mutex_lock(&recorder->mutex);
+    while (atomic_load(&recorder->running)) {
+        bool flush = atomic_exchange(&recorder->flushRequested, false);
+        pthread_mutex_unlock(&recorder->mutex);
+        Drain(recorder, flush);
+        pthread_mutex_lock(&recorder->mutex);
+
+        if (atomic_load(&recorder->running) && !atomic_load(&recorder->flushRequested)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += MULTITRACK_WRITE_INTERVAL_MS * 1000000;
+            ts.tv_sec += ts.tv_nsec / 1000000000;
+            ts.tv_nsec %= 1000000000;
+            pthread_cond_timedwait(&recorder->cond, &recorder->mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+
+    return NULL;
+}
+
+// Every tap latches the same value before any of them process, so a start or stop lands
+// on the same frame in every track
+static void LatchRecording(void* data)
+{
+    MultitrackTrack* track = (MultitrackTrack*)data;
+    track->recorder->cycleRecording = atomic_load(&track->recorder->recording);
+    track->recorder->cycleChecked = false;
+}
+
+// The first tap to process checks every ring, the cycle's length isn't known until then.
+// Rings only gain room while the writer drains, so one that fits now still fits at its tap.
+static void CheckCycleFits(MultitrackRecorder* recorder, u16 numFrames)
+{
+    recorder->cycleChecked = true;
+
+    u32 numTracks = atomic_load(&recorder->numTracks);
+    for (u32 t = 0; t < numTracks; t++) {
+        if (RecordRing_Space(&recorder->tracks[t].ring) < numFrames) {
+            recorder->cycleRecording = false;
+    recorder->cycleChecked = false;
+            atomic_fetch_add_explicit(&recorder->numSkippedCycles, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&recorder->numSkippedFrames, numFrames, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+static void ProcessTap(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    (void)sampleRate;
+
+    MultitrackTrack* track = (MultitrackTrack*)data;
+    Assert(track, "Track is null");
+
+    MultitrackRecorder* recorder = track->recorder;
+    if (recorder->cycleRecording && !recorder->cycleChecked) {
+        CheckCycleFits(recorder, numFrames);
+    }
+    if (recorder->cycleRecording) {
+        RecordRing_Write(&track->ring, buffer, numFrames);
+    }
+}
+
+void MultitrackRecorder_Init(MultitrackRecorder* recorder,
+                             MultitrackLayout layout,
+                             const char* filename,
+                             PcmFormat format,
+                             PcmDitherMode dither,
+                             u32 maxTracks)
+{
+    Assert(recorder, "Recorder is null");
+    Assert(maxTracks > 0 && maxTracks <= MULTITRACK_MAX_TRACKS, "Can't record %u tracks", maxTracks);
+    Assert((layout == MULTITRACK_INTERLEAVED) == (filename != NULL), "Only an interleaved recording has one file");
+
+    recorder->layout = layout;
+    recorder->format = format;
+    recorder->ditherMode = dither;
+    recorder->maxTracks = maxTracks;
+    recorder->batchFrames = 0;
+    recorder->filename[0] = '\0';
+    if (filename) {
+        strncpy(recorder->filename, filename, MULTITRACK_MAX_PATH - 1);
+        recorder->filename[MULTITRACK_MAX_PATH - 1] = '\0';
+    }
+    recorder->file.fd = -1;
+
+    // Every ring up front, plus a block of staging to convert into and a batch to interleave in
+    u64 ringBytes = (u64)MULTITRACK_RING_FRAMES * 2 * sizeof(f32) + RECORD_RING_ALIGNMENT;
+    u64 encodedBytes = (u64)RECORD_RING_BLOCK_FRAMES * 2 * sizeof(f32) + RECORD_RING_ALIGNMENT;
+    u64 interleavedBytes = (u64)MULTITRACK_BATCH_BYTES + RECORD_RING_ALIGNMENT;
+    u64 arenaBytes = ringBytes * maxTracks;
+    arenaBytes += (format != PCM_FORMAT_F32) ? encodedBytes : 0;
+    arenaBytes += (layout == MULTITRACK_INTERLEAVED) ? interleavedBytes : 0;
+    HeapArena_Init(&recorder->arena, arenaBytes);
+
+    recorder->encoded = NULL;
+    if (format != PCM_FORMAT_F32) {
+        recorder->encoded = (u8*)AlignUp((u64)HeapArena_Alloc(&recorder->arena, encodedBytes), RECORD_RING_ALIGNMENT);
+    }
+    recorder->interleaved = NULL;
+    if (layout == MULTITRACK_INTERLEAVED) {
+        recorder->interleaved = (u8*)AlignUp((u64)HeapArena_Alloc(&recorder->arena, interleavedBytes), RECORD_RING_ALIGNMENT);
+    }
+
+    atomic_store(&recorder->numTracks, 0);
+    atomic_store(&recorder->recording, false);
+    recorder->cycleRecording = false;
+    atomic_store(&recorder->bytesWritten, 0);
+    atomic_store(&recorder->numWrites, 0);
+    atomic_store(&recorder->writeNs, 0);
+    atomic_store(&recorder->maxWriteNs, 0);
+    atomic_store(&recorder->numSkippedCycles, 0);
+    atomic_store(&recorder->numSkippedFrames, 0);
+    recorder->startNs = 0;
+
+    // The writer thread starts with the first recording, once every track is in place
+    atomic_store(&recorder->flushRequested, false);
+    atomic_store(&recorder->running, false);
+    Assert(pthread_mutex_init(&recorder->mutex, NULL) == 0, "Failed to create mutex");
+    Assert(pthread_cond_init(&recorder->cond, NULL) == 0, "Failed to create condition variable");
+}
+
+void MultitrackRecorder_Deinit(MultitrackRecorder* recorder)
+{
+    Assert(recorder, "Recorder is null");
+
+    atomic_store(&recorder->recording, false);
+
+    if (recorder->startNs != 0) {
+        pthread_mutex_lock(&recorder->mutex);
+        atomic_store(&recorder->running, false);
+        pthread_cond_signal(&recorder->cond);
+        pthread_mutex_unlock(&recorder->mutex);
+        pthread_join(recorder->writer, NULL);
+    }
+
+    // Anything recorded up to shutdown still makes it into the files
+    Drain(recorder, true);
+
+    LogInfo("Deinitialising MultitrackRecorder");
+    MultitrackRecorder_LogStats(recorder);
+
+    u32 numTracks = atomic_load(&recorder->numTracks);
+    for (u32 t = 0; t < numTracks; t++) {
+        WavWriter_Close(&recorder->tracks[t].file);
+    }
+    WavWriter_Close(&recorder->file);
+
+    pthread_mutex_destroy(&recorder->mutex);
+    pthread_cond_destroy(&recorder->cond);
+    HeapArena_Deinit(&recorder->arena);
+}
+
+u16 MultitrackRecorder_AddTrack(MultitrackRecorder* recorder, CoreEngineContext* ctx, const char* filename)
+{
+    Assert(recorder, "Recorder is null");
+    Assert(ctx, "Engine is null");
+    Assert(recorder->startNs == 0, "Tracks must be added before recording starts");
+    Assert((recorder->layout == MULTITRACK_FILE_PER_TRACK) == (filename != NULL),
+           "A track has its own file only when not interleaved");
+
+    u32 index = atomic_load(&recorder->numTracks);
+    Assert(index < recorder->maxTracks, "Recorder already has all %u tracks", recorder->maxTracks);
+
+    MultitrackTrack* track = &recorder->tracks[index];
+    track->recorder = recorder;
+    track->index = index;
+    atomic_store(&track->framesWritten, 0);
+    RecordRing_Init(&track->ring, &recorder->arena, MULTITRACK_RING_FRAMES);
+    PcmDither_Init(&track->dither, recorder->ditherMode, (u32)Trace_NowNs() + index);
+    track->file.fd = -1;
+    if (filename) {
+        WavWriter_Open(&track->file, filename, recorder->format, 2, SAMPLE_RATE_DEFAULT);
+    }
+    atomic_store(&recorder->numTracks, index + 1);
+
+    // Shedding a tap would slip its track against the others, and a copy is cheap to keep
+    u16 id = CoreEngine_CreateProcessor(ctx, ProcessTap, NULL, LatchRecording, (void*)track);
+    CoreEngine_SetPriority(ctx, id, PROCESSOR_PRIORITY_CRITICAL);
+    return id;
+}
+
+void MultitrackRecorder_StartRecord(MultitrackRecorder* recorder)
+{
+    Assert(recorder, "Recorder is null");
+
+    u32 numTracks = atomic_load(&recorder->numTracks);
+    Assert(numTracks > 0, "Nothing to record, no tracks added");
+
+    if (recorder->startNs == 0) {
+        if (recorder->layout == MULTITRACK_INTERLEAVED) {
+            WavWriter_Open(&recorder->file, recorder->filename, recorder->format, numTracks * 2, SAMPLE_RATE_DEFAULT);
+
+            // The largest power of two that fits the batch, never more than a ring block
+            u32 fitFrames = MULTITRACK_BATCH_BYTES / recorder->file.bytesPerFrame;
+            recorder->batchFrames = RECORD_RING_BLOCK_FRAMES;
+            while (recorder->batchFrames > fitFrames) {
+                recorder->batchFrames >>= 1;
+            }
+        }
+
+        recorder->startNs = Trace_NowNs();
+        atomic_store(&recorder->running, true);
+        Assert(pthread_create(&recorder->writer, NULL, Writer, (void*)recorder) == 0, "Failed to create thread");
+    }
+
+    atomic_store(&recorder->recording, true);
+}
+
+void MultitrackRecorder_StopRecord(MultitrackRecorder* recorder)
+{
+    Assert(recorder, "Recorder is null");
+
+    atomic_store(&recorder->recording, false);
+
+    pthread_mutex_lock(&recorder->mutex);
+    atomic_store(&recorder->flushRequested, true);
+    pthread_cond_signal(&recorder->cond);
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+f64 MultitrackRecorder_MegabytesPerSecond(MultitrackRecorder* recorder)
+{
+    if (recorder->startNs == 0) {
+        return 0.0;
+    }
+    f64 seconds = (Trace_NowNs() - recorder->startNs) / 1e9;
+    return atomic_load(&recorder->bytesWritten) / (1024.0 * 1024.0) / seconds;
+}
+
+void MultitrackRecorder_LogStats(MultitrackRecorder* recorder)
+{
+    u64 bytesWritten = atomic_load(&recorder->bytesWritten);
+    u64 writeNs = atomic_load(&recorder->writeNs);
+    f64 megabytes = bytesWritten / (1024.0 * 1024.0);
+    u32 numTracks = atomic_load(&recorder->numTracks);
+
+    LogInfo("MultitrackRecorder { tracks: %u, written: %.1fMB in %llu writes, %.1fMB/s sustained, "
+            "%.1fMB/s while writing, worst write: %.2fms, skipped: %llu cycles (%llu frames) }",
+            numTracks,
+            megabytes,
+            atomic_load(&recorder->numWrites),
+            MultitrackRecorder_MegabytesPerSecond(recorder),
+            writeNs > 0 ? megabytes / (writeNs / 1e9) : 0.0,
+            atomic_load(&recorder->maxWriteNs) / 1000000.0,
+            atomic_load(&recorder->numSkippedCycles),
+            atomic_load(&recorder->numSkippedFrames));
+
+    for (u32 t = 0; t < numTracks; t++) {
+        RecordRing* ring = &recorder->tracks[t].ring;
+        LogInfo("Track %u { written: %llu frames, waiting: %u frames, most waiting: %.1fms of %.1fms, "
+                "overruns: %llu (%llu frames) }",
+                t,
+                atomic_load(&recorder->tracks[t].framesWritten),
+                RecordRing_Available(ring),
+                atomic_load(&ring->maxLagFrames) * 1000.0 / SAMPLE_RATE_DEFAULT,
+                ring->capacity * 1000.0 / SAMPLE_RATE_DEFAULT,
+                atomic_load(&ring->numOverruns),
+                atomic_load(&ring->numOverrunFrames));
+    }
+}
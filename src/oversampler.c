@@ -0,0 +1,213 @@
+#include <oversampler.h>
+#include <logger.h>
+#include <utils.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+#define OVERSAMPLER_KAISER_BETA 9.0 // Around 90dB of stopband
+
+// The odd taps of a Kaiser windowed half-band lowpass, scaled so they sum to one
+static void BuildTaps(f32* taps, u32 numTaps)
+{
+    f64 halfWidth = numTaps;
+    f64 windowScale = 1.0 / BesselI0(OVERSAMPLER_KAISER_BETA);
+    f64 sum = 0.0;
+
+    for (u32 tap = 0; tap < numTaps; tap++) {
+        f64 distance = 2.0 * tap - (numTaps - 1); // Odd, symmetric about the centre tap
+        f64 x = distance / halfWidth;
+        f64 window = BesselI0(OVERSAMPLER_KAISER_BETA * sqrt(1.0 - x * x)) * windowScale;
+        f64 sinc = sin(M_PI * distance / 2.0) / (M_PI * distance / 2.0);
+        taps[tap] = (f32)(sinc * window);
+        sum += taps[tap];
+    }
+
+    // The centre tap makes up the other half of DC, the rest have to come to one doubled
+    for (u32 tap = 0; tap < numTaps; tap++) {
+        taps[tap] = (f32)(taps[tap] / sum);
+    }
+}
+
+static inline void StereoDot(const f32* taps, const f32* left, const f32* right, u32 numTaps, f32* output)
+{
+#if defined(__ARM_NEON)
+    float32x4_t sumLeft = vdupq_n_f32(0.0f);
+    float32x4_t sumRight = vdupq_n_f32(0.0f);
+    for (u32 tap = 0; tap < numTaps; tap += 4) {
+        float32x4_t coeffs = vld1q_f32(taps + tap);
+        sumLeft = vmlaq_f32(sumLeft, coeffs, vld1q_f32(left + tap));
+        sumRight = vmlaq_f32(sumRight, coeffs, vld1q_f32(right + tap));
+    }
+    float32x2_t pairs = vpadd_f32(vadd_f32(vget_low_f32(sumLeft), vget_high_f32(sumLeft)),
+                                  vadd_f32(vget_low_f32(sumRight), vget_high_f32(sumRight)));
+    vst1_f32(output, pairs);
+#elif defined(__SSE2__)
+    __m128 sumLeft = _mm_setzero_ps();
+    __m128 sumRight = _mm_setzero_ps();
+    for (u32 tap = 0; tap < numTaps; tap += 4) {
+        __m128 coeffs = _mm_loadu_ps(taps + tap);
+        sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(coeffs, _mm_loadu_ps(left + tap)));
+        sumRight = _mm_add_ps(sumRight, _mm_mul_ps(coeffs, _mm_loadu_ps(right + tap)));
+    }
+    f32 lanes[8];
+    _mm_storeu_ps(lanes, sumLeft);
+    _mm_storeu_ps(lanes + 4, sumRight);
+    output[0] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    output[1] = (lanes[4] + lanes[5]) + (lanes[6] + lanes[7]);
+#else
+    f32 sumLeft = 0.0f;
+    f32 sumRight = 0.0f;
+    for (u32 tap = 0; tap < numTaps; tap++) {
+        sumLeft += taps[tap] * left[tap];
+        sumRight += taps[tap] * right[tap];
+    }
+    output[0] = sumLeft;
+    output[1] = sumRight;
+#endif
+}
+
+// Writes a frame into a doubled history at pos, the run of numTaps ending with it starts at
+// pos + 1
+static inline void PushFrame(f32* history, u32 pos, u32 numTaps, f32 left, f32 right)
+{
+    f32* l = history + pos;
+    f32* r = l + numTaps * 2;
+    l[0] = l[numTaps] = left;
+    r[0] = r[numTaps] = right;
+}
+
+// Each frame in gives two out: the dot product branch, then the centre tap's half way
+// through the history
+static void Upsample(OversamplerStage* stage, const f32* input, u32 numFrames, f32* output)
+{
+    u32 numTaps = stage->numTaps;
+    for (u32 i = 0; i < numFrames; i++) {
+        PushFrame(stage->upHistory, stage->upPos, numTaps, input[i * 2], input[i * 2 + 1]);
+        const f32* left = stage->upHistory + stage->upPos + 1;
+        const f32* right = left + numTaps * 2;
+
+        StereoDot(stage->taps, left, right, numTaps, output + i * 4);
+        output[i * 4 + 2] = left[numTaps / 2];
+        output[i * 4 + 3] = right[numTaps / 2];
+        stage->upPos = (stage->upPos + 1) % numTaps;
+    }
+}
+
+// Each pair of frames in gives one out, keeping the even phase
+static void Downsample(OversamplerStage* stage, const f32* input, u32 numFrames, f32* output)
+{
+    u32 numTaps = stage->numTaps;
+    for (u32 i = 0; i < numFrames; i++) {
+        PushFrame(stage->evenHistory, stage->downPos, numTaps, input[i * 4], input[i * 4 + 1]);
+        PushFrame(stage->oddHistory, stage->downPos, numTaps, input[i * 4 + 2], input[i * 4 + 3]);
+        const f32* left = stage->evenHistory + stage->downPos + 1;
+        const f32* right = left + numTaps * 2;
+        const f32* oddLeft = stage->oddHistory + stage->downPos + 1;
+        const f32* oddRight = oddLeft + numTaps * 2;
+
+        f32 sums[2];
+        StereoDot(stage->taps, left, right, numTaps, sums);
+        output[i * 2] = 0.5f * (sums[0] + oddLeft[numTaps / 2 - 1]);
+        output[i * 2 + 1] = 0.5f * (sums[1] + oddRight[numTaps / 2 - 1]);
+        stage->downPos = (stage->downPos + 1) % numTaps;
+    }
+}
+
+static void ProcessOversampler(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    Oversampler* os = (Oversampler*)data;
+    Assert(os, "Oversampler is null");
+
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 chunkFrames = MIN((u32)numFrames - done, OVERSAMPLER_BLOCK_FRAMES);
+        f32* io = buffer + done * 2;
+
+        u32 stageFrames = chunkFrames;
+        const f32* lower = io;
+        for (u32 s = 0; s < os->numStages; s++) {
+            Upsample(&os->stages[s], lower, stageFrames, os->stages[s].buffer);
+            lower = os->stages[s].buffer;
+            stageFrames *= 2;
+        }
+
+        os->Inner(sampleRate * os->factor, (u16)stageFrames, os->stages[os->numStages - 1].buffer, os->innerData);
+
+        for (u32 s = os->numStages; s-- > 0;) {
+            stageFrames /= 2;
+            f32* output = (s > 0) ? os->stages[s - 1].buffer : io;
+            Downsample(&os->stages[s], os->stages[s].buffer, stageFrames, output);
+        }
+
+        done += chunkFrames;
+    }
+}
+
+static void DestroyOversampler(void* data)
+{
+    Oversampler* os = (Oversampler*)data;
+    Assert(os, "Oversampler is null");
+
+    LogInfo("Destroying Oversampler");
+}
+
+u16 Oversampler_Create(Oversampler* os, CoreEngineContext* ctx, u32 factor, ProcessFunc Inner, void* innerData)
+{
+    Assert(os, "Oversampler is null");
+    Assert(ctx, "Engine is null");
+    Assert(Inner, "Oversampler needs something to run");
+    Assert(factor == 2 || factor == 4 || factor == 8, "Can't oversample %ux", factor);
+
+    os->factor = factor;
+    os->numStages = (u32)__builtin_ctz(factor);
+    os->Inner = Inner;
+    os->innerData = innerData;
+
+    u64 numFloats = 0;
+    for (u32 s = 0; s < os->numStages; s++) {
+        u32 numTaps = (s == 0) ? OVERSAMPLER_FIRST_TAPS : OVERSAMPLER_LATER_TAPS;
+        numFloats += numTaps + numTaps * 4 * 3 + (OVERSAMPLER_BLOCK_FRAMES << (s + 1)) * 2;
+    }
+
+    f32* memory = HeapArena_Alloc(&ctx->heapArena, numFloats * sizeof(f32));
+    memset(memory, 0, numFloats * sizeof(f32));
+
+    // Each stage's round trip delays by one frame short of its taps at its lower rate
+    os->latencyFrames = 0.0f;
+    f32* next = memory;
+    for (u32 s = 0; s < os->numStages; s++) {
+        OversamplerStage* stage = &os->stages[s];
+        stage->numTaps = (s == 0) ? OVERSAMPLER_FIRST_TAPS : OVERSAMPLER_LATER_TAPS;
+        stage->taps = next;
+        stage->upHistory = stage->taps + stage->numTaps;
+        stage->evenHistory = stage->upHistory + stage->numTaps * 4;
+        stage->oddHistory = stage->evenHistory + stage->numTaps * 4;
+        stage->buffer = stage->oddHistory + stage->numTaps * 4;
+        next = stage->buffer + (OVERSAMPLER_BLOCK_FRAMES << (s + 1)) * 2;
+        stage->upPos = 0;
+        stage->downPos = 0;
+
+        BuildTaps(stage->taps, stage->numTaps);
+        os->latencyFrames += (f32)(stage->numTaps - 1) / (f32)(1 << s);
+    }
+
+    LogInfo("Creating Oversampler { factor: %u, latency: %.2f frames }", factor, os->latencyFrames);
+
+    return CoreEngine_CreateProcessor(ctx, ProcessOversampler, DestroyOversampler, NULL, (void*)os);
+}
+
+f32 Oversampler_LatencyFrames(const Oversampler* os)
+{
+    return os->latencyFrames;
+}
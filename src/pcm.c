@@ -0,0 +1,398 @@
+#include <pcm.h>
+#include <logger.h>
+
+#include <math.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+// Samples converted at a time through the stack, even so blocks always start on a left sample
+#define CONVERT_BLOCK_SAMPLES 256
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const char* formatNames_[PCM_FORMAT_COUNT] = {
+    "PCM_FORMAT_S16",
+    "PCM_FORMAT_S24",
+    "PCM_FORMAT_S32",
+    "PCM_FORMAT_F32",
+};
+
+u16 Pcm_BytesPerSample(PcmFormat format)
+{
+    switch (format) {
+        case PCM_FORMAT_S16: return 2;
+        case PCM_FORMAT_S24: return 3;
+        case PCM_FORMAT_S32: return 4;
+        case PCM_FORMAT_F32: return 4;
+        default:
+            Assert(false, "Unknown PCM format %d", format);
+            return 0;
+    }
+}
+
+const char* Pcm_FormatName(PcmFormat format)
+{
+    Assert(format < PCM_FORMAT_COUNT, "Unknown PCM format %d", format);
+    return formatNames_[format];
+}
+
+// Straight through for interleaved stereo, every target we build for is little endian so
+// the samples load directly into vector lanes
+static u32 DecodeS16Vector(const u8* src, u32 numSamples, f32* dst)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    const i16* samples = (const i16*)src;
+    for (; i + 8 <= numSamples; i += 8) {
+        int16x8_t packed = vld1q_s16(samples + i);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed))), PCM_S16_SCALE));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed))), PCM_S16_SCALE));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM_S16_SCALE);
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i packed = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        __m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+        __m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(low, scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(high, scale));
+    }
+#else
+    (void)src;
+    (void)numSamples;
+    (void)dst;
+#endif
+    return i;
+}
+
+static u32 DecodeS32Vector(const u8* src, u32 numSamples, f32* dst)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    const i32* samples = (const i32*)src;
+    for (; i + 4 <= numSamples; i += 4) {
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(samples + i)), PCM_S32_SCALE));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM_S32_SCALE);
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128i packed = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(packed), scale));
+    }
+#else
+    (void)src;
+    (void)numSamples;
+    (void)dst;
+#endif
+    return i;
+}
+
+#define DECODE_STEREO(load, bytesPerSample)\
+    do {\
+        u32 stride = (u32)(bytesPerSample) * numChannels;\
+        u32 rightOffset = (numChannels > 1) ? (bytesPerSample) : 0;\
+        for (u32 i = 0; i < numFrames; i++) {\
+            const u8* frame = src + i * stride;\
+            dst[i * 2] = load(frame);\
+            dst[i * 2 + 1] = load(frame + rightOffset);\
+        }\
+    } while (0)
+
+void Pcm_DecodeStereo(PcmFormat format, const u8* src, u16 numChannels, u32 numFrames, f32* dst)
+{
+    Assert(numChannels > 0, "Can't decode PCM with no channels");
+
+    switch (format) {
+        case PCM_FORMAT_S16:
+            if (numChannels == 2) {
+                for (u32 i = DecodeS16Vector(src, numFrames * 2, dst); i < numFrames * 2; i++) {
+                    dst[i] = Pcm_LoadS16(src + i * 2);
+                }
+            }
+            else {
+                DECODE_STEREO(Pcm_LoadS16, 2);
+            }
+            break;
+        case PCM_FORMAT_S24:
+            DECODE_STEREO(Pcm_LoadS24, 3);
+            break;
+        case PCM_FORMAT_S32:
+            if (numChannels == 2) {
+                for (u32 i = DecodeS32Vector(src, numFrames * 2, dst); i < numFrames * 2; i++) {
+                    dst[i] = Pcm_LoadS32(src + i * 4);
+                }
+            }
+            else {
+                DECODE_STEREO(Pcm_LoadS32, 4);
+            }
+            break;
+        case PCM_FORMAT_F32:
+            if (numChannels == 2) {
+                memcpy(dst, src, numFrames * 2 * sizeof(f32));
+            }
+            else {
+                DECODE_STEREO(Pcm_LoadF32, 4);
+            }
+            break;
+        default:
+            Assert(false, "Unknown PCM format %d", format);
+    }
+}
+
+PcmFormat Pcm_CompactFormat(PcmFormat sourceFormat)
+{
+    switch (sourceFormat) {
+        case PCM_FORMAT_S16: return PCM_FORMAT_S16;
+        case PCM_FORMAT_S24: return PCM_FORMAT_S24;
+        default: return PCM_FORMAT_F32; // 32 bit ints would lose precision as f32 anyway
+    }
+}
+
+// Full scale maps to the first step past the top, so +1.0 saturates rather than wrapping
+static inline i32 Quantise(f32 scaled, i32 min, i32 max)
+{
+    scaled = rintf(scaled);
+    return (scaled <= (f32)min) ? min : (scaled >= (f32)max) ? max : (i32)scaled;
+}
+
+static void FormatRange(PcmFormat format, f32* scale, i32* min, i32* max)
+{
+    switch (format) {
+        case PCM_FORMAT_S16: *scale = 32768.0f; *min = INT16_MIN; *max = INT16_MAX; break;
+        case PCM_FORMAT_S24: *scale = 8388608.0f; *min = -8388608; *max = 8388607; break;
+        case PCM_FORMAT_S32: *scale = 2147483648.0f; *min = INT32_MIN; *max = INT32_MAX; break;
+        default:
+            Assert(false, "No integer range for PCM format %d", format);
+    }
+}
+
+// Rounds to nearest even and saturates, the same as Quantise lane for lane
+static void QuantiseBlock(const f32* src, u32 numSamples, f32 scale, i32 min, i32 max, i32* dst)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    // Conversion saturates by itself, clamping first just keeps 16 and 24 bit in range
+    const float32x4_t low = vdupq_n_f32((f32)min);
+    const float32x4_t high = vdupq_n_f32((f32)max);
+    for (; i + 4 <= numSamples; i += 4) {
+        float32x4_t scaled = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(src + i), scale), low), high);
+        vst1q_s32(dst + i, vcvtnq_s32_f32(scaled));
+    }
+#elif defined(__SSE2__)
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 low = _mm_set1_ps((f32)min);
+    const __m128 high = _mm_set1_ps((f32)max);
+    const __m128 overflow = _mm_set1_ps(2147483648.0f);
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 scaled = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), vscale), low), high);
+        // Out of range converts to INT32_MIN, flipping every bit of that gives INT32_MAX
+        __m128i flip = _mm_castps_si128(_mm_cmpge_ps(scaled, overflow));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_cvtps_epi32(scaled), flip));
+    }
+#endif
+    for (; i < numSamples; i++) {
+        dst[i] = Quantise(src[i] * scale, min, max);
+    }
+}
+
+static void PackBlock(PcmFormat format, const i32* values, u32 numSamples, u8* dst)
+{
+    switch (format) {
+        case PCM_FORMAT_S16:
+            for (u32 i = 0; i < numSamples; i++) {
+                i16 value = (i16)values[i];
+                memcpy(dst + i * 2, &value, sizeof(value));
+            }
+            break;
+        case PCM_FORMAT_S24:
+            for (u32 i = 0; i < numSamples; i++) {
+                dst[i * 3] = (u8)values[i];
+                dst[i * 3 + 1] = (u8)(values[i] >> 8);
+                dst[i * 3 + 2] = (u8)(values[i] >> 16);
+            }
+            break;
+        case PCM_FORMAT_S32:
+            memcpy(dst, values, numSamples * sizeof(i32));
+            break;
+        default:
+            Assert(false, "Can't pack PCM format %d", format);
+    }
+}
+
+// Difference of two uniform values, triangular over +-1 step
+static inline f32 Tpdf(u32* random)
+{
+    u32 x = *random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    u32 y = x;
+    y ^= y << 13;
+    y ^= y >> 17;
+    y ^= y << 5;
+    *random = y;
+    return (f32)(x >> 8) * (1.0f / 16777216.0f) - (f32)(y >> 8) * (1.0f / 16777216.0f);
+}
+
+void Pcm_EncodeStereo(PcmFormat format, const f32* src, u32 numFrames, u8* dst)
+{
+    Pcm_EncodeStereoDithered(format, src, numFrames, NULL, dst);
+}
+
+void PcmDither_Init(PcmDither* dither, PcmDitherMode mode, u32 seed)
+{
+    Assert(mode < PCM_DITHER_COUNT, "Unknown dither mode %d", mode);
+    dither->mode = mode;
+    dither->random = (seed != 0) ? seed : 0x9E3779B9; // Xorshift never leaves zero
+    dither->error[0] = 0.0f;
+    dither->error[1] = 0.0f;
+}
+
+void Pcm_EncodeStereoDithered(PcmFormat format, const f32* src, u32 numFrames, PcmDither* dither, u8* dst)
+{
+    u32 numSamples = numFrames * 2;
+    if (format == PCM_FORMAT_F32) {
+        memcpy(dst, src, numSamples * sizeof(f32));
+        return;
+    }
+
+    f32 scale;
+    i32 min, max;
+    FormatRange(format, &scale, &min, &max);
+    u16 bytesPerSample = Pcm_BytesPerSample(format);
+    PcmDitherMode mode = (dither != NULL) ? dither->mode : PCM_DITHER_NONE;
+
+    f32 noisy[CONVERT_BLOCK_SAMPLES];
+    i32 values[CONVERT_BLOCK_SAMPLES];
+    for (u32 start = 0; start < numSamples; start += CONVERT_BLOCK_SAMPLES) {
+        u32 count = MIN(CONVERT_BLOCK_SAMPLES, numSamples - start);
+        const f32* block = src + start;
+
+        switch (mode) {
+            case PCM_DITHER_NONE:
+                QuantiseBlock(block, count, scale, min, max, values);
+                break;
+            case PCM_DITHER_TPDF:
+                // Noise goes in at the target's scale, in f32 it'd be below the input's precision
+                for (u32 i = 0; i < count; i++) {
+                    noisy[i] = block[i] * scale + Tpdf(&dither->random);
+                }
+                QuantiseBlock(noisy, count, 1.0f, min, max, values);
+                break;
+            case PCM_DITHER_SHAPED:
+                // First order, the error leaves as its difference from the one before
+                for (u32 i = 0; i < count; i++) {
+                    f32* error = &dither->error[i & 1];
+                    f32 wanted = block[i] * scale - *error;
+                    values[i] = Quantise(wanted + Tpdf(&dither->random), min, max);
+                    // Clipping would otherwise feed back without limit
+                    *error = fminf(fmaxf((f32)values[i] - wanted, -1.5f), 1.5f);
+                }
+                break;
+            default:
+                Assert(false, "Unknown dither mode %d", mode);
+        }
+
+        PackBlock(format, values, count, dst + start * bytesPerSample);
+    }
+}
+
+// Four frames at a time, every target we build for is little endian so the samples load
+// straight into vector lanes
+static u32 MixS16Vector(const u8* src, u32 numSamples, f32* dst)
+{
+    u32 i = 0;
+#if defined(__ARM_NEON)
+    const i16* samples = (const i16*)src;
+    for (; i + 8 <= numSamples; i += 8) {
+        int16x8_t packed = vld1q_s16(samples + i);
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed)));
+        vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), low, PCM_S16_SCALE));
+        vst1q_f32(dst + i + 4, vmlaq_n_f32(vld1q_f32(dst + i + 4), high, PCM_S16_SCALE));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM_S16_SCALE);
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i packed = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        // Into the top half of each 32 bit lane then shift back down to sign extend
+        __m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+        __m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(low, scale)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(high, scale)));
+    }
+#else
+    (void)src;
+    (void)numSamples;
+    (void)dst;
+#endif
+    return i;
+}
+
+void Pcm_MixStereo(PcmFormat format, const u8* src, u32 numFrames, f32* dst)
+{
+    u32 numSamples = numFrames * 2;
+
+    switch (format) {
+        case PCM_FORMAT_S16:
+            for (u32 i = MixS16Vector(src, numSamples, dst); i < numSamples; i++) {
+                dst[i] += Pcm_LoadS16(src + i * 2);
+            }
+            break;
+        case PCM_FORMAT_S24:
+            for (u32 i = 0; i < numSamples; i++) {
+                dst[i] += Pcm_LoadS24(src + i * 3);
+            }
+            break;
+        case PCM_FORMAT_S32:
+            for (u32 i = 0; i < numSamples; i++) {
+                dst[i] += Pcm_LoadS32(src + i * 4);
+            }
+            break;
+        case PCM_FORMAT_F32: {
+            const f32* samples = (const f32*)src;
+            for (u32 i = 0; i < numSamples; i++) {
+                dst[i] += samples[i];
+            }
+            break;
+        }
+        default:
+            Assert(false, "Unknown PCM format %d", format);
+    }
+}
+
+#define MIX_STEREO_RAMP(load, bytesPerSample)\
+    do {\
+        for (u32 i = 0; i < numFrames; i++) {\
+            const u8* frame = src + i * 2 * (bytesPerSample);\
+            dst[i * 2] += load(frame) * gain;\
+            dst[i * 2 + 1] += load(frame + (bytesPerSample)) * gain;\
+            gain += gainStep;\
+        }\
+    } while (0)
+
+void Pcm_MixStereoRamp(PcmFormat format, const u8* src, u32 numFrames, f32 gain, f32 gainStep, f32* dst)
+{
+    switch (format) {
+        case PCM_FORMAT_S16:
+            MIX_STEREO_RAMP(Pcm_LoadS16, 2);
+            break;
+        case PCM_FORMAT_S24:
+            MIX_STEREO_RAMP(Pcm_LoadS24, 3);
+            break;
+        case PCM_FORMAT_S32:
+            MIX_STEREO_RAMP(Pcm_LoadS32, 4);
+            break;
+        case PCM_FORMAT_F32:
+            MIX_STEREO_RAMP(Pcm_LoadF32, 4);
+            break;
+        default:
+            Assert(false, "Unknown PCM format %d", format);
+    }
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include <record_ring.h>
+#include <logger.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+static u32 NextPowerOfTwo(u32 value)
+{
+    u32 result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void RecordRing_Init(RecordRing* ring, HeapArena* arena, u32 numFrames)
+{
+    RecordRing_InitExact(ring, arena, NextPowerOfTwo(numFrames < RECORD_RING_BLOCK_FRAMES ? RECORD_RING_BLOCK_FRAMES : numFrames));
+}
+
+void RecordRing_InitExact(RecordRing* ring, HeapArena* arena, u32 numFrames)
+{
+    Assert(ring, "RecordRing is null");
+    Assert(arena, "HeapArena is null");
+    Assert(numFrames > 0, "RecordRing must hold at least one frame");
+
+    ring->capacity = numFrames;
+
+    u64 size = (u64)ring->capacity * 2 * sizeof(f32);
+    u8* base = HeapArena_Alloc(arena, size + RECORD_RING_ALIGNMENT);
+    ring->frames = (f32*)AlignUp((u64)base, RECORD_RING_ALIGNMENT);
+    memset(ring->frames, 0, size);
+
+    atomic_store(&ring->writeIndex, 0);
+    atomic_store(&ring->readIndex, 0);
+    atomic_store(&ring->numOverruns, 0);
+    atomic_store(&ring->numOverrunFrames, 0);
+    atomic_store(&ring->maxLagFrames, 0);
+}
+
+u32 RecordRing_Space(RecordRing* ring)
+{
+    u64 writeIndex = atomic_load_explicit(&ring->writeIndex, memory_order_relaxed);
+    u64 readIndex = atomic_load_explicit(&ring->readIndex, memory_order_acquire);
+    return ring->capacity - (u32)(writeIndex - readIndex);
+}
+
+bool RecordRing_Write(RecordRing* ring, const f32* frames, u32 numFrames)
+{
+    u64 writeIndex = atomic_load_explicit(&ring->writeIndex, memory_order_relaxed);
+    u64 readIndex = atomic_load_explicit(&ring->readIndex, memory_order_acquire);
+    u32 used = (u32)(writeIndex - readIndex);
+
+    if (numFrames > ring->capacity - used) {
+        atomic_fetch_add_explicit(&ring->numOverruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ring->numOverrunFrames, numFrames, memory_order_relaxed);
+        return false;
+    }
+
+    // At most two copies, the second only when the cycle straddles the wrap
+    u32 start = (u32)(writeIndex % ring->capacity);
+    u32 first = MIN(numFrames, ring->capacity - start);
+    if (frames != NULL) {
+        memcpy(ring->frames + start * 2, frames, first * 2 * sizeof(f32));
+        memcpy(ring->frames, frames + first * 2, (numFrames - first) * 2 * sizeof(f32));
+    } else {
+        memset(ring->frames + start * 2, 0, first * 2 * sizeof(f32));
+        memset(ring->frames, 0, (numFrames - first) * 2 * sizeof(f32));
+    }
+    atomic_store_explicit(&ring->writeIndex, writeIndex + numFrames, memory_order_release);
+
+    if (used + numFrames > atomic_load_explicit(&ring->maxLagFrames, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->maxLagFrames, used + numFrames, memory_order_relaxed);
+    }
+    return true;
+}
+
+void RecordRing_Trim(RecordRing* ring, u32 numFrames)
+{
+    u64 writeIndex = atomic_load_explicit(&ring->writeIndex, memory_order_relaxed);
+    u64 readIndex = atomic_load_explicit(&ring->readIndex, memory_order_relaxed);
+    if (writeIndex - readIndex > numFrames) {
+        atomic_store_explicit(&ring->readIndex, writeIndex - numFrames, memory_order_release);
+    }
+}
+
+u32 RecordRing_Available(RecordRing* ring)
+{
+    u64 writeIndex = atomic_load_explicit(&ring->writeIndex, memory_order_acquire);
+    return (u32)(writeIndex - atomic_load_explicit(&ring->readIndex, memory_order_relaxed));
+}
+
+u32 RecordRing_Peek(RecordRing* ring, u32 maxFrames, const f32** frames)
+{
+    u64 readIndex = atomic_load_explicit(&ring->readIndex, memory_order_relaxed);
+    u32 start = (u32)(readIndex % ring->capacity);
+
+    // Read once, the producer may have moved on between two loads
+    u32 available = RecordRing_Available(ring);
+    available = MIN(available, maxFrames);
+
+    *frames = ring->frames + start * 2;
+    return MIN(available, ring->capacity - start);
+}
+
+void RecordRing_Consume(RecordRing* ring, u32 numFrames)
+{
+    Assert(numFrames <= RecordRing_Available(ring), "Consumed %u frames past the write position", numFrames);
+    atomic_fetch_add_explicit(&ring->readIndex, numFrames, memory_order_release);
+}
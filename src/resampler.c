@@ -0,0 +1,234 @@
+#include <resampler.h>
+#include <logger.h>
+#include <utils.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CONVERT_BLOCK_FRAMES 4096
+
+typedef struct {
+    u32 numTaps; // Multiple of 4 for the vector loop
+    u32 numPhases;
+    f64 beta; // Kaiser window shape, higher trades transition width for stopband
+    f64 rolloff; // Cutoff as a fraction of the lower Nyquist
+} QualitySettings;
+
+// Each cutoff sits half a transition band below Nyquist, so the stopband starts right at it
+static const QualitySettings qualities_[RESAMPLER_QUALITY_COUNT] = {
+    { 16, 128, 6.0, 0.77 },
+    { 64, 256, 8.0, 0.92 },
+    { 128, 256, 10.0, 0.95 },
+};
+
+static void BuildTable(Resampler* resampler, const QualitySettings* settings)
+{
+    f64 cutoff = settings->rolloff * ((resampler->outRate < resampler->inRate) ? (f64)resampler->outRate / resampler->inRate : 1.0);
+    f64 halfWidth = settings->numTaps / 2.0;
+    f64 windowScale = 1.0 / BesselI0(settings->beta);
+
+    for (u32 phase = 0; phase <= settings->numPhases; phase++) {
+        f32* row = resampler->table + phase * settings->numTaps;
+        f64 fraction = (f64)phase / settings->numPhases;
+        f64 sum = 0.0;
+
+        for (u32 tap = 0; tap < settings->numTaps; tap++) {
+            f64 distance = (f64)tap - RESAMPLER_LATENCY(settings->numTaps) - fraction;
+            f64 x = distance / halfWidth;
+            f64 window = (fabs(x) < 1.0) ? BesselI0(settings->beta * sqrt(1.0 - x * x)) * windowScale : 0.0;
+            f64 sinc = (distance == 0.0) ? 1.0 : sin(M_PI * cutoff * distance) / (M_PI * cutoff * distance);
+            row[tap] = (f32)(cutoff * sinc * window);
+            sum += row[tap];
+        }
+
+        // Unity gain at DC for every phase, otherwise the fractional position shows up as ripple
+        for (u32 tap = 0; tap < settings->numTaps; tap++) {
+            row[tap] = (f32)(row[tap] / sum);
+        }
+    }
+}
+
+// One output frame, the taps interpolated between the two nearest phases as they're used
+static inline void Convolve(const f32* row0, 
+                            const f32* row1, 
+                            f32 t, 
+                            const f32* left, 
+                            const f32* right, 
+                            u32 numTaps, 
+                            f32* output)
+{
+#if defined(__ARM_NEON)
+    float32x4_t sumLeft = vdupq_n_f32(0.0f);
+    float32x4_t sumRight = vdupq_n_f32(0.0f);
+    for (u32 tap = 0; tap < numTaps; tap += 4) {
+        float32x4_t low = vld1q_f32(row0 + tap);
+        float32x4_t coeffs = vmlaq_n_f32(low, vsubq_f32(vld1q_f32(row1 + tap), low), t);
+        sumLeft = vmlaq_f32(sumLeft, coeffs, vld1q_f32(left + tap));
+        sumRight = vmlaq_f32(sumRight, coeffs, vld1q_f32(right + tap));
+    }
+    float32x2_t pairs = vpadd_f32(vadd_f32(vget_low_f32(sumLeft), vget_high_f32(sumLeft)), 
+                                  vadd_f32(vget_low_f32(sumRight), vget_high_f32(sumRight)));
+    vst1_f32(output, pairs);
+#elif defined(__SSE2__)
+    __m128 sumLeft = _mm_setzero_ps();
+    __m128 sumRight = _mm_setzero_ps();
+    __m128 weight = _mm_set1_ps(t);
+    for (u32 tap = 0; tap < numTaps; tap += 4) {
+        __m128 low = _mm_loadu_ps(row0 + tap);
+        __m128 coeffs = _mm_add_ps(low, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row1 + tap), low), weight));
+        sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(coeffs, _mm_loadu_ps(left + tap)));
+        sumRight = _mm_add_ps(sumRight, _mm_mul_ps(coeffs, _mm_loadu_ps(right + tap)));
+    }
+    f32 lanes[8];
+    _mm_storeu_ps(lanes, sumLeft);
+    _mm_storeu_ps(lanes + 4, sumRight);
+    output[0] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    output[1] = (lanes[4] + lanes[5]) + (lanes[6] + lanes[7]);
+#else
+    f32 sumLeft = 0.0f;
+    f32 sumRight = 0.0f;
+    for (u32 tap = 0; tap < numTaps; tap++) {
+        f32 coeff = row0[tap] + (row1[tap] - row0[tap]) * t;
+        sumLeft += coeff * left[tap];
+        sumRight += coeff * right[tap];
+    }
+    output[0] = sumLeft;
+    output[1] = sumRight;
+#endif
+}
+
+u32 Resampler_Capacity(u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames)
+{
+    return qualities_[quality].numTaps + (u32)ceil(maxOutFrames * ((f64)inRate / outRate)) + 2;
+}
+
+u64 Resampler_ArenaBytes(u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames)
+{
+    const QualitySettings* settings = &qualities_[quality];
+    u64 tableBytes = (u64)(settings->numPhases + 1) * settings->numTaps * sizeof(f32);
+    u64 inputBytes = (u64)Resampler_Capacity(inRate, outRate, quality, maxOutFrames) * sizeof(f32);
+    return AlignUp(tableBytes, ARENA_ALIGNMENT) + AlignUp(inputBytes, ARENA_ALIGNMENT) * 2;
+}
+
+void Resampler_Init(Resampler* resampler, HeapArena* arena, u32 inRate, u32 outRate, ResamplerQuality quality, u32 maxOutFrames)
+{
+    Assert(resampler, "Resampler is null");
+    Assert(arena, "Arena is null");
+    Assert(inRate > 0 && outRate > 0, "Can't resample from %d Hz to %d Hz", inRate, outRate);
+    Assert(quality < RESAMPLER_QUALITY_COUNT, "Unknown resampler quality %d", quality);
+
+    const QualitySettings* settings = &qualities_[quality];
+    memset(resampler, 0, sizeof(Resampler));
+    resampler->inRate = inRate;
+    resampler->outRate = outRate;
+    resampler->quality = quality;
+    resampler->step = (f64)inRate / outRate;
+    resampler->numTaps = settings->numTaps;
+    resampler->numPhases = settings->numPhases;
+    resampler->capacity = Resampler_Capacity(inRate, outRate, quality, maxOutFrames);
+
+    resampler->table = HeapArena_Alloc(arena, (u64)(settings->numPhases + 1) * settings->numTaps * sizeof(f32));
+    resampler->left = HeapArena_Alloc(arena, resampler->capacity * sizeof(f32));
+    resampler->right = HeapArena_Alloc(arena, resampler->capacity * sizeof(f32));
+
+    BuildTable(resampler, settings);
+}
+
+void Resampler_Reset(Resampler* resampler, f64 fraction)
+{
+    Assert(fraction >= 0.0 && fraction < 1.0, "Resampler start %f isn't a fraction of a frame", fraction);
+    resampler->numBuffered = 0;
+    resampler->position = fraction;
+}
+
+u32 Resampler_InputNeeded(const Resampler* resampler, u32 numOutFrames)
+{
+    if (numOutFrames == 0) {
+        return 0;
+    }
+    f64 lastPosition = resampler->position + (numOutFrames - 1) * resampler->step;
+    u32 framesNeeded = (u32)lastPosition + resampler->numTaps;
+    return (framesNeeded > resampler->numBuffered) ? framesNeeded - resampler->numBuffered : 0;
+}
+
+void Resampler_Process(Resampler* resampler, const f32* input, u32 numInFrames, f32* output, u32 numOutFrames)
+{
+    Assert(resampler->numBuffered + numInFrames <= resampler->capacity, 
+           "Resampler given %d frames with room for %d", numInFrames, resampler->capacity - resampler->numBuffered);
+
+    for (u32 i = 0; i < numInFrames; i++) {
+        resampler->left[resampler->numBuffered + i] = input[i * 2];
+        resampler->right[resampler->numBuffered + i] = input[i * 2 + 1];
+    }
+    resampler->numBuffered += numInFrames;
+    Assert(Resampler_InputNeeded(resampler, numOutFrames) == 0, "Resampler short of input for %d frames", numOutFrames);
+
+    u32 numTaps = resampler->numTaps;
+    for (u32 i = 0; i < numOutFrames; i++) {
+        f64 position = resampler->position + i * resampler->step;
+        u32 first = (u32)position;
+        f64 phase = (position - first) * resampler->numPhases;
+        u32 row = (u32)phase;
+        const f32* row0 = resampler->table + row * numTaps;
+        Convolve(row0, row0 + numTaps, (f32)(phase - row), resampler->left + first, resampler->right + first, numTaps, output + i * 2);
+    }
+
+    // Keep whatever later output frames still reach back into
+    resampler->position += numOutFrames * resampler->step;
+    u32 used = (u32)resampler->position;
+    used = (used < resampler->numBuffered) ? used : resampler->numBuffered;
+    resampler->numBuffered -= used;
+    resampler->position -= used;
+    memmove(resampler->left, resampler->left + used, resampler->numBuffered * sizeof(f32));
+    memmove(resampler->right, resampler->right + used, resampler->numBuffered * sizeof(f32));
+}
+
+u64 Resampler_OutputFrames(u32 inRate, u32 outRate, u64 numInFrames)
+{
+    return (numInFrames * outRate) / inRate;
+}
+
+void Resampler_ConvertAll(ResamplerQuality quality, 
+                          u32 inRate, 
+                          u32 outRate, 
+                          const f32* input, 
+                          u64 numInFrames, 
+                          f32* output, 
+                          u64 numOutFrames)
+{
+    // Only lives as long as the conversion
+    HeapArena arena;
+    u64 blockBytes = (u64)Resampler_Capacity(inRate, outRate, quality, CONVERT_BLOCK_FRAMES) * 2 * sizeof(f32);
+    HeapArena_Init(&arena, Resampler_ArenaBytes(inRate, outRate, quality, CONVERT_BLOCK_FRAMES) + blockBytes);
+
+    Resampler resampler;
+    Resampler_Init(&resampler, &arena, inRate, outRate, quality, CONVERT_BLOCK_FRAMES);
+    Resampler_Reset(&resampler, 0.0);
+    f32* block = HeapArena_Alloc(&arena, blockBytes);
+
+    // Starting early by the latency lines output frame 0 up with input frame 0
+    i64 inputFrame = -(i64)RESAMPLER_LATENCY(resampler.numTaps);
+    for (u64 outputFrame = 0; outputFrame < numOutFrames; ) {
+        u32 framesThisTime = (numOutFrames - outputFrame < CONVERT_BLOCK_FRAMES) ? (u32)(numOutFrames - outputFrame) : CONVERT_BLOCK_FRAMES;
+        u32 framesNeeded = Resampler_InputNeeded(&resampler, framesThisTime);
+
+        for (u32 i = 0; i < framesNeeded; i++) {
+            i64 frame = inputFrame + i;
+            bool inside = frame >= 0 && (u64)frame < numInFrames;
+            block[i * 2] = inside ? input[frame * 2] : 0.0f;
+            block[i * 2 + 1] = inside ? input[frame * 2 + 1] : 0.0f;
+        }
+
+        Resampler_Process(&resampler, block, framesNeeded, output + outputFrame * 2, framesThisTime);
+        inputFrame += framesNeeded;
+        outputFrame += framesThisTime;
+    }
+
+    HeapArena_Deinit(&arena);
+}
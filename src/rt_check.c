@@ -0,0 +1,415 @@
+#include <rt_check.h>
+
+#ifndef RTCHECK
+
+void RtCheck_EnterRealtime(void) {}
+void RtCheck_ExitRealtime(void) {}
+void RtCheck_BeginAllow(void) {}
+void RtCheck_EndAllow(void) {}
+bool RtCheck_IsCompiled(void) { return false; }
+u64 RtCheck_GetViolationCount(void) { return 0; }
+u64 RtCheck_GetViolationCountByType(RtViolationType type) { (void)type; return 0; }
+void RtCheck_ResetCounts(void) {}
+void RtCheck_Report(void) {}
+
+#else
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+#if !defined(__APPLE__)
+#include <dlfcn.h>
+#endif
+
+// The sanitizers intercept the same functions, leave those to them
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define RTCHECK_SKIP_ALLOC
+#endif
+#if __has_feature(thread_sanitizer)
+#define RTCHECK_SKIP_PTHREAD
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define RTCHECK_SKIP_ALLOC
+#endif
+#if defined(__SANITIZE_THREAD__)
+#define RTCHECK_SKIP_PTHREAD
+#endif
+
+// Per thread state lives in a pthread key rather than _Thread_local, since lazily
+// allocated thread locals would call straight back into the malloc hook.
+#define STATE_REALTIME (1u << 0)
+#define STATE_REPORTING (1u << 1)
+#define STATE_ALLOW_SHIFT 2
+
+static pthread_key_t stateKey_;
+static atomic_u64 counts_[NUM_RT_VIOLATION_TYPES];
+static atomic_u32 numReports_;
+
+static const char* typeNames_[NUM_RT_VIOLATION_TYPES] = {
+    "allocation",
+    "mutex",
+    "condition variable",
+    "I/O",
+};
+
+__attribute__((constructor)) static void InitRtCheck(void)
+{
+    pthread_key_create(&stateKey_, NULL);
+}
+
+static inline uintptr_t GetState(void)
+{
+    return (uintptr_t)pthread_getspecific(stateKey_);
+}
+
+static inline void SetState(uintptr_t state)
+{
+    pthread_setspecific(stateKey_, (const void*)state);
+}
+
+static void Violation(RtViolationType type, const char* function)
+{
+    uintptr_t state = GetState();
+    if (!(state & STATE_REALTIME) || (state & STATE_REPORTING) || (state >> STATE_ALLOW_SHIFT) > 0) {
+        return;
+    }
+
+    // Anything the report itself calls must not recurse back in here
+    SetState(state | STATE_REPORTING);
+    atomic_fetch_add(&counts_[type], 1);
+
+    if (atomic_fetch_add(&numReports_, 1) < RTCHECK_MAX_REPORTS) {
+        char header[160];
+        int length = snprintf(header, sizeof(header), 
+                              "\x1b[31mRT VIOLATION\x1b[0m -- %s (%s) called on the audio thread\n", 
+                              function, typeNames_[type]);
+        write(STDERR_FILENO, header, (size_t)length);
+
+        void* frames[RTCHECK_MAX_FRAMES];
+        int numFrames = backtrace(frames, RTCHECK_MAX_FRAMES);
+        backtrace_symbols_fd(frames + 2, numFrames - 2, STDERR_FILENO);
+    }
+
+    SetState(state);
+}
+
+void RtCheck_EnterRealtime(void)
+{
+    SetState(GetState() | STATE_REALTIME);
+}
+
+void RtCheck_ExitRealtime(void)
+{
+    SetState(GetState() & ~(uintptr_t)STATE_REALTIME);
+}
+
+void RtCheck_BeginAllow(void)
+{
+    SetState(GetState() + (1u << STATE_ALLOW_SHIFT));
+}
+
+void RtCheck_EndAllow(void)
+{
+    uintptr_t state = GetState();
+    if ((state >> STATE_ALLOW_SHIFT) > 0) {
+        SetState(state - (1u << STATE_ALLOW_SHIFT));
+    }
+}
+
+bool RtCheck_IsCompiled(void)
+{
+    return true;
+}
+
+u64 RtCheck_GetViolationCount(void)
+{
+    u64 total = 0;
+    for (u8 i = 0; i < NUM_RT_VIOLATION_TYPES; i++) {
+        total += atomic_load(&counts_[i]);
+    }
+    return total;
+}
+
+u64 RtCheck_GetViolationCountByType(RtViolationType type)
+{
+    return atomic_load(&counts_[type]);
+}
+
+void RtCheck_ResetCounts(void)
+{
+    for (u8 i = 0; i < NUM_RT_VIOLATION_TYPES; i++) {
+        atomic_store(&counts_[i], 0);
+    }
+    atomic_store(&numReports_, 0);
+}
+
+void RtCheck_Report(void)
+{
+    fprintf(stderr, "Realtime safety violations: %llu\n", (unsigned long long)RtCheck_GetViolationCount());
+    for (u8 i = 0; i < NUM_RT_VIOLATION_TYPES; i++) {
+        fprintf(stderr, "  %-20s %llu\n", typeNames_[i], (unsigned long long)atomic_load(&counts_[i]));
+    }
+}
+
+// ============================================================================
+// Interposers
+//
+// macOS: dyld swaps in RtCheck_<name> for <name> everywhere outside this image, this file
+//        is built as its own dylib so calls made from in here still reach the originals.
+// Elsewhere: the wrappers take the symbol names themselves and forward with RTLD_NEXT.
+// ============================================================================
+
+#if defined(__APPLE__)
+
+#define RT_WRAPPER(name) RtCheck_##name
+#define RT_DECLARE_REAL(name)
+#define RT_REAL(name) name
+#define RT_REAL_ALLOC(name) name
+#define RT_INTERPOSE(name)\
+    __attribute__((used)) static const struct { const void* replacement; const void* original; } __interpose_##name\
+    __attribute__((section("__DATA,__interpose"))) = { (const void*)(unsigned long)&RtCheck_##name, (const void*)(unsigned long)&name }
+
+#else
+
+#define RT_WRAPPER(name) name
+#define RT_DECLARE_REAL(name) static void* real_##name = NULL
+#define RT_REAL(name) ((__typeof__(&name))LookupReal(&real_##name, #name))
+#define RT_REAL_ALLOC(name) __libc_##name
+#define RT_INTERPOSE(name)
+
+// glibc's own entry points, dlsym itself may allocate so can't be used to find these
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static void* LookupReal(void** slot, const char* name)
+{
+    if (*slot == NULL) {
+        *slot = dlsym(RTLD_NEXT, name);
+    }
+    return *slot;
+}
+
+#endif
+
+#ifndef RTCHECK_SKIP_ALLOC
+
+void* RT_WRAPPER(malloc)(size_t size)
+{
+    Violation(RT_VIOLATION_ALLOC, "malloc");
+    return RT_REAL_ALLOC(malloc)(size);
+}
+RT_INTERPOSE(malloc);
+
+void* RT_WRAPPER(calloc)(size_t count, size_t size)
+{
+    Violation(RT_VIOLATION_ALLOC, "calloc");
+    return RT_REAL_ALLOC(calloc)(count, size);
+}
+RT_INTERPOSE(calloc);
+
+void* RT_WRAPPER(realloc)(void* ptr, size_t size)
+{
+    Violation(RT_VIOLATION_ALLOC, "realloc");
+    return RT_REAL_ALLOC(realloc)(ptr, size);
+}
+RT_INTERPOSE(realloc);
+
+void RT_WRAPPER(free)(void* ptr)
+{
+    Violation(RT_VIOLATION_ALLOC, "free");
+    RT_REAL_ALLOC(free)(ptr);
+}
+RT_INTERPOSE(free);
+
+#endif // RTCHECK_SKIP_ALLOC
+
+#ifndef RTCHECK_SKIP_PTHREAD
+
+RT_DECLARE_REAL(pthread_mutex_lock);
+int RT_WRAPPER(pthread_mutex_lock)(pthread_mutex_t* mutex)
+{
+    Violation(RT_VIOLATION_LOCK, "pthread_mutex_lock");
+    return RT_REAL(pthread_mutex_lock)(mutex);
+}
+RT_INTERPOSE(pthread_mutex_lock);
+
+RT_DECLARE_REAL(pthread_cond_wait);
+int RT_WRAPPER(pthread_cond_wait)(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    Violation(RT_VIOLATION_CONDITION, "pthread_cond_wait");
+    return RT_REAL(pthread_cond_wait)(cond, mutex);
+}
+RT_INTERPOSE(pthread_cond_wait);
+
+RT_DECLARE_REAL(pthread_cond_timedwait);
+int RT_WRAPPER(pthread_cond_timedwait)(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* time)
+{
+    Violation(RT_VIOLATION_CONDITION, "pthread_cond_timedwait");
+    return RT_REAL(pthread_cond_timedwait)(cond, mutex, time);
+}
+RT_INTERPOSE(pthread_cond_timedwait);
+
+RT_DECLARE_REAL(pthread_cond_signal);
+int RT_WRAPPER(pthread_cond_signal)(pthread_cond_t* cond)
+{
+    Violation(RT_VIOLATION_CONDITION, "pthread_cond_signal");
+    return RT_REAL(pthread_cond_signal)(cond);
+}
+RT_INTERPOSE(pthread_cond_signal);
+
+RT_DECLARE_REAL(pthread_cond_broadcast);
+int RT_WRAPPER(pthread_cond_broadcast)(pthread_cond_t* cond)
+{
+    Violation(RT_VIOLATION_CONDITION, "pthread_cond_broadcast");
+    return RT_REAL(pthread_cond_broadcast)(cond);
+}
+RT_INTERPOSE(pthread_cond_broadcast);
+
+#endif // RTCHECK_SKIP_PTHREAD
+
+RT_DECLARE_REAL(open);
+int RT_WRAPPER(open)(const char* path, int flags, ...)
+{
+    Violation(RT_VIOLATION_IO, "open");
+    va_list args;
+    va_start(args, flags);
+    int mode = (flags & O_CREAT) ? va_arg(args, int) : 0;
+    va_end(args);
+    return RT_REAL(open)(path, flags, mode);
+}
+RT_INTERPOSE(open);
+
+RT_DECLARE_REAL(read);
+ssize_t RT_WRAPPER(read)(int fd, void* buffer, size_t size)
+{
+    Violation(RT_VIOLATION_IO, "read");
+    return RT_REAL(read)(fd, buffer, size);
+}
+RT_INTERPOSE(read);
+
+RT_DECLARE_REAL(write);
+ssize_t RT_WRAPPER(write)(int fd, const void* buffer, size_t size)
+{
+    Violation(RT_VIOLATION_IO, "write");
+    return RT_REAL(write)(fd, buffer, size);
+}
+RT_INTERPOSE(write);
+
+RT_DECLARE_REAL(pread);
+ssize_t RT_WRAPPER(pread)(int fd, void* buffer, size_t size, off_t offset)
+{
+    Violation(RT_VIOLATION_IO, "pread");
+    return RT_REAL(pread)(fd, buffer, size, offset);
+}
+RT_INTERPOSE(pread);
+
+RT_DECLARE_REAL(pwrite);
+ssize_t RT_WRAPPER(pwrite)(int fd, const void* buffer, size_t size, off_t offset)
+{
+    Violation(RT_VIOLATION_IO, "pwrite");
+    return RT_REAL(pwrite)(fd, buffer, size, offset);
+}
+RT_INTERPOSE(pwrite);
+
+RT_DECLARE_REAL(fopen);
+FILE* RT_WRAPPER(fopen)(const char* path, const char* mode)
+{
+    Violation(RT_VIOLATION_IO, "fopen");
+    return RT_REAL(fopen)(path, mode);
+}
+RT_INTERPOSE(fopen);
+
+RT_DECLARE_REAL(fread);
+size_t RT_WRAPPER(fread)(void* buffer, size_t size, size_t count, FILE* file)
+{
+    Violation(RT_VIOLATION_IO, "fread");
+    return RT_REAL(fread)(buffer, size, count, file);
+}
+RT_INTERPOSE(fread);
+
+RT_DECLARE_REAL(fwrite);
+size_t RT_WRAPPER(fwrite)(const void* buffer, size_t size, size_t count, FILE* file)
+{
+    Violation(RT_VIOLATION_IO, "fwrite");
+    return RT_REAL(fwrite)(buffer, size, count, file);
+}
+RT_INTERPOSE(fwrite);
+
+RT_DECLARE_REAL(fputs);
+int RT_WRAPPER(fputs)(const char* string, FILE* file)
+{
+    Violation(RT_VIOLATION_IO, "fputs");
+    return RT_REAL(fputs)(string, file);
+}
+RT_INTERPOSE(fputs);
+
+RT_DECLARE_REAL(puts);
+int RT_WRAPPER(puts)(const char* string)
+{
+    Violation(RT_VIOLATION_IO, "puts");
+    return RT_REAL(puts)(string);
+}
+RT_INTERPOSE(puts);
+
+RT_DECLARE_REAL(fflush);
+int RT_WRAPPER(fflush)(FILE* file)
+{
+    Violation(RT_VIOLATION_IO, "fflush");
+    return RT_REAL(fflush)(file);
+}
+RT_INTERPOSE(fflush);
+
+RT_DECLARE_REAL(vprintf);
+int RT_WRAPPER(vprintf)(const char* format, va_list args)
+{
+    Violation(RT_VIOLATION_IO, "vprintf");
+    return RT_REAL(vprintf)(format, args);
+}
+RT_INTERPOSE(vprintf);
+
+RT_DECLARE_REAL(vfprintf);
+int RT_WRAPPER(vfprintf)(FILE* file, const char* format, va_list args)
+{
+    Violation(RT_VIOLATION_IO, "vfprintf");
+    return RT_REAL(vfprintf)(file, format, args);
+}
+RT_INTERPOSE(vfprintf);
+
+int RT_WRAPPER(printf)(const char* format, ...)
+{
+    Violation(RT_VIOLATION_IO, "printf");
+    va_list args;
+    va_start(args, format);
+    int result = RT_REAL(vprintf)(format, args);
+    va_end(args);
+    return result;
+}
+RT_INTERPOSE(printf);
+
+int RT_WRAPPER(fprintf)(FILE* file, const char* format, ...)
+{
+    Violation(RT_VIOLATION_IO, "fprintf");
+    va_list args;
+    va_start(args, format);
+    int result = RT_REAL(vfprintf)(file, format, args);
+    va_end(args);
+    return result;
+}
+RT_INTERPOSE(fprintf);
+
+#endif // RTCHECK
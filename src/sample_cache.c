@@ -0,0 +1,330 @@
+#include <sample_cache.h>
+#include <logger.h>
+#include <resampler.h>
+#include <wav_file.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __APPLE__
+#define ModifiedNs(info) ((u64)(info).st_mtimespec.tv_sec * 1000000000ull + (u64)(info).st_mtimespec.tv_nsec)
+#else
+#define ModifiedNs(info) ((u64)(info).st_mtim.tv_sec * 1000000000ull + (u64)(info).st_mtim.tv_nsec)
+#endif
+
+#define DECODE_BLOCK_FRAMES 16384
+
+// FNV-1a, only used to skip string compares on the lookup
+static u64 HashPath(const char* path)
+{
+    u64 hash = 14695981039346656037ull;
+    while (*path) {
+        hash ^= (u8)*path++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Must hold the mutex
+static void FreeEntry(SampleCache* cache, SampleCacheEntry* entry)
+{
+    Assert(entry->refCount == 0, "Freeing sample %s while %d players still use it", entry->path, entry->refCount);
+    cache->usedBytes -= entry->sizeBytes;
+    cache->savedBytes -= entry->numFrames * 2 * sizeof(f32) - entry->sizeBytes;
+    cache->numEntries--;
+    free(entry->data);
+    memset(entry, 0, sizeof(SampleCacheEntry));
+}
+
+// Must hold the mutex, evicts least recently used first until the size fits the budget
+static bool MakeRoom(SampleCache* cache, u64 sizeBytes)
+{
+    while (cache->usedBytes + sizeBytes > cache->budgetBytes) {
+        SampleCacheEntry* oldest = NULL;
+        for (u32 i = 0; i < SAMPLE_CACHE_MAX_ENTRIES; i++) {
+            SampleCacheEntry* entry = &cache->entries[i];
+            if (entry->data != NULL && entry->refCount == 0 && (oldest == NULL || entry->lastUsed < oldest->lastUsed)) {
+                oldest = entry;
+            }
+        }
+        if (oldest == NULL) {
+            return false;
+        }
+
+        LogInfo("Evicting %s from the sample cache (%.1fMB)", oldest->path, (f64)oldest->sizeBytes / (1024.0 * 1024.0));
+        FreeEntry(cache, oldest);
+        cache->numEvictions++;
+    }
+    return true;
+}
+
+// Must hold the mutex
+static SampleCacheEntry* Find(SampleCache* cache, const char* path, u64 pathHash, u32 sampleRate)
+{
+    for (u32 i = 0; i < SAMPLE_CACHE_MAX_ENTRIES; i++) {
+        SampleCacheEntry* entry = &cache->entries[i];
+        if (entry->data != NULL 
+                && !entry->stale
+                && entry->pathHash == pathHash 
+                && entry->sampleRate == sampleRate 
+                && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Must hold the mutex, finds the entry only if it's of the file as it is now on disk
+static SampleCacheEntry* FindCurrent(SampleCache* cache, const char* path, u64 pathHash, u32 sampleRate, u64 modifiedNs)
+{
+    SampleCacheEntry* entry = Find(cache, path, pathHash, sampleRate);
+    if (entry != NULL && entry->modifiedNs != modifiedNs) {
+        // Changed on disk, players already using the old one keep it until they're done
+        entry->stale = true;
+        if (entry->refCount == 0) {
+            FreeEntry(cache, entry);
+        }
+        entry = NULL;
+    }
+    return entry;
+}
+
+// Resamples the whole file at the best quality, this is the one place it's done off the audio
+// path so players of cached samples pay nothing for it. Returns the frames converted.
+static u64 ConvertRate(const WavFile* file, u32 sampleRate, PcmFormat format, u64 numFrames, u8* data)
+{
+    f32* decoded = malloc(file->totalFrames * 2 * sizeof(f32));
+    f32* converted = malloc(numFrames * 2 * sizeof(f32));
+    if (decoded == NULL || converted == NULL) {
+        free(decoded);
+        free(converted);
+        return 0;
+    }
+
+    u64 framesRead = 0;
+    while (framesRead < file->totalFrames) {
+        u64 remainingFrames = file->totalFrames - framesRead;
+        u32 framesThisTime = (remainingFrames < DECODE_BLOCK_FRAMES) ? (u32)remainingFrames : DECODE_BLOCK_FRAMES;
+        framesRead += WavFile_ReadFrames(file, framesRead, framesThisTime, decoded + framesRead * 2);
+    }
+
+    LogInfo("Resampling %llu frames from %d Hz to %d Hz for the sample cache", framesRead, file->sampleRate, sampleRate);
+    Resampler_ConvertAll(RESAMPLER_QUALITY_HIGH, file->sampleRate, sampleRate, decoded, framesRead, converted, numFrames);
+    Pcm_EncodeStereo(format, converted, (u32)numFrames, data);
+
+    free(decoded);
+    free(converted);
+    return numFrames;
+}
+
+// Without the mutex, so one long load never holds up anyone else. Returns the decoded
+// frames, NULL if the file can't be read or is too long to cache.
+static u8* Decode(const char* path, u32 sampleRate, bool compact, PcmFormat* format, u64* numFrames)
+{
+    WavFile file;
+    if (!WavFile_TryOpen(&file, path)) {
+        return NULL;
+    }
+
+    u64 maxFrames = (u64)SAMPLE_CACHE_MAX_SECONDS * file.sampleRate;
+    *format = compact ? Pcm_CompactFormat(file.format) : PCM_FORMAT_F32;
+    u32 bytesPerFrame = 2 * Pcm_BytesPerSample(*format);
+    u64 outputFrames = Resampler_OutputFrames(file.sampleRate, sampleRate, file.totalFrames);
+    u8* data = (outputFrames > 0 && file.totalFrames <= maxFrames) ? malloc(outputFrames * bytesPerFrame) : NULL;
+    f32* block = (data != NULL) ? malloc(DECODE_BLOCK_FRAMES * 2 * sizeof(f32)) : NULL;
+    if (block == NULL) {
+        free(data);
+        WavFile_Close(&file);
+        return NULL;
+    }
+
+    // Through f32 and back, lossless as the compact format is never wider than the source
+    u64 framesDecoded = 0;
+    if (file.sampleRate == sampleRate) {
+        while (framesDecoded < file.totalFrames) {
+            u32 framesRead = WavFile_ReadFrames(&file, framesDecoded, DECODE_BLOCK_FRAMES, block);
+            if (framesRead == 0) {
+                break;
+            }
+            Pcm_EncodeStereo(*format, block, framesRead, data + framesDecoded * bytesPerFrame);
+            framesDecoded += framesRead;
+        }
+    }
+    else {
+        framesDecoded = ConvertRate(&file, sampleRate, *format, outputFrames, data);
+    }
+    free(block);
+    WavFile_Close(&file);
+    if (framesDecoded == 0) {
+        free(data);
+        return NULL;
+    }
+
+    *numFrames = framesDecoded;
+    return data;
+}
+
+// Must hold the mutex, takes the decoded frames on or returns NULL if there's no room
+static SampleCacheEntry* Insert(SampleCache* cache, 
+                                const char* path, 
+                                u64 modifiedNs, 
+                                u32 sampleRate, 
+                                u8* data, 
+                                PcmFormat format, 
+                                u64 numFrames)
+{
+    u64 sizeBytes = numFrames * 2 * Pcm_BytesPerSample(format);
+    if (!MakeRoom(cache, sizeBytes)) {
+        return NULL;
+    }
+
+    SampleCacheEntry* entry = NULL;
+    for (u32 i = 0; i < SAMPLE_CACHE_MAX_ENTRIES && entry == NULL; i++) {
+        entry = (cache->entries[i].data == NULL) ? &cache->entries[i] : NULL;
+    }
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    strncpy(entry->path, path, SAMPLE_CACHE_MAX_PATH - 1);
+    entry->pathHash = HashPath(path);
+    entry->modifiedNs = modifiedNs;
+    entry->sampleRate = sampleRate;
+    entry->data = data;
+    entry->format = format;
+    entry->numFrames = numFrames;
+    entry->sizeBytes = sizeBytes;
+    entry->refCount = 0;
+    entry->stale = false;
+
+    cache->usedBytes += entry->sizeBytes;
+    cache->savedBytes += numFrames * 2 * sizeof(f32) - entry->sizeBytes;
+    cache->numEntries++;
+    return entry;
+}
+
+void SampleCache_Init(SampleCache* cache, u64 budgetBytes, bool compact)
+{
+    Assert(cache, "SampleCache is null");
+
+    memset(cache, 0, sizeof(SampleCache));
+    cache->budgetBytes = budgetBytes;
+    cache->compact = compact;
+    Assert(pthread_mutex_init(&cache->mutex, NULL) == 0, "Failed to create mutex");
+}
+
+void SampleCache_Deinit(SampleCache* cache)
+{
+    Assert(cache, "SampleCache is null");
+
+    for (u32 i = 0; i < SAMPLE_CACHE_MAX_ENTRIES; i++) {
+        SampleCacheEntry* entry = &cache->entries[i];
+        if (entry->data != NULL) {
+            Assert(entry->refCount == 0, "Sample %s still in use on deinit", entry->path);
+            FreeEntry(cache, entry);
+        }
+    }
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+void SampleCache_SetBudget(SampleCache* cache, u64 budgetBytes)
+{
+    Assert(cache, "SampleCache is null");
+
+    pthread_mutex_lock(&cache->mutex);
+    cache->budgetBytes = budgetBytes;
+    if (!MakeRoom(cache, 0)) {
+        LogWarn("Sample cache is over its %.1fMB budget with every sample in use", (f64)budgetBytes / (1024.0 * 1024.0));
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+const SampleCacheEntry* SampleCache_Acquire(SampleCache* cache, const char* path, u32 sampleRate)
+{
+    Assert(cache, "SampleCache is null");
+    Assert(path, "Path is null");
+
+    struct stat info;
+    if (stat(path, &info) != 0 || strlen(path) >= SAMPLE_CACHE_MAX_PATH) {
+        pthread_mutex_lock(&cache->mutex);
+        cache->numRejected++;
+        pthread_mutex_unlock(&cache->mutex);
+        return NULL;
+    }
+
+    u64 pathHash = HashPath(path);
+    u64 modifiedNs = ModifiedNs(info);
+
+    pthread_mutex_lock(&cache->mutex);
+    SampleCacheEntry* entry = FindCurrent(cache, path, pathHash, sampleRate, modifiedNs);
+    if (entry != NULL) {
+        cache->numHits++;
+    }
+    else {
+        cache->numMisses++;
+        pthread_mutex_unlock(&cache->mutex);
+
+        PcmFormat format = PCM_FORMAT_F32;
+        u64 numFrames = 0;
+        u8* data = Decode(path, sampleRate, cache->compact, &format, &numFrames);
+
+        // Someone else may have loaded the same file meanwhile, theirs is kept
+        pthread_mutex_lock(&cache->mutex);
+        entry = FindCurrent(cache, path, pathHash, sampleRate, modifiedNs);
+        if (entry == NULL && data != NULL) {
+            entry = Insert(cache, path, modifiedNs, sampleRate, data, format, numFrames);
+            data = (entry != NULL) ? NULL : data;
+        }
+        free(data);
+        cache->numRejected += (entry == NULL) ? 1 : 0;
+    }
+
+    if (entry != NULL) {
+        entry->refCount++;
+        entry->lastUsed = ++cache->clock;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return entry;
+}
+
+void SampleCache_Release(SampleCache* cache, const SampleCacheEntry* entry)
+{
+    Assert(cache, "SampleCache is null");
+    Assert(entry && entry->refCount > 0, "Releasing a sample that isn't held");
+
+    pthread_mutex_lock(&cache->mutex);
+    SampleCacheEntry* mutableEntry = &cache->entries[entry - cache->entries];
+    mutableEntry->refCount--;
+    if (mutableEntry->stale && mutableEntry->refCount == 0) {
+        FreeEntry(cache, mutableEntry);
+    }
+    else {
+        // Recently played counts as recently used
+        mutableEntry->lastUsed = ++cache->clock;
+        // Anything left over budget because it was in use can go now
+        MakeRoom(cache, 0);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void SampleCache_LogStats(SampleCache* cache)
+{
+    pthread_mutex_lock(&cache->mutex);
+
+    u64 lookups = cache->numHits + cache->numMisses;
+    LogInfo("Sample cache { samples: %d, used: %.1f/%.1fMB, hits: %llu, misses: %llu, hit rate: %.1f%%, "
+            "evictions: %llu, rejected: %llu, saved by compact storage: %.1fMB }",
+            cache->numEntries,
+            (f64)cache->usedBytes / (1024.0 * 1024.0),
+            (f64)cache->budgetBytes / (1024.0 * 1024.0),
+            cache->numHits,
+            cache->numMisses,
+            (lookups > 0) ? 100.0 * (f64)cache->numHits / (f64)lookups : 0.0,
+            cache->numEvictions,
+            cache->numRejected,
+            (f64)cache->savedBytes / (1024.0 * 1024.0));
+
+    pthread_mutex_unlock(&cache->mutex);
+}
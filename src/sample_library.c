@@ -0,0 +1,103 @@
+#include <sample_library.h>
+#include <logger.h>
+#include <trace.h>
+#include <wav_file.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+void SampleLibrary_Init(SampleLibrary* library, const char* name, u32 preloadMs, bool compact)
+{
+    Assert(library, "SampleLibrary is null");
+    Assert(name, "SampleLibrary needs a name");
+    Assert(preloadMs > 0, "SampleLibrary needs something to preload");
+
+    memset(library, 0, sizeof(SampleLibrary));
+    strncpy(library->name, name, SAMPLE_LIBRARY_MAX_NAME - 1);
+    library->preloadMs = preloadMs;
+    library->compact = compact;
+}
+
+void SampleLibrary_Deinit(SampleLibrary* library)
+{
+    Assert(library, "SampleLibrary is null");
+
+    for (u32 i = 0; i < library->numSamples; i++) {
+        free(library->samples[i].head);
+    }
+    free(library->samples);
+    memset(library, 0, sizeof(SampleLibrary));
+}
+
+u32 SampleLibrary_Add(SampleLibrary* library, const char* path)
+{
+    Assert(library, "SampleLibrary is null");
+    Assert(path && strlen(path) < SAMPLE_LIBRARY_MAX_PATH, "Invalid sample path");
+
+    u64 startNs = Trace_NowNs();
+
+    if (library->numSamples == library->capacity) {
+        u32 capacity = (library->capacity == 0) ? INITIAL_CAPACITY : library->capacity * 2;
+        LibrarySample* samples = realloc(library->samples, capacity * sizeof(LibrarySample));
+        Assert(samples, "Failed to grow sample library %s to %d samples", library->name, capacity);
+        library->residentBytes += (capacity - library->capacity) * sizeof(LibrarySample);
+        library->samples = samples;
+        library->capacity = capacity;
+    }
+
+    WavFile file;
+    WavFile_Open(&file, path);
+
+    LibrarySample* sample = &library->samples[library->numSamples];
+    memset(sample, 0, sizeof(LibrarySample));
+    strncpy(sample->path, path, SAMPLE_LIBRARY_MAX_PATH - 1);
+    sample->totalFrames = file.totalFrames;
+    sample->sampleRate = file.sampleRate;
+
+    u64 preloadFrames = ((u64)library->preloadMs * file.sampleRate) / 1000;
+    sample->numHeadFrames = (u32)((preloadFrames < file.totalFrames) ? preloadFrames : file.totalFrames);
+    sample->headFormat = library->compact ? Pcm_CompactFormat(file.format) : PCM_FORMAT_F32;
+    u64 headBytes = (u64)sample->numHeadFrames * 2 * Pcm_BytesPerSample(sample->headFormat);
+    u64 decodedBytes = (u64)sample->numHeadFrames * 2 * sizeof(f32);
+    sample->head = malloc(headBytes);
+    f32* decoded = (sample->headFormat == PCM_FORMAT_F32) ? (f32*)sample->head : malloc(decodedBytes);
+    Assert(sample->head && decoded, "Failed to allocate %llu bytes for the head of %s", decodedBytes, path);
+
+    sample->numHeadFrames = WavFile_ReadFrames(&file, 0, sample->numHeadFrames, decoded);
+    if (decoded != (f32*)sample->head) {
+        Pcm_EncodeStereo(sample->headFormat, decoded, sample->numHeadFrames, sample->head);
+        free(decoded);
+    }
+
+    library->residentBytes += headBytes;
+    library->savedBytes += decodedBytes - headBytes;
+    library->diskBytes += file.dataSize;
+    WavFile_Close(&file);
+
+    library->loadNs += Trace_NowNs() - startNs;
+    return library->numSamples++;
+}
+
+const LibrarySample* SampleLibrary_Get(const SampleLibrary* library, u32 index)
+{
+    Assert(library, "SampleLibrary is null");
+    Assert(index < library->numSamples, "No sample %d in library %s, it has %d", index, library->name, library->numSamples);
+    return &library->samples[index];
+}
+
+void SampleLibrary_LogStats(const SampleLibrary* library)
+{
+    f64 loadMs = (f64)library->loadNs / 1e6;
+    LogInfo("Sample library %s { samples: %d, preload: %dms, resident: %.1fMB of %.1fMB on disk, "
+            "saved by compact storage: %.1fMB, load time: %.1fms, per sample: %.3fms }",
+            library->name,
+            library->numSamples,
+            library->preloadMs,
+            (f64)library->residentBytes / (1024.0 * 1024.0),
+            (f64)library->diskBytes / (1024.0 * 1024.0),
+            (f64)library->savedBytes / (1024.0 * 1024.0),
+            loadMs,
+            (library->numSamples > 0) ? loadMs / library->numSamples : 0.0);
+}
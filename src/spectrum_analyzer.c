@@ -0,0 +1,97 @@
+#include <spectrum_analyzer.h>
+#include <logger.h>
+
+#include <math.h>
+#include <string.h>
+
+static void Publish(SpectrumAnalyzer* analyzer)
+{
+    analyzer->sequences[analyzer->writing] = ++analyzer->numPublished;
+    u8 previous = atomic_exchange(&analyzer->latest, (u8)(analyzer->writing | SPECTRUM_ANALYZER_FRESH));
+    analyzer->writing = previous & ~SPECTRUM_ANALYZER_FRESH;
+}
+
+static void OnFrame(u32 channel, f32* re, f32* im, void* data)
+{
+    SpectrumAnalyzer* analyzer = (SpectrumAnalyzer*)data;
+    Assert(analyzer, "SpectrumAnalyzer is null");
+
+    f32* magnitudes = analyzer->spectra[analyzer->writing] + channel * analyzer->numBins;
+    for (u32 k = 0; k < analyzer->numBins; k++) {
+        magnitudes[k] = sqrtf(re[k] * re[k] + im[k] * im[k]) * analyzer->magnitudeScale;
+    }
+
+    // Right comes last, and with it the whole spectrum
+    if (channel == 1) {
+        Publish(analyzer);
+    }
+}
+
+static void ProcessSpectrumAnalyzer(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    (void)sampleRate;
+
+    SpectrumAnalyzer* analyzer = (SpectrumAnalyzer*)data;
+    Assert(analyzer, "SpectrumAnalyzer is null");
+
+    Stft_Process(&analyzer->stft, buffer, numFrames);
+}
+
+static void DestroySpectrumAnalyzer(void* data)
+{
+    SpectrumAnalyzer* analyzer = (SpectrumAnalyzer*)data;
+    Assert(analyzer, "SpectrumAnalyzer is null");
+
+    LogInfo("Destroying SpectrumAnalyzer { published: %llu }", analyzer->numPublished);
+}
+
+u16 SpectrumAnalyzer_Create(SpectrumAnalyzer* analyzer, CoreEngineContext* ctx, u32 frameFrames, u32 hopFrames)
+{
+    Assert(analyzer, "SpectrumAnalyzer is null");
+    Assert(ctx, "Engine is null");
+
+    Stft_Init(&analyzer->stft, &ctx->heapArena, frameFrames, hopFrames, false, OnFrame, (void*)analyzer);
+    analyzer->numBins = analyzer->stft.numBins;
+
+    // A sine's peak comes out at half the window's sum
+    f64 windowSum = 0.0;
+    for (u32 i = 0; i < frameFrames; i++) {
+        windowSum += analyzer->stft.window[i];
+    }
+    analyzer->magnitudeScale = (f32)(2.0 / windowSum);
+
+    u64 spectrumFloats = (u64)analyzer->numBins * 2;
+    f32* memory = HeapArena_Alloc(&ctx->heapArena, spectrumFloats * 3 * sizeof(f32));
+    memset(memory, 0, spectrumFloats * 3 * sizeof(f32));
+
+    for (u32 i = 0; i < 3; i++) {
+        analyzer->spectra[i] = memory + i * spectrumFloats;
+        analyzer->sequences[i] = 0;
+    }
+    analyzer->writing = 0;
+    atomic_store(&analyzer->latest, 1);
+    analyzer->reading = 2;
+    analyzer->numPublished = 0;
+
+    LogInfo("Creating SpectrumAnalyzer { frame: %u, hop: %u, bins: %u }", frameFrames, hopFrames, analyzer->numBins);
+
+    u16 id = CoreEngine_CreateProcessor(ctx, ProcessSpectrumAnalyzer, DestroySpectrumAnalyzer, NULL, (void*)analyzer);
+    CoreEngine_SetPriority(ctx, id, PROCESSOR_PRIORITY_LOW);
+    return id;
+}
+
+const f32* SpectrumAnalyzer_Read(SpectrumAnalyzer* analyzer, u64* sequence)
+{
+    Assert(analyzer, "SpectrumAnalyzer is null");
+
+    if (atomic_load(&analyzer->latest) & SPECTRUM_ANALYZER_FRESH) {
+        u8 previous = atomic_exchange(&analyzer->latest, analyzer->reading);
+        analyzer->reading = previous & ~SPECTRUM_ANALYZER_FRESH;
+    }
+
+    u64 current = analyzer->sequences[analyzer->reading];
+    if (sequence) {
+        *sequence = current;
+    }
+    return (current > 0) ? analyzer->spectra[analyzer->reading] : NULL;
+}
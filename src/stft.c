@@ -0,0 +1,122 @@
+#include <stft.h>
+#include <logger.h>
+
+#include <math.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+#define STFT_NUM_CHANNELS 2
+
+void Stft_Init(Stft* stft, HeapArena* arena, u32 frameFrames, u32 hopFrames, bool synthesis, StftFrameFunc OnFrame, void* data)
+{
+    Assert(stft, "Stft is null");
+    Assert(arena, "Arena is null");
+    Assert(OnFrame, "Stft needs a frame callback");
+    Assert(frameFrames >= 4 && (frameFrames & (frameFrames - 1)) == 0, "STFT frame of %u is not a power of two", frameFrames);
+    Assert(hopFrames > 0 && hopFrames <= frameFrames, "STFT hop of %u doesn't fit a frame of %u", hopFrames, frameFrames);
+    Assert(!synthesis || (frameFrames / 2) % hopFrames == 0, "STFT hop of %u doesn't overlap a frame of %u evenly", hopFrames, frameFrames);
+
+    stft->frameFrames = frameFrames;
+    stft->hopFrames = hopFrames;
+    stft->numBins = frameFrames / 2 + 1;
+    stft->synthesis = synthesis;
+    stft->OnFrame = OnFrame;
+    stft->data = data;
+    stft->pos = frameFrames - hopFrames;
+    stft->numHops = 0;
+
+    u64 numFloats = frameFrames // window
+                  + frameFrames * STFT_NUM_CHANNELS * 2 // input, overlap
+                  + hopFrames * STFT_NUM_CHANNELS // output
+                  + frameFrames + stft->numBins * 2; // samples, re, im
+    f32* memory = HeapArena_Alloc(arena, numFloats * sizeof(f32));
+    memset(memory, 0, numFloats * sizeof(f32));
+
+    stft->window = memory;
+    stft->input = stft->window + frameFrames;
+    stft->overlap = stft->input + frameFrames * STFT_NUM_CHANNELS;
+    stft->output = stft->overlap + frameFrames * STFT_NUM_CHANNELS;
+    stft->samples = stft->output + hopFrames * STFT_NUM_CHANNELS;
+    stft->re = stft->samples + frameFrames;
+    stft->im = stft->re + stft->numBins;
+
+    // Periodic, so overlapping copies sum flat
+    for (u32 i = 0; i < frameFrames; i++) {
+        f64 hann = 0.5 - 0.5 * cos(2.0 * M_PI * i / frameFrames);
+        stft->window[i] = (f32)(synthesis ? sqrt(hann) : hann);
+    }
+
+    // Hann copies a hop apart add up to frameFrames / (2 * hop), and the inverse comes back
+    // frameFrames / 2 times over
+    stft->outputScale = (f32)(4.0 * hopFrames / ((f64)frameFrames * frameFrames));
+
+    Fft_Init(&stft->fft, arena, frameFrames / 2);
+}
+
+static void TransformFrame(Stft* stft)
+{
+    u32 frameFrames = stft->frameFrames;
+    u32 hopFrames = stft->hopFrames;
+
+    for (u32 c = 0; c < STFT_NUM_CHANNELS; c++) {
+        f32* input = stft->input + c * frameFrames;
+        for (u32 i = 0; i < frameFrames; i++) {
+            stft->samples[i] = input[i] * stft->window[i];
+        }
+        Fft_ForwardReal(&stft->fft, stft->samples, stft->re, stft->im);
+        stft->OnFrame(c, stft->re, stft->im, stft->data);
+
+        if (stft->synthesis) {
+            Fft_InverseReal(&stft->fft, stft->re, stft->im, stft->samples);
+            f32* overlap = stft->overlap + c * frameFrames;
+            for (u32 i = 0; i < frameFrames; i++) {
+                overlap[i] += stft->samples[i] * stft->window[i] * stft->outputScale;
+            }
+
+            // Nothing later reaches back before the next frame's start, so the first hop is done
+            memcpy(stft->output + c * hopFrames, overlap, hopFrames * sizeof(f32));
+            memmove(overlap, overlap + hopFrames, (frameFrames - hopFrames) * sizeof(f32));
+            memset(overlap + frameFrames - hopFrames, 0, hopFrames * sizeof(f32));
+        }
+
+        memmove(input, input + hopFrames, (frameFrames - hopFrames) * sizeof(f32));
+    }
+    stft->numHops++;
+}
+
+void Stft_Process(Stft* stft, f32* buffer, u32 numFrames)
+{
+    Assert(stft, "Stft is null");
+
+    u32 frameFrames = stft->frameFrames;
+    u32 hopFrames = stft->hopFrames;
+    u32 start = frameFrames - hopFrames;
+
+    // Up to the end of the current hop at a time, however the blocks fall
+    u32 done = 0;
+    while (done < numFrames) {
+        u32 chunkFrames = MIN(numFrames - done, frameFrames - stft->pos);
+        f32* io = buffer + done * 2;
+
+        for (u32 c = 0; c < STFT_NUM_CHANNELS; c++) {
+            f32* input = stft->input + c * frameFrames + stft->pos;
+            const f32* output = stft->output + c * hopFrames + (stft->pos - start);
+            for (u32 i = 0; i < chunkFrames; i++) {
+                input[i] = io[i * 2 + c];
+                if (stft->synthesis) {
+                    io[i * 2 + c] = output[i];
+                }
+            }
+        }
+
+        stft->pos += chunkFrames;
+        done += chunkFrames;
+        if (stft->pos == frameFrames) {
+            TransformFrame(stft);
+            stft->pos = start;
+        }
+    }
+}
@@ -0,0 +1,328 @@
+#include <stream_scheduler.h>
+#include <logger.h>
+#include <trace.h>
+
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static i64 DeadlineNs(const StreamSource* source, u64 nowNs)
+{
+    u64 bufferedFrames = atomic_load_explicit(&source->bufferedFrames, memory_order_relaxed);
+    u64 framesPerSecond = atomic_load_explicit(&source->framesPerSecond, memory_order_relaxed);
+    return (i64)nowNs + (i64)((bufferedFrames * 1000000000ull) / framesPerSecond);
+}
+
+// Must hold the mutex
+static StreamSource* PickNext(StreamScheduler* scheduler, u64 nowNs, bool limitDevices)
+{
+    StreamSource* next = NULL;
+    i64 nextDeadline = INT64_MAX;
+
+    for (u32 i = 0; i < scheduler->numSources; i++) {
+        StreamSource* source = scheduler->sources[i];
+        if (source->inFlight || !atomic_load_explicit(&source->pending, memory_order_acquire)) {
+            continue;
+        }
+        if (limitDevices && scheduler->devices[source->device].numInFlight >= scheduler->maxIoPerDevice) {
+            continue;
+        }
+
+        i64 deadline = DeadlineNs(source, nowNs);
+        if (deadline < nextDeadline) {
+            next = source;
+            nextDeadline = deadline;
+        }
+    }
+
+    return next;
+}
+
+// Must hold the mutex
+static void FinishRead(StreamScheduler* scheduler, StreamSource* source, u64 bytesRead)
+{
+    StreamDevice* device = &scheduler->devices[source->device];
+    source->inFlight = false;
+    device->numInFlight--;
+    device->bytesRead += bytesRead;
+    scheduler->bytesRead += bytesRead;
+}
+
+// Must hold the mutex, it's released for the read itself
+static void Dispatch(StreamScheduler* scheduler, StreamSource* source, u64 nowNs)
+{
+    i64 slackNs = DeadlineNs(source, nowNs) - (i64)nowNs;
+    bool late = atomic_load(&source->bufferedFrames) == 0;
+
+    source->inFlight = true;
+    scheduler->devices[source->device].numInFlight++;
+    scheduler->numReads++;
+    scheduler->totalSlackNs += slackNs;
+    scheduler->numLateReads += late ? 1 : 0;
+    if (slackNs < scheduler->minSlackNs) {
+        scheduler->minSlackNs = slackNs;
+    }
+    atomic_store_explicit(&source->pending, false, memory_order_relaxed);
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    TraceBegin("StreamRead");
+    u64 bytesRead = source->Fill(source->data);
+    TraceEnd("StreamRead");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    if (bytesRead != STREAM_FILL_ASYNC) {
+        FinishRead(scheduler, source, bytesRead);
+    }
+}
+
+static void WaitForRequests(StreamScheduler* scheduler)
+{
+    // The audio thread can't signal us, so poll for new requests
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += STREAM_POLL_INTERVAL_MS * 1000000;
+    ts.tv_sec += ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&scheduler->cond, &scheduler->mutex, &ts);
+}
+
+static void* IoWorker(void* data)
+{
+    StreamScheduler* scheduler = (StreamScheduler*)data;
+    Assert(scheduler, "StreamScheduler is null");
+
+    Trace_SetThreadName("Stream I/O");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    while (atomic_load(&scheduler->running)) {
+        StreamSource* next = PickNext(scheduler, Trace_NowNs(), true);
+        if (next != NULL) {
+            Dispatch(scheduler, next, Trace_NowNs());
+            // A device slot just freed up, someone else may have been waiting on it
+            pthread_cond_broadcast(&scheduler->cond);
+            continue;
+        }
+        WaitForRequests(scheduler);
+    }
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    return NULL;
+}
+
+// Queues reads for everything that's due, submits them as one batch, then sleeps in the
+// reap until either something lands or it's time to look for new requests
+static void* AsyncPump(void* data)
+{
+    StreamScheduler* scheduler = (StreamScheduler*)data;
+    Assert(scheduler, "StreamScheduler is null");
+
+    Trace_SetThreadName("Stream I/O");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    while (atomic_load(&scheduler->running)) {
+        StreamSource* next;
+        while ((next = PickNext(scheduler, Trace_NowNs(), true)) != NULL) {
+            Dispatch(scheduler, next, Trace_NowNs());
+        }
+
+        if (scheduler->asyncIo->numInFlight == 0 && scheduler->asyncIo->numQueued == 0) {
+            WaitForRequests(scheduler);
+            continue;
+        }
+
+        pthread_mutex_unlock(&scheduler->mutex);
+        AsyncIo_Flush(scheduler->asyncIo);
+        AsyncIo_Reap(scheduler->asyncIo, STREAM_POLL_INTERVAL_MS);
+        pthread_mutex_lock(&scheduler->mutex);
+    }
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    // Nothing else will complete these once we're gone
+    while (scheduler->asyncIo->numInFlight > 0 || scheduler->asyncIo->numQueued > 0) {
+        AsyncIo_Flush(scheduler->asyncIo);
+        AsyncIo_Reap(scheduler->asyncIo, STREAM_POLL_INTERVAL_MS);
+    }
+
+    return NULL;
+}
+
+void StreamScheduler_Init(StreamScheduler* scheduler, u8 numThreads, u8 maxIoPerDevice)
+{
+    Assert(scheduler, "StreamScheduler is null");
+    Assert(numThreads > 0 && numThreads <= STREAM_NUM_IO_THREADS, "Invalid number of stream I/O threads %d", numThreads);
+    Assert(maxIoPerDevice > 0, "Need at least one read in flight per device");
+
+    memset(scheduler, 0, sizeof(StreamScheduler));
+    scheduler->numThreads = numThreads;
+    scheduler->maxIoPerDevice = maxIoPerDevice;
+    scheduler->minSlackNs = INT64_MAX;
+    scheduler->startNs = Trace_NowNs();
+
+    Assert(pthread_mutex_init(&scheduler->mutex, NULL) == 0, "Failed to create mutex");
+    Assert(pthread_cond_init(&scheduler->cond, NULL) == 0, "Failed to create condition variable");
+}
+
+void StreamScheduler_Deinit(StreamScheduler* scheduler)
+{
+    Assert(scheduler, "StreamScheduler is null");
+    Assert(!atomic_load(&scheduler->running), "StreamScheduler still running on deinit");
+
+    pthread_mutex_destroy(&scheduler->mutex);
+    pthread_cond_destroy(&scheduler->cond);
+    scheduler->numSources = 0;
+}
+
+void StreamScheduler_Start(StreamScheduler* scheduler)
+{
+    Assert(scheduler, "StreamScheduler is null");
+
+    atomic_store(&scheduler->running, true);
+    if (scheduler->asyncIo != NULL) {
+        LogInfo("Starting stream scheduler on %s async I/O", AsyncIo_BackendName(scheduler->asyncIo));
+        Assert(pthread_create(&scheduler->threads[0], NULL, AsyncPump, (void*)scheduler) == 0, "Failed to create thread");
+        return;
+    }
+
+    LogInfo("Starting stream scheduler with %d I/O threads", scheduler->numThreads);
+    for (u8 i = 0; i < scheduler->numThreads; i++) {
+        Assert(pthread_create(&scheduler->threads[i], NULL, IoWorker, (void*)scheduler) == 0, "Failed to create thread");
+    }
+}
+
+void StreamScheduler_AttachAsyncIo(StreamScheduler* scheduler, AsyncIo* asyncIo, u8 maxStreamsPerDevice)
+{
+    Assert(scheduler, "StreamScheduler is null");
+    Assert(asyncIo, "AsyncIo is null");
+    Assert(!atomic_load(&scheduler->running), "Can't attach async I/O to a running stream scheduler");
+    Assert(maxStreamsPerDevice > 0, "Need at least one stream in flight per device");
+
+    scheduler->asyncIo = asyncIo;
+    scheduler->maxIoPerDevice = maxStreamsPerDevice;
+}
+
+void StreamScheduler_Stop(StreamScheduler* scheduler)
+{
+    LogInfo("Stopping stream scheduler");
+    Assert(scheduler, "StreamScheduler is null");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    atomic_store(&scheduler->running, false);
+    pthread_cond_broadcast(&scheduler->cond);
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    u8 numThreads = (scheduler->asyncIo != NULL) ? 1 : scheduler->numThreads;
+    for (u8 i = 0; i < numThreads; i++) {
+        pthread_join(scheduler->threads[i], NULL);
+    }
+}
+
+void StreamScheduler_Register(StreamScheduler* scheduler, StreamSource* source, i32 fd)
+{
+    Assert(scheduler, "StreamScheduler is null");
+    Assert(source && source->Fill, "StreamSource needs a fill function");
+    Assert(source->framesPerSecond > 0, "StreamSource needs a consumption rate");
+
+    struct stat info;
+    Assert(fstat(fd, &info) == 0, "Failed to stat stream file");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    Assert(scheduler->numSources < STREAM_MAX_SOURCES, "Too many streams, max is %d", STREAM_MAX_SOURCES);
+
+    u8 device = 0;
+    while (device < scheduler->numDevices && scheduler->devices[device].id != (u64)info.st_dev) {
+        device++;
+    }
+    if (device == scheduler->numDevices) {
+        Assert(scheduler->numDevices < STREAM_MAX_DEVICES, "Too many devices, max is %d", STREAM_MAX_DEVICES);
+        scheduler->devices[device] = (StreamDevice) { .id = (u64)info.st_dev };
+        scheduler->numDevices++;
+    }
+
+    source->device = device;
+    source->inFlight = false;
+    scheduler->sources[scheduler->numSources++] = source;
+    pthread_mutex_unlock(&scheduler->mutex);
+}
+
+void StreamScheduler_Unregister(StreamScheduler* scheduler, StreamSource* source)
+{
+    Assert(scheduler, "StreamScheduler is null");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    // Let any read in progress finish first
+    while (source->inFlight) {
+        pthread_cond_wait(&scheduler->cond, &scheduler->mutex);
+    }
+    for (u32 i = 0; i < scheduler->numSources; i++) {
+        if (scheduler->sources[i] == source) {
+            scheduler->sources[i] = scheduler->sources[--scheduler->numSources];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&scheduler->mutex);
+}
+
+void StreamScheduler_Complete(StreamScheduler* scheduler, StreamSource* source, u64 bytesRead)
+{
+    Assert(scheduler, "StreamScheduler is null");
+    Assert(source->inFlight, "Completing a stream fill that was never dispatched");
+
+    pthread_mutex_lock(&scheduler->mutex);
+    FinishRead(scheduler, source, bytesRead);
+    // Unregister may be waiting on this
+    pthread_cond_broadcast(&scheduler->cond);
+    pthread_mutex_unlock(&scheduler->mutex);
+}
+
+u32 StreamScheduler_RunOnce(StreamScheduler* scheduler)
+{
+    Assert(scheduler, "StreamScheduler is null");
+
+    u32 numFills = 0;
+    pthread_mutex_lock(&scheduler->mutex);
+    StreamSource* next;
+    while ((next = PickNext(scheduler, Trace_NowNs(), false)) != NULL) {
+        Dispatch(scheduler, next, Trace_NowNs());
+        numFills++;
+    }
+    pthread_cond_broadcast(&scheduler->cond);
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    AsyncIo* asyncIo = scheduler->asyncIo;
+    while (asyncIo != NULL && (asyncIo->numInFlight > 0 || asyncIo->numQueued > 0)) {
+        AsyncIo_Flush(asyncIo);
+        AsyncIo_Reap(asyncIo, STREAM_POLL_INTERVAL_MS);
+    }
+
+    return numFills;
+}
+
+void StreamScheduler_LogStats(StreamScheduler* scheduler)
+{
+    pthread_mutex_lock(&scheduler->mutex);
+
+    f64 seconds = (f64)(Trace_NowNs() - scheduler->startNs) / 1e9;
+    f64 megabytes = (f64)scheduler->bytesRead / (1024.0 * 1024.0);
+    f64 minSlackMs = (scheduler->numReads > 0) ? (f64)scheduler->minSlackNs / 1e6 : 0.0;
+    f64 meanSlackMs = (scheduler->numReads > 0) ? ((f64)scheduler->totalSlackNs / scheduler->numReads) / 1e6 : 0.0;
+
+    LogInfo("Streaming { streams: %d, reads: %llu, read: %.1fMB, throughput: %.2fMB/s, "
+            "min slack: %.2fms, mean slack: %.2fms, late reads: %llu }",
+            scheduler->numSources,
+            scheduler->numReads,
+            megabytes,
+            (seconds > 0.0) ? megabytes / seconds : 0.0,
+            minSlackMs,
+            meanSlackMs,
+            scheduler->numLateReads);
+
+    if (scheduler->numLateReads > 0) {
+        LogWarn("%llu stream reads were issued after the stream had already run dry", scheduler->numLateReads);
+    }
+
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    if (scheduler->asyncIo != NULL) {
+        AsyncIo_LogStats(scheduler->asyncIo);
+    }
+}
@@ -1,29 +1,64 @@
 #include <stdlib.h>
 #include <logger.h>
 #include <thread_pool.h>
+#include <trace.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+static void Wake(ThreadPool* pool, u64 numWakes)
+{
+    for (u64 i = 0; i < numWakes; i++) {
+#if defined(__APPLE__)
+        dispatch_semaphore_signal(pool->wake);
+#else
+        sem_post(&pool->wake);
+#endif
+    }
+}
+
+static void WaitForWake(ThreadPool* pool)
+{
+#if defined(__APPLE__)
+    dispatch_semaphore_wait(pool->wake, DISPATCH_TIME_FOREVER);
+#else
+    while (sem_wait(&pool->wake) != 0) {} // Retry if a signal interrupts it
+#endif
+}
 
 static void* Worker(void* data)
 {
     ThreadPool* pool = (ThreadPool*) data;
     Assert(pool, "ThreadPool is null");
 
-    while (atomic_load(&pool->running) || (atomic_load(&pool->numPendingTasks) > 0)) {
-        pthread_mutex_lock(&pool->mutex);
+    Trace_SetThreadName("ThreadPool Worker");
 
-        while (pool->numPendingTasks == 0 && pool->running) {
-            pthread_cond_wait(&pool->cond, &pool->mutex);
-        }
+    // Each wake drains the queue, so spare wakes only cost an empty pass. Stop clears running
+    // before waking every worker, so all of them see it and exit once the queue is empty.
+    while (true) {
+        WaitForWake(pool);
 
-        if (pool->numPendingTasks == 0 && !pool->running) {
+        while (true) {
+            pthread_mutex_lock(&pool->mutex);
+            if (atomic_load(&pool->numPendingTasks) == 0) {
+                pthread_mutex_unlock(&pool->mutex);
+                break;
+            }
+
+            TaskInfo task = pool->tasks[pool->tail % pool->capacity];
+            pool->tail++;
+            atomic_fetch_sub(&pool->numPendingTasks, 1);
             pthread_mutex_unlock(&pool->mutex);
-            break;
-        }
 
-        TaskInfo task = pool->tasks[pool->numPendingTasks - 1];
-        atomic_fetch_sub(&pool->numPendingTasks, 1);
-        pthread_mutex_unlock(&pool->mutex);
+            TraceBegin(task.name);
+            task.callback(task.data);
+            TraceEnd(task.name);
+        }
 
-        task.callback(task.data);
+        if (!atomic_load(&pool->running)) {
+            break;
+        }
     }
 
     return NULL;
@@ -38,6 +73,9 @@ void ThreadPool_Init(ThreadPool* pool, u8 numThreads, u64 capacity)
     Assert(capacity > 0, "Job queue capacity must be > 0");
     
     pool->numPendingTasks = 0;
+    pool->head = 0;
+    pool->flushedHead = 0;
+    pool->tail = 0;
     pool->numThreads = numThreads;
     pool->tasks = malloc(capacity * sizeof(TaskInfo));
     pool->threads = malloc(numThreads * sizeof(pthread_t));
@@ -45,7 +83,12 @@ void ThreadPool_Init(ThreadPool* pool, u8 numThreads, u64 capacity)
     pool->capacity = capacity;
 
     Assert(pthread_mutex_init(&pool->mutex, NULL) == 0, "Failed to create mutex");
-    Assert(pthread_cond_init(&pool->cond, NULL) == 0, "Failed to create condition variable");
+#if defined(__APPLE__)
+    pool->wake = dispatch_semaphore_create(0);
+    Assert(pool->wake, "Failed to create semaphore");
+#else
+    Assert(sem_init(&pool->wake, 0, 0) == 0, "Failed to create semaphore");
+#endif
 }
 
 void ThreadPool_Deinit(ThreadPool* pool)
@@ -59,7 +102,11 @@ void ThreadPool_Deinit(ThreadPool* pool)
     free(pool->threads);
 
     pthread_mutex_destroy(&pool->mutex);
-    pthread_cond_destroy(&pool->cond);
+#if defined(__APPLE__)
+    dispatch_release(pool->wake);
+#else
+    sem_destroy(&pool->wake);
+#endif
 }
 
 void ThreadPool_Start(ThreadPool* pool)
@@ -77,31 +124,46 @@ void ThreadPool_Stop(ThreadPool* pool)
     Assert(pool, "ThreadPool is null");
 
     atomic_store(&pool->running, false);
-    pthread_cond_broadcast(&pool->cond);
+    Wake(pool, pool->numThreads);
 
     for (u8 i = 0; i < pool->numThreads; i++) {
         pthread_join(pool->threads[i], NULL);
     }
 }
 
-void ThreadPool_DeferTask(ThreadPool* pool, TaskCallback callback, void* data)
+void _ThreadPool_DeferTask(ThreadPool* pool, TaskCallback callback, void* data, const char* name)
+{
+    bool deferred = _ThreadPool_TryDeferTask(pool, callback, data, name);
+    Assert(deferred, "Number of tasks reached capacity");
+}
+
+bool _ThreadPool_TryDeferTask(ThreadPool* pool, TaskCallback callback, void* data, const char* name)
 {
     Assert(pool, "ThreadPool is null");
-    Assert(pool->numPendingTasks < pool->capacity, "Number of tasks reached capacity");
+    if (atomic_load(&pool->numPendingTasks) >= pool->capacity) {
+        return false;
+    }
     
-    // NOTE: not thread safe, intended only to be called by the audio thread
+    // NOTE: not thread safe, intended only to be called by the audio thread. The slot is
+    // filled in before the count that hands it to the workers goes up.
 
-    pool->tasks[pool->numPendingTasks] = (TaskInfo) {
+    pool->tasks[pool->head % pool->capacity] = (TaskInfo) {
         .callback = callback,
         .data = data,
+        .name = name,
     };
+    pool->head++;
     atomic_fetch_add(&pool->numPendingTasks, 1);
+    return true;
 }
 
 void ThreadPool_FlushTasks(ThreadPool* pool)
 {
-    if (atomic_load(&pool->numPendingTasks) > 0) {
-        pthread_cond_broadcast(&pool->cond);
-    }
+    TraceCounter("PendingTasks", atomic_load(&pool->numPendingTasks));
+
+    // A worker drains everything it finds, so more wakes than threads would go to waste
+    u64 numNewTasks = pool->head - pool->flushedHead;
+    pool->flushedHead = pool->head;
+    Wake(pool, MIN(numNewTasks, (u64)pool->numThreads));
 }
 
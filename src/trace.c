@@ -0,0 +1,253 @@
+#include <trace.h>
+#include <logger.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef enum {
+    TRACE_RING_FREE,
+    TRACE_RING_OWNED,
+    TRACE_RING_ORPHANED, // Owning thread exited, events kept until the ring is reclaimed
+} TraceRingState;
+
+static TraceRing rings_[TRACE_MAX_THREADS];
+static atomic_u32 numRingsUsed_ = 0;
+static atomic_u32 nextThreadId_ = 1;
+static _Thread_local TraceRing* threadRing_ = NULL;
+static pthread_key_t ringKey_;
+static pthread_once_t ringKeyOnce_ = PTHREAD_ONCE_INIT;
+
+static _Atomic(bool) enabled_ = true;
+static atomic_u64 lastTriggerNs_ = 0;
+static atomic_u64 dumpPendingNs_ = 0; // When the pending dump was handed out, 0 if none
+static char dumpPath_[256] = TRACE_DEFAULT_DUMP_PATH;
+static pthread_mutex_t dumpMutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* phases_[] = {
+    "B", // TRACE_BEGIN
+    "E", // TRACE_END
+    "C", // TRACE_COUNTER
+    "i", // TRACE_INSTANT
+};
+
+static void ReleaseRing(void* data)
+{
+    TraceRing* ring = (TraceRing*)data;
+    atomic_store(&ring->state, TRACE_RING_ORPHANED);
+}
+
+static void CreateRingKey(void)
+{
+    pthread_key_create(&ringKey_, ReleaseRing);
+}
+
+static TraceRing* AcquireRing(void)
+{
+    if (threadRing_) {
+        return threadRing_;
+    }
+
+    pthread_once(&ringKeyOnce_, CreateRingKey);
+
+    // Prefer never used rings so exited threads' history survives as long as possible
+    for (u8 pass = 0; pass < 2 && threadRing_ == NULL; pass++) {
+        for (u32 i = 0; i < TRACE_MAX_THREADS; i++) {
+            u8 expected = (pass == 0) ? TRACE_RING_FREE : TRACE_RING_ORPHANED;
+            if (atomic_compare_exchange_strong(&rings_[i].state, &expected, TRACE_RING_OWNED)) {
+                TraceRing* ring = &rings_[i];
+                ring->startIndex = atomic_load(&ring->head);
+                ring->threadId = atomic_fetch_add(&nextThreadId_, 1);
+                snprintf(ring->threadName, sizeof(ring->threadName), "Thread %u", ring->threadId);
+                pthread_setspecific(ringKey_, ring);
+                threadRing_ = ring;
+
+                u32 used = atomic_load(&numRingsUsed_);
+                while (i + 1 > used && !atomic_compare_exchange_weak(&numRingsUsed_, &used, i + 1));
+                break;
+            }
+        }
+    }
+
+    return threadRing_;
+}
+
+u64 Trace_NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+void _TraceEvent(TraceEventType type, const char* name, i64 value)
+{
+    if (!atomic_load_explicit(&enabled_, memory_order_relaxed)) {
+        return;
+    }
+
+    TraceRing* ring = AcquireRing();
+    if (ring == NULL) {
+        return;
+    }
+
+    u64 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent* event = &ring->events[head & (TRACE_RING_CAPACITY - 1)];
+    event->name = name;
+    event->timestampNs = Trace_NowNs();
+    event->value = value;
+    event->type = (u8)type;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void Trace_SetEnabled(bool enabled)
+{
+    atomic_store(&enabled_, enabled);
+}
+
+bool Trace_IsEnabled(void)
+{
+    return atomic_load(&enabled_);
+}
+
+void Trace_SetThreadName(const char* name)
+{
+    TraceRing* ring = AcquireRing();
+    if (ring) {
+        snprintf(ring->threadName, sizeof(ring->threadName), "%s", name);
+    }
+}
+
+void Trace_SetDumpPath(const char* path)
+{
+    pthread_mutex_lock(&dumpMutex_);
+    snprintf(dumpPath_, sizeof(dumpPath_), "%s", path);
+    pthread_mutex_unlock(&dumpMutex_);
+}
+
+bool Trace_Trigger(const char* reason)
+{
+    _TraceEvent(TRACE_INSTANT, reason, -1);
+
+    // Rate limit so a burst of misses results in one dump with the lead up to the first
+    u64 now = Trace_NowNs();
+    u64 last = atomic_load_explicit(&lastTriggerNs_, memory_order_relaxed);
+    if (last != 0 && now - last < (u64)TRACE_DUMP_COOLDOWN_MS * 1000000ull) {
+        return false;
+    }
+
+    // One dump at a time, unless the last one handed out has sat so long it never ran
+    u64 pending = atomic_load(&dumpPendingNs_);
+    if (pending != 0 && now - pending < (u64)TRACE_DUMP_STALE_MS * 1000000ull) {
+        return false;
+    }
+    if (!atomic_compare_exchange_strong(&dumpPendingNs_, &pending, now)) {
+        return false;
+    }
+
+    atomic_store_explicit(&lastTriggerNs_, now, memory_order_relaxed);
+    return true;
+}
+
+void Trace_CancelDump(void)
+{
+    // Nothing was dumped, so nothing to cool down from either
+    atomic_store_explicit(&lastTriggerNs_, 0, memory_order_relaxed);
+    atomic_store(&dumpPendingNs_, 0);
+}
+
+static u64 WriteRing(FILE* file, TraceRing* ring, TraceEvent* scratch, bool* first)
+{
+    // Copy out the newest window, then discard anything the owner may have overwritten meanwhile
+    u64 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    u64 begin = (head > TRACE_RING_CAPACITY) ? head - TRACE_RING_CAPACITY : 0;
+    begin = (begin > ring->startIndex) ? begin : ring->startIndex;
+
+    for (u64 i = begin; i < head; i++) {
+        scratch[i - begin] = ring->events[i & (TRACE_RING_CAPACITY - 1)];
+    }
+
+    u64 newHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+    u64 valid = (newHead > TRACE_RING_CAPACITY) ? newHead - TRACE_RING_CAPACITY : 0;
+    u64 skip = (valid > begin) ? valid - begin : 0;
+
+    fprintf(file, "%s\n    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+            *first ? "" : ",", ring->threadId, ring->threadName);
+    *first = false;
+
+    // Drop unmatched ends at the start of the window so viewers don't misnest spans
+    i32 depth = 0;
+    u64 numWritten = 0;
+
+    for (u64 i = begin + skip; i < head; i++) {
+        TraceEvent* event = &scratch[i - begin];
+
+        if (event->type == TRACE_END && depth == 0) {
+            continue;
+        }
+        depth += (event->type == TRACE_BEGIN) ? 1 : (event->type == TRACE_END) ? -1 : 0;
+
+        fprintf(file, ",\n    {\"name\": \"%s\", \"ph\": \"%s\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u",
+                event->name, phases_[event->type], (f64)event->timestampNs / 1000.0, ring->threadId);
+
+        if (event->type == TRACE_COUNTER) {
+            fprintf(file, ", \"args\": {\"value\": %lld}", (long long)event->value);
+        }
+        else if (event->type == TRACE_INSTANT) {
+            fprintf(file, ", \"s\": \"g\"");
+        }
+        else if (event->value >= 0) {
+            fprintf(file, ", \"args\": {\"id\": %lld}", (long long)event->value);
+        }
+
+        fprintf(file, "}");
+        numWritten++;
+    }
+
+    return numWritten;
+}
+
+bool Trace_Dump(const char* path)
+{
+    pthread_mutex_lock(&dumpMutex_);
+
+    if (path == NULL) {
+        path = dumpPath_;
+    }
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        LogError("Failed to open %s for trace dump", path);
+        pthread_mutex_unlock(&dumpMutex_);
+        return false;
+    }
+
+    TraceEvent* scratch = malloc(sizeof(TraceEvent) * TRACE_RING_CAPACITY);
+    Assert(scratch, "Failed to allocate trace dump scratch space");
+
+    fprintf(file, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [");
+
+    bool first = true;
+    u64 numEvents = 0;
+    u32 numRings = atomic_load(&numRingsUsed_);
+    for (u32 i = 0; i < numRings; i++) {
+        if (atomic_load(&rings_[i].state) != TRACE_RING_FREE) {
+            numEvents += WriteRing(file, &rings_[i], scratch, &first);
+        }
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    free(scratch);
+
+    LogInfo("Wrote %llu trace events to %s", numEvents, path);
+    pthread_mutex_unlock(&dumpMutex_);
+    return true;
+}
+
+void Trace_DumpTask(void* data)
+{
+    (void)data;
+    Trace_Dump(NULL);
+    atomic_store(&dumpPendingNs_, 0);
+}
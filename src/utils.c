@@ -53,3 +53,13 @@ f32 Clamp(f32 value, f32 min, f32 max)
     return value;
 }
 
+f64 BesselI0(f64 x)
+{
+    f64 sum = 1.0;
+    f64 term = 1.0;
+    for (u32 k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
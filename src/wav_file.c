@@ -0,0 +1,231 @@
+#include <wav_file.h>
+#include <logger.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// KSDATAFORMAT_SUBTYPE_* GUIDs only differ in the leading format tag
+static const u8 extensibleGuidTail_[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static u64 pageSize_ = 0;
+
+static inline u16 ReadU16(const u8* src)
+{
+    return (u16)src[0] | ((u16)src[1] << 8);
+}
+
+static inline u32 ReadU32(const u8* src)
+{
+    return (u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static inline u64 ReadU64(const u8* src)
+{
+    return (u64)ReadU32(src) | ((u64)ReadU32(src + 4) << 32);
+}
+
+// Returns PCM_FORMAT_COUNT for anything that can't be read
+static PcmFormat ParseFormat(const u8* fmt, u32 fmtSize, const char* path)
+{
+    if (fmtSize < 16) {
+        LogWarn("fmt chunk too small in %s", path);
+        return PCM_FORMAT_COUNT;
+    }
+
+    u16 formatTag = ReadU16(fmt);
+    u16 bitsPerSample = ReadU16(fmt + 14);
+
+    if (formatTag == WAV_FORMAT_TAG_EXTENSIBLE) {
+        const u8* subFormat = fmt + 24;
+        if (fmtSize < 40 || memcmp(subFormat + 2, extensibleGuidTail_, sizeof(extensibleGuidTail_)) != 0) {
+            LogWarn("Unknown extensible sub format in %s", path);
+            return PCM_FORMAT_COUNT;
+        }
+        formatTag = ReadU16(subFormat);
+    }
+
+    if (formatTag == WAV_FORMAT_TAG_FLOAT && bitsPerSample == 32) {
+        return PCM_FORMAT_F32;
+    }
+    if (formatTag == WAV_FORMAT_TAG_PCM) {
+        switch (bitsPerSample) {
+            case 16: return PCM_FORMAT_S16;
+            case 24: return PCM_FORMAT_S24;
+            case 32: return PCM_FORMAT_S32;
+            default: break;
+        }
+    }
+    LogWarn("Unsupported WAV format tag 0x%x at %d bits in %s", formatTag, bitsPerSample, path);
+    return PCM_FORMAT_COUNT;
+}
+
+// Leaves the file closed for a failed TryOpen
+static bool Reject(WavFile* file)
+{
+    WavFile_Close(file);
+    return false;
+}
+
+void WavFile_Open(WavFile* file, const char* path)
+{
+    bool opened = WavFile_TryOpen(file, path);
+    Assert(opened, "Failed to open %s as a WAV file", path);
+}
+
+bool WavFile_TryOpen(WavFile* file, const char* path)
+{
+    Assert(file != NULL, "WavFile is NULL");
+    memset(file, 0, sizeof(WavFile));
+
+    if (pageSize_ == 0) {
+        pageSize_ = (u64)sysconf(_SC_PAGESIZE);
+    }
+
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        LogWarn("Failed to open %s", path);
+        return Reject(file);
+    }
+
+    struct stat info;
+    if (fstat(file->fd, &info) != 0 || info.st_size < 12) {
+        LogWarn("%s is too small to be a WAV file", path);
+        return Reject(file);
+    }
+
+    file->mapSize = (u64)info.st_size;
+    void* map = mmap(NULL, file->mapSize, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (map == MAP_FAILED) {
+        LogWarn("Failed to map %s", path);
+        return Reject(file);
+    }
+    file->map = (const u8*)map;
+
+    // Playback mostly walks forwards, let the kernel read ahead aggressively
+    madvise(map, file->mapSize, MADV_SEQUENTIAL);
+
+    const u8* riff = file->map;
+    bool rf64 = memcmp(riff, "RF64", 4) == 0;
+    if ((!rf64 && memcmp(riff, "RIFF", 4) != 0) || memcmp(riff + 8, "WAVE", 4) != 0) {
+        LogWarn("%s is not a RIFF/WAVE file", path);
+        return Reject(file);
+    }
+
+    const u8* fmt = NULL;
+    u32 fmtSize = 0;
+    u64 offset = 12;
+    u64 ds64DataSize = 0; // RF64 data chunks past 4 GB give their real size here
+
+    // Chunk sizes are untrusted, clamp everything to the end of the file
+    while (offset + 8 <= file->mapSize) {
+        const u8* chunk = file->map + offset;
+        u64 chunkSize = ReadU32(chunk + 4);
+        u64 available = file->mapSize - offset - 8;
+
+        if (rf64 && memcmp(chunk, "ds64", 4) == 0 && chunkSize >= 16 && available >= 16) {
+            ds64DataSize = ReadU64(chunk + 16);
+        }
+        else if (memcmp(chunk, "fmt ", 4) == 0) {
+            fmt = chunk + 8;
+            fmtSize = (u32)((chunkSize < available) ? chunkSize : available);
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (rf64 && chunkSize == 0xFFFFFFFF) {
+                chunkSize = ds64DataSize;
+            }
+            file->data = chunk + 8;
+            file->dataOffset = (u64)(file->data - file->map);
+            file->dataSize = (chunkSize < available) ? chunkSize : available;
+            if (fmt != NULL) {
+                break;
+            }
+        }
+
+        // Chunks are word aligned
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (fmt == NULL || file->data == NULL) {
+        LogWarn("No %s chunk in %s", (fmt == NULL) ? "fmt" : "data", path);
+        return Reject(file);
+    }
+
+    file->format = ParseFormat(fmt, fmtSize, path);
+    if (file->format == PCM_FORMAT_COUNT) {
+        return Reject(file);
+    }
+    file->numChannels = ReadU16(fmt + 2);
+    file->sampleRate = ReadU32(fmt + 4);
+    file->bytesPerFrame = Pcm_BytesPerSample(file->format) * file->numChannels;
+    if (file->numChannels == 0 || ReadU16(fmt + 12) != file->bytesPerFrame) {
+        LogWarn("Unexpected %u channels with block alignment %u in %s", file->numChannels, ReadU16(fmt + 12), path);
+        return Reject(file);
+    }
+
+    file->totalFrames = file->dataSize / file->bytesPerFrame;
+
+    LogInfo("Opened %s { format: %s, channels: %d, sample rate: %d, frames: %llu }", 
+            path, Pcm_FormatName(file->format), file->numChannels, file->sampleRate, file->totalFrames);
+    return true;
+}
+
+void WavFile_Close(WavFile* file)
+{
+    Assert(file != NULL, "WavFile is NULL");
+    if (file->map != NULL) {
+        munmap((void*)file->map, file->mapSize);
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    memset(file, 0, sizeof(WavFile));
+    file->fd = -1;
+}
+
+u32 WavFile_ReadFrames(const WavFile* file, u64 startFrame, u32 numFrames, f32* dst)
+{
+    if (startFrame >= file->totalFrames) {
+        return 0;
+    }
+
+    u64 remaining = file->totalFrames - startFrame;
+    u32 framesToRead = (remaining < numFrames) ? (u32)remaining : numFrames;
+    const u8* src = file->data + startFrame * file->bytesPerFrame;
+    Pcm_DecodeStereo(file->format, src, file->numChannels, framesToRead, dst);
+
+    return framesToRead;
+}
+
+bool WavFile_CanMap(const WavFile* file, u32 sampleRate)
+{
+    return file->format == PCM_FORMAT_F32 
+        && file->numChannels == 2 
+        && file->sampleRate == sampleRate
+        && ((uintptr_t)file->data % sizeof(f32)) == 0;
+}
+
+const f32* WavFile_MapFrames(const WavFile* file, u64 frame)
+{
+    return (const f32*)(file->data + frame * file->bytesPerFrame);
+}
+
+void WavFile_Prefetch(const WavFile* file, u64 startFrame, u64 numFrames)
+{
+    if (startFrame >= file->totalFrames) {
+        return;
+    }
+
+    u64 remaining = file->totalFrames - startFrame;
+    numFrames = (remaining < numFrames) ? remaining : numFrames;
+
+    uintptr_t begin = (uintptr_t)(file->data + startFrame * file->bytesPerFrame);
+    uintptr_t end = begin + numFrames * file->bytesPerFrame;
+    begin &= ~(uintptr_t)(pageSize_ - 1);
+
+    madvise((void*)begin, end - begin, MADV_WILLNEED);
+}
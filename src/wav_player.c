@@ -1,93 +1,1136 @@
 #include "logger.h"
-#include <AudioToolbox/AudioToolbox.h>
-#include <CoreAudioTypes/CoreAudioBaseTypes.h>
-#include <CoreServices/CoreServices.h>
-#include <MacTypes.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdatomic.h>
 #include <string.h>
+#include <trace.h>
+#include <unistd.h>
 #include <wav_player.h>
 
 static u32 numWavPlayers_ = 0;
 
-static void LoadNextChunk(void* data)
+#define REQUEST_FRAME_BITS 48
+#define REQUEST_REVERSE (1ull << (REQUEST_FRAME_BITS - 1))
+#define REQUEST_FRAME_MASK (REQUEST_REVERSE - 1)
+
+static inline u64 PackRequest(u16 generation, u64 frame, bool reverse)
+{
+    return ((u64)generation << REQUEST_FRAME_BITS) | (reverse ? REQUEST_REVERSE : 0) | (frame & REQUEST_FRAME_MASK);
+}
+
+typedef struct {
+    bool active;
+    u64 start;
+    u64 end;
+    u32 crossfade;
+} WavLoop;
+
+// Each thread takes its own copy, a loop changed part way through is caught at the next wrap
+static void LoadLoop(WavPlayer* player, WavLoop* loop)
+{
+    loop->active = (atomic_load(&player->flags) & WAVPLAYER_LOOPING) != 0;
+    loop->start = atomic_load(&player->loopStart);
+    loop->end = atomic_load(&player->loopEnd);
+    loop->crossfade = atomic_load(&player->loopCrossfade);
+}
+
+static inline bool WrapsAt(const WavPlayer* player, const WavLoop* loop, u64 frame)
+{
+    return loop->active && (frame == loop->end || frame >= player->totalFrames);
+}
+
+// The crossfade already played the start of the loop, so a wrap lands just after it
+static inline u64 WrapTarget(const WavLoop* loop)
+{
+    return loop->start + loop->crossfade;
+}
+
+// How much can be played from frame before the loop or the file ends
+static u64 FramesUntilEnd(const WavPlayer* player, const WavLoop* loop, u64 frame)
+{
+    u64 end = (loop->active && frame < loop->end) ? loop->end : player->totalFrames;
+    return (frame < end) ? end - frame : 0;
+}
+
+// Played backwards a loop runs down to the frame a forward wrap lands on, then back up to
+// the end. Backwards positions are exclusive, the next frame played is the one before.
+static inline bool WrapsBackAt(const WavLoop* loop, u64 frame)
+{
+    return loop->active && frame == WrapTarget(loop);
+}
+
+static u64 FramesUntilStart(const WavLoop* loop, u64 frame)
+{
+    u64 start = (loop->active && frame > WrapTarget(loop)) ? WrapTarget(loop) : 0;
+    return frame - start;
+}
+
+// What InitResample takes from the arena
+static u64 ResampleArenaBytes(const WavPlayer* player)
+{
+    u32 rate = player->file.sampleRate;
+    u64 inputBytes = (u64)Resampler_Capacity(rate, SAMPLE_RATE_DEFAULT, player->resampleQuality, AUDIO_FILE_CHUNK_SIZE) * 2 * sizeof(f32);
+    return Resampler_ArenaBytes(rate, SAMPLE_RATE_DEFAULT, player->resampleQuality, AUDIO_FILE_CHUNK_SIZE) + AlignUp(inputBytes, ARENA_ALIGNMENT);
+}
+
+static void InitResample(WavResample* resample, const WavPlayer* player, HeapArena* arena)
+{
+    Resampler_Init(&resample->resampler, arena, player->file.sampleRate, SAMPLE_RATE_DEFAULT, player->resampleQuality, AUDIO_FILE_CHUNK_SIZE);
+    resample->input = HeapArena_Alloc(arena, resample->resampler.capacity * 2 * sizeof(f32));
+    resample->nextFrame = UINT64_MAX;
+    resample->fileFrame = 0;
+}
+
+// File frame under an engine rate frame, for paging in ahead of a read
+static inline u64 FileFrame(const WavPlayer* player, u64 frame)
+{
+    return player->resampling ? (frame * player->file.sampleRate) / SAMPLE_RATE_DEFAULT : frame;
+}
+
+// Up to numFrames from frame on at the engine rate into interleaved stereo f32, returns
+// the frames read. A read that doesn't follow on from the last primes the resampler afresh.
+static u32 ReadFrames(const WavPlayer* player, WavResample* resample, u64 frame, u32 numFrames, f32* dst)
+{
+    if (!player->resampling) {
+        return WavFile_ReadFrames(&player->file, frame, numFrames, dst);
+    }
+    if (frame >= player->totalFrames) {
+        return 0;
+    }
+    numFrames = (player->totalFrames - frame < numFrames) ? (u32)(player->totalFrames - frame) : numFrames;
+
+    Resampler* resampler = &resample->resampler;
+    if (frame != resample->nextFrame) {
+        u64 position = frame * player->file.sampleRate;
+        Resampler_Reset(resampler, (f64)(position % SAMPLE_RATE_DEFAULT) / SAMPLE_RATE_DEFAULT);
+        resample->fileFrame = (i64)(position / SAMPLE_RATE_DEFAULT) - RESAMPLER_LATENCY(resampler->numTaps);
+    }
+
+    // Zeros either side of the file
+    u32 framesNeeded = Resampler_InputNeeded(resampler, numFrames);
+    u32 leadingFrames = (resample->fileFrame < 0) ? (u32)-resample->fileFrame : 0;
+    leadingFrames = (leadingFrames < framesNeeded) ? leadingFrames : framesNeeded;
+    memset(resample->input, 0, leadingFrames * 2 * sizeof(f32));
+    u32 framesRead = WavFile_ReadFrames(&player->file, 
+                                        (u64)(resample->fileFrame + leadingFrames), 
+                                        framesNeeded - leadingFrames, 
+                                        resample->input + leadingFrames * 2);
+    u32 trailingFrames = framesNeeded - leadingFrames - framesRead;
+    memset(resample->input + (leadingFrames + framesRead) * 2, 0, trailingFrames * 2 * sizeof(f32));
+
+    Resampler_Process(resampler, resample->input, framesNeeded, dst, numFrames);
+    resample->fileFrame += framesNeeded;
+    resample->nextFrame = frame + numFrames;
+    return numFrames;
+}
+
+static void RecordLoad(WavPlayer* player)
+{
+    u64 loadNs = Trace_NowNs() - player->stream.requestNs;
+    atomic_store(&player->lastLoadNs, loadNs);
+    if (loadNs > atomic_load(&player->maxLoadNs)) {
+        atomic_store(&player->maxLoadNs, loadNs);
+    }
+    atomic_fetch_add(&player->numLoads, 1);
+}
+
+// Picks up a new request from the audio thread, returns its generation
+static u16 TakeRequest(WavStream* stream)
+{
+    u64 request = atomic_load_explicit(&stream->request, memory_order_acquire);
+    u16 generation = (u16)(request >> REQUEST_FRAME_BITS);
+    if (generation != stream->loaderGeneration) {
+        stream->loaderGeneration = generation;
+        stream->loaderFrame = request & REQUEST_FRAME_MASK;
+        stream->loaderReverse = (request & REQUEST_REVERSE) != 0;
+        stream->endQueued = false;
+    }
+    return generation;
+}
+
+// The chunk after the last one the loader read, in whichever direction it's reading, 0 frames
+// at the end of the file. Chunks never cross the loop ends, so the ring carries straight on
+// after a wrap.
+static u32 NextChunk(WavPlayer* player, const WavLoop* loop, u64* startFrame)
+{
+    WavStream* stream = &player->stream;
+    u64 numFrames;
+
+    if (stream->loaderReverse) {
+        if (WrapsBackAt(loop, stream->loaderFrame)) {
+            stream->loaderFrame = loop->end;
+        }
+        numFrames = FramesUntilStart(loop, stream->loaderFrame);
+        numFrames = (numFrames < AUDIO_FILE_CHUNK_SIZE) ? numFrames : AUDIO_FILE_CHUNK_SIZE;
+        stream->loaderFrame -= numFrames;
+        *startFrame = stream->loaderFrame;
+    }
+    else {
+        if (WrapsAt(player, loop, stream->loaderFrame)) {
+            stream->loaderFrame = WrapTarget(loop);
+        }
+        numFrames = FramesUntilEnd(player, loop, stream->loaderFrame);
+        numFrames = (numFrames < AUDIO_FILE_CHUNK_SIZE) ? numFrames : AUDIO_FILE_CHUNK_SIZE;
+        *startFrame = stream->loaderFrame;
+        stream->loaderFrame += numFrames;
+    }
+    return (u32)numFrames;
+}
+
+static u64 FillStream(void* data)
 {
     WavPlayer* player = (WavPlayer*)data;
     Assert(player != NULL, "WavPlayer is NULL");
+    WavStream* stream = &player->stream;
 
-    OSStatus status;
-    u32 framesToRead = AUDIO_FILE_CHUNK_SIZE;
-    u8 bufferToLoad = (atomic_load(&player->currentBufferIndex) == 0) ? 1 : 0;
+    u16 generation = TakeRequest(stream);
 
-    if (player->flags & WAVPLAYER_SEEK) {
-        status = ExtAudioFileSeek(player->audioFile, atomic_load(&player->seekPosition));
-        Assert(status == noErr, "Failed to reset wav file cursor to start for id %d", player->id);
-        atomic_fetch_and(&player->flags, ~WAVPLAYER_SEEK);
-        atomic_store(&player->currentFrame, atomic_load(&player->seekPosition));
+    // All the free slots are filled from one contiguous range, so page it in as one read
+    u64 writeIndex = atomic_load_explicit(&stream->writeIndex, memory_order_relaxed);
+    u64 freeSlots = stream->numSlots - (writeIndex - atomic_load_explicit(&stream->readIndex, memory_order_acquire));
+    u64 prefetchFrames = freeSlots * AUDIO_FILE_CHUNK_SIZE;
+    u64 prefetchStart = stream->loaderFrame;
+    if (stream->loaderReverse) {
+        prefetchFrames = (prefetchFrames < stream->loaderFrame) ? prefetchFrames : stream->loaderFrame;
+        prefetchStart -= prefetchFrames;
     }
+    WavFile_Prefetch(&player->file, FileFrame(player, prefetchStart), FileFrame(player, prefetchFrames));
+    u64 framesRead = 0;
 
-    status = ExtAudioFileRead(player->audioFile, &framesToRead, player->coreAudioBuffers[bufferToLoad]);
-    Assert(status == noErr, "Failed to load chunk from audio file for WavPlayer %d", player->id);
+    WavLoop loop;
+    LoadLoop(player, &loop);
 
-    atomic_store(&player->currentNumFrames[bufferToLoad], framesToRead);
+    while (!stream->endQueued) {
+        u64 readIndex = atomic_load_explicit(&stream->readIndex, memory_order_acquire);
+        if (writeIndex - readIndex >= stream->numSlots) {
+            break;
+        }
 
-    if ((framesToRead == 0) && ((player->flags & WAVPLAYER_LOOPING) == 0))  {
-        atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+        WavStreamSlot* slot = &stream->slots[writeIndex % stream->numSlots];
+        u32 framesToRead = NextChunk(player, &loop, &slot->startFrame);
+        slot->numFrames = ReadFrames(player, &stream->resample, slot->startFrame, framesToRead, slot->frames);
+        slot->generation = generation;
+        stream->endQueued = (slot->numFrames == 0);
+        framesRead += slot->numFrames;
+
+        writeIndex++;
+        atomic_store_explicit(&stream->writeIndex, writeIndex, memory_order_release);
+
+        // Don't keep filling for a position that's already been seeked away from
+        if ((u16)(atomic_load(&stream->request) >> REQUEST_FRAME_BITS) != generation) {
+            break;
+        }
     }
+
+    stream->submitIndex = writeIndex;
+    RecordLoad(player);
+
+    return framesRead * player->file.bytesPerFrame;
 }
 
-static void ProcessWavPlayer(f64 sampleRate, u16 numOutputFrames, f32* buffer, void* data)
+// Publish completed slots to the audio thread, in order
+static void PublishReadySlots(WavStream* stream)
 {
-    LogTrace("Process wav");
-    (void)sampleRate;
+    u64 writeIndex = atomic_load_explicit(&stream->writeIndex, memory_order_relaxed);
+    while (writeIndex < stream->submitIndex) {
+        WavStreamSlot* slot = &stream->slots[writeIndex % stream->numSlots];
+        if (!slot->ready) {
+            break;
+        }
+        slot->ready = false;
+        writeIndex++;
+    }
+    atomic_store_explicit(&stream->writeIndex, writeIndex, memory_order_release);
+}
+
+static void OnStreamRead(AsyncIoRequest* request)
+{
+    WavPlayer* player = (WavPlayer*)request->data;
+    Assert(player != NULL, "WavPlayer is NULL");
+    WavStream* stream = &player->stream;
+    WavStreamSlot* slot = &stream->slots[request - stream->reads];
+
+    // Anything short of what was asked for is a failed read, play silence rather than stop
+    u16 bytesPerFrame = player->file.bytesPerFrame;
+    i64 bytesAvailable = request->result - (i64)slot->readSkip;
+    u32 framesRead = (bytesAvailable > 0) ? (u32)(bytesAvailable / bytesPerFrame) : 0;
+    framesRead = (framesRead < slot->numFrames) ? framesRead : slot->numFrames;
+    if (framesRead < slot->numFrames) {
+        LogWarn("WavPlayer %d read %d of %d frames at %llu (%lld)", 
+                player->id, framesRead, slot->numFrames, slot->startFrame, request->result);
+        memset(slot->frames + framesRead * 2, 0, (slot->numFrames - framesRead) * 2 * sizeof(f32));
+    }
+
+    const u8* raw = (const u8*)request->buffer + slot->readSkip;
+    Pcm_DecodeStereo(player->file.format, raw, player->file.numChannels, framesRead, slot->frames);
+    AsyncIo_ReleaseBuffer(player->asyncIo, request->bufferIndex);
 
+    slot->ready = true;
+    stream->bytesInFlight += (request->result > 0) ? (u64)request->result : 0;
+    stream->numReadsInFlight--;
+    PublishReadySlots(stream);
+
+    if (stream->numReadsInFlight == 0) {
+        RecordLoad(player);
+        StreamScheduler_Complete(player->scheduler, &stream->source, stream->bytesInFlight);
+    }
+}
+
+// Queues a read for each free slot, straight into a registered buffer and converted when it
+// lands. Called from the scheduler thread, the only thread driving its AsyncIo.
+static u64 FillStreamAsync(void* data)
+{
     WavPlayer* player = (WavPlayer*)data;
-    Assert(player, "WavPlayer is null");
+    Assert(player != NULL, "WavPlayer is NULL");
+    WavStream* stream = &player->stream;
+    AsyncIo* asyncIo = player->asyncIo;
 
-    if (player->flags & WAVPLAYER_FINISHED) {
+    u16 generation = TakeRequest(stream);
+
+    // The previous fill has fully landed by the time the scheduler calls again
+    stream->submitIndex = atomic_load_explicit(&stream->writeIndex, memory_order_relaxed);
+    stream->numReadsInFlight = 0;
+    stream->bytesInFlight = 0;
+
+    WavLoop loop;
+    LoadLoop(player, &loop);
+
+    u16 bytesPerFrame = player->file.bytesPerFrame;
+    while (!stream->endQueued) {
+        u64 readIndex = atomic_load_explicit(&stream->readIndex, memory_order_acquire);
+        if (stream->submitIndex - readIndex >= stream->numSlots) {
+            break;
+        }
+
+        WavStreamSlot* slot = &stream->slots[stream->submitIndex % stream->numSlots];
+        u64 loaderFrame = stream->loaderFrame; // Put back if the read can't be queued
+        slot->numFrames = NextChunk(player, &loop, &slot->startFrame);
+        slot->generation = generation;
+
+        if (slot->numFrames == 0) {
+            slot->ready = true;
+            stream->endQueued = true;
+            stream->submitIndex++;
+            break;
+        }
+
+        i32 bufferIndex = AsyncIo_AcquireBuffer(asyncIo);
+        if (bufferIndex < 0) {
+            stream->loaderFrame = loaderFrame;
+            break;
+        }
+
+        // Read whole aligned blocks around the frames so the same request works with O_DIRECT
+        u64 offset = player->file.dataOffset + slot->startFrame * bytesPerFrame;
+        u64 alignedOffset = offset & ~((u64)ASYNC_IO_ALIGNMENT - 1);
+        slot->readSkip = (u32)(offset - alignedOffset);
+        slot->ready = false;
+
+        AsyncIoRequest* read = &stream->reads[stream->submitIndex % stream->numSlots];
+        *read = (AsyncIoRequest) {
+            .op = ASYNC_IO_READ,
+            .fd = stream->fd,
+            .buffer = AsyncIo_GetBuffer(asyncIo, bufferIndex),
+            .size = (u32)AlignUp(slot->readSkip + slot->numFrames * bytesPerFrame, ASYNC_IO_ALIGNMENT),
+            .offset = alignedOffset,
+            .bufferIndex = bufferIndex,
+            .OnComplete = OnStreamRead,
+            .data = (void*)player,
+        };
+        if (!AsyncIo_Queue(asyncIo, read)) {
+            AsyncIo_ReleaseBuffer(asyncIo, bufferIndex);
+            stream->loaderFrame = loaderFrame;
+            break;
+        }
+
+        stream->numReadsInFlight++;
+        stream->submitIndex++;
+    }
+
+    if (stream->numReadsInFlight > 0) {
+        return STREAM_FILL_ASYNC;
+    }
+
+    // Nothing to wait on, at most an end marker to hand over
+    PublishReadySlots(stream);
+    RecordLoad(player);
+    return 0;
+}
+
+static void RequestFill(WavPlayer* player)
+{
+    WavStream* stream = &player->stream;
+    if (atomic_load_explicit(&stream->source.pending, memory_order_relaxed)) {
+        return;
+    }
+
+    stream->requestNs = Trace_NowNs();
+    StreamScheduler_Request(&stream->source);
+}
+
+static void PrefetchFrom(WavPlayer* player, u64 frame)
+{
+    if (player->mapped) {
+        WavFile_Prefetch(&player->file, frame, WAVPLAYER_PREFETCH_FRAMES);
+    }
+    player->prefetchFrame = frame + WAVPLAYER_PREFETCH_FRAMES;
+}
+
+// Backwards prefetchFrame is the lowest frame paged in
+static void PrefetchBefore(WavPlayer* player, u64 frame)
+{
+    u64 startFrame = (frame > WAVPLAYER_PREFETCH_FRAMES) ? frame - WAVPLAYER_PREFETCH_FRAMES : 0;
+    if (player->mapped) {
+        WavFile_Prefetch(&player->file, startFrame, frame - startFrame);
+    }
+    player->prefetchFrame = startFrame;
+}
+
+// The region a seek to frame can start playing from straight away, if any
+static const WavRegion* FindRegion(WavPlayer* player, u64 frame)
+{
+    if (frame < player->memory.numFrames) {
+        return &player->memory;
+    }
+    if (frame < player->head.numFrames) {
+        return &player->head;
+    }
+
+    u32 numCues = atomic_load_explicit(&player->numCues, memory_order_acquire);
+    for (u32 i = 0; i < numCues; i++) {
+        const WavRegion* cue = &player->cues[i];
+        if (frame >= cue->frame && frame < cue->frame + cue->numFrames) {
+            return cue;
+        }
+    }
+    return NULL;
+}
+
+static const u8* RegionData(const WavRegion* region, u64 offset, u64* contiguousFrames)
+{
+    u64 blockOffset = offset % region->blockFrames;
+    u64 blockFrames = region->blockFrames - blockOffset;
+    u64 remainingFrames = region->numFrames - offset;
+    *contiguousFrames = (remainingFrames < blockFrames) ? remainingFrames : blockFrames;
+    return region->blocks[offset / region->blockFrames] + blockOffset * 2 * Pcm_BytesPerSample(region->format);
+}
+
+// Mixes numFrames of src, the file from frame on. Across the loop crossfade src fades out
+// while the audio after the loop start, kept resident for it, fades in.
+static void MixFrames(WavPlayer* player, 
+                      const WavLoop* loop, 
+                      const u8* src, 
+                      PcmFormat format, 
+                      u64 frame, 
+                      u32 numFrames, 
+                      f32* buffer)
+{
+    u64 fadeStart = loop->end - loop->crossfade;
+    if (!loop->active || loop->crossfade == 0 || frame + numFrames <= fadeStart || frame >= loop->end) {
+        Pcm_MixStereo(format, src, numFrames, buffer);
         return;
     }
 
-    // Cache atomics
-    u8 currentBufferIndex = atomic_load(&player->currentBufferIndex);
-    u64 currentFrame = atomic_load(&player->currentFrame);
-    u64 currentNumFrames = atomic_load(&player->currentNumFrames[currentBufferIndex]); 
+    u32 plainFrames = (frame < fadeStart) ? (u32)(fadeStart - frame) : 0;
+    Pcm_MixStereo(format, src, plainFrames, buffer);
 
-    u64 currentFrameInBuffer = currentFrame % AUDIO_FILE_CHUNK_SIZE;
-    u64 remainingFrames = currentNumFrames - currentFrameInBuffer;
-    u16 framesThisTime = (remainingFrames < numOutputFrames) ? remainingFrames : numOutputFrames;
-    f32* wavBuffer = (f32*)player->coreAudioBuffers[currentBufferIndex]->mBuffers[0].mData;
-    u32 baseSampleIndex = currentFrameInBuffer * 2;
+    u32 fadeOffset = (u32)(frame + plainFrames - fadeStart);
+    u32 fadeFrames = numFrames - plainFrames;
+    f32 gainStep = 1.0f / (f32)(loop->crossfade + 1);
+    f32 fadeOutGain = 1.0f - (f32)(fadeOffset + 1) * gainStep;
+    src += plainFrames * 2 * Pcm_BytesPerSample(format);
+    buffer += plainFrames * 2;
+    Pcm_MixStereoRamp(format, src, fadeFrames, fadeOutGain, -gainStep, buffer);
 
-    // Copy audio data from the Wav file into the output buffer
-    for (u16 i = 0; i < framesThisTime; i++) {
-        u32 sampleIndex = baseSampleIndex + i * 2;
+    u32 framesFaded = 0;
+    while (framesFaded < fadeFrames) {
+        u64 loopFrame = loop->start + fadeOffset + framesFaded;
+        const WavRegion* region = FindRegion(player, loopFrame);
+        if (region == NULL) {
+            break;
+        }
 
-        // TODO: Handle under-run
-        buffer[i * 2] += wavBuffer[sampleIndex];
-        buffer[i * 2 + 1] += wavBuffer[sampleIndex + 1];
+        u64 contiguousFrames;
+        const u8* loopData = RegionData(region, loopFrame - region->frame, &contiguousFrames);
+        u32 framesThisTime = fadeFrames - framesFaded;
+        framesThisTime = (contiguousFrames < framesThisTime) ? (u32)contiguousFrames : framesThisTime;
+        f32 fadeInGain = (f32)(fadeOffset + framesFaded + 1) * gainStep;
+        Pcm_MixStereoRamp(region->format, loopData, framesThisTime, fadeInGain, gainStep, buffer + framesFaded * 2);
+        framesFaded += framesThisTime;
     }
+}
 
-    atomic_fetch_add(&player->currentFrame, framesThisTime);
-    currentFrameInBuffer += framesThisTime;
+// Plays from player->playing until the buffer is full, the region runs out, the file ends
+// or the loop wraps somewhere outside the region. Returns the frames played.
+static u16 ProcessRegion(WavPlayer* player, const WavLoop* loop, u16 numOutputFrames, f32* buffer)
+{
+    const WavRegion* region = player->playing;
+    u64 frame = atomic_load(&player->currentFrame);
+    u16 framesWritten = 0;
 
-    // Finished streaming the current buffer?
-    if (currentFrameInBuffer >= currentNumFrames) {
-        if (currentFrame < (player->totalFrames - 1)) {
-            // File isn't finished, load the next chunk
-            atomic_store(&player->currentBufferIndex, (currentBufferIndex == 0) ? 1 : 0);
-            ThreadPool_DeferTask(player->threadPool, LoadNextChunk, (void*)player);
+    while (framesWritten < numOutputFrames) {
+        if (WrapsAt(player, loop, frame)) {
+            u64 target = WrapTarget(loop);
+            if (target < region->frame || target >= region->frame + region->numFrames) {
+                break;
+            }
+            frame = target;
         }
-        else if (atomic_load(&player->flags) & WAVPLAYER_LOOPING) {
-            // File is finished but should loop, reset the cursor and load the next chunk
-            atomic_store(&player->currentBufferIndex, (currentBufferIndex == 0) ? 1 : 0);
-            WavPlayer_Seek(player, 0);
-            ThreadPool_DeferTask(player->threadPool, LoadNextChunk, (void*)player);
+
+        u64 offset = frame - region->frame;
+        if (offset >= region->numFrames) {
+            player->playing = NULL;
+            break;
         }
-        else {
-            // File is finished but not looping, just mark as finished
+
+        u64 contiguousFrames;
+        const u8* data = RegionData(region, offset, &contiguousFrames);
+        u64 framesUntilEnd = FramesUntilEnd(player, loop, frame);
+        u64 framesThisTime = numOutputFrames - framesWritten;
+        framesThisTime = (contiguousFrames < framesThisTime) ? contiguousFrames : framesThisTime;
+        framesThisTime = (framesUntilEnd < framesThisTime) ? framesUntilEnd : framesThisTime;
+        if (framesThisTime == 0) {
+            break;
+        }
+
+        MixFrames(player, loop, data, region->format, frame, (u32)framesThisTime, buffer + framesWritten * 2);
+        framesWritten += (u16)framesThisTime;
+        frame += framesThisTime;
+    }
+
+    atomic_store(&player->currentFrame, frame);
+    return framesWritten;
+}
+
+static void ReverseFrames(f32* frames, u32 numFrames)
+{
+    for (u32 i = 0; i < numFrames / 2; i++) {
+        u32 j = numFrames - 1 - i;
+        f32 left = frames[i * 2];
+        f32 right = frames[i * 2 + 1];
+        frames[i * 2] = frames[j * 2];
+        frames[i * 2 + 1] = frames[j * 2 + 1];
+        frames[j * 2] = left;
+        frames[j * 2 + 1] = right;
+    }
+}
+
+// Backwards playback only ever mixes into the silence of the varispeed window, so mixing in
+// file order and then flipping the frames round is the same as mixing them backwards
+static void MixReversed(PcmFormat format, const u8* src, u32 numFrames, f32* buffer)
+{
+    Pcm_MixStereo(format, src, numFrames, buffer);
+    ReverseFrames(buffer, numFrames);
+}
+
+// ProcessRegion backwards, without the loop crossfade
+static u16 ProcessRegionReverse(WavPlayer* player, const WavLoop* loop, u16 numOutputFrames, f32* buffer)
+{
+    const WavRegion* region = player->playing;
+    u64 frame = atomic_load(&player->currentFrame);
+    u16 framesWritten = 0;
+
+    while (framesWritten < numOutputFrames) {
+        if (WrapsBackAt(loop, frame)) {
+            if (loop->end <= region->frame || loop->end > region->frame + region->numFrames) {
+                break;
+            }
+            frame = loop->end;
+        }
+
+        if (frame <= region->frame) {
+            player->playing = NULL;
+            break;
+        }
+
+        // Down to the start of the block the frame before this one is in
+        u64 offset = frame - region->frame;
+        u64 blockFrames = offset - ((offset - 1) / region->blockFrames) * region->blockFrames;
+        u64 framesUntilStart = FramesUntilStart(loop, frame);
+        u64 framesThisTime = numOutputFrames - framesWritten;
+        framesThisTime = (blockFrames < framesThisTime) ? blockFrames : framesThisTime;
+        framesThisTime = (framesUntilStart < framesThisTime) ? framesUntilStart : framesThisTime;
+        if (framesThisTime == 0) {
+            break;
+        }
+
+        u64 contiguousFrames;
+        const u8* data = RegionData(region, offset - framesThisTime, &contiguousFrames);
+        MixReversed(region->format, data, (u32)framesThisTime, buffer + framesWritten * 2);
+        framesWritten += (u16)framesThisTime;
+        frame -= framesThisTime;
+    }
+
+    atomic_store(&player->currentFrame, frame);
+    return framesWritten;
+}
+
+// Plays from the file mapping or a sample cache entry, either way it's all addressable
+static u16 ProcessInMemory(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    if (atomic_load(&player->flags) & WAVPLAYER_SEEK) {
+        u64 seekFrame = atomic_load(&player->seekPosition);
+        atomic_fetch_and(&player->flags, ~WAVPLAYER_SEEK);
+        atomic_store(&player->currentFrame, seekFrame);
+        PrefetchFrom(player, seekFrame);
+    }
+
+    WavLoop loop;
+    LoadLoop(player, &loop);
+    u64 startFrame = atomic_load(&player->currentFrame);
+
+    // Mapped samples are read straight out of the page cache, compact ones widened as they mix
+    player->playing = &player->memory;
+    u16 framesWritten = ProcessRegion(player, &loop, numOutputFrames, buffer);
+    if (framesWritten < numOutputFrames) {
+        atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+    }
+
+    // Keep readahead half a window in front so the audio thread never takes a hard fault
+    u64 frame = atomic_load(&player->currentFrame);
+    if (frame < startFrame) {
+        PrefetchFrom(player, frame);
+    }
+    else if (frame + (WAVPLAYER_PREFETCH_FRAMES / 2) >= player->prefetchFrame) {
+        PrefetchFrom(player, player->prefetchFrame);
+    }
+    return framesWritten;
+}
+
+static u16 ProcessInMemoryReverse(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    if (atomic_load(&player->flags) & WAVPLAYER_SEEK) {
+        u64 seekFrame = atomic_load(&player->seekPosition);
+        atomic_fetch_and(&player->flags, ~WAVPLAYER_SEEK);
+        seekFrame = (seekFrame < player->totalFrames) ? seekFrame + 1 : player->totalFrames;
+        atomic_store(&player->currentFrame, seekFrame);
+        PrefetchBefore(player, seekFrame);
+    }
+
+    WavLoop loop;
+    LoadLoop(player, &loop);
+    u64 startFrame = atomic_load(&player->currentFrame);
+
+    player->playing = &player->memory;
+    u16 framesWritten = ProcessRegionReverse(player, &loop, numOutputFrames, buffer);
+    if (framesWritten < numOutputFrames) {
+        atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+    }
+
+    u64 frame = atomic_load(&player->currentFrame);
+    if (frame > startFrame) {
+        PrefetchBefore(player, frame);
+    }
+    else if (frame <= player->prefetchFrame + (WAVPLAYER_PREFETCH_FRAMES / 2)) {
+        PrefetchBefore(player, player->prefetchFrame);
+    }
+    return framesWritten;
+}
+
+// Where the stream should pick up for playback at frame, past the region covering it if any
+static u64 ResumeFrame(const WavPlayer* player, const WavLoop* loop, u64 frame)
+{
+    if (player->playing == NULL) {
+        return frame;
+    }
+    if (player->reverse) {
+        u64 regionStart = player->playing->frame;
+        return (loop->active && frame > WrapTarget(loop) && regionStart < WrapTarget(loop)) ? WrapTarget(loop) : regionStart;
+    }
+    u64 regionEnd = player->playing->frame + player->playing->numFrames;
+    return (loop->active && frame < loop->end && regionEnd > loop->end) ? loop->end : regionEnd;
+}
+
+// Everything buffered is dropped, anything the loader is part way through gets dropped by
+// its generation when it lands
+static void RestartStream(WavPlayer* player, u64 frame)
+{
+    WavStream* stream = &player->stream;
+    stream->generation++;
+    stream->readOffset = 0;
+    atomic_store_explicit(&stream->request, PackRequest(stream->generation, frame, player->reverse), memory_order_release);
+    atomic_store_explicit(&stream->readIndex, atomic_load(&stream->writeIndex), memory_order_release);
+}
+
+// Plays on from frame, out of a resident region straight away if one covers it
+static void StreamFrom(WavPlayer* player, const WavLoop* loop, u64 frame)
+{
+    if (player->reverse) {
+        player->playing = (frame > 0) ? FindRegion(player, frame - 1) : NULL;
+    }
+    else {
+        player->playing = FindRegion(player, frame);
+    }
+    RestartStream(player, ResumeFrame(player, loop, frame));
+    atomic_store(&player->currentFrame, frame);
+}
+
+// Whether the ring already holds what comes after a wrap, the loader wraps in step with us
+// unless the loop changed since it read ahead
+static bool StreamContinuesAt(WavPlayer* player, u64 readIndex, u64 writeIndex, u64 frame)
+{
+    WavStream* stream = &player->stream;
+    if (stream->readOffset > 0) {
+        return false;
+    }
+    for (; readIndex < writeIndex; readIndex++) {
+        WavStreamSlot* slot = &stream->slots[readIndex % stream->numSlots];
+        if (slot->generation == stream->generation) {
+            u64 slotFrame = player->reverse ? slot->startFrame + slot->numFrames : slot->startFrame;
+            return slotFrame == frame && slot->numFrames > 0;
+        }
+    }
+    return false;
+}
+
+// The loop changed while playing from a region, the stream has to pick up somewhere else
+static void CheckResumeFrame(WavPlayer* player, const WavLoop* loop)
+{
+    if (player->playing != NULL) {
+        WavStream* stream = &player->stream;
+        u64 resumeFrame = ResumeFrame(player, loop, atomic_load(&player->currentFrame));
+        if ((atomic_load_explicit(&stream->request, memory_order_relaxed) & REQUEST_FRAME_MASK) != resumeFrame) {
+            RestartStream(player, resumeFrame);
+        }
+    }
+}
+
+// Top up at the low water mark rather than waiting to run dry, or as soon as there's room
+// while playing faster than normal
+static void UpdateFill(WavPlayer* player, u64 readIndex, u64 writeIndex)
+{
+    WavStream* stream = &player->stream;
+    atomic_store_explicit(&stream->readIndex, readIndex, memory_order_release);
+
+    u64 filledSlots = writeIndex - readIndex;
+    u32 fillFrames = (u32)(filledSlots * AUDIO_FILE_CHUNK_SIZE) - stream->readOffset;
+    if (player->playing != NULL) {
+        u64 frame = atomic_load(&player->currentFrame);
+        u64 regionEnd = player->playing->frame + player->playing->numFrames;
+        fillFrames += (u32)(player->reverse ? frame - player->playing->frame : regionEnd - frame);
+    }
+    atomic_store_explicit(&stream->source.bufferedFrames, fillFrames, memory_order_relaxed);
+    if (fillFrames < atomic_load(&player->minFillFrames)) {
+        atomic_store(&player->minFillFrames, fillFrames);
+    }
+
+    bool fast = fabs(player->varispeed.rate) > 1.0;
+    u64 lowWaterSlots = fast ? stream->numSlots - 1 : stream->lowWaterSlots;
+    if ((filledSlots <= lowWaterSlots) && !(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        RequestFill(player);
+    }
+}
+
+static u16 ProcessStreamed(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    WavStream* stream = &player->stream;
+
+    WavLoop loop;
+    LoadLoop(player, &loop);
+
+    if (atomic_load(&player->flags) & WAVPLAYER_SEEK) {
+        u64 frame = atomic_load(&player->seekPosition);
+        atomic_fetch_and(&player->flags, ~WAVPLAYER_SEEK);
+        StreamFrom(player, &loop, frame);
+    }
+
+    CheckResumeFrame(player, &loop);
+
+    u64 readIndex = atomic_load_explicit(&stream->readIndex, memory_order_relaxed);
+    u64 writeIndex = atomic_load_explicit(&stream->writeIndex, memory_order_acquire);
+    u16 framesWritten = 0;
+
+    while (framesWritten < numOutputFrames) {
+        u64 frame = atomic_load(&player->currentFrame);
+
+        if (WrapsAt(player, &loop, frame)) {
+            // Short loops stay resident rather than cycling tiny slots through the ring
+            u64 target = WrapTarget(&loop);
+            bool shortLoop = (loop.end - target) < AUDIO_FILE_CHUNK_SIZE;
+            if (player->playing != NULL || shortLoop || !StreamContinuesAt(player, readIndex, writeIndex, target)) {
+                StreamFrom(player, &loop, target);
+                readIndex = writeIndex;
+            }
+            else {
+                atomic_store(&player->currentFrame, target);
+            }
+            continue;
+        }
+        else if (frame >= player->totalFrames) {
+            atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+            break;
+        }
+
+        if (player->playing != NULL) {
+            u16 framesPlayed = ProcessRegion(player, &loop, numOutputFrames - framesWritten, buffer + framesWritten * 2);
+            framesWritten += framesPlayed;
+            bool wrapping = WrapsAt(player, &loop, atomic_load(&player->currentFrame));
+            if (framesPlayed == 0 && player->playing != NULL && !wrapping) {
+                break;
+            }
+            continue;
+        }
+
+        if (readIndex == writeIndex) {
+            // Underrun, leave the rest silent and hold position until the loader catches up
+            atomic_fetch_add(&player->numUnderruns, 1);
+            atomic_fetch_add(&player->numUnderrunFrames, numOutputFrames - framesWritten);
+            TraceInstant("WavUnderrun");
+            break;
+        }
+
+        WavStreamSlot* slot = &stream->slots[readIndex % stream->numSlots];
+        if (slot->generation != stream->generation) {
+            readIndex++;
+            continue;
+        }
+
+        if (slot->numFrames == 0) {
+            atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+            break;
+        }
+
+        // Read ahead for a loop that's since been cleared or moved, start over from here
+        if (stream->readOffset == 0 && slot->startFrame != frame) {
+            StreamFrom(player, &loop, frame);
+            readIndex = writeIndex;
+            continue;
+        }
+
+        u64 slotFrame = slot->startFrame + stream->readOffset;
+        u64 availableFrames = slot->numFrames - stream->readOffset;
+        u64 framesUntilEnd = FramesUntilEnd(player, &loop, slotFrame);
+        u64 framesThisTime = numOutputFrames - framesWritten;
+        framesThisTime = (availableFrames < framesThisTime) ? availableFrames : framesThisTime;
+        framesThisTime = (framesUntilEnd < framesThisTime) ? framesUntilEnd : framesThisTime;
+
+        const u8* wavData = (const u8*)(slot->frames + stream->readOffset * 2);
+        MixFrames(player, &loop, wavData, PCM_FORMAT_F32, slotFrame, (u32)framesThisTime, buffer + framesWritten * 2);
+
+        framesWritten += (u16)framesThisTime;
+        stream->readOffset += (u32)framesThisTime;
+        atomic_store(&player->currentFrame, slot->startFrame + stream->readOffset);
+
+        if (stream->readOffset >= slot->numFrames) {
+            stream->readOffset = 0;
+            readIndex++;
+        }
+    }
+
+    UpdateFill(player, readIndex, writeIndex);
+    return framesWritten;
+}
+
+// ProcessStreamed backwards, slots are read from their last frame down
+static u16 ProcessStreamedReverse(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    WavStream* stream = &player->stream;
+
+    WavLoop loop;
+    LoadLoop(player, &loop);
+
+    if (atomic_load(&player->flags) & WAVPLAYER_SEEK) {
+        u64 frame = atomic_load(&player->seekPosition);
+        atomic_fetch_and(&player->flags, ~WAVPLAYER_SEEK);
+        StreamFrom(player, &loop, (frame < player->totalFrames) ? frame + 1 : player->totalFrames);
+    }
+
+    CheckResumeFrame(player, &loop);
+
+    u64 readIndex = atomic_load_explicit(&stream->readIndex, memory_order_relaxed);
+    u64 writeIndex = atomic_load_explicit(&stream->writeIndex, memory_order_acquire);
+    u16 framesWritten = 0;
+
+    while (framesWritten < numOutputFrames) {
+        u64 frame = atomic_load(&player->currentFrame);
+
+        if (WrapsBackAt(&loop, frame)) {
+            if (player->playing != NULL || !StreamContinuesAt(player, readIndex, writeIndex, loop.end)) {
+                StreamFrom(player, &loop, loop.end);
+                readIndex = writeIndex;
+            }
+            else {
+                atomic_store(&player->currentFrame, loop.end);
+            }
+            continue;
+        }
+        else if (frame == 0) {
+            atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+            break;
+        }
+
+        if (player->playing != NULL) {
+            u16 framesPlayed = ProcessRegionReverse(player, &loop, numOutputFrames - framesWritten, buffer + framesWritten * 2);
+            framesWritten += framesPlayed;
+            bool wrapping = WrapsBackAt(&loop, atomic_load(&player->currentFrame));
+            if (framesPlayed == 0 && player->playing != NULL && !wrapping) {
+                break;
+            }
+            continue;
+        }
+
+        if (readIndex == writeIndex) {
+            atomic_fetch_add(&player->numUnderruns, 1);
+            atomic_fetch_add(&player->numUnderrunFrames, numOutputFrames - framesWritten);
+            TraceInstant("WavUnderrun");
+            break;
+        }
+
+        WavStreamSlot* slot = &stream->slots[readIndex % stream->numSlots];
+        if (slot->generation != stream->generation) {
+            readIndex++;
+            continue;
+        }
+
+        if (slot->numFrames == 0) {
             atomic_fetch_or(&player->flags, WAVPLAYER_FINISHED);
+            break;
+        }
+
+        u64 slotEnd = slot->startFrame + slot->numFrames;
+        if (stream->readOffset == 0 && slotEnd != frame) {
+            StreamFrom(player, &loop, frame);
+            readIndex = writeIndex;
+            continue;
+        }
+
+        u64 slotFrame = slotEnd - stream->readOffset;
+        u64 availableFrames = slot->numFrames - stream->readOffset;
+        u64 framesUntilStart = FramesUntilStart(&loop, slotFrame);
+        u64 framesThisTime = numOutputFrames - framesWritten;
+        framesThisTime = (availableFrames < framesThisTime) ? availableFrames : framesThisTime;
+        framesThisTime = (framesUntilStart < framesThisTime) ? framesUntilStart : framesThisTime;
+
+        const u8* wavData = (const u8*)(slot->frames + (slotFrame - framesThisTime - slot->startFrame) * 2);
+        MixReversed(PCM_FORMAT_F32, wavData, (u32)framesThisTime, buffer + framesWritten * 2);
+
+        framesWritten += (u16)framesThisTime;
+        stream->readOffset += (u32)framesThisTime;
+        atomic_store(&player->currentFrame, slotEnd - stream->readOffset);
+
+        if (stream->readOffset >= slot->numFrames) {
+            stream->readOffset = 0;
+            readIndex++;
         }
     }
+
+    UpdateFill(player, readIndex, writeIndex);
+    return framesWritten;
+}
+
+// The next numFrames of the file in the direction it's playing, one to one
+static u16 ProcessFrames(WavPlayer* player, u16 numFrames, f32* buffer)
+{
+    if (player->memory.numFrames > 0) {
+        return player->reverse ? ProcessInMemoryReverse(player, numFrames, buffer) : ProcessInMemory(player, numFrames, buffer);
+    }
+    return player->reverse ? ProcessStreamedReverse(player, numFrames, buffer) : ProcessStreamed(player, numFrames, buffer);
+}
+
+// Turns playback round. The frames the window holds are the next to play the other way, the
+// file carries on from the far side of them.
+static void Reverse(WavPlayer* player)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+    u64 frame = atomic_load(&player->currentFrame);
+    u32 numFrames = varispeed->numFrames;
+    player->reverse = !player->reverse;
+
+    u64 resumeFrame = player->reverse ? ((frame > numFrames) ? frame - numFrames : 0) : frame + numFrames;
+    resumeFrame = (resumeFrame < player->totalFrames) ? resumeFrame : player->totalFrames;
+
+    // Too few frames held past the play position to look back over, start afresh
+    if (numFrames < varispeed->position + 1.0 + INTERPOLATOR_HISTORY) {
+        resumeFrame = frame;
+        memset(varispeed->frames, 0, INTERPOLATOR_HISTORY * 2 * sizeof(f32));
+        varispeed->numFrames = INTERPOLATOR_HISTORY;
+        varispeed->position = INTERPOLATOR_HISTORY;
+    }
+    else {
+        ReverseFrames(varispeed->frames, numFrames);
+        varispeed->position = (f64)(numFrames - 1) - varispeed->position;
+    }
+
+    if (player->memory.numFrames > 0) {
+        atomic_store(&player->currentFrame, resumeFrame);
+        if (player->reverse) {
+            PrefetchBefore(player, resumeFrame);
+        }
+        else {
+            PrefetchFrom(player, resumeFrame);
+        }
+    }
+    else {
+        WavLoop loop;
+        LoadLoop(player, &loop);
+        StreamFrom(player, &loop, resumeFrame);
+    }
+}
+
+// Pulls whatever more the window needs for frames up to position, returns false if the file
+// couldn't keep up. Past the end the window fills with silence so the last frames play out.
+static bool FillWindow(WavPlayer* player, f64 position)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+    u32 framesNeeded = (u32)position + INTERPOLATOR_AHEAD + 1;
+    Assert(framesNeeded <= varispeed->capacity, "WavPlayer %d varispeed window too small for %d frames", player->id, framesNeeded);
+    if (framesNeeded <= varispeed->numFrames) {
+        return true;
+    }
+
+    u32 framesToPull = framesNeeded - varispeed->numFrames;
+    f32* frames = varispeed->frames + varispeed->numFrames * 2;
+    memset(frames, 0, framesToPull * 2 * sizeof(f32));
+    u32 framesPulled = ProcessFrames(player, (u16)framesToPull, frames);
+    if (framesPulled < framesToPull && !(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        varispeed->numFrames += framesPulled;
+        return false;
+    }
+    varispeed->numFrames = framesNeeded;
+    return true;
+}
+
+// Interpolates numFrames out of the window while the rate ramps, always moving forwards
+// through it. Holds position and leaves silence if the file couldn't keep up.
+static bool ProcessWindow(WavPlayer* player, u16 numFrames, f32* buffer)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+    f64 direction = player->reverse ? -1.0 : 1.0;
+    f64 speed = varispeed->rate * direction;
+    f64 speedStep = (varispeed->rampFrames > 0) ? varispeed->rateStep * direction : 0.0;
+
+    // Where the last frame reads from, the speed never goes negative within a call
+    f64 lastPosition = varispeed->position + (numFrames - 1) * speed + speedStep * (numFrames - 1) * (numFrames - 2) / 2.0;
+    lastPosition = (lastPosition > varispeed->position) ? lastPosition : varispeed->position;
+    if (!FillWindow(player, lastPosition)) {
+        return false;
+    }
+
+    Interpolation interpolation = (Interpolation)atomic_load_explicit(&player->interpolation, memory_order_relaxed);
+    varispeed->position = Interpolator_Process(interpolation, varispeed->frames, varispeed->position, speed, speedStep, numFrames, buffer);
+
+    // Only keep what the next position still reaches back to
+    u32 framesUsed = (u32)varispeed->position - INTERPOLATOR_HISTORY;
+    framesUsed = (framesUsed < varispeed->numFrames) ? framesUsed : varispeed->numFrames;
+    memmove(varispeed->frames, varispeed->frames + framesUsed * 2, (varispeed->numFrames - framesUsed) * 2 * sizeof(f32));
+    varispeed->numFrames -= framesUsed;
+    varispeed->position -= framesUsed;
+    return true;
+}
+
+static void ProcessVarispeed(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+
+    // Nothing held carries over a seek
+    if (atomic_load(&player->flags) & WAVPLAYER_SEEK) {
+        memset(varispeed->frames, 0, INTERPOLATOR_HISTORY * 2 * sizeof(f32));
+        varispeed->numFrames = INTERPOLATOR_HISTORY;
+        varispeed->position = INTERPOLATOR_HISTORY;
+    }
+
+    u16 framesWritten = 0;
+    while (framesWritten < numOutputFrames) {
+        // Heading the other way, or about to from a standstill
+        f64 heading = (varispeed->rate != 0.0 || varispeed->rampFrames == 0) ? varispeed->rate : varispeed->rateStep;
+        if (heading != 0.0 && (heading < 0.0) != player->reverse) {
+            Reverse(player);
+        }
+
+        // Split where the ramp ends and where the rate goes through zero
+        u32 framesThisTime = numOutputFrames - framesWritten;
+        if (varispeed->rampFrames > 0) {
+            framesThisTime = (varispeed->rampFrames < framesThisTime) ? varispeed->rampFrames : framesThisTime;
+            if (varispeed->rate != 0.0 && (varispeed->rate < 0.0) != (varispeed->rateStep < 0.0)) {
+                u32 framesToZero = (u32)ceil(-varispeed->rate / varispeed->rateStep);
+                framesThisTime = (framesToZero < framesThisTime) ? framesToZero : framesThisTime;
+            }
+        }
+
+        if (!ProcessWindow(player, (u16)framesThisTime, buffer + framesWritten * 2)) {
+            break;
+        }
+
+        framesWritten += (u16)framesThisTime;
+        if (varispeed->rampFrames > 0) {
+            varispeed->rampFrames -= framesThisTime;
+            varispeed->rate = (varispeed->rampFrames > 0) ? varispeed->rate + varispeed->rateStep * framesThisTime : varispeed->targetRate;
+        }
+    }
+
+    // The scheduler sees faster players run dry sooner
+    f64 speed = fabs(varispeed->rate) * SAMPLE_RATE_DEFAULT;
+    atomic_store_explicit(&player->stream.source.framesPerSecond, (speed >= 1.0) ? (u32)speed : 1, memory_order_relaxed);
+}
+
+// Straight through at exactly normal speed, keeping the last few frames in the window for
+// when the rate changes. Whatever was already in the buffer is taken back off them so the
+// window holds only this player.
+static void ProcessDirect(WavPlayer* player, u16 numOutputFrames, f32* buffer)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+    u32 numKept = (numOutputFrames < INTERPOLATOR_HISTORY) ? numOutputFrames : INTERPOLATOR_HISTORY;
+    f32* tail = buffer + (numOutputFrames - numKept) * 2;
+    f32 mixedBefore[INTERPOLATOR_HISTORY * 2];
+    memcpy(mixedBefore, tail, numKept * 2 * sizeof(f32));
+
+    ProcessFrames(player, numOutputFrames, buffer);
+
+    f32* history = varispeed->frames + (INTERPOLATOR_HISTORY - numKept) * 2;
+    memmove(varispeed->frames, varispeed->frames + numKept * 2, (INTERPOLATOR_HISTORY - numKept) * 2 * sizeof(f32));
+    for (u32 i = 0; i < numKept * 2; i++) {
+        history[i] = tail[i] - mixedBefore[i];
+    }
+}
+
+static void TakeRate(WavPlayer* player)
+{
+    WavVarispeed* varispeed = &player->varispeed;
+    atomic_fetch_and(&player->flags, ~WAVPLAYER_RATE);
+    varispeed->targetRate = atomic_load(&player->targetRate);
+    varispeed->rampFrames = atomic_load(&player->rateRampFrames);
+    if (varispeed->rampFrames == 0) {
+        varispeed->rate = varispeed->targetRate;
+    }
+    varispeed->rateStep = (varispeed->rampFrames > 0) ? (varispeed->targetRate - varispeed->rate) / varispeed->rampFrames : 0.0;
+}
+
+static void ProcessWavPlayer(f64 sampleRate, u16 numOutputFrames, f32* buffer, void* data)
+{
+    LogTrace("Process wav");
+    (void)sampleRate;
+
+    WavPlayer* player = (WavPlayer*)data;
+    Assert(player, "WavPlayer is null");
+
+    if (player->flags & WAVPLAYER_FINISHED) {
+        return;
+    }
+    Assert(numOutputFrames <= BUFFER_SIZE, "WavPlayer %d asked for %d frames", player->id, numOutputFrames);
+
+    WavVarispeed* varispeed = &player->varispeed;
+    if (atomic_load(&player->flags) & WAVPLAYER_RATE) {
+        TakeRate(player);
+    }
+
+    // Back to the direct path once settled at normal speed, at the next seek so nothing jumps
+    bool normalSpeed = (varispeed->rate == 1.0) && (varispeed->rampFrames == 0) && !player->reverse;
+    if (varispeed->active && normalSpeed && (atomic_load(&player->flags) & WAVPLAYER_SEEK)) {
+        varispeed->active = false;
+        memset(varispeed->frames, 0, INTERPOLATOR_HISTORY * 2 * sizeof(f32));
+    }
+    else if (!varispeed->active && !normalSpeed) {
+        varispeed->active = true;
+        varispeed->numFrames = INTERPOLATOR_HISTORY;
+        varispeed->position = INTERPOLATOR_HISTORY;
+    }
+
+    if (varispeed->active) {
+        ProcessVarispeed(player, numOutputFrames, buffer);
+    }
+    else {
+        ProcessDirect(player, numOutputFrames, buffer);
+    }
 }
 
 static void DestroyWavPlayer(void* data)
@@ -95,90 +1138,357 @@ static void DestroyWavPlayer(void* data)
     WavPlayer* player = (WavPlayer*)data;
     Assert(player, "WavPlayer is null");
     LogInfo("Destroying WavPlayer");
-    for (u8 i = 0; i < 2; i++) {
-        free(player->coreAudioBuffers[i]->mBuffers[0].mData);
-        free(player->coreAudioBuffers[i]);
+    WavPlayer_LogStats(player);
+    if (player->cached != NULL) {
+        SampleCache_Release(player->sampleCache, player->cached);
+        return;
+    }
+    if (!player->mapped) {
+        StreamScheduler_Unregister(player->scheduler, &player->stream.source);
+        if (player->stream.asyncRead && player->stream.fd != player->file.fd) {
+            close(player->stream.fd);
+        }
+        for (u32 i = 0; i < player->stream.numSlots; i++) {
+            PoolAllocator_Free(player->chunkPool, player->stream.slots[i].frames);
+        }
+        for (u32 i = 0; i < atomic_load(&player->numCues); i++) {
+            for (u32 j = 0; j < WAVPLAYER_CUE_CHUNKS; j++) {
+                PoolAllocator_Free(player->chunkPool, (void*)player->cues[i].blocks[j]);
+            }
+        }
     }
-    ExtAudioFileDispose(player->audioFile);
+    WavFile_Close(&player->file);
 }
 
-u16 WavPlayer_Create(WavPlayer* player, CoreEngineContext* ctx, const char* filename, u8 flags)
+static u16 CreatePlayer(WavPlayer* player, 
+                        CoreEngineContext* ctx, 
+                        const char* filename, 
+                        u8 flags, 
+                        u32 readaheadMs, 
+                        const LibrarySample* sample)
 {
     Assert(player != NULL, "WavPlayer is NULL");
     Assert(ctx != NULL, "CoreEngineContext is NULL");
 
-    LogInfo("Creating WavPlayer { id: %d, file: %s }", numWavPlayers_, filename);
-
-    OSStatus status;
-
-    CFURLRef url = CFURLCreateFromFileSystemRepresentation(
-        NULL/*TODO: use custom heap*/,
-        (const u8*)filename,
-        strlen(filename),
-        false // IsDirectory
-    );
-
-    status = ExtAudioFileOpenURL(url, &player->audioFile);
-    Assert(status == noErr, "Failed to open %s", filename);
-
-    AudioStreamBasicDescription readDesc;
-    u32 propSize = sizeof(readDesc);
-    status = ExtAudioFileGetProperty(player->audioFile, kExtAudioFileProperty_FileDataFormat, &propSize, &readDesc);
-    Assert(status == noErr, "Failed to get file data format properties for %s", filename);
-    LogInfo("WAV file sample rate is %f", readDesc.mSampleRate);
-
-    AudioStreamBasicDescription streamFormat = (AudioStreamBasicDescription) {
-        .mSampleRate = readDesc.mSampleRate,
-        .mFormatID = kAudioFormatLinearPCM,
-        .mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked,
-        .mBytesPerPacket = 4 * 2,
-        .mFramesPerPacket = 1,
-        .mBytesPerFrame = 4 * 2,
-        .mChannelsPerFrame = 2,
-        .mBitsPerChannel = 32,
-    };
-
-    status = ExtAudioFileSetProperty(player->audioFile, kExtAudioFileProperty_ClientDataFormat, sizeof(streamFormat), &streamFormat);
-    Assert(status == noErr, "Failed to set file properties for %s", filename);
-
-    i64 totalFrames;
-    propSize = sizeof(totalFrames);
-    status = ExtAudioFileGetProperty(player->audioFile, kExtAudioFileProperty_FileLengthFrames, &propSize, &totalFrames);
-    Assert(status == noErr, "Failed to get file length for %s", filename);
-    Assert(totalFrames > 0, "Total frames read in %s was 0", filename);
-
-    u32 dataByteSize = AUDIO_FILE_CHUNK_SIZE * streamFormat.mBytesPerFrame;
-    for (u8 i = 0; i < 2; i++) {
-        player->coreAudioBuffers[i] = malloc(sizeof(AudioBufferList) + (sizeof(AudioBuffer)));
-        player->coreAudioBuffers[i]->mNumberBuffers = 1;
-        player->coreAudioBuffers[i]->mBuffers[0].mNumberChannels = 2;
-        player->coreAudioBuffers[i]->mBuffers[0].mDataByteSize = dataByteSize;
-        player->coreAudioBuffers[i]->mBuffers[0].mData = malloc(dataByteSize);
-    }
-
-    player->totalFrames = (u64)totalFrames;
+    LogInfo("Creating WavPlayer { id: %d, file: %s, readahead: %dms }", numWavPlayers_, filename, readaheadMs);
+
+    // A cache hit needs no file of its own at all
+    player->sampleCache = &ctx->sampleCache;
+    player->cached = (flags & WAVPLAYER_CACHED) ? SampleCache_Acquire(player->sampleCache, filename, SAMPLE_RATE_DEFAULT) : NULL;
+    if (player->cached == NULL) {
+        WavFile_Open(&player->file, filename);
+        Assert(player->file.totalFrames > 0, "Total frames read in %s was 0", filename);
+    }
+    else {
+        memset(&player->file, 0, sizeof(WavFile));
+        player->file.fd = -1;
+    }
+
+    // The cache converts to the engine rate as it loads, anything else is converted as it streams
+    memset(&player->stream, 0, sizeof(WavStream));
+    player->resampling = (player->cached == NULL) && (player->file.sampleRate != SAMPLE_RATE_DEFAULT);
+    player->resampleQuality = (flags & WAVPLAYER_HIGH_QUALITY) ? RESAMPLER_QUALITY_HIGH : RESAMPLER_QUALITY_MEDIUM;
+    if (player->cached != NULL) {
+        player->totalFrames = player->cached->numFrames;
+    }
+    else if (player->resampling) {
+        player->totalFrames = Resampler_OutputFrames(player->file.sampleRate, SAMPLE_RATE_DEFAULT, player->file.totalFrames);
+        LogInfo("%s is %d Hz, resampling to %d Hz", filename, player->file.sampleRate, SAMPLE_RATE_DEFAULT);
+    }
+    else {
+        player->totalFrames = player->file.totalFrames;
+    }
     player->currentFrame = 0;
-    player->currentBufferIndex = 0;
+    player->seekPosition = 0;
     player->flags = flags;
-    player->threadPool = &ctx->threadPool;
+    player->scheduler = &ctx->streamScheduler;
+    player->asyncIo = ctx->streamScheduler.asyncIo;
+    player->chunkPool = ctx->chunkPool;
+    memset(&player->memory, 0, sizeof(WavRegion));
+    memset(&player->head, 0, sizeof(WavRegion));
+    player->numCues = 0;
+    player->playing = NULL;
+    player->loopStart = 0;
+    player->loopEnd = player->totalFrames;
+    player->loopCrossfade = 0;
+
+    player->reverse = false;
+    player->targetRate = 1.0f;
+    player->rateRampFrames = 0;
+    player->interpolation = INTERPOLATION_CUBIC;
+    memset(&player->varispeed, 0, sizeof(WavVarispeed));
+    player->varispeed.rate = 1.0;
+    player->varispeed.targetRate = 1.0;
+    player->varispeed.capacity = (u32)(BUFFER_SIZE * WAVPLAYER_MAX_RATE) + INTERPOLATOR_SPAN + 2;
+    player->varispeed.frames = HeapArena_Alloc(&ctx->heapArena, player->varispeed.capacity * 2 * sizeof(f32));
+    memset(player->varispeed.frames, 0, player->varispeed.capacity * 2 * sizeof(f32));
+    Interpolator_Init();
+
+    // The head only stands in for the start of the file it was decoded from, at our rate
+    if (sample != NULL && player->resampling) {
+        LogWarn("%s is %d Hz, streaming without the preloaded head", filename, sample->sampleRate);
+    }
+    else if (sample != NULL && sample->totalFrames == player->file.totalFrames) {
+        player->head = (WavRegion) {
+            .numFrames = sample->numHeadFrames,
+            .format = sample->headFormat,
+            .blockFrames = sample->numHeadFrames,
+            .blocks = { sample->head },
+        };
+        player->playing = (sample->numHeadFrames > 0) ? &player->head : NULL;
+    }
+    else if (sample != NULL) {
+        LogWarn("%s changed since its library was loaded, streaming without the preloaded head", filename);
+    }
+
+    // Library samples always stream so the audio thread never faults on a cold mapping
+    player->mapped = (player->cached == NULL) && (sample == NULL) && WavFile_CanMap(&player->file, SAMPLE_RATE_DEFAULT);
+    player->numUnderruns = 0;
+    player->numUnderrunFrames = 0;
+    player->numLoads = 0;
+    player->lastLoadNs = 0;
+    player->maxLoadNs = 0;
     player->id = numWavPlayers_;
     numWavPlayers_++;
 
-    // Preload both buffers
-    LoadNextChunk((void*)player);
-    atomic_store(&player->currentBufferIndex, 1);
-    LoadNextChunk((void*)player);
-    atomic_store(&player->currentBufferIndex, 0);
+    if (player->cached != NULL) {
+        LogInfo("WavPlayer %d playing from the sample cache", player->id);
+        player->memory = (WavRegion) {
+            .numFrames = player->totalFrames,
+            .format = player->cached->format,
+            .blockFrames = player->totalFrames,
+            .blocks = { player->cached->data },
+        };
+    }
+    else if (player->mapped) {
+        LogInfo("WavPlayer %d playing directly from the file mapping", player->id);
+        player->memory = (WavRegion) {
+            .numFrames = player->totalFrames,
+            .format = PCM_FORMAT_F32,
+            .blockFrames = player->totalFrames,
+            .blocks = { (const u8*)WavFile_MapFrames(&player->file, 0) },
+        };
+        PrefetchFrom(player, 0);
+    }
+    else {
+        WavStream* stream = &player->stream;
+        u64 readaheadFrames = ((u64)readaheadMs * SAMPLE_RATE_DEFAULT) / 1000;
+        u32 numSlots = (u32)((readaheadFrames + AUDIO_FILE_CHUNK_SIZE - 1) / AUDIO_FILE_CHUNK_SIZE);
+        numSlots = (numSlots < WAVPLAYER_MIN_SLOTS) ? WAVPLAYER_MIN_SLOTS : numSlots;
+        numSlots = (numSlots > WAVPLAYER_MAX_SLOTS) ? WAVPLAYER_MAX_SLOTS : numSlots;
+        stream->numSlots = numSlots;
+        stream->lowWaterSlots = numSlots / 2;
+
+        u32 dataByteSize = AUDIO_FILE_CHUNK_SIZE * 2 * sizeof(f32);
+        Assert(dataByteSize <= ctx->chunkPool->blockSize, "Chunk of %d bytes doesn't fit in pool block", dataByteSize);
+        for (u32 i = 0; i < numSlots; i++) {
+            stream->slots[i].frames = PoolAllocator_Alloc(player->chunkPool);
+        }
+
+        // Async reads need a whole chunk plus alignment slack to fit in one I/O buffer,
+        // anything wider than that is converted out of the mapping instead. So is anything
+        // being resampled, the resampler needs its input in order and reads land out of it.
+        u64 maxReadSize = AUDIO_FILE_CHUNK_SIZE * player->file.bytesPerFrame + ASYNC_IO_ALIGNMENT;
+        stream->asyncRead = (player->asyncIo != NULL) && (maxReadSize <= player->asyncIo->bufferSize) && !player->resampling;
+        if (player->resampling) {
+            InitResample(&stream->resample, player, &ctx->heapArena);
+        }
+        stream->fd = player->file.fd;
+        if (stream->asyncRead && (flags & WAVPLAYER_DIRECT_IO)) {
+            i32 fd = AsyncIo_Open(filename, O_RDONLY, true);
+            stream->fd = (fd >= 0) ? fd : player->file.fd;
+        }
+
+        stream->source.Fill = stream->asyncRead ? FillStreamAsync : FillStream;
+        stream->source.data = (void*)player;
+        stream->source.framesPerSecond = SAMPLE_RATE_DEFAULT;
+
+        if (player->playing != NULL) {
+            // Nothing read here, the tail after the head is fetched while the head plays
+            stream->loaderFrame = player->head.numFrames;
+            atomic_store(&stream->request, PackRequest(0, player->head.numFrames, false));
+            stream->source.bufferedFrames = (u32)player->head.numFrames;
+            StreamScheduler_Register(player->scheduler, &stream->source, player->file.fd);
+            RequestFill(player);
+        }
+        else {
+            // Fill the whole ring up front, the scheduler may already be running so this
+            // can't go through its AsyncIo
+            stream->requestNs = Trace_NowNs();
+            FillStream((void*)player);
+            stream->source.bufferedFrames = numSlots * AUDIO_FILE_CHUNK_SIZE;
+            StreamScheduler_Register(player->scheduler, &stream->source, player->file.fd);
+        }
+    }
+
+    player->minFillFrames = player->stream.source.bufferedFrames;
 
-    CFRelease(url);
+    if (flags & WAVPLAYER_LOOPING) {
+        WavPlayer_SetLoop(player, 0, (u32)player->totalFrames, 0);
+    }
 
     return CoreEngine_CreateProcessor(ctx, ProcessWavPlayer, DestroyWavPlayer, NULL, (void*)player);
 }
 
+u16 WavPlayer_Create(WavPlayer* player, CoreEngineContext* ctx, const char* filename, u8 flags)
+{
+    return WavPlayer_CreateWithReadahead(player, ctx, filename, flags, WAVPLAYER_DEFAULT_READAHEAD_MS);
+}
+
+u16 WavPlayer_CreateWithReadahead(WavPlayer* player, 
+                                  CoreEngineContext* ctx, 
+                                  const char* filename, 
+                                  u8 flags, 
+                                  u32 readaheadMs)
+{
+    return CreatePlayer(player, ctx, filename, flags, readaheadMs, NULL);
+}
+
+u16 WavPlayer_CreateFromLibrary(WavPlayer* player, 
+                                CoreEngineContext* ctx, 
+                                const SampleLibrary* library, 
+                                u32 sampleIndex, 
+                                u8 flags)
+{
+    Assert(library != NULL, "SampleLibrary is NULL");
+    const LibrarySample* sample = SampleLibrary_Get(library, sampleIndex);
+    return CreatePlayer(player, ctx, sample->path, flags & ~WAVPLAYER_CACHED, WAVPLAYER_DEFAULT_READAHEAD_MS, sample);
+}
+
 void WavPlayer_Seek(WavPlayer *player, u32 seekPosition)
 {
     LogInfo("Seek to %d", seekPosition);
     atomic_store(&player->seekPosition, seekPosition);
+    atomic_fetch_and(&player->flags, ~WAVPLAYER_FINISHED);
     atomic_fetch_or(&player->flags, WAVPLAYER_SEEK);
 }
 
+u32 WavPlayer_AddCue(WavPlayer* player, u32 frame)
+{
+    Assert(player != NULL, "WavPlayer is NULL");
+    u32 numCues = atomic_load(&player->numCues);
+    Assert(numCues < WAVPLAYER_MAX_CUES, "WavPlayer %d already has %d cues", player->id, numCues);
+    Assert(frame < player->totalFrames, "Cue at %d is past the end of WavPlayer %d", frame, player->id);
+
+    WavRegion* cue = &player->cues[numCues];
+    memset(cue, 0, sizeof(WavRegion));
+    cue->frame = frame;
+    cue->format = PCM_FORMAT_F32;
+    cue->blockFrames = AUDIO_FILE_CHUNK_SIZE;
+
+    if (player->mapped) {
+        WavFile_Prefetch(&player->file, frame, WAVPLAYER_PREFETCH_FRAMES);
+    }
+    else if (player->memory.numFrames == 0) {
+        // Decoded now, off the audio thread, so the seek never waits on the stream. The
+        // loader's resampler belongs to the scheduler thread, cues get one of their own that
+        // only lasts as long as the decode.
+        HeapArena arena;
+        WavResample resample;
+        if (player->resampling) {
+            HeapArena_Init(&arena, ResampleArenaBytes(player));
+            InitResample(&resample, player, &arena);
+        }
+        for (u32 i = 0; i < WAVPLAYER_CUE_CHUNKS; i++) {
+            f32* chunk = PoolAllocator_Alloc(player->chunkPool);
+            Assert(chunk != NULL, "Out of audio chunks for cue %d of WavPlayer %d", numCues, player->id);
+            cue->numFrames += ReadFrames(player, &resample, frame + cue->numFrames, AUDIO_FILE_CHUNK_SIZE, chunk);
+            cue->blocks[i] = (const u8*)chunk;
+        }
+        if (player->resampling) {
+            HeapArena_Deinit(&arena);
+        }
+    }
+
+    LogInfo("WavPlayer %d cue %d at %d, %llu frames preloaded", player->id, numCues, frame, cue->numFrames);
+    atomic_store_explicit(&player->numCues, numCues + 1, memory_order_release);
+    return numCues;
+}
+
+void WavPlayer_SeekToCue(WavPlayer* player, u32 cueIndex)
+{
+    Assert(cueIndex < atomic_load(&player->numCues), "WavPlayer %d has no cue %d", player->id, cueIndex);
+    WavPlayer_Seek(player, (u32)player->cues[cueIndex].frame);
+}
+
+void WavPlayer_SetLoop(WavPlayer* player, u32 startFrame, u32 endFrame, u32 crossfadeFrames)
+{
+    Assert(player != NULL, "WavPlayer is NULL");
+    Assert(startFrame < endFrame && endFrame <= player->totalFrames, 
+           "Loop %d-%d is outside WavPlayer %d", startFrame, endFrame, player->id);
+    Assert(crossfadeFrames < endFrame - startFrame, "Crossfade of %d frames is longer than the loop", crossfadeFrames);
+
+    // Streamed players keep the loop start resident, it's both faded in and wrapped to
+    if (player->memory.numFrames == 0) {
+        const WavRegion* region = FindRegion(player, startFrame);
+        if (region == NULL || region->frame + region->numFrames <= (u64)startFrame + crossfadeFrames) {
+            region = &player->cues[WavPlayer_AddCue(player, startFrame)];
+        }
+
+        u64 residentFrames = region->frame + region->numFrames - startFrame;
+        if (crossfadeFrames >= residentFrames) {
+            LogWarn("WavPlayer %d loop crossfade cut to the %llu frames kept resident", player->id, residentFrames);
+            crossfadeFrames = (u32)residentFrames - 1;
+        }
+    }
+    else if (player->mapped) {
+        WavFile_Prefetch(&player->file, startFrame, WAVPLAYER_PREFETCH_FRAMES);
+    }
+
+    LogInfo("WavPlayer %d looping %d-%d, %d frame crossfade", player->id, startFrame, endFrame, crossfadeFrames);
+    atomic_store(&player->loopStart, startFrame);
+    atomic_store(&player->loopEnd, endFrame);
+    atomic_store(&player->loopCrossfade, crossfadeFrames);
+    atomic_fetch_or(&player->flags, WAVPLAYER_LOOPING);
+}
+
+void WavPlayer_ClearLoop(WavPlayer* player)
+{
+    Assert(player != NULL, "WavPlayer is NULL");
+    atomic_fetch_and(&player->flags, ~WAVPLAYER_LOOPING);
+}
+
+void WavPlayer_SetRate(WavPlayer* player, f32 rate, u32 rampMs)
+{
+    Assert(player != NULL, "WavPlayer is NULL");
+    Assert(fabsf(rate) <= WAVPLAYER_MAX_RATE, "WavPlayer %d can't play at %.2fx", player->id, rate);
+
+    atomic_store(&player->targetRate, rate);
+    atomic_store(&player->rateRampFrames, (u32)(((u64)rampMs * SAMPLE_RATE_DEFAULT) / 1000));
+    atomic_fetch_and(&player->flags, ~WAVPLAYER_FINISHED);
+    atomic_fetch_or(&player->flags, WAVPLAYER_RATE);
+}
+
+void WavPlayer_SetInterpolation(WavPlayer* player, Interpolation interpolation)
+{
+    Assert(player != NULL, "WavPlayer is NULL");
+    Assert(interpolation < INTERPOLATION_COUNT, "Unknown interpolation %d", interpolation);
+    atomic_store(&player->interpolation, (u8)interpolation);
+}
+
+void WavPlayer_LogStats(WavPlayer* player)
+{
+    if (player->cached != NULL) {
+        LogInfo("WavPlayer %d { cached }", player->id);
+        return;
+    }
+    if (player->mapped) {
+        LogInfo("WavPlayer %d { mapped }", player->id);
+        return;
+    }
+
+    LogInfo("WavPlayer %d { underruns: %llu (%llu frames), loads: %llu, last load: %.2fms, "
+            "worst load: %.2fms, fill: %u frames, lowest fill: %u frames }",
+            player->id,
+            atomic_load(&player->numUnderruns),
+            atomic_load(&player->numUnderrunFrames),
+            atomic_load(&player->numLoads),
+            (f64)atomic_load(&player->lastLoadNs) / 1e6,
+            (f64)atomic_load(&player->maxLoadNs) / 1e6,
+            atomic_load(&player->stream.source.bufferedFrames),
+            atomic_load(&player->minFillFrames));
+
+    if (atomic_load(&player->numUnderruns) > 0) {
+        LogWarn("WavPlayer %d ran dry, consider a longer readahead", player->id);
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // fallocate
+#endif
+#include <wav_writer.h>
+#include <wav_file.h>
+#include <logger.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DS64_SIZE 28 // RIFF size, data size and sample count as u64, then an empty table
+#define RIFF_SIZE_MAX 0xFFFFFFFFull
+
+// KSDATAFORMAT_SUBTYPE_* GUIDs after the leading format tag
+static const u8 extensibleGuidTail_[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static inline u8* PutU16(u8* dst, u16 value)
+{
+    dst[0] = (u8)value;
+    dst[1] = (u8)(value >> 8);
+    return dst + 2;
+}
+
+static inline u8* PutU32(u8* dst, u32 value)
+{
+    dst = PutU16(dst, (u16)value);
+    return PutU16(dst, (u16)(value >> 16));
+}
+
+static inline u8* PutU64(u8* dst, u64 value)
+{
+    dst = PutU32(dst, (u32)value);
+    return PutU32(dst, (u32)(value >> 32));
+}
+
+static inline u8* PutChunk(u8* dst, const char* id, u32 size)
+{
+    memcpy(dst, id, 4);
+    return PutU32(dst + 4, size);
+}
+
+static bool PwriteAll(i32 fd, const u8* src, u64 size, u64 offset)
+{
+    while (size > 0) {
+        ssize_t written = pwrite(fd, src, size, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        src += written;
+        size -= (u64)written;
+        offset += (u64)written;
+    }
+    return true;
+}
+
+// Reserves the next extent without changing the file size, so a file cut off early doesn't
+// end in a run of zeros that looks like audio
+static void Preallocate(WavWriter* writer, u64 end)
+{
+    while (writer->canPreallocate && writer->allocatedBytes < end) {
+#if defined(__linux__)
+        bool ok = fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, (off_t)writer->allocatedBytes, WAV_WRITER_PREALLOCATE_BYTES) == 0;
+#elif defined(__APPLE__)
+        fstore_t store = {
+            .fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL,
+            .fst_posmode = F_PEOFPOSMODE,
+            .fst_offset = 0,
+            .fst_length = WAV_WRITER_PREALLOCATE_BYTES,
+        };
+        bool ok = fcntl(writer->fd, F_PREALLOCATE, &store) != -1;
+        if (!ok) {
+            // Contiguous is only a preference
+            store.fst_flags = F_ALLOCATEALL;
+            ok = fcntl(writer->fd, F_PREALLOCATE, &store) != -1;
+        }
+#else
+        bool ok = false;
+        errno = ENOTSUP;
+#endif
+        if (!ok) {
+            LogWarn("Can't preallocate recording space (%s), extending as it's written", strerror(errno));
+            writer->canPreallocate = false;
+            return;
+        }
+        writer->allocatedBytes += WAV_WRITER_PREALLOCATE_BYTES;
+        writer->numPreallocations++;
+    }
+}
+
+static u32 FmtSize(const WavWriter* writer)
+{
+    if (writer->numChannels > 2) {
+        return 40;
+    }
+    return (writer->format == PCM_FORMAT_F32) ? 18 : 16;
+}
+
+static void BuildHeader(const WavWriter* writer, u8* header)
+{
+    memset(header, 0, WAV_WRITER_HEADER_SIZE);
+
+    u64 numFrames = WavWriter_NumFrames(writer);
+    u64 riffSize = WAV_WRITER_HEADER_SIZE - 8 + writer->dataBytes + (writer->dataBytes & 1);
+    bool rf64 = riffSize > RIFF_SIZE_MAX;
+
+    u8* dst = PutChunk(header, rf64 ? "RF64" : "RIFF", rf64 ? RIFF_SIZE_MAX : (u32)riffSize);
+    memcpy(dst, "WAVE", 4);
+    dst += 4;
+
+    // Sizes past 4 GB go in ds64, otherwise the same bytes are just skipped over
+    dst = PutChunk(dst, rf64 ? "ds64" : "JUNK", DS64_SIZE);
+    if (rf64) {
+        PutU64(PutU64(PutU64(dst, riffSize), writer->dataBytes), numFrames);
+    }
+    dst += DS64_SIZE;
+
+    u16 formatTag = (writer->format == PCM_FORMAT_F32) ? WAV_FORMAT_TAG_FLOAT : WAV_FORMAT_TAG_PCM;
+    u16 bitsPerSample = Pcm_BytesPerSample(writer->format) * 8;
+    u32 fmtSize = FmtSize(writer);
+
+    dst = PutChunk(dst, "fmt ", fmtSize);
+    dst = PutU16(dst, (fmtSize == 40) ? WAV_FORMAT_TAG_EXTENSIBLE : formatTag);
+    dst = PutU16(dst, writer->numChannels);
+    dst = PutU32(dst, writer->sampleRate);
+    dst = PutU32(dst, writer->sampleRate * writer->bytesPerFrame);
+    dst = PutU16(dst, writer->bytesPerFrame);
+    dst = PutU16(dst, bitsPerSample);
+    if (fmtSize == 18) {
+        dst = PutU16(dst, 0);
+    }
+    else if (fmtSize == 40) {
+        dst = PutU16(dst, 22);
+        dst = PutU16(dst, bitsPerSample); // Valid bits
+        dst = PutU32(dst, 0); // No speaker mapping, stems are just channels
+        dst = PutU16(dst, formatTag);
+        memcpy(dst, extensibleGuidTail_, sizeof(extensibleGuidTail_));
+        dst += sizeof(extensibleGuidTail_);
+    }
+
+    if (writer->format == PCM_FORMAT_F32) {
+        dst = PutChunk(dst, "fact", 4);
+        dst = PutU32(dst, rf64 ? (u32)RIFF_SIZE_MAX : (u32)numFrames);
+    }
+
+    // Pad out so the data lands on the next page
+    u8* data = header + WAV_WRITER_HEADER_SIZE - 8;
+    PutChunk(dst, "JUNK", (u32)(data - dst - 8));
+    PutChunk(data, "data", rf64 ? RIFF_SIZE_MAX : (u32)writer->dataBytes);
+}
+
+void WavWriter_Open(WavWriter* writer, const char* path, PcmFormat format, u16 numChannels, u32 sampleRate)
+{
+    Assert(writer != NULL, "WavWriter is NULL");
+    Assert(numChannels > 0, "Can't write %s with no channels", path);
+    memset(writer, 0, sizeof(WavWriter));
+
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    Assert(writer->fd >= 0, "Failed to create %s (%s)", path, strerror(errno));
+
+    writer->format = format;
+    writer->numChannels = numChannels;
+    writer->sampleRate = sampleRate;
+    writer->bytesPerFrame = Pcm_BytesPerSample(format) * numChannels;
+    writer->headerIntervalBytes = WAV_WRITER_HEADER_INTERVAL_BYTES;
+    writer->canPreallocate = true;
+
+    Preallocate(writer, WAV_WRITER_HEADER_SIZE);
+    Assert(WavWriter_WriteHeader(writer), "Failed to write header to %s (%s)", path, strerror(errno));
+
+    LogInfo("Recording to %s { format: %s, channels: %d, sample rate: %d }",
+            path, Pcm_FormatName(format), numChannels, sampleRate);
+}
+
+void WavWriter_Close(WavWriter* writer)
+{
+    Assert(writer != NULL, "WavWriter is NULL");
+    if (writer->fd < 0) {
+        return;
+    }
+
+    // Chunks are word aligned, odd sized data gets a pad byte after it
+    u64 fileSize = WAV_WRITER_HEADER_SIZE + writer->dataBytes;
+    if (writer->dataBytes & 1) {
+        u8 pad = 0;
+        PwriteAll(writer->fd, &pad, 1, fileSize++);
+    }
+
+    if (!WavWriter_WriteHeader(writer) || ftruncate(writer->fd, (off_t)fileSize) != 0) {
+        LogWarn("Failed to finish recording (%s)", strerror(errno));
+    }
+    close(writer->fd);
+
+    LogInfo("Recorded %llu frames { writes: %llu, header writes: %llu, preallocations: %llu, errors: %llu }",
+            WavWriter_NumFrames(writer),
+            writer->numWrites,
+            writer->numHeaderWrites,
+            writer->numPreallocations,
+            writer->numErrors);
+    writer->fd = -1;
+}
+
+bool WavWriter_Write(WavWriter* writer, const void* frames, u32 numFrames)
+{
+    u64 size = (u64)numFrames * writer->bytesPerFrame;
+    u64 offset = WAV_WRITER_HEADER_SIZE + writer->dataBytes;
+    Preallocate(writer, offset + size);
+
+    if (!PwriteAll(writer->fd, (const u8*)frames, size, offset)) {
+        LogWarn("Failed to write %u frames (%s)", numFrames, strerror(errno));
+        writer->numErrors++;
+        return false;
+    }
+    writer->dataBytes += size;
+    writer->numWrites++;
+
+    if (writer->dataBytes - writer->headerDataBytes >= writer->headerIntervalBytes) {
+        return WavWriter_WriteHeader(writer);
+    }
+    return true;
+}
+
+bool WavWriter_WriteHeader(WavWriter* writer)
+{
+    u8 header[WAV_WRITER_HEADER_SIZE];
+    BuildHeader(writer, header);
+
+    if (!PwriteAll(writer->fd, header, WAV_WRITER_HEADER_SIZE, 0)) {
+        writer->numErrors++;
+        return false;
+    }
+    writer->headerDataBytes = writer->dataBytes;
+    writer->numHeaderWrites++;
+    return true;
+}
+
+u64 WavWriter_NumFrames(const WavWriter* writer)
+{
+    return writer->dataBytes / writer->bytesPerFrame;
+}
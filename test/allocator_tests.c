@@ -0,0 +1,112 @@
+#include "test_framework.h"
+#include <string.h>
+#include <allocator.h>
+
+#define TEST_ARENA_SIZE (1024 * 1024)
+
+TEST(Allocator, HeapArena)
+{
+    HeapArena arena;
+
+    CHECK_DEATH(HeapArena_Init(NULL, TEST_ARENA_SIZE));
+    CHECK_DEATH(HeapArena_Init(&arena, 0));
+
+    HeapArena_Init(&arena, TEST_ARENA_SIZE);
+    CHECK_TRUE(arena.base != NULL);
+    CHECK_TRUE(HeapArena_Remaining(&arena) == arena.size);
+
+    u8* first = HeapArena_Alloc(&arena, 1);
+    u8* second = HeapArena_Alloc(&arena, 100);
+    CHECK_TRUE(((u64)first % ARENA_ALIGNMENT) == 0);
+    CHECK_TRUE(((u64)second % ARENA_ALIGNMENT) == 0);
+    CHECK_TRUE(second == first + ARENA_ALIGNMENT);
+    CHECK_TRUE(HeapArena_Remaining(&arena) == arena.size - 3 * ARENA_ALIGNMENT);
+
+    CHECK_DEATH(HeapArena_Alloc(&arena, arena.size));
+    CHECK_TRUE(HeapArena_Remaining(&arena) == arena.size - 3 * ARENA_ALIGNMENT);
+
+    HeapArena_Deinit(&arena);
+    CHECK_TRUE(arena.base == NULL);
+}
+
+TEST(Allocator, PoolAllocAndFree)
+{
+    HeapArena arena;
+    PoolAllocator pool;
+    void* blocks[8];
+
+    HeapArena_Init(&arena, TEST_ARENA_SIZE);
+    PoolAllocator_Init(&pool, &arena, "Test", 100, 8);
+    CHECK_TRUE(pool.blockSize == 128);
+
+    for (u8 i = 0; i < 8; i++) {
+        blocks[i] = PoolAllocator_Alloc(&pool);
+        CHECK_TRUE(((u64)blocks[i] % ARENA_ALIGNMENT) == 0);
+        CHECK_TRUE(PoolAllocator_Owns(&pool, blocks[i]));
+        memset(blocks[i], 0xff, 100);
+    }
+
+    CHECK_TRUE(atomic_load(&pool.numUsed) == 8);
+    CHECK_DEATH(PoolAllocator_Alloc(&pool)); // Exhausted
+
+    // Most recently freed block is handed out next
+    PoolAllocator_Free(&pool, blocks[3]);
+    CHECK_TRUE(atomic_load(&pool.numUsed) == 7);
+    CHECK_TRUE(PoolAllocator_Alloc(&pool) == blocks[3]);
+
+    u8 notOwned;
+    CHECK_DEATH(PoolAllocator_Free(&pool, &notOwned));
+    CHECK_DEATH(PoolAllocator_Free(&pool, (u8*)blocks[0] + 1));
+
+    for (u8 i = 0; i < 8; i++) {
+        PoolAllocator_Free(&pool, blocks[i]);
+    }
+    CHECK_TRUE(atomic_load(&pool.numUsed) == 0);
+
+    u8* zeroed = PoolAllocator_Calloc(&pool);
+    for (u32 i = 0; i < pool.blockSize; i++) {
+        CHECK_TRUE(zeroed[i] == 0);
+    }
+
+    HeapArena_Deinit(&arena);
+}
+
+TEST(Allocator, PoolHighWater)
+{
+    HeapArena arena;
+    PoolAllocator pool;
+
+    HeapArena_Init(&arena, TEST_ARENA_SIZE);
+    PoolAllocator_Init(&pool, &arena, "Test", 64, 4);
+
+    void* a = PoolAllocator_Alloc(&pool);
+    void* b = PoolAllocator_Alloc(&pool);
+    void* c = PoolAllocator_Alloc(&pool);
+    PoolAllocator_Free(&pool, b);
+    PoolAllocator_Free(&pool, c);
+    b = PoolAllocator_Alloc(&pool);
+
+    CHECK_TRUE(atomic_load(&pool.numUsed) == 2);
+    CHECK_TRUE(atomic_load(&pool.highWater) == 3);
+
+    PoolAllocator_Free(&pool, a);
+    PoolAllocator_Free(&pool, b);
+    HeapArena_Deinit(&arena);
+}
+
+TEST_SETUP(Allocator)
+{
+    ADD_TEST(Allocator, HeapArena);
+    ADD_TEST(Allocator, PoolAllocAndFree);
+    ADD_TEST(Allocator, PoolHighWater);
+}
+
+TEST_BRINGUP(Allocator)
+{
+
+}
+
+TEST_TEARDOWN(Allocator)
+{
+
+}
@@ -0,0 +1,286 @@
+#include "test_framework.h"
+#include <async_io.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_IO_PATH "/tmp/jamcore_async_io_test.bin"
+#define TEST_NUM_BUFFERS 16
+#define TEST_BUFFER_SIZE 8192
+#define TEST_FILE_SIZE (TEST_NUM_BUFFERS * TEST_BUFFER_SIZE)
+
+static HeapArena arena_;
+static AsyncIo io_;
+static AsyncIoRequest requests_[TEST_NUM_BUFFERS];
+static u32 numCompleted_;
+
+static u8 PatternByte(u64 offset)
+{
+    return (u8)((offset * 7) ^ (offset >> 9));
+}
+
+static void WritePatternFile(void)
+{
+    static u8 data[TEST_FILE_SIZE];
+    for (u64 i = 0; i < TEST_FILE_SIZE; i++) {
+        data[i] = PatternByte(i);
+    }
+    FILE* file = fopen(TEST_IO_PATH, "wb");
+    fwrite(data, 1, TEST_FILE_SIZE, file);
+    fclose(file);
+}
+
+static void OnComplete(AsyncIoRequest* request)
+{
+    (void)request;
+    numCompleted_++;
+}
+
+static void WaitForAll(void)
+{
+    for (u32 i = 0; i < 1000 && (io_.numInFlight > 0 || io_.numQueued > 0); i++) {
+        AsyncIo_Flush(&io_);
+        AsyncIo_Reap(&io_, 10);
+    }
+}
+
+// Reads every block back to front so completions aren't just file order
+static bool ReadsMatchFile(bool direct)
+{
+    i32 fd = AsyncIo_Open(TEST_IO_PATH, O_RDONLY, direct);
+    if (fd < 0) {
+        return false;
+    }
+
+    for (u32 i = 0; i < TEST_NUM_BUFFERS; i++) {
+        i32 bufferIndex = AsyncIo_AcquireBuffer(&io_);
+        requests_[i] = (AsyncIoRequest) {
+            .op = ASYNC_IO_READ,
+            .fd = fd,
+            .buffer = AsyncIo_GetBuffer(&io_, bufferIndex),
+            .size = TEST_BUFFER_SIZE,
+            .offset = (u64)(TEST_NUM_BUFFERS - 1 - i) * TEST_BUFFER_SIZE,
+            .bufferIndex = bufferIndex,
+            .OnComplete = OnComplete,
+        };
+        if (!AsyncIo_Queue(&io_, &requests_[i])) {
+            return false;
+        }
+    }
+    WaitForAll();
+    close(fd);
+
+    bool matches = (numCompleted_ == TEST_NUM_BUFFERS);
+    for (u32 i = 0; i < TEST_NUM_BUFFERS; i++) {
+        const u8* data = (const u8*)requests_[i].buffer;
+        matches &= (requests_[i].result == TEST_BUFFER_SIZE);
+        for (u32 j = 0; j < TEST_BUFFER_SIZE && matches; j++) {
+            matches &= (data[j] == PatternByte(requests_[i].offset + j));
+        }
+        AsyncIo_ReleaseBuffer(&io_, requests_[i].bufferIndex);
+    }
+    return matches;
+}
+
+TEST(AsyncIo, ReadsInOneBatch)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_AUTO, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE);
+
+    CHECK_TRUE(ReadsMatchFile(false));
+    CHECK_TRUE(io_.numSubmitted == TEST_NUM_BUFFERS);
+    CHECK_TRUE(io_.numBatches == 1);
+    CHECK_TRUE(io_.bytesRead == TEST_FILE_SIZE);
+    CHECK_TRUE(io_.numErrors == 0);
+    CHECK_TRUE(io_.numFreeBuffers == TEST_NUM_BUFFERS);
+
+    AsyncIo_Deinit(&io_);
+}
+
+TEST(AsyncIo, ThreadedFallbackReads)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_THREADED, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE);
+    CHECK_TRUE(io_.backend == ASYNC_IO_BACKEND_THREADED);
+
+    CHECK_TRUE(ReadsMatchFile(false));
+    CHECK_TRUE(io_.numBatches == 1);
+
+    AsyncIo_Deinit(&io_);
+}
+
+TEST(AsyncIo, DirectReadsFromAlignedBuffers)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_AUTO, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE - 100);
+
+    // Rounded up so O_DIRECT is happy with every buffer
+    CHECK_TRUE(io_.bufferSize == TEST_BUFFER_SIZE);
+    CHECK_TRUE(((uintptr_t)AsyncIo_GetBuffer(&io_, 3) % ASYNC_IO_ALIGNMENT) == 0);
+    CHECK_TRUE(ReadsMatchFile(true));
+
+    AsyncIo_Deinit(&io_);
+}
+
+// Reads that touch or overlap on one descriptor go out as one, the rest go out as they are
+static bool MergedReadsMatchFile(AsyncIoBackend backend)
+{
+    AsyncIo_Init(&io_, &arena_, backend, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE);
+    i32 fd = AsyncIo_Open(TEST_IO_PATH, O_RDONLY, false);
+    i32 otherFd = AsyncIo_Open(TEST_IO_PATH, O_RDONLY, false);
+
+    const struct { i32 fd; u64 offset; i64 result; } reads[] = {
+        { fd, 0, TEST_BUFFER_SIZE },
+        { fd, TEST_BUFFER_SIZE / 2, TEST_BUFFER_SIZE }, // Overlaps
+        { fd, TEST_BUFFER_SIZE * 3 / 2, TEST_BUFFER_SIZE }, // Touches
+        { otherFd, TEST_BUFFER_SIZE * 5 / 2, TEST_BUFFER_SIZE }, // Touches, but another descriptor
+        { fd, TEST_FILE_SIZE - TEST_BUFFER_SIZE, TEST_BUFFER_SIZE },
+        { fd, TEST_FILE_SIZE - TEST_BUFFER_SIZE / 2, TEST_BUFFER_SIZE / 2 }, // Runs off the end
+    };
+    u32 numReads = sizeof(reads) / sizeof(reads[0]);
+
+    for (u32 i = 0; i < numReads; i++) {
+        i32 bufferIndex = AsyncIo_AcquireBuffer(&io_);
+        requests_[i] = (AsyncIoRequest) {
+            .op = ASYNC_IO_READ,
+            .fd = reads[i].fd,
+            .buffer = AsyncIo_GetBuffer(&io_, bufferIndex),
+            .size = TEST_BUFFER_SIZE,
+            .offset = reads[i].offset,
+            .bufferIndex = bufferIndex,
+            .OnComplete = OnComplete,
+        };
+        AsyncIo_Queue(&io_, &requests_[i]);
+    }
+    WaitForAll();
+    close(fd);
+    close(otherFd);
+
+    bool matches = (numCompleted_ == numReads) &&
+                   (io_.numSubmitted == numReads) &&
+                   (io_.numMergedReads == 3) &&
+                   (io_.numFreeMerges == ASYNC_IO_MAX_MERGES) &&
+                   (io_.bytesRead == 5 * TEST_BUFFER_SIZE + TEST_BUFFER_SIZE / 2);
+    for (u32 i = 0; i < numReads; i++) {
+        const u8* data = (const u8*)requests_[i].buffer;
+        matches &= (requests_[i].result == reads[i].result);
+        for (u32 j = 0; j < reads[i].result && matches; j++) {
+            matches &= (data[j] == PatternByte(requests_[i].offset + j));
+        }
+        AsyncIo_ReleaseBuffer(&io_, requests_[i].bufferIndex);
+    }
+
+    AsyncIo_Deinit(&io_);
+    return matches;
+}
+
+TEST(AsyncIo, MergesAdjacentReads)
+{
+    CHECK_TRUE(MergedReadsMatchFile(ASYNC_IO_BACKEND_AUTO));
+}
+
+TEST(AsyncIo, ThreadedFallbackMergesReads)
+{
+    CHECK_TRUE(MergedReadsMatchFile(ASYNC_IO_BACKEND_THREADED));
+}
+
+TEST(AsyncIo, WritesLandAtTheirOffsets)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_AUTO, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE);
+
+    i32 fd = AsyncIo_Open(TEST_IO_PATH, O_WRONLY, false);
+    CHECK_TRUE(fd >= 0);
+    for (u32 i = 0; i < 4; i++) {
+        i32 bufferIndex = AsyncIo_AcquireBuffer(&io_);
+        u8* buffer = AsyncIo_GetBuffer(&io_, bufferIndex);
+        memset(buffer, 0xA0 + i, TEST_BUFFER_SIZE);
+        requests_[i] = (AsyncIoRequest) {
+            .op = ASYNC_IO_WRITE,
+            .fd = fd,
+            .buffer = buffer,
+            .size = TEST_BUFFER_SIZE,
+            .offset = (u64)i * 2 * TEST_BUFFER_SIZE,
+            .bufferIndex = bufferIndex,
+            .OnComplete = OnComplete,
+        };
+        CHECK_TRUE(AsyncIo_Queue(&io_, &requests_[i]));
+    }
+    WaitForAll();
+    close(fd);
+
+    CHECK_TRUE(numCompleted_ == 4);
+    CHECK_TRUE(io_.bytesWritten == 4 * TEST_BUFFER_SIZE);
+
+    // Only the written blocks changed
+    fd = open(TEST_IO_PATH, O_RDONLY);
+    u8 block[TEST_BUFFER_SIZE];
+    for (u32 i = 0; i < 8; i++) {
+        CHECK_TRUE(pread(fd, block, TEST_BUFFER_SIZE, (off_t)i * TEST_BUFFER_SIZE) == TEST_BUFFER_SIZE);
+        u8 expected = (i % 2 == 0) ? (u8)(0xA0 + i / 2) : PatternByte((u64)i * TEST_BUFFER_SIZE);
+        CHECK_TRUE(block[0] == expected);
+    }
+    close(fd);
+
+    AsyncIo_Deinit(&io_);
+}
+
+TEST(AsyncIo, BuffersRunOut)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_AUTO, 2, TEST_BUFFER_SIZE);
+
+    i32 first = AsyncIo_AcquireBuffer(&io_);
+    i32 second = AsyncIo_AcquireBuffer(&io_);
+    CHECK_TRUE(first >= 0 && second >= 0 && first != second);
+    CHECK_TRUE(AsyncIo_AcquireBuffer(&io_) == -1);
+
+    AsyncIo_ReleaseBuffer(&io_, second);
+    CHECK_TRUE(AsyncIo_AcquireBuffer(&io_) == second);
+    CHECK_DEATH(AsyncIo_GetBuffer(&io_, 2));
+
+    AsyncIo_Deinit(&io_);
+}
+
+TEST(AsyncIo, FailedReadsReportErrno)
+{
+    AsyncIo_Init(&io_, &arena_, ASYNC_IO_BACKEND_AUTO, TEST_NUM_BUFFERS, TEST_BUFFER_SIZE);
+
+    requests_[0] = (AsyncIoRequest) {
+        .op = ASYNC_IO_READ,
+        .fd = -1,
+        .buffer = AsyncIo_GetBuffer(&io_, 0),
+        .size = TEST_BUFFER_SIZE,
+        .bufferIndex = -1,
+        .OnComplete = OnComplete,
+    };
+    CHECK_TRUE(AsyncIo_Queue(&io_, &requests_[0]));
+    WaitForAll();
+
+    CHECK_TRUE(numCompleted_ == 1);
+    CHECK_TRUE(requests_[0].result < 0);
+    CHECK_TRUE(io_.numErrors == 1);
+
+    AsyncIo_Deinit(&io_);
+}
+
+TEST_SETUP(AsyncIo)
+{
+    ADD_TEST(AsyncIo, ReadsInOneBatch);
+    ADD_TEST(AsyncIo, ThreadedFallbackReads);
+    ADD_TEST(AsyncIo, DirectReadsFromAlignedBuffers);
+    ADD_TEST(AsyncIo, MergesAdjacentReads);
+    ADD_TEST(AsyncIo, ThreadedFallbackMergesReads);
+    ADD_TEST(AsyncIo, WritesLandAtTheirOffsets);
+    ADD_TEST(AsyncIo, BuffersRunOut);
+    ADD_TEST(AsyncIo, FailedReadsReportErrno);
+}
+
+TEST_BRINGUP(AsyncIo)
+{
+    HeapArena_Init(&arena_, (TEST_NUM_BUFFERS + 1) * TEST_BUFFER_SIZE);
+    WritePatternFile();
+    numCompleted_ = 0;
+}
+
+TEST_TEARDOWN(AsyncIo)
+{
+    HeapArena_Deinit(&arena_);
+    remove(TEST_IO_PATH);
+}
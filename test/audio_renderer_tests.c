@@ -0,0 +1,170 @@
+#include "test_framework.h"
+#include <audio_renderer.h>
+#include <core_engine.h>
+#include <wav_file.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_WAV_PATH "/tmp/jamcore_audio_renderer_test.wav"
+#define TEST_CYCLE_FRAMES 480
+#define TEST_HISTORY_SECONDS 1.0
+#define TEST_HISTORY_FRAMES 48000
+
+static CoreEngineContext ctx_;
+static f32 buffer_[TEST_CYCLE_FRAMES * 2];
+
+static f32 TestSample(u64 sampleIndex)
+{
+    return (f32)(sampleIndex % 65521) / 65521.0f - 0.5f;
+}
+
+static void RunCycle(u16 id, u64 cycle)
+{
+    for (u32 i = 0; i < TEST_CYCLE_FRAMES * 2; i++) {
+        buffer_[i] = TestSample(cycle * TEST_CYCLE_FRAMES * 2 + i);
+    }
+
+    // Skipped whenever the engine would shed it
+    AudioProcessor* proc = &ctx_.processors[id];
+    if (!LoadMonitor_ShouldBypass(&ctx_.loadMonitor, proc->priority)) {
+        proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_, proc->procData);
+    }
+}
+
+// Destroys the renderer so the file is complete, then checks it runs on from firstFrame
+static bool FileCarriesOnFrom(u64 firstFrame, u64 numFrames)
+{
+    CoreEngine_Deinit(&ctx_);
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    bool ok = (file.totalFrames == numFrames);
+    if (ok && numFrames > 0) {
+        const f32* frames = WavFile_MapFrames(&file, 0);
+        for (u64 i = 0; i < numFrames * 2; i++) {
+            ok &= (frames[i] == TestSample(firstFrame * 2 + i));
+        }
+    }
+    WavFile_Close(&file);
+    return ok;
+}
+
+TEST(AudioRenderer, CommitKeepsTheHistoryAndCarriesOn)
+{
+    AudioRenderer* renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    u16 id = AudioRenderer_CreateCapture(renderer, &ctx_, TEST_WAV_PATH, PCM_FORMAT_F32, PCM_DITHER_NONE, TEST_HISTORY_SECONDS);
+    CHECK_TRUE(renderer->ring.capacity == TEST_HISTORY_FRAMES + AUDIO_RENDERER_CAPTURE_HEADROOM_FRAMES);
+
+    // Three seconds in, only the last one is kept
+    u64 cycle = 0;
+    for (; cycle < 300; cycle++) {
+        RunCycle(id, cycle);
+    }
+    CHECK_TRUE(RecordRing_Available(&renderer->ring) == TEST_HISTORY_FRAMES);
+
+    AudioRenderer_Commit(renderer);
+    for (; cycle < 400; cycle++) {
+        RunCycle(id, cycle);
+    }
+    AudioRenderer_StopRecord(renderer);
+    for (; cycle < 410; cycle++) {
+        RunCycle(id, cycle);
+    }
+
+    CHECK_TRUE(FileCarriesOnFrom(300 * TEST_CYCLE_FRAMES - TEST_HISTORY_FRAMES, TEST_HISTORY_FRAMES + 100 * TEST_CYCLE_FRAMES));
+}
+
+TEST(AudioRenderer, StopBeforeHandoverKeepsJustTheHistory)
+{
+    AudioRenderer* renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    u16 id = AudioRenderer_CreateCapture(renderer, &ctx_, TEST_WAV_PATH, PCM_FORMAT_F32, PCM_DITHER_NONE, TEST_HISTORY_SECONDS);
+    for (u64 cycle = 0; cycle < 200; cycle++) {
+        RunCycle(id, cycle);
+    }
+
+    // The handover cycle still goes in
+    AudioRenderer_Commit(renderer);
+    AudioRenderer_StopRecord(renderer);
+    for (u64 cycle = 200; cycle < 210; cycle++) {
+        RunCycle(id, cycle);
+    }
+
+    CHECK_TRUE(FileCarriesOnFrom(200 * TEST_CYCLE_FRAMES - TEST_HISTORY_FRAMES, TEST_HISTORY_FRAMES + TEST_CYCLE_FRAMES));
+}
+
+TEST(AudioRenderer, UncommittedCaptureIsDiscarded)
+{
+    AudioRenderer* renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    u16 id = AudioRenderer_CreateCapture(renderer, &ctx_, TEST_WAV_PATH, PCM_FORMAT_S24, PCM_DITHER_TPDF, TEST_HISTORY_SECONDS);
+    for (u64 cycle = 0; cycle < 200; cycle++) {
+        RunCycle(id, cycle);
+    }
+    CHECK_TRUE(atomic_load(&renderer->framesWritten) == 0);
+
+    CoreEngine_Deinit(&ctx_);
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+    CHECK_TRUE(access(TEST_WAV_PATH, F_OK) != 0);
+}
+
+TEST(AudioRenderer, CaptureLeavesNoFileBehind)
+{
+    AudioRenderer* renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    AudioRenderer_CreateCapture(renderer, &ctx_, TEST_WAV_PATH, PCM_FORMAT_F32, PCM_DITHER_NONE, TEST_HISTORY_SECONDS);
+    CHECK_TRUE(access(TEST_WAV_PATH, F_OK) != 0);
+
+    CoreEngine_Deinit(&ctx_);
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+    CHECK_TRUE(access(TEST_WAV_PATH, F_OK) != 0);
+}
+
+TEST(AudioRenderer, NeverShedUnderOverload)
+{
+    // Room for a full size ring
+    CoreEngine_Deinit(&ctx_);
+    CoreEngine_Init(&ctx_, 1.0f, 16384);
+
+    // Everything that can be shed is
+    atomic_store(&ctx_.loadMonitor.shedLevel, NUM_PROCESSOR_PRIORITIES - 1);
+
+    AudioRenderer* renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    u16 id = AudioRenderer_Create(renderer, &ctx_, TEST_WAV_PATH);
+    AudioRenderer_StartRecord(renderer);
+    for (u64 cycle = 0; cycle < 100; cycle++) {
+        RunCycle(id, cycle);
+    }
+    AudioRenderer_StopRecord(renderer);
+    CHECK_TRUE(FileCarriesOnFrom(0, 100 * TEST_CYCLE_FRAMES));
+
+    atomic_store(&ctx_.loadMonitor.shedLevel, NUM_PROCESSOR_PRIORITIES - 1);
+    renderer = CoreEngine_New(&ctx_, AudioRenderer);
+    id = AudioRenderer_CreateCapture(renderer, &ctx_, TEST_WAV_PATH, PCM_FORMAT_F32, PCM_DITHER_NONE, TEST_HISTORY_SECONDS);
+    for (u64 cycle = 0; cycle < 200; cycle++) {
+        RunCycle(id, cycle);
+    }
+    AudioRenderer_Commit(renderer);
+    AudioRenderer_StopRecord(renderer);
+    RunCycle(id, 200);
+    CHECK_TRUE(FileCarriesOnFrom(200 * TEST_CYCLE_FRAMES - TEST_HISTORY_FRAMES, TEST_HISTORY_FRAMES + TEST_CYCLE_FRAMES));
+}
+
+TEST_SETUP(AudioRenderer)
+{
+    ADD_TEST(AudioRenderer, CommitKeepsTheHistoryAndCarriesOn);
+    ADD_TEST(AudioRenderer, StopBeforeHandoverKeepsJustTheHistory);
+    ADD_TEST(AudioRenderer, UncommittedCaptureIsDiscarded);
+    ADD_TEST(AudioRenderer, CaptureLeavesNoFileBehind);
+    ADD_TEST(AudioRenderer, NeverShedUnderOverload);
+}
+
+TEST_BRINGUP(AudioRenderer)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(AudioRenderer)
+{
+    CoreEngine_Deinit(&ctx_);
+    remove(TEST_WAV_PATH);
+}
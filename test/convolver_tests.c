@@ -0,0 +1,168 @@
+#include "test_framework.h"
+#include "test_wav.h"
+#include <convolver.h>
+#include <core_engine.h>
+#include <math.h>
+#include <resampler.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_WAV_PATH "/tmp/jamcore_convolver_test.wav"
+#define TEST_CYCLE_FRAMES 300 // Doesn't divide any block size, so chunks get split
+#define TEST_IR_FRAMES 18000 // Long enough to reach the last tier
+#define TEST_INPUT_FRAMES 40000
+#define TEST_TOLERANCE 1e-3
+
+static CoreEngineContext ctx_;
+static f32 ir_[TEST_IR_FRAMES * 2];
+static f32 input_[TEST_INPUT_FRAMES * 2];
+static f32 output_[TEST_INPUT_FRAMES * 2];
+
+static f32 Noise(u32* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (f32)(*state >> 8) / (f32)(1 << 23) - 1.0f;
+}
+
+static void FillIr(u32 numFrames)
+{
+    u32 state = 1;
+    for (u32 i = 0; i < numFrames * 2; i++) {
+        ir_[i] = 0.05f * expf(-(f32)(i / 2) / 6000.0f) * Noise(&state);
+    }
+}
+
+static void FillInput(u32 numFrames)
+{
+    u32 state = 2;
+    for (u32 i = 0; i < numFrames * 2; i++) {
+        input_[i] = Noise(&state);
+    }
+}
+
+static f64 Reference(u32 irFrames, u32 frame, u32 channel)
+{
+    f64 sum = 0.0;
+    for (u32 i = 0; i < irFrames && i <= frame; i++) {
+        sum += (f64)ir_[i * 2 + channel] * input_[(frame - i) * 2 + channel];
+    }
+    return sum;
+}
+
+// Runs the input through in engine sized cycles, letting the workers catch up after each
+static void Run(Convolver* conv, u16 id, u32 numFrames, bool waitForWorkers)
+{
+    AudioProcessor* proc = &ctx_.processors[id];
+    memcpy(output_, input_, numFrames * 2 * sizeof(f32));
+    for (u32 done = 0; done < numFrames; done += TEST_CYCLE_FRAMES) {
+        u16 cycleFrames = (u16)((numFrames - done < TEST_CYCLE_FRAMES) ? numFrames - done : TEST_CYCLE_FRAMES);
+        proc->Process(SAMPLE_RATE_DEFAULT, cycleFrames, output_ + done * 2, proc->procData);
+
+        for (u32 t = 0; waitForWorkers && t < conv->numTiers; t++) {
+            ConvolverTier* tier = &conv->tiers[t];
+            while (atomic_load(&tier->numConsumed) != atomic_load(&tier->numSubmitted)) {
+                ThreadPool_FlushTasks(&ctx_.threadPool);
+            }
+        }
+    }
+}
+
+static bool MatchesReference(u32 irFrames, u32 fromFrame, u32 toFrame, u32 step)
+{
+    bool ok = true;
+    for (u32 frame = fromFrame; frame < toFrame; frame += step) {
+        for (u32 c = 0; c < 2; c++) {
+            ok &= (fabs(output_[frame * 2 + c] - Reference(irFrames, frame, c)) < TEST_TOLERANCE);
+        }
+    }
+    return ok;
+}
+
+TEST(Convolver, ImpulseGivesTheIrBack)
+{
+    FillIr(1000);
+    memset(input_, 0, sizeof(input_));
+    input_[0] = input_[1] = 1.0f;
+
+    Convolver* conv = CoreEngine_New(&ctx_, Convolver);
+    u16 id = Convolver_CreateFromFrames(conv, &ctx_, ir_, 1000);
+    CHECK_TRUE(conv->numTiers == 0);
+    Run(conv, id, 1200, false);
+
+    // Direct form is exact, the partitions after it aren't quite
+    bool exact = true;
+    bool close = true;
+    for (u32 i = 0; i < 1200 * 2; i++) {
+        f32 expected = (i < 1000 * 2) ? ir_[i] : 0.0f;
+        if (i < CONVOLVER_HEAD_FRAMES * 2) {
+            exact &= (output_[i] == expected);
+        }
+        close &= (fabsf(output_[i] - expected) < 1e-5f);
+    }
+    CHECK_TRUE(exact);
+    CHECK_TRUE(close);
+}
+
+TEST(Convolver, MatchesDirectConvolution)
+{
+    FillIr(TEST_IR_FRAMES);
+    FillInput(TEST_INPUT_FRAMES);
+
+    ThreadPool_Start(&ctx_.threadPool);
+    Convolver* conv = CoreEngine_New(&ctx_, Convolver);
+    u16 id = Convolver_CreateFromFrames(conv, &ctx_, ir_, TEST_IR_FRAMES);
+    CHECK_TRUE(conv->numTiers == 2);
+    Run(conv, id, TEST_INPUT_FRAMES, true);
+    ThreadPool_Stop(&ctx_.threadPool);
+
+    CHECK_TRUE(MatchesReference(TEST_IR_FRAMES, 0, TEST_INPUT_FRAMES, 97));
+    CHECK_TRUE(atomic_load(&conv->tiers[0].numLateBlocks) == 0);
+    CHECK_TRUE(atomic_load(&conv->tiers[1].numLateBlocks) == 0);
+}
+
+TEST(Convolver, LateWorkersOnlyCostTheTail)
+{
+    FillIr(TEST_IR_FRAMES);
+    FillInput(TEST_INPUT_FRAMES);
+
+    // Nothing ever runs the tiers
+    Convolver* conv = CoreEngine_New(&ctx_, Convolver);
+    u16 id = Convolver_CreateFromFrames(conv, &ctx_, ir_, TEST_IR_FRAMES);
+    Run(conv, id, TEST_INPUT_FRAMES, false);
+
+    CHECK_TRUE(atomic_load(&conv->tiers[0].numLateBlocks) > 0);
+    CHECK_TRUE(atomic_load(&conv->tiers[1].numLateBlocks) > 0);
+    CHECK_TRUE(MatchesReference(TEST_IR_FRAMES, 0, 2048, 7));
+}
+
+TEST(Convolver, ResamplesTheIrFile)
+{
+    // A mono impulse at 24 kHz
+    static i16 samples[2400];
+    samples[0] = 16384;
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_PCM, 0, 1, 16, 24000, samples, sizeof(samples));
+
+    Convolver* conv = CoreEngine_New(&ctx_, Convolver);
+    Convolver_Create(conv, &ctx_, TEST_WAV_PATH);
+    CHECK_TRUE(conv->irFrames == Resampler_OutputFrames(24000, SAMPLE_RATE_DEFAULT, 2400));
+    CHECK_TRUE(conv->numTiers == 1);
+}
+
+TEST_SETUP(Convolver)
+{
+    ADD_TEST(Convolver, ImpulseGivesTheIrBack);
+    ADD_TEST(Convolver, MatchesDirectConvolution);
+    ADD_TEST(Convolver, LateWorkersOnlyCostTheTail);
+    ADD_TEST(Convolver, ResamplesTheIrFile);
+}
+
+TEST_BRINGUP(Convolver)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(Convolver)
+{
+    CoreEngine_Deinit(&ctx_);
+    remove(TEST_WAV_PATH);
+}
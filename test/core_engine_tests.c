@@ -126,6 +126,25 @@ TEST(CoreEngine, ProcessAudio)
     CoreEngine_Deinit(&ctx);
 }
 
+TEST(CoreEngine, SourcesPlayThroughShedding)
+{
+    CoreEngineContext ctx;
+    FakeProcessor proc;
+
+    // Created without asking for a priority, then everything that can be shed is
+    CoreEngine_Init(&ctx, 1.0f, 4096);
+    u16 id = FakeProcessor_Create(&proc, &ctx, BUFFER_SIZE);
+    CoreEngine_AddSource(&ctx, id);
+    atomic_store(&ctx.loadMonitor.shedLevel, NUM_PROCESSOR_PRIORITIES - 1);
+    CoreEngine_Start(&ctx);
+
+    bool processed = FakeProcessor_WaitForData(&proc);
+    CoreEngine_Stop(&ctx);
+    CoreEngine_Deinit(&ctx);
+
+    CHECK_TRUE(processed);
+}
+
 TEST(CoreEngine, Routing)
 {
     // TODO
@@ -139,6 +158,7 @@ TEST_SETUP(CoreEngine)
     ADD_TEST(CoreEngine, Stop);
     ADD_TEST(CoreEngine, CreateProcessors);
     ADD_TEST(CoreEngine, ProcessAudio);
+    ADD_TEST(CoreEngine, SourcesPlayThroughShedding);
 }
 
 TEST_BRINGUP(CoreEngine)
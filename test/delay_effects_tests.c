@@ -0,0 +1,193 @@
+#include "test_framework.h"
+#include <core_engine.h>
+#include <delay_effects.h>
+#include <math.h>
+#include <string.h>
+
+#define TEST_CYCLE_FRAMES 512
+#define TEST_NUM_FRAMES (TEST_CYCLE_FRAMES * 200)
+
+static CoreEngineContext ctx_;
+static f32 input_[TEST_NUM_FRAMES * 2];
+static f32 buffer_[TEST_NUM_FRAMES * 2];
+
+static void FillNoise(void)
+{
+    u32 state = 6;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        state = state * 1664525u + 1013904223u;
+        input_[i] = (f32)(state >> 8) / (f32)(1 << 23) - 1.0f;
+    }
+}
+
+static void RunAt(u16 id, f64 sampleRate)
+{
+    memcpy(buffer_, input_, sizeof(buffer_));
+    AudioProcessor* proc = &ctx_.processors[id];
+    for (u32 done = 0; done < TEST_NUM_FRAMES; done += TEST_CYCLE_FRAMES) {
+        proc->Process(sampleRate, TEST_CYCLE_FRAMES, buffer_ + done * 2, proc->procData);
+    }
+}
+
+static void Run(u16 id)
+{
+    RunAt(id, SAMPLE_RATE_DEFAULT);
+}
+
+static bool IsDelayedBy(u32 delay, f32 tolerance)
+{
+    bool ok = true;
+    for (u32 i = delay * 2; i < TEST_NUM_FRAMES * 2; i++) {
+        ok &= (fabsf(buffer_[i] - input_[i - delay * 2]) < tolerance);
+    }
+    return ok;
+}
+
+TEST(DelayEffects, DelayRepeatsDieAwayByTheFeedback)
+{
+    memset(input_, 0, sizeof(input_));
+    input_[0] = 1.0f;
+    input_[1] = -1.0f;
+
+    DelayEffect* delay = CoreEngine_New(&ctx_, DelayEffect);
+    u16 id = DelayEffect_Create(delay, &ctx_, 2.0, 0.01, 0.02, 0.5f);
+    DelayEffect_SetMix(delay, 0.0f, 1.0f);
+    Run(id);
+
+    CHECK_TRUE(fabsf(buffer_[480 * 2] - 1.0f) < 1e-4f);
+    CHECK_TRUE(fabsf(buffer_[960 * 2] - 0.5f) < 1e-4f);
+    CHECK_TRUE(fabsf(buffer_[1440 * 2] - 0.25f) < 1e-4f);
+    CHECK_TRUE(fabsf(buffer_[960 * 2 + 1] + 1.0f) < 1e-4f);
+    CHECK_TRUE(fabsf(buffer_[1920 * 2 + 1] + 0.5f) < 1e-4f);
+    CHECK_TRUE(fabsf(buffer_[700 * 2]) < 1e-4f);
+}
+
+TEST(DelayEffects, DelayTimeGlidesWhenMoved)
+{
+    FillNoise();
+
+    DelayEffect* delay = CoreEngine_New(&ctx_, DelayEffect);
+    u16 id = DelayEffect_Create(delay, &ctx_, 2.0, 0.5, 0.5, 0.0f);
+    AudioProcessor* proc = &ctx_.processors[id];
+    proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_, proc->procData);
+    CHECK_TRUE(delay->delayFrames[0] == 24000.0f);
+
+    // A second of cycles is well past the glide, and ten seconds is clamped to the line's two
+    DelayEffect_Set(delay, 1.0, 10.0, 0.0f);
+    proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_, proc->procData);
+    CHECK_TRUE(delay->delayFrames[0] > 24000.0f && delay->delayFrames[0] < 48000.0f);
+    for (u32 cycle = 0; cycle < 100; cycle++) {
+        proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_, proc->procData);
+    }
+    CHECK_TRUE(fabs(delay->delayFrames[0] - 48000.0) < 1.0);
+    CHECK_TRUE(fabs(delay->delayFrames[1] - 96000.0) < 1.0);
+}
+
+TEST(DelayEffects, StillChorusIsOneDelayedVoice)
+{
+    FillNoise();
+
+    // Without depth every voice reads the same whole frame delay and they average to it
+    Chorus* chorus = CoreEngine_New(&ctx_, Chorus);
+    u16 id = Chorus_Create(chorus, &ctx_, 4, 0.8f, 0.0f);
+    Chorus_SetMix(chorus, 0.0f, 1.0f);
+    Run(id);
+
+    u32 delay = (u32)(CHORUS_CENTRE_SECONDS * SAMPLE_RATE_DEFAULT);
+    bool ok = true;
+    for (u32 i = delay * 2; i < TEST_NUM_FRAMES * 2; i++) {
+        ok &= (fabsf(buffer_[i] - input_[i - delay * 2]) < 1e-5f);
+    }
+    CHECK_TRUE(ok);
+
+    // With it the voices spread out around the centre
+    Chorus_Set(chorus, 0.8f, 0.005f);
+    Run(id);
+    f64 differences = 0.0;
+    for (u32 i = TEST_NUM_FRAMES; i < TEST_NUM_FRAMES * 2; i++) {
+        differences += fabsf(buffer_[i] - input_[i - delay * 2]);
+    }
+    CHECK_TRUE(differences > 1000.0);
+}
+
+TEST(DelayEffects, FlangerFeedbackStaysBounded)
+{
+    FillNoise();
+
+    f32 feedbacks[2] = { FLANGER_MAX_FEEDBACK, -FLANGER_MAX_FEEDBACK };
+    for (u32 f = 0; f < 2; f++) {
+        Flanger* flanger = CoreEngine_New(&ctx_, Flanger);
+        u16 id = Flanger_Create(flanger, &ctx_, 0.5f, 0.003f, 2.0f);
+        CHECK_TRUE(atomic_load(&flanger->feedback) == FLANGER_MAX_FEEDBACK);
+        Flanger_Set(flanger, 0.5f, 0.003f, feedbacks[f]);
+        Run(id);
+
+        f32 peak = 0.0f;
+        for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+            peak = fmaxf(peak, fabsf(buffer_[i]));
+        }
+        CHECK_TRUE(isfinite(peak) && peak > 1.0f && peak < 50.0f);
+    }
+}
+
+TEST(DelayEffects, SweepsFitTheLineAtHigherRates)
+{
+    FillNoise();
+
+    // At 4x, as inside an Oversampler, the still chorus is the same 15ms
+    Chorus* chorus = CoreEngine_New(&ctx_, Chorus);
+    u16 id = Chorus_Create(chorus, &ctx_, 2, 0.8f, 0.0f);
+    Chorus_SetMix(chorus, 0.0f, 1.0f);
+    RunAt(id, SAMPLE_RATE_DEFAULT * 4);
+    CHECK_TRUE(IsDelayedBy((u32)(CHORUS_CENTRE_SECONDS * SAMPLE_RATE_DEFAULT * 4), 1e-5f));
+
+    // Past the most the line is sized for it shrinks to the line rather than wrapping round it
+    Chorus_SetMix(chorus, 0.0f, 1.0f);
+    RunAt(id, SAMPLE_RATE_DEFAULT * DELAY_EFFECT_MAX_RATE_FACTOR * 2);
+    CHECK_TRUE(IsDelayedBy((u32)chorus->maxFrames, 1e-5f));
+
+    // A flanger at full depth at 4x reads the whole sweep back out of the line, checked
+    // against interpolating the input directly along the same LFO
+    Flanger* flanger = CoreEngine_New(&ctx_, Flanger);
+    id = Flanger_Create(flanger, &ctx_, 2.0f, FLANGER_MAX_DEPTH_SECONDS, 0.0f);
+    Flanger_SetMix(flanger, 0.0f, 1.0f);
+    f64 sampleRate = SAMPLE_RATE_DEFAULT * 4;
+    RunAt(id, sampleRate);
+
+    f32 swing = (f32)(FLANGER_MAX_DEPTH_SECONDS * sampleRate) / 2.0f;
+    f32 centre = (f32)(FLANGER_MIN_DELAY_SECONDS * sampleRate) + swing;
+    f64 phase = 0.0;
+    bool ok = true;
+    for (u32 i = 0; i < TEST_NUM_FRAMES; i++) {
+        f64 position = i - (f64)(centre + swing * (f32)sin(2.0 * M_PI * phase));
+        phase += 2.0 / sampleRate;
+        phase -= (phase >= 1.0) ? 1.0 : 0.0;
+        if (position < 0.0) {
+            continue;
+        }
+        u32 frame = (u32)position;
+        f32 t = (f32)(position - frame);
+        f32 expected = input_[frame * 2] + (input_[frame * 2 + 2] - input_[frame * 2]) * t;
+        ok &= (fabsf(buffer_[i * 2] - expected) < 1e-3f);
+    }
+    CHECK_TRUE(ok);
+}
+
+TEST_SETUP(DelayEffects)
+{
+    ADD_TEST(DelayEffects, DelayRepeatsDieAwayByTheFeedback);
+    ADD_TEST(DelayEffects, DelayTimeGlidesWhenMoved);
+    ADD_TEST(DelayEffects, StillChorusIsOneDelayedVoice);
+    ADD_TEST(DelayEffects, FlangerFeedbackStaysBounded);
+    ADD_TEST(DelayEffects, SweepsFitTheLineAtHigherRates);
+}
+
+TEST_BRINGUP(DelayEffects)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(DelayEffects)
+{
+    CoreEngine_Deinit(&ctx_);
+}
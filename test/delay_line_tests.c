@@ -0,0 +1,105 @@
+#include "test_framework.h"
+#include <allocator.h>
+#include <delay_line.h>
+#include <math.h>
+
+#define TEST_NUM_FRAMES 20000 // Past the line's capacity, so reads and writes wrap
+#define TEST_MAX_DELAY 4000
+
+static HeapArena arena_;
+static f32 input_[TEST_NUM_FRAMES * 2];
+static f32 output_[TEST_NUM_FRAMES * 2];
+
+static f64 Tone(f64 frame, u32 channel)
+{
+    f64 phase = 2.0 * M_PI * 500.0 * frame / 48000.0;
+    return channel ? 0.5 * cos(phase) : sin(phase);
+}
+
+// Reads then writes in the longest runs the delays allow, every frame the same delays
+static void Run(DelayLine* line, DelayInterp interp, f32 delayLeft, f32 delayRight)
+{
+    DelayTapState state = { 0 };
+    u32 maxRun = DelayLine_MaxRun((delayLeft < delayRight) ? delayLeft : delayRight);
+    f32 delays[DELAY_LINE_MAX_RUN_FRAMES * 2];
+    for (u32 i = 0; i < DELAY_LINE_MAX_RUN_FRAMES; i++) {
+        delays[i * 2] = delayLeft;
+        delays[i * 2 + 1] = delayRight;
+    }
+
+    for (u32 done = 0; done < TEST_NUM_FRAMES; done += maxRun) {
+        u32 numFrames = (TEST_NUM_FRAMES - done < maxRun) ? TEST_NUM_FRAMES - done : maxRun;
+        DelayLine_Read(line, interp, delays, numFrames, &state, output_ + done * 2);
+        DelayLine_Write(line, input_ + done * 2, numFrames);
+    }
+}
+
+TEST(DelayLine, WholeFrameDelaysAreExact)
+{
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        input_[i] = (f32)(i % 1009) - 504.0f;
+    }
+
+    for (u32 interp = 0; interp < DELAY_INTERP_COUNT; interp++) {
+        DelayLine line;
+        DelayLine_Init(&line, &arena_, TEST_MAX_DELAY);
+        CHECK_TRUE(line.capacity == 4096);
+
+        // Short enough for single frame runs on one side, as long as it goes on the other
+        Run(&line, (DelayInterp)interp, 3.0f, TEST_MAX_DELAY);
+        bool ok = true;
+        for (u32 i = 0; i < TEST_NUM_FRAMES; i++) {
+            f32 left = (i >= 3) ? input_[(i - 3) * 2] : 0.0f;
+            f32 right = (i >= TEST_MAX_DELAY) ? input_[(i - TEST_MAX_DELAY) * 2 + 1] : 0.0f;
+            ok &= (output_[i * 2] == left && output_[i * 2 + 1] == right);
+        }
+        CHECK_TRUE(ok);
+    }
+}
+
+TEST(DelayLine, FractionalReadsFollowTheSignal)
+{
+    for (u32 i = 0; i < TEST_NUM_FRAMES; i++) {
+        input_[i * 2] = (f32)Tone(i, 0);
+        input_[i * 2 + 1] = (f32)Tone(i, 1);
+    }
+
+    // Linear droops between frames, cubic hardly, and allpass is right once it settles
+    f32 tolerances[DELAY_INTERP_COUNT] = { 1e-3f, 1e-5f, 1e-3f };
+    for (u32 interp = 0; interp < DELAY_INTERP_COUNT; interp++) {
+        DelayLine line;
+        DelayLine_Init(&line, &arena_, TEST_MAX_DELAY);
+        Run(&line, (DelayInterp)interp, 100.37f, 2999.81f);
+
+        f64 worst = 0.0;
+        for (u32 i = 4000; i < TEST_NUM_FRAMES; i++) {
+            worst = fmax(worst, fabs(output_[i * 2] - Tone(i - 100.37, 0)));
+            worst = fmax(worst, fabs(output_[i * 2 + 1] - Tone(i - 2999.81, 1)));
+        }
+        CHECK_TRUE(worst < tolerances[interp]);
+    }
+}
+
+TEST(DelayLine, RunsKeepClearOfTheirOwnFrames)
+{
+    CHECK_TRUE(DelayLine_MaxRun(DELAY_LINE_MIN_DELAY_FRAMES) == 1);
+    CHECK_TRUE(DelayLine_MaxRun(24.5f) == 22);
+    CHECK_TRUE(DelayLine_MaxRun(48000.0f) == DELAY_LINE_MAX_RUN_FRAMES);
+}
+
+TEST_SETUP(DelayLine)
+{
+    ADD_TEST(DelayLine, WholeFrameDelaysAreExact);
+    ADD_TEST(DelayLine, FractionalReadsFollowTheSignal);
+    ADD_TEST(DelayLine, RunsKeepClearOfTheirOwnFrames);
+}
+
+TEST_BRINGUP(DelayLine)
+{
+    HeapArena_Init(&arena_, 1024 * 1024);
+}
+
+TEST_TEARDOWN(DelayLine)
+{
+    HeapArena_Deinit(&arena_);
+}
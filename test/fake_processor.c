@@ -1,5 +1,6 @@
 #include "fake_processor.h"
 #include "logger.h"
+#include "rt_check.h"
 #include <pthread.h>
 #include <sys/errno.h>
 #include <time.h>
@@ -12,6 +13,8 @@ static void ProcessFake(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
 
     LogInfoPeriodic(1000, "Fake processor callback invoked");
 
+    // Test instrumentation, not part of what's being checked
+    RtCheck_BeginAllow();
     pthread_mutex_lock(&proc->mutex);
 
     proc->numFrames = numFrames;
@@ -20,6 +23,7 @@ static void ProcessFake(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
 
     if ((numFrames * 2) > proc->capacity) {
         pthread_mutex_unlock(&proc->mutex);
+        RtCheck_EndAllow();
         Assert(false, "Number of received frames exceeds capacity of fake processor buffer");
     }
 
@@ -27,6 +31,7 @@ static void ProcessFake(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
 
     pthread_mutex_unlock(&proc->mutex);
     pthread_cond_signal(&proc->cond);
+    RtCheck_EndAllow();
 }
 
 static void DestroyFake(void* data)
@@ -48,9 +53,11 @@ static void FakeOnNewAudioCycle(void* data)
     FakeProcessor* proc = (FakeProcessor*)data;
     Assert(proc, "Expected valid FakeProcessor but got null"); 
 
+    RtCheck_BeginAllow();
     pthread_mutex_lock(&proc->mutex);
     proc->newAudioCycleCalled = true;
     pthread_mutex_unlock(&proc->mutex);
+    RtCheck_EndAllow();
 }
 
 u16 FakeProcessor_Create(FakeProcessor* proc, CoreEngineContext* ctx, u16 bufferSize)
@@ -0,0 +1,116 @@
+#include "test_framework.h"
+#include <fft.h>
+#include <math.h>
+#include <string.h>
+
+#define TEST_SIZE 64
+
+static HeapArena arena_;
+
+static f32 Noise(u32* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (f32)(*state >> 8) / (f32)(1 << 23) - 1.0f;
+}
+
+// Brute force transform of numSamples real samples, bin k
+static void Dft(const f32* samples, u32 numSamples, u32 k, f64* re, f64* im)
+{
+    *re = 0.0;
+    *im = 0.0;
+    for (u32 n = 0; n < numSamples; n++) {
+        f64 angle = -2.0 * M_PI * k * n / numSamples;
+        *re += samples[n] * cos(angle);
+        *im += samples[n] * sin(angle);
+    }
+}
+
+TEST(Fft, MatchesTheDft)
+{
+    Fft fft;
+    Fft_Init(&fft, &arena_, TEST_SIZE);
+
+    u32 state = 3;
+    f32 re[TEST_SIZE], im[TEST_SIZE];
+    for (u32 i = 0; i < TEST_SIZE; i++) {
+        re[i] = Noise(&state);
+        im[i] = Noise(&state);
+    }
+
+    f32 outRe[TEST_SIZE], outIm[TEST_SIZE];
+    memcpy(outRe, re, sizeof(re));
+    memcpy(outIm, im, sizeof(im));
+    Fft_Forward(&fft, outRe, outIm);
+
+    bool ok = true;
+    for (u32 k = 0; k < TEST_SIZE; k++) {
+        f64 reRe, reIm, imRe, imIm;
+        Dft(re, TEST_SIZE, k, &reRe, &reIm);
+        Dft(im, TEST_SIZE, k, &imRe, &imIm);
+        ok &= (fabs(outRe[k] - (reRe - imIm)) < 1e-4 && fabs(outIm[k] - (reIm + imRe)) < 1e-4);
+    }
+    CHECK_TRUE(ok);
+
+    // Taken apart as two real signals and put back, then inverted, it comes back scaled
+    f32 aRe[TEST_SIZE / 2 + 1], aIm[TEST_SIZE / 2 + 1], bRe[TEST_SIZE / 2 + 1], bIm[TEST_SIZE / 2 + 1];
+    Fft_SplitReal(&fft, outRe, outIm, aRe, aIm, bRe, bIm);
+    Fft_JoinReal(&fft, aRe, aIm, bRe, bIm, outRe, outIm);
+    Fft_Inverse(&fft, outRe, outIm);
+    ok = true;
+    for (u32 i = 0; i < TEST_SIZE; i++) {
+        ok &= (fabsf(outRe[i] - re[i] * TEST_SIZE * 2) < 1e-3f && fabsf(outIm[i] - im[i] * TEST_SIZE * 2) < 1e-3f);
+    }
+    CHECK_TRUE(ok);
+}
+
+TEST(Fft, RealTransformMatchesTheDft)
+{
+    // Small enough for the radix 4 pass alone, and big enough for the vector stages too
+    u32 sizes[] = { 2, 4, TEST_SIZE };
+    for (u32 s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        u32 size = sizes[s];
+        Fft fft;
+        Fft_Init(&fft, &arena_, size);
+
+        u32 state = 4;
+        f32 samples[TEST_SIZE * 2];
+        for (u32 i = 0; i < size * 2; i++) {
+            samples[i] = Noise(&state);
+        }
+
+        f32 re[TEST_SIZE + 1], im[TEST_SIZE + 1];
+        Fft_ForwardReal(&fft, samples, re, im);
+
+        bool ok = true;
+        for (u32 k = 0; k <= size; k++) {
+            f64 dftRe, dftIm;
+            Dft(samples, size * 2, k, &dftRe, &dftIm);
+            ok &= (fabs(re[k] - dftRe) < 1e-4 && fabs(im[k] - dftIm) < 1e-4);
+        }
+        CHECK_TRUE(ok);
+
+        f32 output[TEST_SIZE * 2];
+        Fft_InverseReal(&fft, re, im, output);
+        ok = true;
+        for (u32 i = 0; i < size * 2; i++) {
+            ok &= (fabsf(output[i] - samples[i] * size) < 1e-4f);
+        }
+        CHECK_TRUE(ok);
+    }
+}
+
+TEST_SETUP(Fft)
+{
+    ADD_TEST(Fft, MatchesTheDft);
+    ADD_TEST(Fft, RealTransformMatchesTheDft);
+}
+
+TEST_BRINGUP(Fft)
+{
+    HeapArena_Init(&arena_, 64 * 1024);
+}
+
+TEST_TEARDOWN(Fft)
+{
+    HeapArena_Deinit(&arena_);
+}
@@ -0,0 +1,75 @@
+#include "test_framework.h"
+#include <interpolator.h>
+#include <math.h>
+#include <string.h>
+
+#define TEST_NUM_FRAMES 4096
+
+static f32 src_[TEST_NUM_FRAMES * 2];
+static f32 dst_[TEST_NUM_FRAMES * 2];
+
+// Worst error reading a 1kHz sine at 48kHz at rate from frame 8 on
+static f64 SineError(Interpolation mode, f64 rate)
+{
+    for (u32 i = 0; i < TEST_NUM_FRAMES; i++) {
+        src_[i * 2] = (f32)sin(2.0 * M_PI * 1000.0 * i / 48000.0);
+        src_[i * 2 + 1] = -src_[i * 2];
+    }
+    memset(dst_, 0, sizeof(dst_));
+
+    u32 numFrames = 2000;
+    Interpolator_Process(mode, src_, 8.0, rate, 0.0, numFrames, dst_);
+
+    f64 maxError = 0.0;
+    for (u32 i = 0; i < numFrames; i++) {
+        f64 expected = sin(2.0 * M_PI * 1000.0 * (8.0 + i * rate) / 48000.0);
+        maxError = fmax(maxError, fmax(fabs(dst_[i * 2] - expected), fabs(dst_[i * 2 + 1] + expected)));
+    }
+    return maxError;
+}
+
+TEST(Interpolator, WholeFramesAreExact)
+{
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        src_[i] = (f32)((i * 7919) % 1000) / 1000.0f - 0.5f;
+    }
+
+    for (u32 mode = 0; mode < INTERPOLATION_COUNT; mode++) {
+        memset(dst_, 0, sizeof(dst_));
+        f64 position = Interpolator_Process(mode, src_, INTERPOLATOR_HISTORY, 1.0, 0.0, 1000, dst_);
+        CHECK_TRUE(position == INTERPOLATOR_HISTORY + 1000);
+        CHECK_TRUE(memcmp(dst_, src_ + INTERPOLATOR_HISTORY * 2, 1000 * 2 * sizeof(f32)) == 0);
+    }
+}
+
+TEST(Interpolator, FollowsSinesBetweenFrames)
+{
+    CHECK_TRUE(SineError(INTERPOLATION_LINEAR, 0.7) < 5e-3);
+    CHECK_TRUE(SineError(INTERPOLATION_CUBIC, 0.7) < 1e-4);
+    CHECK_TRUE(SineError(INTERPOLATION_SINC, 0.7) < 1e-3);
+    CHECK_TRUE(SineError(INTERPOLATION_CUBIC, 1.9) < 1e-4);
+}
+
+TEST(Interpolator, RampsTheRate)
+{
+    memset(src_, 0, sizeof(src_));
+    f64 position = Interpolator_Process(INTERPOLATION_CUBIC, src_, 10.0, 0.5, 0.01, 100, dst_);
+    CHECK_TRUE(fabs(position - (10.0 + 100 * 0.5 + 0.01 * 100 * 99 / 2.0)) < 1e-9);
+}
+
+TEST_SETUP(Interpolator)
+{
+    ADD_TEST(Interpolator, WholeFramesAreExact);
+    ADD_TEST(Interpolator, FollowsSinesBetweenFrames);
+    ADD_TEST(Interpolator, RampsTheRate);
+}
+
+TEST_BRINGUP(Interpolator)
+{
+    Interpolator_Init();
+}
+
+TEST_TEARDOWN(Interpolator)
+{
+
+}
@@ -0,0 +1,99 @@
+#include "test_framework.h"
+#include <load_monitor.h>
+
+#define BUDGET_NS 10000000ull
+
+static void RunCycles(LoadMonitor* monitor, u32 numCycles, f32 ratio)
+{
+    for (u32 i = 0; i < numCycles; i++) {
+        LoadMonitor_EndCycle(monitor, (u64)(BUDGET_NS * ratio), BUDGET_NS);
+    }
+}
+
+TEST(LoadMonitor, CountsMisses)
+{
+    LoadMonitor monitor;
+    LoadMonitor_Init(&monitor);
+
+    CHECK_DEATH(LoadMonitor_EndCycle(&monitor, 0, 0));
+
+    CHECK_TRUE(!LoadMonitor_EndCycle(&monitor, BUDGET_NS / 2, BUDGET_NS));
+    CHECK_TRUE(!LoadMonitor_EndCycle(&monitor, BUDGET_NS * 0.85, BUDGET_NS));
+    CHECK_TRUE(LoadMonitor_EndCycle(&monitor, BUDGET_NS * 2, BUDGET_NS));
+
+    CHECK_TRUE(atomic_load(&monitor.numCycles) == 3);
+    CHECK_TRUE(atomic_load(&monitor.numNearMisses) == 1);
+    CHECK_TRUE(atomic_load(&monitor.numXruns) == 1);
+    CHECK_TRUE(atomic_load(&monitor.peakLoad) == 2.0f);
+}
+
+TEST(LoadMonitor, ShedsByPriority)
+{
+    LoadMonitor monitor;
+    LoadMonitor_Init(&monitor);
+
+    for (u8 priority = 0; priority < NUM_PROCESSOR_PRIORITIES; priority++) {
+        CHECK_TRUE(!LoadMonitor_ShouldBypass(&monitor, priority));
+    }
+
+    // A miss sheds the lowest class straight away
+    RunCycles(&monitor, 1, 1.5f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == 1);
+    CHECK_TRUE(LoadMonitor_ShouldBypass(&monitor, PROCESSOR_PRIORITY_LOW));
+    CHECK_TRUE(!LoadMonitor_ShouldBypass(&monitor, PROCESSOR_PRIORITY_NORMAL));
+
+    // Further misses wait for the hold period before shedding more
+    RunCycles(&monitor, LOAD_ESCALATE_HOLD_CYCLES - 1, 1.5f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == 1);
+
+    // Sustained overload sheds everything but critical processors
+    RunCycles(&monitor, LOAD_ESCALATE_HOLD_CYCLES * 8, 1.5f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == NUM_PROCESSOR_PRIORITIES - 1);
+    CHECK_TRUE(LoadMonitor_ShouldBypass(&monitor, PROCESSOR_PRIORITY_HIGH));
+    CHECK_TRUE(!LoadMonitor_ShouldBypass(&monitor, PROCESSOR_PRIORITY_CRITICAL));
+}
+
+TEST(LoadMonitor, RestoresWhenCalm)
+{
+    LoadMonitor monitor;
+    LoadMonitor_Init(&monitor);
+
+    RunCycles(&monitor, 1, 1.5f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == 1);
+
+    // Smoothed load takes a while to come down, then needs a full calm period
+    RunCycles(&monitor, 100, 0.1f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == 1);
+    RunCycles(&monitor, LOAD_RESTORE_CYCLES, 0.1f);
+    CHECK_TRUE(atomic_load(&monitor.shedLevel) == 0);
+    CHECK_TRUE(!LoadMonitor_ShouldBypass(&monitor, PROCESSOR_PRIORITY_LOW));
+}
+
+TEST(LoadMonitor, DeviceTimestampGaps)
+{
+    LoadMonitor monitor;
+    LoadMonitor_Init(&monitor);
+
+    CHECK_TRUE(!LoadMonitor_CheckTimestamp(&monitor, 1000.0, 512));
+    CHECK_TRUE(!LoadMonitor_CheckTimestamp(&monitor, 1512.0, 512));
+    CHECK_TRUE(LoadMonitor_CheckTimestamp(&monitor, 2536.0, 512));
+    CHECK_TRUE(atomic_load(&monitor.numDeviceXruns) == 1);
+}
+
+TEST_SETUP(LoadMonitor)
+{
+    ADD_TEST(LoadMonitor, CountsMisses);
+    ADD_TEST(LoadMonitor, ShedsByPriority);
+    ADD_TEST(LoadMonitor, RestoresWhenCalm);
+    ADD_TEST(LoadMonitor, DeviceTimestampGaps);
+}
+
+TEST_BRINGUP(LoadMonitor)
+{
+
+}
+
+TEST_TEARDOWN(LoadMonitor)
+{
+
+}
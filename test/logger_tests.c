@@ -0,0 +1,279 @@
+// Info and below are compiled out of this file alone, whatever the build sets, to check
+// they cost nothing. Round trips go through errors, which are never compiled out.
+#undef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_WARNING
+
+#include "test_framework.h"
+#include <logger.h>
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define CAPTURE_BYTES (256 * 1024)
+
+static FILE* capture_ = NULL;
+static i32 savedStdout_ = -1;
+static char captured_[CAPTURE_BYTES];
+
+// Everything the logger writes goes to stdout, point it at a temporary file for a while
+static void BeginCapture(void)
+{
+    fflush(stdout);
+    capture_ = tmpfile();
+    Assert(capture_, "Failed to create capture file");
+    savedStdout_ = dup(STDOUT_FILENO);
+    dup2(fileno(capture_), STDOUT_FILENO);
+}
+
+static const char* EndCapture(void)
+{
+    Logger_Flush();
+    fflush(stdout);
+    dup2(savedStdout_, STDOUT_FILENO);
+    close(savedStdout_);
+
+    rewind(capture_);
+    u64 length = fread(captured_, 1, CAPTURE_BYTES - 1, capture_);
+    captured_[length] = '\0';
+    fclose(capture_);
+    capture_ = NULL;
+    return captured_;
+}
+
+static u32 CountOccurrences(const char* text, const char* pattern)
+{
+    u32 count = 0;
+    for (const char* p = strstr(text, pattern); p != NULL; p = strstr(p + 1, pattern)) {
+        count++;
+    }
+    return count;
+}
+
+// Raw so nothing but the message is written, other threads may log in between so the
+// expected line is searched for rather than compared against the whole capture
+#define CHECK_ROUND_TRIP(format, ...) {\
+    char __expected[1024];\
+    snprintf(__expected, sizeof(__expected), format "\n", ##__VA_ARGS__);\
+    BeginCapture();\
+    LogErrorRaw(format "\n", ##__VA_ARGS__);\
+    CHECK_TRUE(strstr(EndCapture(), __expected) != NULL);\
+}
+
+static void CheckRoundTrips(TestInfo* __testInfo)
+{
+    CHECK_ROUND_TRIP("int %d %i %u %x %X %o", -42, INT_MIN, 3000000000u, 0xbeef, 0xCAFE, 0755);
+    CHECK_ROUND_TRIP("short %hd %hhu", (short)-7, (unsigned char)200);
+    CHECK_ROUND_TRIP("long long %lld %llu %llx", LLONG_MIN, ULLONG_MAX, 0x123456789abcdefull);
+    CHECK_ROUND_TRIP("long %ld size %zu ptrdiff %td intmax %jd", LONG_MAX, (size_t)SIZE_MAX, (ptrdiff_t)-12345, (intmax_t)INTMAX_MIN);
+    CHECK_ROUND_TRIP("double %f %.3e %g %10.4f %-8.2f|", 3.14159265358979, -1.5e-10, 1e300, 2.5, -0.125);
+    CHECK_ROUND_TRIP("long double %Lf", (long double)0.1);
+    CHECK_ROUND_TRIP("string %s|%-8s|%8s|%.3s", "hello", "left", "right", "truncated");
+    CHECK_ROUND_TRIP("star %*d|%-*d|%.*f|", 6, 42, 5, -3, 2, 3.14159);
+    CHECK_ROUND_TRIP("star %*.*s|%-*.*e|", 7, 2, "abcdef", 12, 1, 12345.678);
+    CHECK_ROUND_TRIP("char %c pointer %p percent %%", 'x', (void*)captured_);
+    CHECK_ROUND_TRIP("mixed %s=%d (%.1f%%) at %p", "load", 97, 97.25, (void*)&savedStdout_);
+}
+
+TEST(Logger, FormatsLikePrintfWhenSynchronous)
+{
+    // Until the logger thread starts every message is captured and formatted in place
+    Logger_Stop();
+    CheckRoundTrips(__testInfo);
+    Logger_Start();
+}
+
+TEST(Logger, FormatsLikePrintfThroughRing)
+{
+    CheckRoundTrips(__testInfo);
+}
+
+TEST(Logger, CopiesStringsInline)
+{
+    char name[32] = "original";
+    char longString[LOG_STRING_BYTES * 2];
+    memset(longString, 'a', sizeof(longString) - 1);
+    longString[sizeof(longString) - 1] = '\0';
+
+    BeginCapture();
+    LogErrorRaw("name=%s\n", name);
+    LogErrorRaw("long=%s|\n", longString);
+
+    // The caller's buffer is gone by the time the logger thread gets to it
+    strcpy(name, "clobbered");
+    memset(longString, 'b', sizeof(longString) - 1);
+    const char* output = EndCapture();
+
+    CHECK_TRUE(strstr(output, "name=original\n") != NULL);
+    CHECK_TRUE(strstr(output, "clobbered") == NULL);
+
+    // Long strings are cut to what fits inline
+    char expected[LOG_STRING_BYTES + 16];
+    memset(expected, 'a', LOG_STRING_BYTES - 1);
+    expected[LOG_STRING_BYTES - 1] = '\0';
+    strcat(expected, "|\n");
+    CHECK_TRUE(strstr(output, expected) != NULL);
+}
+
+typedef struct {
+    u32 numMessages;
+} ProducerArgs;
+
+static void* Producer(void* data)
+{
+    ProducerArgs* args = (ProducerArgs*)data;
+    for (u32 i = 0; i < args->numMessages; i++) {
+        LogErrorRaw("producer %u\n", i);
+    }
+    return NULL;
+}
+
+TEST(Logger, CountsDropsWhenRingFull)
+{
+    u32 numMessages = LOG_RING_CAPACITY * 2;
+    u64 droppedBefore = Logger_GetDroppedCount();
+
+    // Holding stdout stalls the logger thread on its first write, so nothing drains while the
+    // producer runs and a fresh thread's ring takes exactly its capacity
+    BeginCapture();
+    flockfile(stdout);
+
+    pthread_t thread;
+    ProducerArgs args = { .numMessages = numMessages };
+    CHECK_TRUE(pthread_create(&thread, NULL, Producer, &args) == 0);
+    pthread_join(thread, NULL);
+    u64 dropped = Logger_GetDroppedCount() - droppedBefore;
+
+    funlockfile(stdout);
+    const char* output = EndCapture();
+
+    CHECK_TRUE(dropped == numMessages - LOG_RING_CAPACITY);
+    CHECK_TRUE(CountOccurrences(output, "producer ") == LOG_RING_CAPACITY);
+    CHECK_TRUE(strstr(output, "producer 0\n") != NULL);
+    CHECK_TRUE(strstr(output, "Dropped") != NULL);
+}
+
+static _Atomic(u32) numWaiting_ = 0;
+static _Atomic(bool) releaseWaiters_ = false;
+
+static void* HoldRing(void* data)
+{
+    (void)data;
+    LogErrorRaw("holding a ring\n");
+    atomic_fetch_add(&numWaiting_, 1);
+    while (!atomic_load(&releaseWaiters_)) {
+        usleep(100);
+    }
+    return NULL;
+}
+
+TEST(Logger, CountsDropsWithoutFreeRing)
+{
+    // The test thread already holds a ring, so one of these can't get one
+    LogErrorRaw("claiming a ring\n");
+    u64 droppedBefore = Logger_GetDroppedCount();
+    atomic_store(&numWaiting_, 0);
+    atomic_store(&releaseWaiters_, false);
+
+    BeginCapture();
+    pthread_t threads[LOG_MAX_THREADS];
+    for (u32 i = 0; i < LOG_MAX_THREADS; i++) {
+        CHECK_TRUE(pthread_create(&threads[i], NULL, HoldRing, NULL) == 0);
+    }
+    while (atomic_load(&numWaiting_) < LOG_MAX_THREADS) {
+        usleep(100);
+    }
+    u64 dropped = Logger_GetDroppedCount() - droppedBefore;
+
+    atomic_store(&releaseWaiters_, true);
+    for (u32 i = 0; i < LOG_MAX_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    const char* output = EndCapture();
+
+    CHECK_TRUE(dropped >= 1);
+    CHECK_TRUE(CountOccurrences(output, "holding a ring\n") + dropped == LOG_MAX_THREADS);
+    CHECK_TRUE(strstr(output, "no ring free for the thread") != NULL);
+
+    // Rings of exited threads are handed back once drained
+    Logger_Flush();
+    droppedBefore = Logger_GetDroppedCount();
+    CHECK_TRUE(pthread_create(&threads[0], NULL, Producer, &(ProducerArgs) { .numMessages = 1 }) == 0);
+    pthread_join(threads[0], NULL);
+    CHECK_TRUE(Logger_GetDroppedCount() == droppedBefore);
+}
+
+static void* LogOne(void* data)
+{
+    LogErrorRaw("%s\n", (const char*)data);
+    return NULL;
+}
+
+TEST(Logger, MergesThreadsInTimestampOrder)
+{
+    // Stall the logger thread so every message is still queued in its own ring when drained
+    BeginCapture();
+    flockfile(stdout);
+
+    pthread_t thread;
+    LogErrorRaw("merge-1\n");
+    pthread_create(&thread, NULL, LogOne, (void*)"merge-2");
+    pthread_join(thread, NULL);
+    LogErrorRaw("merge-3\n");
+    pthread_create(&thread, NULL, LogOne, (void*)"merge-4");
+    pthread_join(thread, NULL);
+
+    funlockfile(stdout);
+    const char* output = EndCapture();
+
+    const char* first = strstr(output, "merge-1\n");
+    const char* second = strstr(output, "merge-2\n");
+    const char* third = strstr(output, "merge-3\n");
+    const char* fourth = strstr(output, "merge-4\n");
+    CHECK_TRUE(first && second && third && fourth);
+    CHECK_TRUE(first < second && second < third && third < fourth);
+}
+
+TEST(Logger, CompilesOutLevels)
+{
+    i32 numEvaluated = 0;
+
+    BeginCapture();
+    LogTest("compiled-out %d\n", ++numEvaluated);
+    LogTrace("compiled-out %d\n", ++numEvaluated);
+    LogInfo("compiled-out %d\n", ++numEvaluated);
+    LogInfoRaw("compiled-out %d\n", ++numEvaluated);
+    LogInfoOnce("compiled-out %d\n", ++numEvaluated);
+    LogWarnRaw("compiled-in %d\n", ++numEvaluated);
+    const char* output = EndCapture();
+
+    // Arguments of compiled out statements aren't even evaluated
+    CHECK_TRUE(numEvaluated == 1);
+    CHECK_TRUE(strstr(output, "compiled-out") == NULL);
+    CHECK_TRUE(strstr(output, "compiled-in 1\n") != NULL);
+}
+
+TEST_SETUP(Logger)
+{
+    ADD_TEST(Logger, FormatsLikePrintfWhenSynchronous);
+    ADD_TEST(Logger, FormatsLikePrintfThroughRing);
+    ADD_TEST(Logger, CopiesStringsInline);
+    ADD_TEST(Logger, CountsDropsWhenRingFull);
+    ADD_TEST(Logger, CountsDropsWithoutFreeRing);
+    ADD_TEST(Logger, MergesThreadsInTimestampOrder);
+    ADD_TEST(Logger, CompilesOutLevels);
+}
+
+TEST_BRINGUP(Logger)
+{
+    Logger_Start();
+}
+
+TEST_TEARDOWN(Logger)
+{
+    Logger_Stop();
+}
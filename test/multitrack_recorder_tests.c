@@ -0,0 +1,236 @@
+#include "test_framework.h"
+#include <core_engine.h>
+#include <multitrack_recorder.h>
+#include <wav_file.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_INTERLEAVED_PATH "/tmp/jamcore_multitrack_test.wav"
+#define TEST_TRACK_PATH "/tmp/jamcore_multitrack_test_%u.wav"
+#define TEST_CYCLE_FRAMES 480 // Doesn't divide a block, so the last of each file is a flush
+#define TEST_MAX_TRACKS 16
+
+static CoreEngineContext ctx_;
+static MultitrackRecorder recorder_;
+static u16 taps_[TEST_MAX_TRACKS];
+static f32 buffer_[TEST_CYCLE_FRAMES * 2];
+
+// Distinct per track and per frame, and exact in 16 bits
+static f32 TestSample(u32 track, u64 sampleIndex)
+{
+    return (f32)((i32)((sampleIndex * 7 + track * 1009) % 65536) - 32768) / 32768.0f;
+}
+
+static void TrackPath(char* path, u32 track)
+{
+    snprintf(path, 64, TEST_TRACK_PATH, track);
+}
+
+static u32 AddTracks(u32 numTracks)
+{
+    for (u32 t = 0; t < numTracks; t++) {
+        char path[64];
+        TrackPath(path, t);
+        taps_[t] = MultitrackRecorder_AddTrack(&recorder_, &ctx_, recorder_.layout == MULTITRACK_INTERLEAVED ? NULL : path);
+    }
+    return numTracks;
+}
+
+// Every tap latches, then each gets its own bus starting at frame
+static void RunCycle(u32 numTracks, u64 frame)
+{
+    for (u32 t = 0; t < numTracks; t++) {
+        AudioProcessor* proc = &ctx_.processors[taps_[t]];
+        proc->OnNewAudioCycle(proc->procData);
+    }
+    for (u32 t = 0; t < numTracks; t++) {
+        for (u32 i = 0; i < TEST_CYCLE_FRAMES * 2; i++) {
+            buffer_[i] = TestSample(t, frame * 2 + i);
+        }
+        AudioProcessor* proc = &ctx_.processors[taps_[t]];
+        proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_, proc->procData);
+    }
+}
+
+TEST(MultitrackRecorder, PerTrackFilesStartAndStopTogether)
+{
+    MultitrackRecorder_Init(&recorder_, MULTITRACK_FILE_PER_TRACK, NULL, PCM_FORMAT_F32, PCM_DITHER_NONE, 3);
+    u32 numTracks = AddTracks(3);
+    CHECK_TRUE(ctx_.processors[taps_[0]].priority == PROCESSOR_PRIORITY_CRITICAL);
+
+    // Only the middle 200 cycles are recorded
+    u64 frame = 0;
+    for (u32 c = 0; c < 300; c++, frame += TEST_CYCLE_FRAMES) {
+        if (c == 50) {
+            MultitrackRecorder_StartRecord(&recorder_);
+        }
+        if (c == 250) {
+            MultitrackRecorder_StopRecord(&recorder_);
+        }
+        RunCycle(numTracks, frame);
+    }
+    MultitrackRecorder_Deinit(&recorder_);
+    CHECK_TRUE(atomic_load(&recorder_.bytesWritten) == 3ull * 200 * TEST_CYCLE_FRAMES * 8);
+
+    for (u32 t = 0; t < numTracks; t++) {
+        char path[64];
+        TrackPath(path, t);
+        WavFile file;
+        WavFile_Open(&file, path);
+        CHECK_TRUE(file.totalFrames == 200 * TEST_CYCLE_FRAMES);
+
+        bool ok = true;
+        const f32* frames = WavFile_MapFrames(&file, 0);
+        for (u64 i = 0; i < file.totalFrames * 2; i++) {
+            ok &= (frames[i] == TestSample(t, 50 * TEST_CYCLE_FRAMES * 2 + i));
+        }
+        CHECK_TRUE(ok);
+        WavFile_Close(&file);
+    }
+}
+
+TEST(MultitrackRecorder, InterleavesAChannelPairPerTrack)
+{
+    MultitrackRecorder_Init(&recorder_, MULTITRACK_INTERLEAVED, TEST_INTERLEAVED_PATH, PCM_FORMAT_S16, PCM_DITHER_NONE, 3);
+    u32 numTracks = AddTracks(3);
+
+    MultitrackRecorder_StartRecord(&recorder_);
+    CHECK_TRUE(recorder_.batchFrames == RECORD_RING_BLOCK_FRAMES);
+    for (u32 c = 0; c < 200; c++) {
+        RunCycle(numTracks, (u64)c * TEST_CYCLE_FRAMES);
+    }
+    MultitrackRecorder_StopRecord(&recorder_);
+    MultitrackRecorder_Deinit(&recorder_);
+
+    WavFile file;
+    WavFile_Open(&file, TEST_INTERLEAVED_PATH);
+    CHECK_TRUE(file.numChannels == 6 && file.format == PCM_FORMAT_S16);
+    CHECK_TRUE(file.totalFrames == 200 * TEST_CYCLE_FRAMES);
+    WavFile_Close(&file);
+
+    // Frame by frame, each track's pair in the order they were added
+    static i16 samples[200 * TEST_CYCLE_FRAMES * 6];
+    i32 fd = open(TEST_INTERLEAVED_PATH, O_RDONLY);
+    CHECK_TRUE(pread(fd, samples, sizeof(samples), WAV_WRITER_HEADER_SIZE) == sizeof(samples));
+    close(fd);
+
+    bool ok = true;
+    for (u32 f = 0; f < 200 * TEST_CYCLE_FRAMES; f++) {
+        for (u32 t = 0; t < numTracks; t++) {
+            for (u32 c = 0; c < 2; c++) {
+                ok &= (samples[f * 6 + t * 2 + c] == (i16)(TestSample(t, (u64)f * 2 + c) * 32768.0f));
+            }
+        }
+    }
+    CHECK_TRUE(ok);
+}
+
+TEST(MultitrackRecorder, BatchesEveryTrackThroughOneWriter)
+{
+    MultitrackRecorder_Init(&recorder_, MULTITRACK_FILE_PER_TRACK, NULL, PCM_FORMAT_F32, PCM_DITHER_NONE, TEST_MAX_TRACKS);
+    u32 numTracks = AddTracks(TEST_MAX_TRACKS);
+
+    // Faster than real time, the rings hold it all whether or not the writer keeps up
+    MultitrackRecorder_StartRecord(&recorder_);
+    u32 numCycles = MULTITRACK_RING_FRAMES / TEST_CYCLE_FRAMES;
+    for (u32 c = 0; c < numCycles; c++) {
+        RunCycle(numTracks, (u64)c * TEST_CYCLE_FRAMES);
+    }
+    MultitrackRecorder_StopRecord(&recorder_);
+    CHECK_TRUE(MultitrackRecorder_MegabytesPerSecond(&recorder_) >= 0.0);
+    MultitrackRecorder_Deinit(&recorder_);
+
+    // Whole blocks and a flush at most, never a write per cycle
+    u64 trackFrames = (u64)numCycles * TEST_CYCLE_FRAMES;
+    u64 maxWritesPerTrack = trackFrames / RECORD_RING_BLOCK_FRAMES + 1;
+    CHECK_TRUE(atomic_load(&recorder_.bytesWritten) == numTracks * trackFrames * 8);
+    CHECK_TRUE(atomic_load(&recorder_.numWrites) <= numTracks * maxWritesPerTrack);
+    for (u32 t = 0; t < numTracks; t++) {
+        CHECK_TRUE(atomic_load(&recorder_.tracks[t].framesWritten) == trackFrames);
+        CHECK_TRUE(atomic_load(&recorder_.tracks[t].ring.numOverruns) == 0);
+    }
+
+    char path[64];
+    TrackPath(path, TEST_MAX_TRACKS - 1);
+    WavFile file;
+    WavFile_Open(&file, path);
+    CHECK_TRUE(file.totalFrames == trackFrames);
+    const f32* frames = WavFile_MapFrames(&file, 0);
+    CHECK_TRUE(frames[trackFrames * 2 - 1] == TestSample(TEST_MAX_TRACKS - 1, trackFrames * 2 - 1));
+    WavFile_Close(&file);
+}
+
+TEST(MultitrackRecorder, OneTrackFallingBehindSkipsTheCycleOnAll)
+{
+    MultitrackRecorder_Init(&recorder_, MULTITRACK_FILE_PER_TRACK, NULL, PCM_FORMAT_F32, PCM_DITHER_NONE, 3);
+    u32 numTracks = AddTracks(3);
+
+    // The writer is held off draining, and the middle track's ring is backed up to leave
+    // room for just 10 cycles
+    RecordRing* behind = &recorder_.tracks[1].ring;
+    u32 backlogFrames = MULTITRACK_RING_FRAMES - 10 * TEST_CYCLE_FRAMES;
+    pthread_mutex_lock(&recorder_.mutex);
+    MultitrackRecorder_StartRecord(&recorder_);
+    RecordRing_Write(behind, NULL, backlogFrames);
+
+    // Cycles 10 to 19 don't fit it, so none of the tracks take them
+    for (u32 c = 0; c < 20; c++) {
+        RunCycle(numTracks, (u64)c * TEST_CYCLE_FRAMES);
+    }
+    CHECK_TRUE(atomic_load(&recorder_.numSkippedCycles) == 10);
+
+    // Caught up, the rest fits everywhere
+    RecordRing_Consume(behind, backlogFrames);
+    for (u32 c = 20; c < 40; c++) {
+        RunCycle(numTracks, (u64)c * TEST_CYCLE_FRAMES);
+    }
+    pthread_mutex_unlock(&recorder_.mutex);
+    MultitrackRecorder_StopRecord(&recorder_);
+    MultitrackRecorder_Deinit(&recorder_);
+    CHECK_TRUE(atomic_load(&behind->numOverruns) == 0);
+
+    // Every stem is cycles 0 to 9 then 20 to 39, frame for frame
+    for (u32 t = 0; t < numTracks; t++) {
+        char path[64];
+        TrackPath(path, t);
+        WavFile file;
+        WavFile_Open(&file, path);
+        CHECK_TRUE(file.totalFrames == 30 * TEST_CYCLE_FRAMES);
+
+        bool ok = true;
+        const f32* frames = WavFile_MapFrames(&file, 0);
+        for (u64 f = 0; f < file.totalFrames; f++) {
+            u64 source = (f < 10 * TEST_CYCLE_FRAMES) ? f : f + 10 * TEST_CYCLE_FRAMES;
+            ok &= (frames[f * 2] == TestSample(t, source * 2));
+            ok &= (frames[f * 2 + 1] == TestSample(t, source * 2 + 1));
+        }
+        CHECK_TRUE(ok);
+        WavFile_Close(&file);
+    }
+}
+
+TEST_SETUP(MultitrackRecorder)
+{
+    ADD_TEST(MultitrackRecorder, PerTrackFilesStartAndStopTogether);
+    ADD_TEST(MultitrackRecorder, InterleavesAChannelPairPerTrack);
+    ADD_TEST(MultitrackRecorder, BatchesEveryTrackThroughOneWriter);
+    ADD_TEST(MultitrackRecorder, OneTrackFallingBehindSkipsTheCycleOnAll);
+}
+
+TEST_BRINGUP(MultitrackRecorder)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(MultitrackRecorder)
+{
+    CoreEngine_Deinit(&ctx_);
+    remove(TEST_INTERLEAVED_PATH);
+    for (u32 t = 0; t < TEST_MAX_TRACKS; t++) {
+        char path[64];
+        TrackPath(path, t);
+        remove(path);
+    }
+}
@@ -0,0 +1,120 @@
+#include "test_framework.h"
+#include <core_engine.h>
+#include <math.h>
+#include <oversampler.h>
+#include <string.h>
+
+#define TEST_CYCLE_FRAMES 480
+#define TEST_NUM_FRAMES 9600 // The last half is whole periods of every test tone
+#define TEST_TONE_HZ 10000.0
+#define TEST_ALIAS_HZ 18000.0 // Where the tone's third harmonic folds to at the engine rate
+
+static CoreEngineContext ctx_;
+static f32 buffer_[TEST_NUM_FRAMES * 2];
+static f64 innerRate_;
+static u32 innerFrames_;
+
+static void Passthrough(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    (void)buffer;
+    (void)data;
+    innerRate_ = sampleRate;
+    innerFrames_ += numFrames;
+}
+
+// Cubic soft clip, a sine through it picks up a third harmonic a twelfth of its size
+static void SoftClip(f64 sampleRate, u16 numFrames, f32* buffer, void* data)
+{
+    (void)sampleRate;
+    (void)data;
+    for (u32 i = 0; i < (u32)numFrames * 2; i++) {
+        buffer[i] = buffer[i] - buffer[i] * buffer[i] * buffer[i] / 3.0f;
+    }
+}
+
+static void FillTone(f64 frequency, f64 delayFrames)
+{
+    for (u32 i = 0; i < TEST_NUM_FRAMES; i++) {
+        f64 t = (i - delayFrames) / SAMPLE_RATE_DEFAULT;
+        buffer_[i * 2] = (f32)sin(2.0 * M_PI * frequency * t);
+        buffer_[i * 2 + 1] = (f32)(0.5 * cos(2.0 * M_PI * frequency * t));
+    }
+}
+
+static void Run(u16 id)
+{
+    AudioProcessor* proc = &ctx_.processors[id];
+    for (u32 done = 0; done < TEST_NUM_FRAMES; done += TEST_CYCLE_FRAMES) {
+        proc->Process(SAMPLE_RATE_DEFAULT, TEST_CYCLE_FRAMES, buffer_ + done * 2, proc->procData);
+    }
+}
+
+// Size of one frequency in the left channel over the last half
+static f64 Magnitude(f64 frequency)
+{
+    f64 re = 0.0;
+    f64 im = 0.0;
+    for (u32 i = TEST_NUM_FRAMES / 2; i < TEST_NUM_FRAMES; i++) {
+        f64 angle = 2.0 * M_PI * frequency * i / SAMPLE_RATE_DEFAULT;
+        re += buffer_[i * 2] * cos(angle);
+        im += buffer_[i * 2] * sin(angle);
+    }
+    return 2.0 * sqrt(re * re + im * im) / (TEST_NUM_FRAMES / 2);
+}
+
+TEST(Oversampler, PassesThroughAtItsLatency)
+{
+    u32 factors[] = { 2, 4, 8 };
+    for (u32 f = 0; f < 3; f++) {
+        innerFrames_ = 0;
+        Oversampler* os = CoreEngine_New(&ctx_, Oversampler);
+        u16 id = Oversampler_Create(os, &ctx_, factors[f], Passthrough, NULL);
+
+        FillTone(1000.0, 0.0);
+        Run(id);
+        CHECK_TRUE(innerRate_ == SAMPLE_RATE_DEFAULT * factors[f]);
+        CHECK_TRUE(innerFrames_ == TEST_NUM_FRAMES * factors[f]);
+
+        // The same tone, late by exactly what it says
+        f32 output[TEST_NUM_FRAMES * 2];
+        memcpy(output, buffer_, sizeof(output));
+        FillTone(1000.0, Oversampler_LatencyFrames(os));
+        bool ok = true;
+        for (u32 i = TEST_NUM_FRAMES; i < TEST_NUM_FRAMES * 2; i++) {
+            ok &= (fabsf(output[i] - buffer_[i]) < 1e-3f);
+        }
+        CHECK_TRUE(ok);
+        CHECK_TRUE(factors[f] != 2 || Oversampler_LatencyFrames(os) == OVERSAMPLER_FIRST_TAPS - 1);
+    }
+}
+
+TEST(Oversampler, NonlinearityDoesntAlias)
+{
+    // Straight at the engine rate the third harmonic folds down to 18 kHz
+    FillTone(TEST_TONE_HZ, 0.0);
+    SoftClip(SAMPLE_RATE_DEFAULT, TEST_NUM_FRAMES, buffer_, NULL);
+    CHECK_TRUE(fabs(Magnitude(TEST_ALIAS_HZ) - 1.0 / 12.0) < 1e-3);
+
+    Oversampler* os = CoreEngine_New(&ctx_, Oversampler);
+    u16 id = Oversampler_Create(os, &ctx_, 2, SoftClip, NULL);
+    FillTone(TEST_TONE_HZ, 0.0);
+    Run(id);
+    CHECK_TRUE(Magnitude(TEST_ALIAS_HZ) < 1e-4);
+    CHECK_TRUE(fabs(Magnitude(TEST_TONE_HZ) - 0.75) < 1e-2);
+}
+
+TEST_SETUP(Oversampler)
+{
+    ADD_TEST(Oversampler, PassesThroughAtItsLatency);
+    ADD_TEST(Oversampler, NonlinearityDoesntAlias);
+}
+
+TEST_BRINGUP(Oversampler)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(Oversampler)
+{
+    CoreEngine_Deinit(&ctx_);
+}
@@ -0,0 +1,228 @@
+#include "test_framework.h"
+#include <pcm.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_NUM_FRAMES 48000
+#define BENCH_NUM_FRAMES (1 << 20)
+#define BENCH_REPEATS 8
+
+static f32 src_[TEST_NUM_FRAMES * 2];
+static f32 decoded_[TEST_NUM_FRAMES * 2];
+static u8 packed_[TEST_NUM_FRAMES * 2 * 4];
+static u8 encoded_[TEST_NUM_FRAMES * 2 * 4];
+
+static f32 Noise(u32* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (f32)(*state >> 8) / 16777216.0f;
+}
+
+// Sums what went out less what came in, in steps, across the left channel
+static f64 LeftErrorSum(f32 scale, u32 numFrames)
+{
+    f64 sum = 0.0;
+    for (u32 i = 0; i < numFrames; i++) {
+        sum += (f64)decoded_[i * 2] * scale - (f64)src_[i * 2] * scale;
+    }
+    return sum;
+}
+
+TEST(Pcm, IntegersRoundTripExactly)
+{
+    // Every 16 bit value, an odd number of frames so the scalar tail runs too
+    for (u32 i = 0; i < 65536; i++) {
+        i16 value = (i16)(i - 32768);
+        memcpy(packed_ + i * 2, &value, sizeof(value));
+    }
+    Pcm_DecodeStereo(PCM_FORMAT_S16, packed_, 2, 32767, decoded_);
+    bool ok = true;
+    for (u32 i = 0; i < 65534; i++) {
+        ok &= (decoded_[i] == (f32)((i32)i - 32768) / 32768.0f);
+    }
+    CHECK_TRUE(ok);
+
+    Pcm_EncodeStereo(PCM_FORMAT_S16, decoded_, 32767, encoded_);
+    CHECK_TRUE(memcmp(encoded_, packed_, 32767 * 4) == 0);
+
+    // A spread of 24 and 32 bit values, 32 bit ones kept to what f32 holds exactly
+    PcmFormat formats[2] = { PCM_FORMAT_S24, PCM_FORMAT_S32 };
+    for (u32 f = 0; f < 2; f++) {
+        u16 bytes = Pcm_BytesPerSample(formats[f]);
+        u32 state = 1;
+        for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+            i32 value = (i32)(Noise(&state) * 16777216.0f) - 8388608;
+            value = (formats[f] == PCM_FORMAT_S32) ? value * 256 : value;
+            memcpy(packed_ + i * bytes, &value, bytes);
+        }
+        Pcm_DecodeStereo(formats[f], packed_, 2, TEST_NUM_FRAMES - 1, decoded_);
+        Pcm_EncodeStereo(formats[f], decoded_, TEST_NUM_FRAMES - 1, encoded_);
+        CHECK_TRUE(memcmp(encoded_, packed_, (TEST_NUM_FRAMES - 1) * 2 * bytes) == 0);
+    }
+}
+
+TEST(Pcm, RoundsAndSaturates)
+{
+    f32 values[10] = { 1.0f, -1.0f, 1.5f, -1.5f, INFINITY, -INFINITY,
+                       0.5f / 32768.0f, 1.5f / 32768.0f, -0.5f / 32768.0f, 0.7f / 32768.0f };
+    i32 expected16[10] = { 32767, -32768, 32767, -32768, 32767, -32768, 0, 2, 0, 1 };
+
+    // Through the vector loop and the scalar tail, they must agree
+    for (u32 offset = 0; offset < 2; offset++) {
+        f32 input[12] = { 0.0f, 0.0f };
+        memcpy(input + offset * 2, values, sizeof(values));
+        i16 out16[12];
+        Pcm_EncodeStereo(PCM_FORMAT_S16, input, 6, (u8*)out16);
+        for (u32 i = 0; i < 10; i++) {
+            CHECK_TRUE(out16[i + offset * 2] == expected16[i]);
+        }
+
+        i32 out32[12];
+        Pcm_EncodeStereo(PCM_FORMAT_S32, input, 6, (u8*)out32);
+        CHECK_TRUE(out32[offset * 2] == INT32_MAX && out32[offset * 2 + 1] == INT32_MIN);
+        CHECK_TRUE(out32[offset * 2 + 2] == INT32_MAX && out32[offset * 2 + 5] == INT32_MIN);
+
+        u8 out24[12 * 3];
+        Pcm_EncodeStereo(PCM_FORMAT_S24, input, 6, out24);
+        f32 back[12];
+        Pcm_DecodeStereo(PCM_FORMAT_S24, out24, 2, 6, back);
+        CHECK_TRUE(back[offset * 2] == 8388607.0f / 8388608.0f && back[offset * 2 + 1] == -1.0f);
+    }
+
+    // Anything in range lands on the nearest step
+    u32 state = 7;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        src_[i] = Noise(&state) * 2.0f - 1.0f;
+    }
+    Pcm_EncodeStereo(PCM_FORMAT_S24, src_, TEST_NUM_FRAMES, packed_);
+    Pcm_DecodeStereo(PCM_FORMAT_S24, packed_, 2, TEST_NUM_FRAMES, decoded_);
+    f64 maxError = 0.0;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        maxError = fmax(maxError, fabs((f64)decoded_[i] - (f64)src_[i]) * 8388608.0);
+    }
+    CHECK_TRUE(maxError <= 0.5);
+}
+
+TEST(Pcm, DitherIsUnbiased)
+{
+    // A quarter of a step above zero, undithered it's just lost
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        src_[i] = 0.25f / 32768.0f;
+    }
+
+    PcmDither dither;
+    for (u32 mode = 0; mode < PCM_DITHER_COUNT; mode++) {
+        PcmDither_Init(&dither, mode, 1234);
+        Pcm_EncodeStereoDithered(PCM_FORMAT_S16, src_, TEST_NUM_FRAMES, &dither, packed_);
+        Pcm_DecodeStereo(PCM_FORMAT_S16, packed_, 2, TEST_NUM_FRAMES, decoded_);
+
+        f64 mean = 0.0;
+        f64 worst = 0.0;
+        for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+            mean += decoded_[i] * 32768.0;
+            worst = fmax(worst, fabs(decoded_[i] * 32768.0 - 0.25));
+        }
+        mean /= TEST_NUM_FRAMES * 2;
+
+        if (mode == PCM_DITHER_NONE) {
+            CHECK_TRUE(mean == 0.0);
+        }
+        else {
+            CHECK_TRUE(fabs(mean - 0.25) < 0.02);
+            CHECK_TRUE(worst <= (mode == PCM_DITHER_TPDF ? 1.75 : 3.25));
+        }
+    }
+}
+
+TEST(Pcm, ShapedDitherKeepsErrorOffLowFrequencies)
+{
+    u32 state = 99;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        src_[i] = (f32)sin(2.0 * M_PI * 100.0 * (i / 2) / 48000.0) * 0.5f + (Noise(&state) - 0.5f) * 1e-4f;
+    }
+
+    // Shaped, the error is the difference of successive errors, so it sums to almost nothing,
+    // flat TPDF error wanders off like any noise
+    PcmDither dither;
+    PcmDither_Init(&dither, PCM_DITHER_SHAPED, 5);
+    Pcm_EncodeStereoDithered(PCM_FORMAT_S16, src_, TEST_NUM_FRAMES, &dither, packed_);
+    Pcm_DecodeStereo(PCM_FORMAT_S16, packed_, 2, TEST_NUM_FRAMES, decoded_);
+    f64 shaped = fabs(LeftErrorSum(32768.0f, TEST_NUM_FRAMES));
+
+    PcmDither_Init(&dither, PCM_DITHER_TPDF, 5);
+    Pcm_EncodeStereoDithered(PCM_FORMAT_S16, src_, TEST_NUM_FRAMES, &dither, packed_);
+    Pcm_DecodeStereo(PCM_FORMAT_S16, packed_, 2, TEST_NUM_FRAMES, decoded_);
+    f64 flat = fabs(LeftErrorSum(32768.0f, TEST_NUM_FRAMES));
+
+    CHECK_TRUE(shaped < 2.0);
+    CHECK_TRUE(flat > shaped * 10.0);
+}
+
+static f64 NowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Not a pass or fail, logs how fast each conversion runs for comparing builds and targets
+TEST(Pcm, ConversionThroughput)
+{
+    f32* floats = malloc(BENCH_NUM_FRAMES * 2 * sizeof(f32));
+    u8* ints = malloc(BENCH_NUM_FRAMES * 2 * 4);
+    u32 state = 3;
+    for (u32 i = 0; i < BENCH_NUM_FRAMES * 2; i++) {
+        floats[i] = Noise(&state) * 2.0f - 1.0f;
+    }
+
+    PcmDither dither;
+    for (u32 format = PCM_FORMAT_S16; format <= PCM_FORMAT_S32; format++) {
+        // Real samples to decode, not whatever malloc handed back
+        Pcm_EncodeStereo(format, floats, BENCH_NUM_FRAMES, ints);
+        f64 start = NowSeconds();
+        for (u32 r = 0; r < BENCH_REPEATS; r++) {
+            Pcm_DecodeStereo(format, ints, 2, BENCH_NUM_FRAMES, floats);
+        }
+        f64 decodeSeconds = NowSeconds() - start;
+
+        f64 encodeSeconds[PCM_DITHER_COUNT];
+        for (u32 mode = 0; mode < PCM_DITHER_COUNT; mode++) {
+            PcmDither_Init(&dither, mode, 1);
+            start = NowSeconds();
+            for (u32 r = 0; r < BENCH_REPEATS; r++) {
+                Pcm_EncodeStereoDithered(format, floats, BENCH_NUM_FRAMES, &dither, ints);
+            }
+            encodeSeconds[mode] = NowSeconds() - start;
+        }
+
+        f64 megaSamples = (f64)BENCH_NUM_FRAMES * 2 * BENCH_REPEATS / 1e6;
+        LogInfo("%s { decode: %.0f, encode: %.0f, tpdf: %.0f, shaped: %.0f } Msamples/s",
+                Pcm_FormatName(format),
+                megaSamples / decodeSeconds,
+                megaSamples / encodeSeconds[PCM_DITHER_NONE],
+                megaSamples / encodeSeconds[PCM_DITHER_TPDF],
+                megaSamples / encodeSeconds[PCM_DITHER_SHAPED]);
+    }
+
+    free(floats);
+    free(ints);
+}
+
+TEST_SETUP(Pcm)
+{
+    ADD_TEST(Pcm, IntegersRoundTripExactly);
+    ADD_TEST(Pcm, RoundsAndSaturates);
+    ADD_TEST(Pcm, DitherIsUnbiased);
+    ADD_TEST(Pcm, ShapedDitherKeepsErrorOffLowFrequencies);
+    ADD_TEST(Pcm, ConversionThroughput);
+}
+
+TEST_BRINGUP(Pcm)
+{
+}
+
+TEST_TEARDOWN(Pcm)
+{
+}
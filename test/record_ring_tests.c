@@ -0,0 +1,183 @@
+#include "test_framework.h"
+#include <record_ring.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#endif
+
+#define TEST_CYCLE_FRAMES 1000 // Doesn't divide the ring so cycles land across the wrap
+#define TEST_NUM_CYCLES 2000
+#define TEST_HISTORY_FRAMES 4321
+
+static HeapArena arena_;
+static RecordRing ring_;
+static f32 cycle_[TEST_CYCLE_FRAMES * 2];
+
+// Every sample is distinct, so anything dropped, repeated or torn shows up
+static f32 TestSample(u64 sampleIndex)
+{
+    return (f32)(sampleIndex % 1000003) / 1000003.0f - 0.5f;
+}
+
+static void FillCycle(u64 cycleIndex)
+{
+    for (u32 i = 0; i < TEST_CYCLE_FRAMES * 2; i++) {
+        cycle_[i] = TestSample(cycleIndex * TEST_CYCLE_FRAMES * 2 + i);
+    }
+}
+
+// Takes everything waiting and checks it carries on from sampleIndex, returns where it got to
+static u64 DrainAndCheck(u64 sampleIndex, bool* ok)
+{
+    u32 available = RecordRing_Available(&ring_);
+    while (available > 0) {
+        const f32* frames;
+        u32 numFrames = RecordRing_Peek(&ring_, available, &frames);
+        for (u32 i = 0; i < numFrames * 2; i++) {
+            *ok &= (frames[i] == TestSample(sampleIndex++));
+        }
+        RecordRing_Consume(&ring_, numFrames);
+        available -= numFrames;
+    }
+    return sampleIndex;
+}
+
+TEST(RecordRing, CarriesCyclesAcrossTheWrap)
+{
+    CHECK_TRUE(ring_.capacity == RECORD_RING_BLOCK_FRAMES * 2);
+    CHECK_TRUE(((u64)ring_.frames % RECORD_RING_ALIGNMENT) == 0);
+
+    bool ok = true;
+    u64 sampleIndex = 0;
+    for (u64 c = 0; c < 200; c++) {
+        FillCycle(c);
+        CHECK_TRUE(RecordRing_Write(&ring_, cycle_, TEST_CYCLE_FRAMES));
+        if (c % 50 == 49) {
+            sampleIndex = DrainAndCheck(sampleIndex, &ok);
+        }
+    }
+    sampleIndex = DrainAndCheck(sampleIndex, &ok);
+
+    CHECK_TRUE(ok);
+    CHECK_TRUE(sampleIndex == 200 * TEST_CYCLE_FRAMES * 2);
+    CHECK_TRUE(atomic_load(&ring_.numOverruns) == 0);
+    CHECK_TRUE(atomic_load(&ring_.maxLagFrames) == 50 * TEST_CYCLE_FRAMES);
+}
+
+TEST(RecordRing, DropsWholeCyclesWhenFull)
+{
+    u32 numFit = ring_.capacity / TEST_CYCLE_FRAMES;
+    for (u64 c = 0; c < numFit; c++) {
+        FillCycle(c);
+        CHECK_TRUE(RecordRing_Write(&ring_, cycle_, TEST_CYCLE_FRAMES));
+    }
+
+    // Doesn't fit whole, so none of it goes in
+    FillCycle(numFit);
+    CHECK_TRUE(!RecordRing_Write(&ring_, cycle_, TEST_CYCLE_FRAMES));
+    CHECK_TRUE(atomic_load(&ring_.numOverruns) == 1);
+    CHECK_TRUE(atomic_load(&ring_.numOverrunFrames) == TEST_CYCLE_FRAMES);
+    CHECK_TRUE(RecordRing_Available(&ring_) == numFit * TEST_CYCLE_FRAMES);
+
+    bool ok = true;
+    CHECK_TRUE(DrainAndCheck(0, &ok) == (u64)numFit * TEST_CYCLE_FRAMES * 2);
+    CHECK_TRUE(ok);
+
+    // Silence still takes up its frames
+    CHECK_TRUE(RecordRing_Write(&ring_, NULL, TEST_CYCLE_FRAMES));
+    const f32* frames;
+    u32 numFrames = RecordRing_Peek(&ring_, TEST_CYCLE_FRAMES, &frames);
+    CHECK_TRUE(numFrames > 0);
+    for (u32 i = 0; i < numFrames * 2; i++) {
+        ok &= (frames[i] == 0.0f);
+    }
+    CHECK_TRUE(ok);
+}
+
+TEST(RecordRing, TrimKeepsTheNewestFrames)
+{
+    RecordRing history;
+    RecordRing_InitExact(&history, &arena_, TEST_HISTORY_FRAMES + TEST_CYCLE_FRAMES);
+    CHECK_TRUE(history.capacity == TEST_HISTORY_FRAMES + TEST_CYCLE_FRAMES);
+
+    // Round and round, never more than the history left behind
+    for (u64 c = 0; c < 100; c++) {
+        FillCycle(c);
+        CHECK_TRUE(RecordRing_Write(&history, cycle_, TEST_CYCLE_FRAMES));
+        RecordRing_Trim(&history, TEST_HISTORY_FRAMES);
+        CHECK_TRUE(RecordRing_Available(&history) == MIN(TEST_HISTORY_FRAMES, (c + 1) * TEST_CYCLE_FRAMES));
+    }
+    CHECK_TRUE(atomic_load(&history.numOverruns) == 0);
+
+    // What's left is the last of it, in order across the wrap
+    bool ok = true;
+    u64 sampleIndex = (100 * TEST_CYCLE_FRAMES - TEST_HISTORY_FRAMES) * 2;
+    u32 available = RecordRing_Available(&history);
+    while (available > 0) {
+        const f32* frames;
+        u32 numFrames = RecordRing_Peek(&history, available, &frames);
+        for (u32 i = 0; i < numFrames * 2; i++) {
+            ok &= (frames[i] == TestSample(sampleIndex++));
+        }
+        RecordRing_Consume(&history, numFrames);
+        available -= numFrames;
+    }
+    CHECK_TRUE(ok);
+    CHECK_TRUE(sampleIndex == 100 * TEST_CYCLE_FRAMES * 2);
+}
+
+static void* Producer(void* data)
+{
+    (void)data;
+    for (u64 c = 0; c < TEST_NUM_CYCLES; c++) {
+        FillCycle(c);
+        while (!RecordRing_Write(&ring_, cycle_, TEST_CYCLE_FRAMES)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+TEST(RecordRing, WriterOnAnotherThreadGetsEveryFrame)
+{
+    pthread_t producer;
+    CHECK_TRUE(pthread_create(&producer, NULL, Producer, NULL) == 0);
+
+    bool ok = true;
+    u64 sampleIndex = 0;
+    while (sampleIndex < (u64)TEST_NUM_CYCLES * TEST_CYCLE_FRAMES * 2) {
+        u64 before = sampleIndex;
+        sampleIndex = DrainAndCheck(sampleIndex, &ok);
+        if (sampleIndex == before) {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+
+    CHECK_TRUE(ok);
+    CHECK_TRUE(RecordRing_Available(&ring_) == 0);
+    CHECK_TRUE(atomic_load(&ring_.maxLagFrames) <= ring_.capacity);
+}
+
+TEST_SETUP(RecordRing)
+{
+    ADD_TEST(RecordRing, CarriesCyclesAcrossTheWrap);
+    ADD_TEST(RecordRing, DropsWholeCyclesWhenFull);
+    ADD_TEST(RecordRing, TrimKeepsTheNewestFrames);
+    ADD_TEST(RecordRing, WriterOnAnotherThreadGetsEveryFrame);
+}
+
+TEST_BRINGUP(RecordRing)
+{
+    u64 historyBytes = (TEST_HISTORY_FRAMES + TEST_CYCLE_FRAMES) * 2 * sizeof(f32) + RECORD_RING_ALIGNMENT;
+    HeapArena_Init(&arena_, RECORD_RING_BLOCK_FRAMES * 2 * 2 * sizeof(f32) + RECORD_RING_ALIGNMENT * 2 + historyBytes);
+    RecordRing_Init(&ring_, &arena_, RECORD_RING_BLOCK_FRAMES + 1);
+}
+
+TEST_TEARDOWN(RecordRing)
+{
+    HeapArena_Deinit(&arena_);
+}
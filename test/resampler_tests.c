@@ -0,0 +1,133 @@
+#include "test_framework.h"
+#include <resampler.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define TEST_IN_FRAMES 44100
+#define TEST_OUT_FRAMES 48000
+
+static f32* input_;
+static f32* output_;
+
+static void WriteSine(f32* frames, u32 numFrames, f64 frequency, u32 sampleRate)
+{
+    for (u32 i = 0; i < numFrames; i++) {
+        f32 sample = (f32)(0.5 * sin(2.0 * M_PI * frequency * i / sampleRate));
+        frames[i * 2] = sample;
+        frames[i * 2 + 1] = -sample;
+    }
+}
+
+// Worst error against the same sine at the output rate, away from the zero padded ends
+static f64 SineError(const f32* frames, u32 numFrames, f64 frequency, u32 sampleRate)
+{
+    f64 maxError = 0.0;
+    for (u32 i = 100; i < numFrames - 100; i++) {
+        f64 expected = 0.5 * sin(2.0 * M_PI * frequency * i / sampleRate);
+        f64 error = fmax(fabs(frames[i * 2] - expected), fabs(frames[i * 2 + 1] + expected));
+        maxError = fmax(maxError, error);
+    }
+    return maxError;
+}
+
+static f64 Rms(const f32* frames, u32 numFrames)
+{
+    f64 sum = 0.0;
+    for (u32 i = 100; i < numFrames - 100; i++) {
+        sum += frames[i * 2] * frames[i * 2];
+    }
+    return sqrt(sum / (numFrames - 200));
+}
+
+TEST(Resampler, ConvertsSinesAtEveryQuality)
+{
+    const f64 maxErrors[RESAMPLER_QUALITY_COUNT] = { 1e-2, 1e-3, 1e-4 };
+    CHECK_TRUE(Resampler_OutputFrames(44100, 48000, TEST_IN_FRAMES) == TEST_OUT_FRAMES);
+
+    WriteSine(input_, TEST_IN_FRAMES, 1000.0, 44100);
+    for (u32 quality = 0; quality < RESAMPLER_QUALITY_COUNT; quality++) {
+        Resampler_ConvertAll(quality, 44100, 48000, input_, TEST_IN_FRAMES, output_, TEST_OUT_FRAMES);
+        CHECK_TRUE(SineError(output_, TEST_OUT_FRAMES, 1000.0, 48000) < maxErrors[quality]);
+    }
+
+    // Down as well as up, and near the top of the band
+    WriteSine(input_, TEST_OUT_FRAMES, 15000.0, 48000);
+    Resampler_ConvertAll(RESAMPLER_QUALITY_HIGH, 48000, 44100, input_, TEST_OUT_FRAMES, output_, TEST_IN_FRAMES);
+    CHECK_TRUE(SineError(output_, TEST_IN_FRAMES, 15000.0, 44100) < 1e-3);
+}
+
+TEST(Resampler, KeepsDcAtUnityGain)
+{
+    for (u32 i = 0; i < TEST_IN_FRAMES * 2; i++) {
+        input_[i] = 0.25f;
+    }
+    Resampler_ConvertAll(RESAMPLER_QUALITY_MEDIUM, 44100, 48000, input_, TEST_IN_FRAMES, output_, TEST_OUT_FRAMES);
+
+    bool flat = true;
+    for (u32 i = 100; i < TEST_OUT_FRAMES - 100; i++) {
+        flat = flat && fabsf(output_[i * 2] - 0.25f) < 1e-5f;
+    }
+    CHECK_TRUE(flat);
+}
+
+TEST(Resampler, FiltersWhatWouldAlias)
+{
+    // Above the Nyquist of 44.1kHz, folding back down if it weren't filtered out first
+    WriteSine(input_, TEST_OUT_FRAMES, 23000.0, 48000);
+    Resampler_ConvertAll(RESAMPLER_QUALITY_MEDIUM, 48000, 44100, input_, TEST_OUT_FRAMES, output_, TEST_IN_FRAMES);
+    CHECK_TRUE(Rms(output_, TEST_IN_FRAMES) < 1e-3);
+}
+
+TEST(Resampler, StreamsTheSameAsConvertingAll)
+{
+    WriteSine(input_, TEST_IN_FRAMES, 440.0, 44100);
+    Resampler_ConvertAll(RESAMPLER_QUALITY_MEDIUM, 44100, 48000, input_, TEST_IN_FRAMES, output_, TEST_OUT_FRAMES);
+
+    // Sized to exactly what it says it takes
+    HeapArena arena;
+    HeapArena_Init(&arena, Resampler_ArenaBytes(44100, 48000, RESAMPLER_QUALITY_MEDIUM, 512));
+    Resampler resampler;
+    Resampler_Init(&resampler, &arena, 44100, 48000, RESAMPLER_QUALITY_MEDIUM, 512);
+    Resampler_Reset(&resampler, 0.0);
+
+    // Primed from before the start, then uneven blocks
+    f32 block[512 * 2] = { 0 };
+    Resampler_Process(&resampler, block, RESAMPLER_LATENCY(resampler.numTaps), block, 0);
+
+    u32 inputFrame = 0;
+    u32 outputFrame = 0;
+    bool matches = true;
+    for (u32 blockFrames = 1; outputFrame + blockFrames < TEST_OUT_FRAMES - 100; blockFrames = blockFrames * 7 % 512 + 1) {
+        u32 framesNeeded = Resampler_InputNeeded(&resampler, blockFrames);
+        Resampler_Process(&resampler, input_ + inputFrame * 2, framesNeeded, block, blockFrames);
+        for (u32 i = 0; i < blockFrames * 2; i++) {
+            matches = matches && fabsf(block[i] - output_[outputFrame * 2 + i]) < 1e-6f;
+        }
+        inputFrame += framesNeeded;
+        outputFrame += blockFrames;
+    }
+    CHECK_TRUE(matches);
+    CHECK_TRUE(outputFrame > TEST_OUT_FRAMES / 2);
+
+    HeapArena_Deinit(&arena);
+}
+
+TEST_SETUP(Resampler)
+{
+    ADD_TEST(Resampler, ConvertsSinesAtEveryQuality);
+    ADD_TEST(Resampler, KeepsDcAtUnityGain);
+    ADD_TEST(Resampler, FiltersWhatWouldAlias);
+    ADD_TEST(Resampler, StreamsTheSameAsConvertingAll);
+}
+
+TEST_BRINGUP(Resampler)
+{
+    input_ = malloc(TEST_OUT_FRAMES * 2 * sizeof(f32));
+    output_ = malloc(TEST_OUT_FRAMES * 2 * sizeof(f32));
+}
+
+TEST_TEARDOWN(Resampler)
+{
+    free(input_);
+    free(output_);
+}
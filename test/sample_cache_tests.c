@@ -0,0 +1,200 @@
+#include "test_framework.h"
+#include "test_wav.h"
+#include <sample_cache.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define TEST_WAV_A "/tmp/jamcore_sample_cache_a.wav"
+#define TEST_WAV_B "/tmp/jamcore_sample_cache_b.wav"
+#define TEST_WAV_C "/tmp/jamcore_sample_cache_c.wav"
+#define TEST_NUM_FRAMES 1000
+#define TEST_SAMPLE_BYTES (TEST_NUM_FRAMES * 2 * sizeof(f32))
+
+static SampleCache cache_;
+
+static void SetModifiedTime(const char* path, i64 seconds)
+{
+    struct timespec times[2] = { { seconds, 0 }, { seconds, 0 } };
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+static bool MatchesRamp(const SampleCacheEntry* entry, u64 numFrames)
+{
+    if (entry == NULL || entry->numFrames != numFrames) {
+        return false;
+    }
+    for (u64 i = 0; i < numFrames; i++) {
+        f32 frame[2] = { 0.0f, 0.0f };
+        Pcm_MixStereo(entry->format, entry->data + i * 2 * Pcm_BytesPerSample(entry->format), 1, frame);
+        f32 expected = TestWav_RampSample(i);
+        if (frame[0] != expected || frame[1] != -expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(SampleCache, SharesOneDecode)
+{
+    const SampleCacheEntry* first = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+    const SampleCacheEntry* second = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+
+    CHECK_TRUE(first != NULL && first == second);
+    CHECK_TRUE(MatchesRamp(first, TEST_NUM_FRAMES));
+    CHECK_TRUE(first->refCount == 2);
+    CHECK_TRUE(cache_.numMisses == 1);
+    CHECK_TRUE(cache_.numHits == 1);
+    CHECK_TRUE(cache_.usedBytes == TEST_SAMPLE_BYTES);
+
+    // Decoded for another rate is a different entry
+    const SampleCacheEntry* other = SampleCache_Acquire(&cache_, TEST_WAV_A, 44100);
+    CHECK_TRUE(other != NULL && other != first);
+    CHECK_TRUE(other->numFrames == (TEST_NUM_FRAMES * 44100) / 48000);
+    CHECK_TRUE(cache_.numMisses == 2);
+
+    SampleCache_Release(&cache_, first);
+    SampleCache_Release(&cache_, second);
+    SampleCache_Release(&cache_, other);
+    CHECK_TRUE(cache_.numEntries == 2);
+}
+
+TEST(SampleCache, ChangedFilesAreReloaded)
+{
+    const SampleCacheEntry* old = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+    CHECK_TRUE(old != NULL);
+
+    TestWav_WriteRamp(TEST_WAV_A, TEST_NUM_FRAMES / 2, 48000);
+    SetModifiedTime(TEST_WAV_A, 2000000000);
+
+    // Old players keep the old data, new ones get the new file
+    const SampleCacheEntry* changed = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+    CHECK_TRUE(changed != NULL && changed != old);
+    CHECK_TRUE(MatchesRamp(old, TEST_NUM_FRAMES));
+    CHECK_TRUE(MatchesRamp(changed, TEST_NUM_FRAMES / 2));
+    CHECK_TRUE(cache_.numEntries == 2);
+
+    SampleCache_Release(&cache_, old);
+    CHECK_TRUE(cache_.numEntries == 1);
+    CHECK_TRUE(cache_.usedBytes == TEST_SAMPLE_BYTES / 2);
+    SampleCache_Release(&cache_, changed);
+}
+
+TEST(SampleCache, EvictsLeastRecentlyUsed)
+{
+    SampleCache_SetBudget(&cache_, TEST_SAMPLE_BYTES * 2);
+
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_A, 48000));
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_B, 48000));
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_A, 48000));
+
+    // B was used longest ago
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_C, 48000));
+    CHECK_TRUE(cache_.numEvictions == 1);
+    CHECK_TRUE(cache_.numEntries == 2);
+
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_A, 48000));
+    CHECK_TRUE(cache_.numHits == 2);
+    SampleCache_Release(&cache_, SampleCache_Acquire(&cache_, TEST_WAV_B, 48000));
+    CHECK_TRUE(cache_.numMisses == 4);
+    CHECK_TRUE(cache_.numEvictions == 2);
+
+    // Shrinking the budget evicts down to it
+    SampleCache_SetBudget(&cache_, TEST_SAMPLE_BYTES);
+    CHECK_TRUE(cache_.numEntries == 1);
+    CHECK_TRUE(cache_.usedBytes <= TEST_SAMPLE_BYTES);
+}
+
+TEST(SampleCache, SamplesInUseAreNeverEvicted)
+{
+    SampleCache_SetBudget(&cache_, TEST_SAMPLE_BYTES);
+
+    const SampleCacheEntry* held = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+    CHECK_TRUE(held != NULL);
+    CHECK_TRUE(SampleCache_Acquire(&cache_, TEST_WAV_B, 48000) == NULL);
+    CHECK_TRUE(cache_.numRejected == 1);
+    CHECK_TRUE(cache_.numEvictions == 0);
+    CHECK_TRUE(MatchesRamp(held, TEST_NUM_FRAMES));
+
+    SampleCache_Release(&cache_, held);
+    const SampleCacheEntry* next = SampleCache_Acquire(&cache_, TEST_WAV_B, 48000);
+    CHECK_TRUE(next != NULL);
+    CHECK_TRUE(cache_.numEvictions == 1);
+    SampleCache_Release(&cache_, next);
+}
+
+TEST(SampleCache, CompactKeepsSourceWidth)
+{
+    SampleCache_Deinit(&cache_);
+    SampleCache_Init(&cache_, TEST_SAMPLE_BYTES, true);
+
+    // Two 16 bit samples fit in the room of one f32 one
+    const SampleCacheEntry* a = SampleCache_Acquire(&cache_, TEST_WAV_A, 48000);
+    const SampleCacheEntry* b = SampleCache_Acquire(&cache_, TEST_WAV_B, 48000);
+    CHECK_TRUE(a != NULL && b != NULL);
+    CHECK_TRUE(a->format == PCM_FORMAT_S16);
+    CHECK_TRUE(MatchesRamp(a, TEST_NUM_FRAMES));
+    CHECK_TRUE(MatchesRamp(b, TEST_NUM_FRAMES));
+    CHECK_TRUE(cache_.usedBytes == TEST_SAMPLE_BYTES);
+    CHECK_TRUE(cache_.savedBytes == TEST_SAMPLE_BYTES);
+    CHECK_TRUE(cache_.numEvictions == 0);
+
+    SampleCache_Release(&cache_, a);
+    SampleCache_Release(&cache_, b);
+    SampleCache_SetBudget(&cache_, 0);
+    CHECK_TRUE(cache_.savedBytes == 0);
+}
+
+TEST(SampleCache, RejectsWhatShouldStream)
+{
+    TestWav_WriteRamp(TEST_WAV_C, SAMPLE_CACHE_MAX_SECONDS * 8000 + 1, 8000);
+    CHECK_TRUE(SampleCache_Acquire(&cache_, TEST_WAV_C, 8000) == NULL);
+    CHECK_TRUE(SampleCache_Acquire(&cache_, "/tmp/jamcore_sample_cache_missing.wav", 48000) == NULL);
+    CHECK_TRUE(cache_.numRejected == 2);
+    CHECK_TRUE(cache_.numEntries == 0);
+}
+
+TEST(SampleCache, RejectsMalformedFiles)
+{
+    // Not a WAV at all, then a header cut off before any chunks
+    FILE* file = fopen(TEST_WAV_C, "wb");
+    fputs("Not a wave file, just some text", file);
+    fclose(file);
+    CHECK_TRUE(SampleCache_Acquire(&cache_, TEST_WAV_C, 48000) == NULL);
+
+    file = fopen(TEST_WAV_C, "wb");
+    fwrite("RIFF\x04\x00\x00\x00WAVE", 1, 12, file);
+    fclose(file);
+    CHECK_TRUE(SampleCache_Acquire(&cache_, TEST_WAV_C, 48000) == NULL);
+
+    CHECK_TRUE(cache_.numRejected == 2);
+    CHECK_TRUE(cache_.numEntries == 0);
+}
+
+TEST_SETUP(SampleCache)
+{
+    ADD_TEST(SampleCache, SharesOneDecode);
+    ADD_TEST(SampleCache, ChangedFilesAreReloaded);
+    ADD_TEST(SampleCache, EvictsLeastRecentlyUsed);
+    ADD_TEST(SampleCache, SamplesInUseAreNeverEvicted);
+    ADD_TEST(SampleCache, CompactKeepsSourceWidth);
+    ADD_TEST(SampleCache, RejectsWhatShouldStream);
+    ADD_TEST(SampleCache, RejectsMalformedFiles);
+}
+
+TEST_BRINGUP(SampleCache)
+{
+    TestWav_WriteRamp(TEST_WAV_A, TEST_NUM_FRAMES, 48000);
+    TestWav_WriteRamp(TEST_WAV_B, TEST_NUM_FRAMES, 48000);
+    TestWav_WriteRamp(TEST_WAV_C, TEST_NUM_FRAMES, 48000);
+    SetModifiedTime(TEST_WAV_A, 1000000000);
+    SampleCache_Init(&cache_, (u64)SAMPLE_CACHE_DEFAULT_BUDGET_MB * 1024 * 1024, false);
+}
+
+TEST_TEARDOWN(SampleCache)
+{
+    SampleCache_Deinit(&cache_);
+    remove(TEST_WAV_A);
+    remove(TEST_WAV_B);
+    remove(TEST_WAV_C);
+}
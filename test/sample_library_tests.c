@@ -0,0 +1,100 @@
+#include "test_framework.h"
+#include "test_wav.h"
+#include <sample_library.h>
+#include <stdio.h>
+
+#define TEST_WAV_LONG "/tmp/jamcore_sample_library_long.wav"
+#define TEST_WAV_SHORT "/tmp/jamcore_sample_library_short.wav"
+#define TEST_PRELOAD_MS 100
+
+static SampleLibrary library_;
+
+static bool HeadMatchesRamp(const LibrarySample* sample)
+{
+    for (u32 i = 0; i < sample->numHeadFrames; i++) {
+        f32 frame[2] = { 0.0f, 0.0f };
+        Pcm_MixStereo(sample->headFormat, sample->head + i * 2 * Pcm_BytesPerSample(sample->headFormat), 1, frame);
+        f32 expected = TestWav_RampSample(i);
+        if (frame[0] != expected || frame[1] != -expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(SampleLibrary, PreloadsOnlyTheHead)
+{
+    u32 index = SampleLibrary_Add(&library_, TEST_WAV_LONG);
+    const LibrarySample* sample = SampleLibrary_Get(&library_, index);
+
+    CHECK_TRUE(sample->totalFrames == 48000 * 2);
+    CHECK_TRUE(sample->numHeadFrames == 48000 * TEST_PRELOAD_MS / 1000);
+    CHECK_TRUE(HeadMatchesRamp(sample));
+
+    CHECK_TRUE(library_.diskBytes == 48000 * 2 * 2 * sizeof(i16));
+    CHECK_TRUE(library_.residentBytes >= sample->numHeadFrames * 2 * sizeof(f32));
+    CHECK_TRUE(library_.residentBytes < library_.diskBytes);
+    CHECK_TRUE(library_.loadNs > 0);
+}
+
+TEST(SampleLibrary, ShortSamplesAreWhollyPreloaded)
+{
+    SampleLibrary_Add(&library_, TEST_WAV_LONG);
+    u32 index = SampleLibrary_Add(&library_, TEST_WAV_SHORT);
+    const LibrarySample* sample = SampleLibrary_Get(&library_, index);
+
+    CHECK_TRUE(index == 1);
+    CHECK_TRUE(sample->numHeadFrames == sample->totalFrames);
+    CHECK_TRUE(HeadMatchesRamp(sample));
+    CHECK_DEATH(SampleLibrary_Get(&library_, 2));
+}
+
+TEST(SampleLibrary, GrowsPastInitialCapacity)
+{
+    for (u32 i = 0; i < 100; i++) {
+        CHECK_TRUE(SampleLibrary_Add(&library_, TEST_WAV_SHORT) == i);
+    }
+    CHECK_TRUE(library_.numSamples == 100);
+    CHECK_TRUE(HeadMatchesRamp(SampleLibrary_Get(&library_, 0)));
+    CHECK_TRUE(HeadMatchesRamp(SampleLibrary_Get(&library_, 99)));
+}
+
+TEST(SampleLibrary, CompactHeadsHalveResidentSize)
+{
+    SampleLibrary_Add(&library_, TEST_WAV_LONG);
+
+    SampleLibrary compact;
+    SampleLibrary_Init(&compact, "Compact", TEST_PRELOAD_MS, true);
+    u32 index = SampleLibrary_Add(&compact, TEST_WAV_LONG);
+    const LibrarySample* sample = SampleLibrary_Get(&compact, index);
+
+    CHECK_TRUE(sample->headFormat == PCM_FORMAT_S16);
+    CHECK_TRUE(HeadMatchesRamp(sample));
+    u64 headBytes = (u64)sample->numHeadFrames * 2 * sizeof(i16);
+    CHECK_TRUE(compact.savedBytes == headBytes);
+    CHECK_TRUE(library_.residentBytes - compact.residentBytes == headBytes);
+
+    SampleLibrary_Deinit(&compact);
+}
+
+TEST_SETUP(SampleLibrary)
+{
+    ADD_TEST(SampleLibrary, PreloadsOnlyTheHead);
+    ADD_TEST(SampleLibrary, ShortSamplesAreWhollyPreloaded);
+    ADD_TEST(SampleLibrary, GrowsPastInitialCapacity);
+    ADD_TEST(SampleLibrary, CompactHeadsHalveResidentSize);
+}
+
+TEST_BRINGUP(SampleLibrary)
+{
+    TestWav_WriteRamp(TEST_WAV_LONG, 48000 * 2, 48000);
+    TestWav_WriteRamp(TEST_WAV_SHORT, 1000, 48000);
+    SampleLibrary_Init(&library_, "Test", TEST_PRELOAD_MS, false);
+}
+
+TEST_TEARDOWN(SampleLibrary)
+{
+    SampleLibrary_Deinit(&library_);
+    remove(TEST_WAV_LONG);
+    remove(TEST_WAV_SHORT);
+}
@@ -1,15 +1,63 @@
 #include "logger.h"
 #include "test_framework.h"
 
+INCLUDE_TEST_SUITE(Allocator)
+INCLUDE_TEST_SUITE(AsyncIo)
+INCLUDE_TEST_SUITE(AudioRenderer)
+INCLUDE_TEST_SUITE(Convolver)
 INCLUDE_TEST_SUITE(CoreEngine)
+INCLUDE_TEST_SUITE(DelayEffects)
+INCLUDE_TEST_SUITE(DelayLine)
+INCLUDE_TEST_SUITE(Fft)
+INCLUDE_TEST_SUITE(Interpolator)
+INCLUDE_TEST_SUITE(LoadMonitor)
+INCLUDE_TEST_SUITE(Logger)
+INCLUDE_TEST_SUITE(MultitrackRecorder)
 INCLUDE_TEST_SUITE(Oscillators)
+INCLUDE_TEST_SUITE(Oversampler)
+INCLUDE_TEST_SUITE(Pcm)
+INCLUDE_TEST_SUITE(RecordRing)
+INCLUDE_TEST_SUITE(Resampler)
+INCLUDE_TEST_SUITE(SampleCache)
+INCLUDE_TEST_SUITE(SampleLibrary)
+INCLUDE_TEST_SUITE(SpectrumAnalyzer)
+INCLUDE_TEST_SUITE(Stft)
+INCLUDE_TEST_SUITE(StreamScheduler)
 INCLUDE_TEST_SUITE(ThreadPool)
+INCLUDE_TEST_SUITE(Trace)
+INCLUDE_TEST_SUITE(WavFile)
+INCLUDE_TEST_SUITE(WavPlayer)
+INCLUDE_TEST_SUITE(WavWriter)
 
 int main()
 {
+    ADD_TEST_SUITE(Logger);
+    ADD_TEST_SUITE(Trace); // Before anything that could trigger a dump, see TriggerCoolsDown
+    ADD_TEST_SUITE(Allocator);
     ADD_TEST_SUITE(ThreadPool);
     ADD_TEST_SUITE(CoreEngine);
+    ADD_TEST_SUITE(LoadMonitor);
     ADD_TEST_SUITE(Oscillators);
+    ADD_TEST_SUITE(Pcm);
+    ADD_TEST_SUITE(Resampler);
+    ADD_TEST_SUITE(Fft);
+    ADD_TEST_SUITE(Interpolator);
+    ADD_TEST_SUITE(RecordRing);
+    ADD_TEST_SUITE(AsyncIo);
+    ADD_TEST_SUITE(StreamScheduler);
+    ADD_TEST_SUITE(WavFile);
+    ADD_TEST_SUITE(WavWriter);
+    ADD_TEST_SUITE(AudioRenderer);
+    ADD_TEST_SUITE(MultitrackRecorder);
+    ADD_TEST_SUITE(Convolver);
+    ADD_TEST_SUITE(Stft);
+    ADD_TEST_SUITE(SpectrumAnalyzer);
+    ADD_TEST_SUITE(Oversampler);
+    ADD_TEST_SUITE(DelayLine);
+    ADD_TEST_SUITE(DelayEffects);
+    ADD_TEST_SUITE(SampleCache);
+    ADD_TEST_SUITE(SampleLibrary);
+    ADD_TEST_SUITE(WavPlayer);
 
     return RunAllTests(LOG_TEST);
 }
@@ -0,0 +1,115 @@
+#include "test_framework.h"
+#include <core_engine.h>
+#include <math.h>
+#include <pthread.h>
+#include <spectrum_analyzer.h>
+#include <string.h>
+
+#define TEST_CYCLE_FRAMES 480
+#define TEST_FRAME_FRAMES 1024
+#define TEST_SINE_BIN 64
+
+static CoreEngineContext ctx_;
+static f32 buffer_[TEST_FRAME_FRAMES * 2];
+static atomic_bool stop_;
+static atomic_bool torn_;
+
+static void RunCycle(u16 id, u32 numFrames)
+{
+    AudioProcessor* proc = &ctx_.processors[id];
+    proc->Process(SAMPLE_RATE_DEFAULT, (u16)numFrames, buffer_, proc->procData);
+}
+
+TEST(SpectrumAnalyzer, SineShowsAtItsBin)
+{
+    SpectrumAnalyzer* analyzer = CoreEngine_New(&ctx_, SpectrumAnalyzer);
+    u16 id = SpectrumAnalyzer_Create(analyzer, &ctx_, TEST_FRAME_FRAMES, TEST_FRAME_FRAMES / 2);
+    CHECK_TRUE(ctx_.processors[id].priority == PROCESSOR_PRIORITY_LOW);
+    CHECK_TRUE(SpectrumAnalyzer_Read(analyzer, NULL) == NULL);
+
+    bool untouched = true;
+    for (u32 cycle = 0; cycle < 10; cycle++) {
+        for (u32 i = 0; i < TEST_CYCLE_FRAMES; i++) {
+            f32 sine = sinf(2.0f * (f32)M_PI * TEST_SINE_BIN * (cycle * TEST_CYCLE_FRAMES + i) / TEST_FRAME_FRAMES);
+            buffer_[i * 2] = 0.5f * sine;
+            buffer_[i * 2 + 1] = 0.25f * sine;
+        }
+        f32 before = buffer_[TEST_CYCLE_FRAMES * 2 - 1];
+        RunCycle(id, TEST_CYCLE_FRAMES);
+        untouched &= (buffer_[TEST_CYCLE_FRAMES * 2 - 1] == before);
+    }
+    CHECK_TRUE(untouched);
+
+    u64 sequence = 0;
+    const f32* spectrum = SpectrumAnalyzer_Read(analyzer, &sequence);
+    CHECK_TRUE(spectrum != NULL);
+    CHECK_TRUE(sequence == (10 * TEST_CYCLE_FRAMES) / (TEST_FRAME_FRAMES / 2));
+    CHECK_TRUE(fabsf(spectrum[TEST_SINE_BIN] - 0.5f) < 1e-3f);
+    CHECK_TRUE(fabsf(spectrum[analyzer->numBins + TEST_SINE_BIN] - 0.25f) < 1e-3f);
+    CHECK_TRUE(spectrum[TEST_SINE_BIN * 3] < 1e-3f);
+
+    // Nothing new since, the same spectrum stays
+    CHECK_TRUE(SpectrumAnalyzer_Read(analyzer, &sequence) == spectrum);
+}
+
+static void* Reader(void* data)
+{
+    SpectrumAnalyzer* analyzer = (SpectrumAnalyzer*)data;
+    u64 last = 0;
+    while (!atomic_load(&stop_)) {
+        u64 sequence = 0;
+        const f32* spectrum = SpectrumAnalyzer_Read(analyzer, &sequence);
+        if (!spectrum) {
+            continue;
+        }
+        if (sequence < last || memcmp(spectrum, spectrum + analyzer->numBins, analyzer->numBins * sizeof(f32)) != 0) {
+            atomic_store(&torn_, true);
+        }
+        last = sequence;
+    }
+    return NULL;
+}
+
+TEST(SpectrumAnalyzer, ReaderOnlySeesWholeSpectra)
+{
+    SpectrumAnalyzer* analyzer = CoreEngine_New(&ctx_, SpectrumAnalyzer);
+    u16 id = SpectrumAnalyzer_Create(analyzer, &ctx_, 256, 256);
+
+    atomic_store(&stop_, false);
+    atomic_store(&torn_, false);
+    pthread_t thread;
+    pthread_create(&thread, NULL, Reader, analyzer);
+
+    // Both sides the same but every spectrum different, so half of one and half of the next
+    // wouldn't match
+    for (u32 block = 0; block < 5000; block++) {
+        for (u32 i = 0; i < 256 * 2; i++) {
+            buffer_[i] = (f32)((block * 7 + i / 2) % 101) / 101.0f;
+        }
+        RunCycle(id, 256);
+    }
+
+    atomic_store(&stop_, true);
+    pthread_join(thread, NULL);
+    CHECK_TRUE(!atomic_load(&torn_));
+
+    u64 sequence = 0;
+    SpectrumAnalyzer_Read(analyzer, &sequence);
+    CHECK_TRUE(sequence == 5000);
+}
+
+TEST_SETUP(SpectrumAnalyzer)
+{
+    ADD_TEST(SpectrumAnalyzer, SineShowsAtItsBin);
+    ADD_TEST(SpectrumAnalyzer, ReaderOnlySeesWholeSpectra);
+}
+
+TEST_BRINGUP(SpectrumAnalyzer)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(SpectrumAnalyzer)
+{
+    CoreEngine_Deinit(&ctx_);
+}
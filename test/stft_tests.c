@@ -0,0 +1,100 @@
+#include "test_framework.h"
+#include <math.h>
+#include <stft.h>
+#include <string.h>
+
+#define TEST_FRAME_FRAMES 1024
+#define TEST_NUM_FRAMES 10000
+
+static f32 input_[TEST_NUM_FRAMES * 2];
+static f32 buffer_[TEST_NUM_FRAMES * 2];
+static f32 bins_[2][64]; // First bin of each hop, for two runs
+static u32 numCalls_;
+static HeapArena arena_;
+
+static void FillInput(void)
+{
+    u32 state = 5;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        state = state * 1664525u + 1013904223u;
+        input_[i] = (f32)(state >> 8) / (f32)(1 << 23) - 1.0f;
+    }
+}
+
+static void LeaveAsIs(u32 channel, f32* re, f32* im, void* data)
+{
+    (void)channel;
+    (void)re;
+    (void)im;
+    (void)data;
+}
+
+static void RecordFirstBin(u32 channel, f32* re, f32* im, void* data)
+{
+    (void)im;
+    f32* bins = (f32*)data;
+    if (channel == 0 && numCalls_ / 2 < 64) {
+        bins[numCalls_ / 2] = re[1];
+    }
+    numCalls_++;
+}
+
+static void Run(Stft* stft, u32 blockFrames)
+{
+    memcpy(buffer_, input_, sizeof(buffer_));
+    for (u32 done = 0; done < TEST_NUM_FRAMES; done += blockFrames) {
+        u32 numFrames = (TEST_NUM_FRAMES - done < blockFrames) ? TEST_NUM_FRAMES - done : blockFrames;
+        Stft_Process(stft, buffer_ + done * 2, numFrames);
+    }
+}
+
+TEST(Stft, SynthesisGivesTheInputBackAFrameLate)
+{
+    FillInput();
+
+    Stft stft;
+    Stft_Init(&stft, &arena_, TEST_FRAME_FRAMES, TEST_FRAME_FRAMES / 4, true, LeaveAsIs, NULL);
+    Run(&stft, 300);
+
+    bool ok = true;
+    for (u32 i = 0; i < TEST_NUM_FRAMES * 2; i++) {
+        f32 expected = (i >= TEST_FRAME_FRAMES * 2) ? input_[i - TEST_FRAME_FRAMES * 2] : 0.0f;
+        ok &= (fabsf(buffer_[i] - expected) < 1e-4f);
+    }
+    CHECK_TRUE(ok);
+}
+
+TEST(Stft, HopsDontDependOnTheBlockSize)
+{
+    FillInput();
+
+    // A hop that neither the frame nor the blocks divide
+    u32 blockFrames[2] = { 77, 4096 };
+    for (u32 run = 0; run < 2; run++) {
+        Stft stft;
+        numCalls_ = 0;
+        Stft_Init(&stft, &arena_, TEST_FRAME_FRAMES, 300, false, RecordFirstBin, bins_[run]);
+        Run(&stft, blockFrames[run]);
+        CHECK_TRUE(stft.numHops == TEST_NUM_FRAMES / 300);
+        CHECK_TRUE(numCalls_ == stft.numHops * 2);
+    }
+
+    CHECK_TRUE(memcmp(bins_[0], bins_[1], sizeof(bins_[0])) == 0);
+    CHECK_TRUE(memcmp(buffer_, input_, sizeof(buffer_)) == 0);
+}
+
+TEST_SETUP(Stft)
+{
+    ADD_TEST(Stft, SynthesisGivesTheInputBackAFrameLate);
+    ADD_TEST(Stft, HopsDontDependOnTheBlockSize);
+}
+
+TEST_BRINGUP(Stft)
+{
+    HeapArena_Init(&arena_, 1024 * 1024);
+}
+
+TEST_TEARDOWN(Stft)
+{
+    HeapArena_Deinit(&arena_);
+}
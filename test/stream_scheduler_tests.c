@@ -0,0 +1,222 @@
+#include "test_framework.h"
+#include <stream_scheduler.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define NUM_TEST_SOURCES 4
+
+typedef struct {
+    StreamSource source;
+    u32 id;
+} TestStream;
+
+static StreamScheduler scheduler_;
+static TestStream streams_[NUM_TEST_SOURCES];
+static u32 fillOrder_[NUM_TEST_SOURCES * 2];
+static u32 numFills_;
+static i32 fd_;
+
+static HeapArena arena_;
+static AsyncIo asyncIo_;
+static AsyncIoRequest reads_[NUM_TEST_SOURCES];
+static i32 fileFd_;
+static atomic_u32 numCompletedReads_;
+
+static u64 FillTest(void* data)
+{
+    TestStream* stream = (TestStream*)data;
+    fillOrder_[numFills_++] = stream->id;
+    atomic_store(&stream->source.bufferedFrames, 48000);
+    return 1000;
+}
+
+static void OnTestRead(AsyncIoRequest* request)
+{
+    TestStream* stream = (TestStream*)request->data;
+    atomic_store(&stream->source.bufferedFrames, 48000);
+    StreamScheduler_Complete(&scheduler_, &stream->source, (u64)request->result);
+    atomic_fetch_add(&numCompletedReads_, 1);
+}
+
+static u64 FillTestAsync(void* data)
+{
+    TestStream* stream = (TestStream*)data;
+    fillOrder_[numFills_++] = stream->id;
+    reads_[stream->id] = (AsyncIoRequest) {
+        .op = ASYNC_IO_READ,
+        .fd = fileFd_,
+        .buffer = AsyncIo_GetBuffer(&asyncIo_, (i32)stream->id),
+        .size = 1000,
+        .bufferIndex = (i32)stream->id,
+        .OnComplete = OnTestRead,
+        .data = stream,
+    };
+    AsyncIo_Queue(&asyncIo_, &reads_[stream->id]);
+    return STREAM_FILL_ASYNC;
+}
+
+static void AttachAsyncIo(void)
+{
+    static u8 data[4096];
+    FILE* file = fopen("/tmp/jamcore_stream_scheduler_test.bin", "wb");
+    fwrite(data, 1, sizeof(data), file);
+    fclose(file);
+    fileFd_ = open("/tmp/jamcore_stream_scheduler_test.bin", O_RDONLY);
+
+    atomic_store(&numCompletedReads_, 0);
+    HeapArena_Init(&arena_, (NUM_TEST_SOURCES + 1) * ASYNC_IO_ALIGNMENT);
+    AsyncIo_Init(&asyncIo_, &arena_, ASYNC_IO_BACKEND_AUTO, NUM_TEST_SOURCES, ASYNC_IO_ALIGNMENT);
+    StreamScheduler_AttachAsyncIo(&scheduler_, &asyncIo_, STREAM_MAX_ASYNC_PER_DEVICE);
+}
+
+static void DetachAsyncIo(void)
+{
+    AsyncIo_Deinit(&asyncIo_);
+    HeapArena_Deinit(&arena_);
+    close(fileFd_);
+    remove("/tmp/jamcore_stream_scheduler_test.bin");
+}
+
+static void RegisterStreams(u32 rate)
+{
+    for (u32 i = 0; i < NUM_TEST_SOURCES; i++) {
+        streams_[i] = (TestStream) { .id = i };
+        streams_[i].source.Fill = FillTest;
+        streams_[i].source.data = &streams_[i];
+        streams_[i].source.framesPerSecond = rate;
+        StreamScheduler_Register(&scheduler_, &streams_[i].source, fd_);
+    }
+}
+
+TEST(StreamScheduler, EarliestDeadlineFirst)
+{
+    RegisterStreams(48000);
+
+    // Buffered audio decides the order, not registration order
+    atomic_store(&streams_[0].source.bufferedFrames, 9000);
+    atomic_store(&streams_[1].source.bufferedFrames, 100);
+    atomic_store(&streams_[2].source.bufferedFrames, 40000);
+    atomic_store(&streams_[3].source.bufferedFrames, 0);
+    for (u32 i = 0; i < NUM_TEST_SOURCES; i++) {
+        StreamScheduler_Request(&streams_[i].source);
+    }
+
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == NUM_TEST_SOURCES);
+    CHECK_TRUE(fillOrder_[0] == 3);
+    CHECK_TRUE(fillOrder_[1] == 1);
+    CHECK_TRUE(fillOrder_[2] == 0);
+    CHECK_TRUE(fillOrder_[3] == 2);
+
+    CHECK_TRUE(scheduler_.numReads == NUM_TEST_SOURCES);
+    CHECK_TRUE(scheduler_.bytesRead == NUM_TEST_SOURCES * 1000);
+    CHECK_TRUE(scheduler_.numLateReads == 1);
+    CHECK_TRUE(scheduler_.minSlackNs == 0);
+}
+
+TEST(StreamScheduler, ConsumptionRateSetsDeadline)
+{
+    RegisterStreams(48000);
+
+    // Same buffer but one is used up twice as fast
+    streams_[0].source.framesPerSecond = 48000;
+    streams_[1].source.framesPerSecond = 96000;
+    for (u32 i = 0; i < 2; i++) {
+        atomic_store(&streams_[i].source.bufferedFrames, 4800);
+        StreamScheduler_Request(&streams_[i].source);
+    }
+
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == 2);
+    CHECK_TRUE(fillOrder_[0] == 1);
+    CHECK_TRUE(fillOrder_[1] == 0);
+}
+
+TEST(StreamScheduler, OnlyServicesRequests)
+{
+    RegisterStreams(48000);
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == 0);
+
+    StreamScheduler_Request(&streams_[2].source);
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == 1);
+    CHECK_TRUE(fillOrder_[0] == 2);
+    CHECK_TRUE(!atomic_load(&streams_[2].source.pending));
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == 0);
+
+    // Unregistered streams are forgotten
+    StreamScheduler_Unregister(&scheduler_, &streams_[2].source);
+    StreamScheduler_Request(&streams_[2].source);
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == 0);
+    CHECK_TRUE(scheduler_.numDevices == 1);
+}
+
+TEST(StreamScheduler, IoThreadsServiceRequests)
+{
+    RegisterStreams(48000);
+    StreamScheduler_Start(&scheduler_);
+
+    StreamScheduler_Request(&streams_[0].source);
+    for (u32 i = 0; i < 500 && atomic_load(&streams_[0].source.pending); i++) {
+        usleep(1000);
+    }
+    StreamScheduler_Stop(&scheduler_);
+
+    CHECK_TRUE(numFills_ == 1);
+    CHECK_TRUE(fillOrder_[0] == 0);
+}
+
+TEST(StreamScheduler, AsyncFillsCompleteLater)
+{
+    AttachAsyncIo();
+    RegisterStreams(48000);
+    for (u32 i = 0; i < NUM_TEST_SOURCES; i++) {
+        streams_[i].source.Fill = FillTestAsync;
+        StreamScheduler_Request(&streams_[i].source);
+    }
+
+    // Every read is queued before any of them land
+    CHECK_TRUE(StreamScheduler_RunOnce(&scheduler_) == NUM_TEST_SOURCES);
+    CHECK_TRUE(asyncIo_.numBatches == 1);
+    CHECK_TRUE(scheduler_.numReads == NUM_TEST_SOURCES);
+    CHECK_TRUE(scheduler_.bytesRead == NUM_TEST_SOURCES * 1000);
+    for (u32 i = 0; i < NUM_TEST_SOURCES; i++) {
+        CHECK_TRUE(!streams_[i].source.inFlight);
+        CHECK_TRUE(atomic_load(&streams_[i].source.bufferedFrames) == 48000);
+    }
+
+    // And the same again from the scheduler's own thread
+    StreamScheduler_Start(&scheduler_);
+    StreamScheduler_Request(&streams_[1].source);
+    for (u32 i = 0; i < 500 && atomic_load(&numCompletedReads_) < NUM_TEST_SOURCES + 1; i++) {
+        usleep(1000);
+    }
+    StreamScheduler_Stop(&scheduler_);
+    CHECK_TRUE(numFills_ == NUM_TEST_SOURCES + 1);
+    CHECK_TRUE(scheduler_.bytesRead == (NUM_TEST_SOURCES + 1) * 1000);
+
+    for (u32 i = 0; i < NUM_TEST_SOURCES; i++) {
+        StreamScheduler_Unregister(&scheduler_, &streams_[i].source);
+    }
+    DetachAsyncIo();
+}
+
+TEST_SETUP(StreamScheduler)
+{
+    ADD_TEST(StreamScheduler, EarliestDeadlineFirst);
+    ADD_TEST(StreamScheduler, ConsumptionRateSetsDeadline);
+    ADD_TEST(StreamScheduler, OnlyServicesRequests);
+    ADD_TEST(StreamScheduler, IoThreadsServiceRequests);
+    ADD_TEST(StreamScheduler, AsyncFillsCompleteLater);
+}
+
+TEST_BRINGUP(StreamScheduler)
+{
+    StreamScheduler_Init(&scheduler_, 2, STREAM_MAX_IO_PER_DEVICE);
+    numFills_ = 0;
+    fd_ = open("/tmp", O_RDONLY);
+}
+
+TEST_TEARDOWN(StreamScheduler)
+{
+    StreamScheduler_Deinit(&scheduler_);
+    close(fd_);
+}
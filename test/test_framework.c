@@ -1,5 +1,6 @@
 #include "test_framework.h"
 #include <logger.h>
+#include <rt_check.h>
 
 #include <stdio.h>
 #include <setjmp.h>
@@ -186,6 +187,8 @@ i32 RunAllTests(LogLevel logLevel)
         }
         suite->duration = GetTimeMs() - suiteStartTime;
     }
+
+    Logger_Flush();
     
     String suiteNames;
     StringInit(&suiteNames, "");
@@ -237,6 +240,15 @@ i32 RunAllTests(LogLevel logLevel)
 
     WriteJUnitReport();
 
+    // With make RTCHECK=1 anything the audio thread did that it shouldn't fails the run
+    if (RtCheck_IsCompiled()) {
+        RtCheck_Report();
+        if (RtCheck_GetViolationCount() > 0) {
+            printf("%sRealtime safety violations detected!%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+            return 1;
+        }
+    }
+
     return totalFailed > 0 ? 1 : 0;
 }
 
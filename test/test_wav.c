@@ -0,0 +1,86 @@
+#include "test_wav.h"
+#include <logger.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void PutU16(u8* dst, u16 value)
+{
+    dst[0] = value & 0xFF;
+    dst[1] = value >> 8;
+}
+
+static void PutU32(u8* dst, u32 value)
+{
+    for (u8 i = 0; i < 4; i++) {
+        dst[i] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+void TestWav_Write(const char* path, 
+                   u16 formatTag, 
+                   u16 subFormatTag, 
+                   u16 numChannels, 
+                   u16 bitsPerSample, 
+                   u32 sampleRate, 
+                   const void* samples, 
+                   u32 dataSize)
+{
+    u8 header[128];
+    memset(header, 0, sizeof(header));
+    u32 fmtSize = (formatTag == WAV_FORMAT_TAG_EXTENSIBLE) ? 40 : 16;
+    u16 blockAlign = numChannels * bitsPerSample / 8;
+
+    u32 offset = 12;
+    memcpy(header + offset, "fmt ", 4);
+    PutU32(header + offset + 4, fmtSize);
+    u8* fmt = header + offset + 8;
+    PutU16(fmt, formatTag);
+    PutU16(fmt + 2, numChannels);
+    PutU32(fmt + 4, sampleRate);
+    PutU32(fmt + 8, sampleRate * blockAlign);
+    PutU16(fmt + 12, blockAlign);
+    PutU16(fmt + 14, bitsPerSample);
+    if (formatTag == WAV_FORMAT_TAG_EXTENSIBLE) {
+        static const u8 guidTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+        PutU16(fmt + 16, 22);
+        PutU16(fmt + 18, bitsPerSample);
+        PutU16(fmt + 24, subFormatTag);
+        memcpy(fmt + 26, guidTail, sizeof(guidTail));
+    }
+    offset += 8 + fmtSize;
+
+    memcpy(header + offset, "LIST", 4);
+    PutU32(header + offset + 4, 3); // Odd size gets padded
+    offset += 8 + 4;
+
+    memcpy(header + offset, "data", 4);
+    PutU32(header + offset + 4, dataSize);
+    offset += 8;
+
+    memcpy(header, "RIFF", 4);
+    PutU32(header + 4, offset - 8 + dataSize);
+    memcpy(header + 8, "WAVE", 4);
+
+    FILE* file = fopen(path, "wb");
+    Assert(file != NULL, "Failed to create test wav");
+    fwrite(header, 1, offset, file);
+    fwrite(samples, 1, dataSize, file);
+    fclose(file);
+}
+
+void TestWav_WriteRamp(const char* path, u32 numFrames, u32 sampleRate)
+{
+    i16* samples = malloc(numFrames * 2 * sizeof(i16));
+    for (u32 i = 0; i < numFrames; i++) {
+        samples[i * 2] = (i16)(i & 0x7FFF);
+        samples[i * 2 + 1] = -(i16)(i & 0x7FFF);
+    }
+    TestWav_Write(path, WAV_FORMAT_TAG_PCM, 0, 2, 16, sampleRate, samples, numFrames * 2 * sizeof(i16));
+    free(samples);
+}
+
+f32 TestWav_RampSample(u64 frame)
+{
+    return (f32)(frame & 0x7FFF) / 32768.0f;
+}
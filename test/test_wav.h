@@ -0,0 +1,18 @@
+#pragma once
+
+#include <types.h>
+#include <wav_file.h>
+
+// Writes a minimal WAV, with an extra chunk before the data to check chunks get skipped
+void TestWav_Write(const char* path, 
+                   u16 formatTag, 
+                   u16 subFormatTag, 
+                   u16 numChannels, 
+                   u16 bitsPerSample, 
+                   u32 sampleRate, 
+                   const void* samples, 
+                   u32 dataSize);
+
+// Stereo PCM16 where frame i holds (i, -i) wrapped to 15 bits, so any frame can be checked
+void TestWav_WriteRamp(const char* path, u32 numFrames, u32 sampleRate);
+f32 TestWav_RampSample(u64 frame);
@@ -32,9 +32,85 @@ TEST(ThreadPool, RunTasks)
     CHECK_TRUE(count == numTasks);
 }
 
+typedef struct {
+    u32 index;
+    _Atomic(u32) numRuns;
+    _Atomic(u32)* numStarted;
+    u32* order;
+} OrderedTask;
+
+static void OrderedCallback(void* data)
+{
+    OrderedTask* task = (OrderedTask*)data;
+    task->order[atomic_fetch_add(task->numStarted, 1)] = task->index;
+    atomic_fetch_add(&task->numRuns, 1);
+}
+
+TEST(ThreadPool, RunTasksOnceInOrder)
+{
+    // One worker so the order tasks are taken in is the order they run in
+    ThreadPool pool;
+    ThreadPool_Init(&pool, 1, 4);
+    ThreadPool_Start(&pool);
+
+    // Defer while the worker is busy and wrap the queue a few times
+    OrderedTask tasks[12];
+    u32 order[12] = { 0, };
+    _Atomic(u32) numStarted = 0;
+    for (u32 i = 0; i < 12; i++) {
+        tasks[i] = (OrderedTask) { .index = i, .numRuns = 0, .numStarted = &numStarted, .order = order };
+    }
+
+    for (u32 round = 0; round < 3; round++) {
+        for (u32 i = 0; i < 4; i++) {
+            ThreadPool_DeferTask(&pool, OrderedCallback, (void*)&tasks[round * 4 + i]);
+        }
+        ThreadPool_FlushTasks(&pool);
+
+        for (u32 waited = 0; waited < 1000 && atomic_load(&numStarted) < (round + 1) * 4; waited++) {
+            usleep(1000);
+        }
+    }
+
+    ThreadPool_Stop(&pool);
+    ThreadPool_Deinit(&pool);
+
+    CHECK_TRUE(atomic_load(&numStarted) == 12);
+    for (u32 i = 0; i < 12; i++) {
+        CHECK_TRUE(order[i] == i);
+        CHECK_TRUE(atomic_load(&tasks[i].numRuns) == 1);
+    }
+}
+
+TEST(ThreadPool, FlushWakesWorkers)
+{
+    ThreadPool pool;
+    ThreadPool_Init(&pool, 2, 10);
+    ThreadPool_Start(&pool);
+
+    // Run by flushing alone, well before stop drains what's left
+    _Atomic(u8) count = 0;
+    for (u8 round = 1; round <= 3; round++) {
+        for (u8 i = 0; i < 3; i++) {
+            ThreadPool_DeferTask(&pool, TestCallback, (void*)&count);
+        }
+        ThreadPool_FlushTasks(&pool);
+
+        for (u32 waited = 0; waited < 1000 && atomic_load(&count) < round * 3; waited++) {
+            usleep(1000);
+        }
+        CHECK_TRUE(atomic_load(&count) == round * 3);
+    }
+
+    ThreadPool_Stop(&pool);
+    ThreadPool_Deinit(&pool);
+}
+
 TEST_SETUP(ThreadPool)
 {
     ADD_TEST(ThreadPool, RunTasks);
+    ADD_TEST(ThreadPool, RunTasksOnceInOrder);
+    ADD_TEST(ThreadPool, FlushWakesWorkers);
 }
 
 TEST_BRINGUP(ThreadPool)
@@ -0,0 +1,332 @@
+#include "test_framework.h"
+#include <trace.h>
+#include <thread_pool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TEST_TRACE_PATH "/tmp/jamcore_trace_test.json"
+#define OVERWRITE_EXTRA_EVENTS 100
+
+typedef struct {
+    char name[64];
+    char phase;
+    i64 value;
+    bool hasValue;
+} ParsedEvent;
+
+static ParsedEvent events_[TRACE_RING_CAPACITY + 16];
+
+static char* ReadFile(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    char* text = malloc((size_t)size + 1);
+    size_t length = fread(text, 1, (size_t)size, file);
+    text[length] = '\0';
+    fclose(file);
+    return text;
+}
+
+// Just enough of a JSON parser to tell a well formed document from a broken one
+static const char* SkipSpace(const char* p)
+{
+    while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++;
+    return p;
+}
+
+static const char* ParseValue(const char* p);
+
+static const char* ParseString(const char* p)
+{
+    if (*p != '"') return NULL;
+    for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && *++p == '\0') return NULL;
+    }
+    return (*p == '"') ? p + 1 : NULL;
+}
+
+static const char* ParseContainer(const char* p, char close, bool isObject)
+{
+    p = SkipSpace(p + 1);
+    if (*p == close) return p + 1;
+
+    while (p) {
+        if (isObject) {
+            p = ParseString(SkipSpace(p));
+            if (p == NULL) return NULL;
+            p = SkipSpace(p);
+            if (*p != ':') return NULL;
+            p++;
+        }
+        p = ParseValue(p);
+        if (p == NULL) return NULL;
+        p = SkipSpace(p);
+        if (*p == close) return p + 1;
+        if (*p != ',') return NULL;
+        p++;
+    }
+    return NULL;
+}
+
+static const char* ParseValue(const char* p)
+{
+    p = SkipSpace(p);
+    if (*p == '{') return ParseContainer(p, '}', true);
+    if (*p == '[') return ParseContainer(p, ']', false);
+    if (*p == '"') return ParseString(p);
+    if (strncmp(p, "true", 4) == 0 || strncmp(p, "null", 4) == 0) return p + 4;
+    if (strncmp(p, "false", 5) == 0) return p + 5;
+
+    char* end;
+    strtod(p, &end);
+    return (end != p) ? end : NULL;
+}
+
+static bool IsWellFormedJson(const char* text)
+{
+    const char* end = ParseValue(text);
+    return end != NULL && *SkipSpace(end) == '\0';
+}
+
+// Dumps write one event per line, so pulling a thread's events back out is line by line
+static bool FindThreadId(const char* json, const char* threadName, u32* tid)
+{
+    char pattern[96];
+    snprintf(pattern, sizeof(pattern), "\"args\": {\"name\": \"%s\"}", threadName);
+
+    for (const char* line = json; line != NULL; line = strchr(line, '\n')) {
+        line += (*line == '\n') ? 1 : 0;
+        const char* lineEnd = strchr(line, '\n');
+        const char* match = strstr(line, pattern);
+        if (match == NULL || (lineEnd != NULL && match > lineEnd)) {
+            continue;
+        }
+        const char* tidField = strstr(line, "\"tid\": ");
+        return (tidField != NULL) && sscanf(tidField, "\"tid\": %u", tid) == 1;
+    }
+    return false;
+}
+
+static u32 ParseThreadEvents(const char* json, u32 tid, ParsedEvent* events, u32 maxEvents)
+{
+    char tidField[32];
+    snprintf(tidField, sizeof(tidField), "\"tid\": %u,", tid);
+    char tidFieldLast[32];
+    snprintf(tidFieldLast, sizeof(tidFieldLast), "\"tid\": %u}", tid);
+
+    u32 numEvents = 0;
+    char line[512];
+    for (const char* p = json; *p && numEvents < maxEvents; ) {
+        const char* lineEnd = strchr(p, '\n');
+        u64 length = lineEnd ? (u64)(lineEnd - p) : strlen(p);
+        length = (length < sizeof(line) - 1) ? length : sizeof(line) - 1;
+        memcpy(line, p, length);
+        line[length] = '\0';
+        p = lineEnd ? lineEnd + 1 : p + strlen(p);
+
+        if (!strstr(line, tidField) && !strstr(line, tidFieldLast)) {
+            continue;
+        }
+
+        ParsedEvent* event = &events[numEvents];
+        char phase[4];
+        const char* phaseField = strstr(line, "\"ph\": \"");
+        if (sscanf(line, " {\"name\": \"%63[^\"]\"", event->name) != 1 ||
+            phaseField == NULL ||
+            sscanf(phaseField, "\"ph\": \"%3[^\"]\"", phase) != 1) {
+            continue;
+        }
+        if (phase[0] == 'M') {
+            continue;
+        }
+        event->phase = phase[0];
+
+        const char* valueField = strstr(line, "\"value\": ");
+        const char* idField = strstr(line, "\"id\": ");
+        long long value = 0;
+        event->hasValue = (valueField && sscanf(valueField, "\"value\": %lld", &value) == 1) ||
+                          (idField && sscanf(idField, "\"id\": %lld", &value) == 1);
+        event->value = (i64)value;
+        numEvents++;
+    }
+    return numEvents;
+}
+
+static void RunOnThread(void* (*function)(void*))
+{
+    pthread_t thread;
+    pthread_create(&thread, NULL, function, NULL);
+    pthread_join(thread, NULL);
+}
+
+static void* OverwriteThread(void* data)
+{
+    (void)data;
+    Trace_SetThreadName("Overwrite Test");
+    for (u32 i = 0; i < TRACE_RING_CAPACITY + OVERWRITE_EXTRA_EVENTS; i++) {
+        TraceCounter("Overwrite", i);
+    }
+    return NULL;
+}
+
+TEST(Trace, OverwritesOldestFirst)
+{
+    RunOnThread(OverwriteThread);
+    CHECK_TRUE(Trace_Dump(TEST_TRACE_PATH));
+
+    char* json = ReadFile(TEST_TRACE_PATH);
+    CHECK_TRUE(json != NULL);
+    CHECK_TRUE(IsWellFormedJson(json));
+
+    // A full ring keeps the newest window, in order
+    u32 tid = 0;
+    CHECK_TRUE(FindThreadId(json, "Overwrite Test", &tid));
+    u32 numEvents = ParseThreadEvents(json, tid, events_, TRACE_RING_CAPACITY + 16);
+    free(json);
+
+    CHECK_TRUE(numEvents == TRACE_RING_CAPACITY);
+    for (u32 i = 0; i < numEvents; i++) {
+        CHECK_TRUE(events_[i].phase == 'C');
+        CHECK_TRUE(events_[i].hasValue && events_[i].value == OVERWRITE_EXTRA_EVENTS + i);
+    }
+}
+
+static void* SpansThread(void* data)
+{
+    (void)data;
+    Trace_SetThreadName("Spans Test");
+
+    // Wrap the ring inside an outer span, so the window starts on an inner span's end and
+    // the outer span's begin has been overwritten by the time it ends
+    TraceBegin("Outer");
+    for (u32 i = 0; i < TRACE_RING_CAPACITY / 2; i++) {
+        TraceBeginId("Inner", i);
+        TraceEnd("Inner");
+    }
+    TraceEnd("Outer");
+
+    TraceBegin("Cycle");
+    TraceBegin("Nested");
+    TraceCounter("Depth", 2);
+    TraceInstant("Marker");
+    TraceEnd("Nested");
+    TraceEnd("Cycle");
+    return NULL;
+}
+
+TEST(Trace, DumpsWellFormedChromeJson)
+{
+    RunOnThread(SpansThread);
+    CHECK_TRUE(Trace_Dump(TEST_TRACE_PATH));
+
+    char* json = ReadFile(TEST_TRACE_PATH);
+    CHECK_TRUE(json != NULL);
+    CHECK_TRUE(IsWellFormedJson(json));
+    CHECK_TRUE(strstr(json, "\"traceEvents\": [") != NULL);
+    CHECK_TRUE(strstr(json, "\"name\": \"thread_name\", \"ph\": \"M\"") != NULL);
+
+    u32 tid = 0;
+    CHECK_TRUE(FindThreadId(json, "Spans Test", &tid));
+    u32 numEvents = ParseThreadEvents(json, tid, events_, TRACE_RING_CAPACITY + 16);
+    free(json);
+
+    // Unmatched ends at the start of the window are dropped, every span left nests
+    i32 depth = 0;
+    u32 numBegins = 0, numOthers = 0;
+    bool sawOuter = false;
+    for (u32 i = 0; i < numEvents; i++) {
+        depth += (events_[i].phase == 'B') ? 1 : (events_[i].phase == 'E') ? -1 : 0;
+        CHECK_TRUE(depth >= 0);
+        numBegins += (events_[i].phase == 'B') ? 1 : 0;
+        numOthers += (events_[i].phase == 'i' || events_[i].phase == 'C') ? 1 : 0;
+        sawOuter |= (strcmp(events_[i].name, "Outer") == 0);
+    }
+    CHECK_TRUE(depth == 0);
+    CHECK_TRUE(!sawOuter);
+    CHECK_TRUE(numOthers == 2);
+    CHECK_TRUE(numBegins * 2 + numOthers == numEvents);
+    CHECK_TRUE(numEvents == TRACE_RING_CAPACITY - 2);
+
+    // Span ids survive the round trip
+    CHECK_TRUE(strcmp(events_[0].name, "Inner") == 0 && events_[0].phase == 'B');
+    CHECK_TRUE(events_[0].hasValue && events_[0].value == 4);
+    CHECK_TRUE(strcmp(events_[numEvents - 1].name, "Cycle") == 0 && events_[numEvents - 1].phase == 'E');
+}
+
+static void NoOpTask(void* data)
+{
+    (void)data;
+}
+
+TEST(Trace, TriggersAgainAfterFailedSubmit)
+{
+    // Never started, so the one slot stays taken and the dump can't be queued, handled the
+    // way the engine handles a miss
+    ThreadPool pool;
+    ThreadPool_Init(&pool, 1, 1);
+    ThreadPool_DeferTask(&pool, NoOpTask, NULL);
+
+    CHECK_TRUE(Trace_Trigger("UnqueuedMiss"));
+    CHECK_TRUE(!ThreadPool_TryDeferTask(&pool, Trace_DumpTask, NULL));
+    Trace_CancelDump();
+
+    // Neither pending nor cooling down from a dump that never happened
+    CHECK_TRUE(Trace_Trigger("NextMiss"));
+    Trace_CancelDump();
+    ThreadPool_Deinit(&pool);
+}
+
+TEST(Trace, TriggerCoolsDown)
+{
+    // Relies on nothing earlier in the run having dumped
+    Trace_SetDumpPath(TEST_TRACE_PATH);
+    remove(TEST_TRACE_PATH);
+
+    CHECK_TRUE(Trace_Trigger("FirstMiss"));
+    // Already a dump pending
+    CHECK_TRUE(!Trace_Trigger("SecondMiss"));
+
+    Trace_DumpTask(NULL);
+    char* json = ReadFile(TEST_TRACE_PATH);
+    CHECK_TRUE(json != NULL);
+    CHECK_TRUE(IsWellFormedJson(json));
+
+    // Every trigger marks the timeline, even the suppressed ones
+    CHECK_TRUE(strstr(json, "\"name\": \"FirstMiss\", \"ph\": \"i\"") != NULL);
+    CHECK_TRUE(strstr(json, "\"name\": \"SecondMiss\", \"ph\": \"i\"") != NULL);
+    free(json);
+
+    // The dump is done but the cooldown still holds off another
+    remove(TEST_TRACE_PATH);
+    CHECK_TRUE(!Trace_Trigger("ThirdMiss"));
+    CHECK_TRUE(ReadFile(TEST_TRACE_PATH) == NULL);
+
+    Trace_SetDumpPath(TRACE_DEFAULT_DUMP_PATH);
+}
+
+TEST_SETUP(Trace)
+{
+    ADD_TEST(Trace, TriggersAgainAfterFailedSubmit);
+    ADD_TEST(Trace, TriggerCoolsDown);
+    ADD_TEST(Trace, OverwritesOldestFirst);
+    ADD_TEST(Trace, DumpsWellFormedChromeJson);
+}
+
+TEST_BRINGUP(Trace)
+{
+    Trace_SetEnabled(true);
+}
+
+TEST_TEARDOWN(Trace)
+{
+    remove(TEST_TRACE_PATH);
+}
@@ -0,0 +1,142 @@
+#include "test_framework.h"
+#include "test_wav.h"
+#include <wav_file.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_WAV_PATH "/tmp/jamcore_wav_file_test.wav"
+
+TEST(WavFile, DecodesPcm16Mono)
+{
+    i16 samples[4] = { 0, 16384, -32768, 32767 };
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_PCM, 0, 1, 16, 44100, samples, sizeof(samples));
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.format == PCM_FORMAT_S16);
+    CHECK_TRUE(file.numChannels == 1);
+    CHECK_TRUE(file.sampleRate == 44100);
+    CHECK_TRUE(file.totalFrames == 4);
+    CHECK_TRUE(!WavFile_CanMap(&file, 44100));
+
+    // Mono lands on both sides
+    f32 out[8];
+    CHECK_TRUE(WavFile_ReadFrames(&file, 1, 8, out) == 3);
+    CHECK_TRUE(out[0] == 0.5f && out[1] == 0.5f);
+    CHECK_TRUE(out[2] == -1.0f && out[3] == -1.0f);
+    CHECK_TRUE(out[4] == 32767.0f / 32768.0f);
+    CHECK_TRUE(WavFile_ReadFrames(&file, 4, 8, out) == 0);
+
+    WavFile_Close(&file);
+}
+
+TEST(WavFile, DecodesExtensiblePcm24)
+{
+    // Stereo frames of (0.5, -0.5) then (-1.0, max)
+    u8 samples[12] = { 0x00, 0x00, 0x40, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x80, 0xFF, 0xFF, 0x7F };
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_EXTENSIBLE, WAV_FORMAT_TAG_PCM, 2, 24, 48000, samples, sizeof(samples));
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.format == PCM_FORMAT_S24);
+    CHECK_TRUE(file.totalFrames == 2);
+
+    f32 out[4];
+    CHECK_TRUE(WavFile_ReadFrames(&file, 0, 2, out) == 2);
+    CHECK_TRUE(out[0] == 0.5f && out[1] == -0.5f);
+    CHECK_TRUE(out[2] == -1.0f && out[3] == 8388607.0f / 8388608.0f);
+
+    WavFile_Close(&file);
+}
+
+TEST(WavFile, MapsFloatStereo)
+{
+    f32 samples[6] = { 0.1f, -0.1f, 0.2f, -0.2f, 0.3f, -0.3f };
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_FLOAT, 0, 2, 32, 48000, samples, sizeof(samples));
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.format == PCM_FORMAT_F32);
+    CHECK_TRUE(WavFile_CanMap(&file, 48000));
+    CHECK_TRUE(!WavFile_CanMap(&file, 44100));
+
+    const f32* frames = WavFile_MapFrames(&file, 1);
+    CHECK_TRUE(frames[0] == 0.2f && frames[1] == -0.2f);
+    WavFile_Prefetch(&file, 0, 1024);
+
+    WavFile_Close(&file);
+}
+
+TEST(WavFile, CompactFormatsRoundTrip)
+{
+    // Odd length so both the vector loop and the tail after it get used
+    enum { NUM_FRAMES = 13 };
+    f32 source[NUM_FRAMES * 2];
+    for (u32 i = 0; i < NUM_FRAMES * 2; i++) {
+        source[i] = (f32)((i32)((i * 2731) % 65536) - 32768) * PCM_S16_SCALE;
+    }
+    source[0] = -1.0f;
+    source[1] = 32767.0f * PCM_S16_SCALE;
+
+    PcmFormat formats[2] = { PCM_FORMAT_S16, PCM_FORMAT_S24 };
+    for (u32 f = 0; f < 2; f++) {
+        u8 packed[NUM_FRAMES * 2 * 3];
+        Pcm_EncodeStereo(formats[f], source, NUM_FRAMES, packed);
+
+        // Mixing adds on top of what's there
+        f32 mixed[NUM_FRAMES * 2];
+        for (u32 i = 0; i < NUM_FRAMES * 2; i++) {
+            mixed[i] = 0.25f;
+        }
+        Pcm_MixStereo(formats[f], packed, NUM_FRAMES, mixed);
+        for (u32 i = 0; i < NUM_FRAMES * 2; i++) {
+            CHECK_TRUE(mixed[i] == source[i] + 0.25f);
+        }
+    }
+
+    // Out of range clips rather than wrapping
+    f32 loud[2] = { 1.5f, -1.5f };
+    u8 packed[4];
+    f32 clipped[2] = { 0.0f, 0.0f };
+    Pcm_EncodeStereo(PCM_FORMAT_S16, loud, 1, packed);
+    Pcm_MixStereo(PCM_FORMAT_S16, packed, 1, clipped);
+    CHECK_TRUE(clipped[0] == 32767.0f * PCM_S16_SCALE && clipped[1] == -1.0f);
+
+    CHECK_TRUE(Pcm_CompactFormat(PCM_FORMAT_S16) == PCM_FORMAT_S16);
+    CHECK_TRUE(Pcm_CompactFormat(PCM_FORMAT_S32) == PCM_FORMAT_F32);
+}
+
+TEST(WavFile, RejectsBadFiles)
+{
+    FILE* file = fopen(TEST_WAV_PATH, "wb");
+    fputs("This is not a RIFF file at all", file);
+    fclose(file);
+
+    WavFile wav;
+    CHECK_DEATH(WavFile_Open(&wav, TEST_WAV_PATH));
+    CHECK_DEATH(WavFile_Open(&wav, "/tmp/jamcore_file_that_does_not_exist.wav"));
+
+    // 8 bit PCM isn't supported
+    u8 samples[2] = { 0, 0 };
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_PCM, 0, 1, 8, 48000, samples, sizeof(samples));
+    CHECK_DEATH(WavFile_Open(&wav, TEST_WAV_PATH));
+}
+
+TEST_SETUP(WavFile)
+{
+    ADD_TEST(WavFile, DecodesPcm16Mono);
+    ADD_TEST(WavFile, DecodesExtensiblePcm24);
+    ADD_TEST(WavFile, MapsFloatStereo);
+    ADD_TEST(WavFile, CompactFormatsRoundTrip);
+    ADD_TEST(WavFile, RejectsBadFiles);
+}
+
+TEST_BRINGUP(WavFile)
+{
+
+}
+
+TEST_TEARDOWN(WavFile)
+{
+    remove(TEST_WAV_PATH);
+}
@@ -0,0 +1,560 @@
+#include "test_framework.h"
+#include "test_wav.h"
+#include <core_engine.h>
+#include <wav_player.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WAV_PATH "/tmp/jamcore_wav_player_test.wav"
+#define TEST_BLOCK_FRAMES 256
+
+static CoreEngineContext ctx_;
+static f32 buffer_[BUFFER_SIZE * 2];
+
+static void ProcessBlock(u16 id, u16 numFrames)
+{
+    memset(buffer_, 0, sizeof(buffer_));
+    AudioProcessor* proc = &ctx_.processors[id];
+    proc->Process(SAMPLE_RATE_DEFAULT, numFrames, buffer_, proc->procData);
+}
+
+static bool BlockMatchesRamp(u64 startFrame, u16 numFrames)
+{
+    for (u16 i = 0; i < numFrames; i++) {
+        f32 expected = TestWav_RampSample(startFrame + i);
+        if (buffer_[i * 2] != expected || buffer_[i * 2 + 1] != -expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool BlockIsSilent(u16 numFrames)
+{
+    for (u32 i = 0; i < numFrames * 2u; i++) {
+        if (buffer_[i] != 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Plays on from the current frame, checking every frame against the ramp looped the way
+// WavPlayer_SetLoop describes, crossfade included
+static bool PlaysLoop(WavPlayer* player, u16 id, u64 start, u64 end, u32 crossfade, u32 numBlocks)
+{
+    u64 frame = atomic_load(&player->currentFrame);
+    for (u32 block = 0; block < numBlocks; block++) {
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+
+        for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+            frame = (frame == end) ? start + crossfade : frame;
+            f32 expected = TestWav_RampSample(frame);
+            if (frame >= end - crossfade) {
+                u64 fadeFrame = frame - (end - crossfade);
+                f32 gain = (f32)(fadeFrame + 1) / (f32)(crossfade + 1);
+                expected = expected * (1.0f - gain) + TestWav_RampSample(start + fadeFrame) * gain;
+            }
+            if (fabsf(buffer_[i * 2] - expected) > 1e-5f) {
+                return false;
+            }
+            frame++;
+        }
+    }
+    return true;
+}
+
+TEST(WavPlayer, StreamsWholeFile)
+{
+    u32 numFrames = AUDIO_FILE_CHUNK_SIZE * 5 + 100;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, 0, 0);
+    CHECK_TRUE(!player->mapped);
+    CHECK_TRUE(player->stream.numSlots == WAVPLAYER_MIN_SLOTS);
+
+    u64 frame = 0;
+    while (!(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        u16 expectedFrames = (numFrames - frame < TEST_BLOCK_FRAMES) ? (u16)(numFrames - frame) : TEST_BLOCK_FRAMES;
+        CHECK_TRUE(BlockMatchesRamp(frame, expectedFrames));
+        frame += expectedFrames;
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    }
+
+    CHECK_TRUE(frame == numFrames);
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+    CHECK_TRUE(atomic_load(&player->numLoads) > 1);
+}
+
+TEST(WavPlayer, ResamplesToEngineRate)
+{
+    // A second of 44.1kHz sine should come out as a second of the same sine at the engine rate
+    u32 numFrames = 44100;
+    f32* samples = malloc(numFrames * 2 * sizeof(f32));
+    for (u32 i = 0; i < numFrames; i++) {
+        samples[i * 2] = samples[i * 2 + 1] = (f32)(0.5 * sin(2.0 * M_PI * 1000.0 * i / 44100.0));
+    }
+    TestWav_Write(TEST_WAV_PATH, WAV_FORMAT_TAG_FLOAT, 0, 2, 32, 44100, samples, numFrames * 2 * sizeof(f32));
+    free(samples);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, WAVPLAYER_DIRECT_IO, 0);
+    CHECK_TRUE(player->resampling && !player->mapped && !player->stream.asyncRead);
+    CHECK_TRUE(player->totalFrames == SAMPLE_RATE_DEFAULT);
+
+    u64 frame = 0;
+    f64 maxError = 0.0;
+    while (!(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        for (u16 i = 0; i < TEST_BLOCK_FRAMES && frame + i < player->totalFrames - 100; i++) {
+            f64 expected = 0.5 * sin(2.0 * M_PI * 1000.0 * (frame + i) / SAMPLE_RATE_DEFAULT);
+            maxError = (frame + i >= 100) ? fmax(maxError, fabs(buffer_[i * 2] - expected)) : maxError;
+        }
+        frame += TEST_BLOCK_FRAMES;
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    }
+    CHECK_TRUE(maxError < 1e-3);
+    CHECK_TRUE(atomic_load(&player->currentFrame) == SAMPLE_RATE_DEFAULT);
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    // Seeks and cues land on the same sine
+    u32 cue = WavPlayer_AddCue(player, 30000);
+    WavPlayer_SeekToCue(player, cue);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    maxError = 0.0;
+    for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+        f64 expected = 0.5 * sin(2.0 * M_PI * 1000.0 * (30000 + i) / SAMPLE_RATE_DEFAULT);
+        maxError = fmax(maxError, fabs(buffer_[i * 2] - expected));
+    }
+    CHECK_TRUE(maxError < 1e-3);
+}
+
+TEST(WavPlayer, DirectIoStreamsWholeFile)
+{
+    // Odd length so chunks start part way into an aligned block
+    u32 numFrames = AUDIO_FILE_CHUNK_SIZE * 4 + 777;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, WAVPLAYER_DIRECT_IO, 0);
+    CHECK_TRUE(player->stream.asyncRead);
+
+    u64 frame = 0;
+    while (!(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        u16 expectedFrames = (numFrames - frame < TEST_BLOCK_FRAMES) ? (u16)(numFrames - frame) : TEST_BLOCK_FRAMES;
+        CHECK_TRUE(BlockMatchesRamp(frame, expectedFrames));
+        frame += expectedFrames;
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    }
+
+    CHECK_TRUE(frame == numFrames);
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+    CHECK_TRUE(ctx_.asyncIo.numSubmitted > 0);
+    CHECK_TRUE(ctx_.asyncIo.numErrors == 0);
+    CHECK_TRUE(ctx_.asyncIo.numFreeBuffers == ctx_.asyncIo.numBuffers);
+}
+
+TEST(WavPlayer, CachedPlayersShareOneCopy)
+{
+    u32 numFrames = AUDIO_FILE_CHUNK_SIZE + 100;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* first = CoreEngine_New(&ctx_, WavPlayer);
+    WavPlayer* second = CoreEngine_New(&ctx_, WavPlayer);
+    u16 firstId = WavPlayer_Create(first, &ctx_, TEST_WAV_PATH, WAVPLAYER_CACHED);
+    u16 secondId = WavPlayer_Create(second, &ctx_, TEST_WAV_PATH, WAVPLAYER_CACHED | WAVPLAYER_LOOPING);
+
+    // No file handle or stream of their own
+    CHECK_TRUE(first->cached != NULL && first->cached == second->cached);
+    CHECK_TRUE(first->file.fd == -1 && second->file.fd == -1);
+    CHECK_TRUE(first->stream.numSlots == 0 && second->stream.numSlots == 0);
+    CHECK_TRUE(ctx_.sampleCache.numHits == 1 && ctx_.sampleCache.numMisses == 1);
+
+    for (u64 frame = 0; frame < numFrames * 2; frame += TEST_BLOCK_FRAMES) {
+        ProcessBlock(secondId, TEST_BLOCK_FRAMES);
+        for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+            CHECK_TRUE(buffer_[i * 2] == TestWav_RampSample((frame + i) % numFrames));
+        }
+    }
+
+    WavPlayer_Seek(first, numFrames - 10);
+    ProcessBlock(firstId, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(numFrames - 10, 10));
+    CHECK_TRUE(atomic_load(&first->flags) & WAVPLAYER_FINISHED);
+}
+
+TEST(WavPlayer, LibraryPlayerStartsFromHead)
+{
+    u32 numFrames = AUDIO_FILE_CHUNK_SIZE * 6;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    SampleLibrary library;
+    SampleLibrary_Init(&library, "Test", 100, true);
+    u32 index = SampleLibrary_Add(&library, TEST_WAV_PATH);
+    u32 numHeadFrames = SampleLibrary_Get(&library, index)->numHeadFrames;
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateFromLibrary(player, &ctx_, &library, index, 0);
+    CHECK_TRUE(player->playing == &player->head);
+    CHECK_TRUE(atomic_load(&player->numLoads) == 0);
+    CHECK_TRUE(atomic_load(&player->stream.source.pending));
+
+    // The head plays with nothing read from disk yet
+    u64 frame = 0;
+    for (; frame + TEST_BLOCK_FRAMES <= numHeadFrames; frame += TEST_BLOCK_FRAMES) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        CHECK_TRUE(BlockMatchesRamp(frame, TEST_BLOCK_FRAMES));
+    }
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    // And carries straight on into the tail once that's loaded
+    while (!(atomic_load(&player->flags) & WAVPLAYER_FINISHED)) {
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        u16 expectedFrames = (numFrames - frame < TEST_BLOCK_FRAMES) ? (u16)(numFrames - frame) : TEST_BLOCK_FRAMES;
+        CHECK_TRUE(BlockMatchesRamp(frame, expectedFrames));
+        frame += expectedFrames;
+    }
+    CHECK_TRUE(frame == numFrames);
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    // Seeking back into the head plays it again at once
+    WavPlayer_Seek(player, 1000);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(1000, TEST_BLOCK_FRAMES));
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    CoreEngine_Deinit(&ctx_);
+    SampleLibrary_Deinit(&library);
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST(WavPlayer, UnderrunIsSilentAndHoldsPosition)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, AUDIO_FILE_CHUNK_SIZE * 8, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, 0, 0);
+
+    // Never service the loader so the ring runs dry
+    u64 bufferedFrames = (u64)player->stream.numSlots * AUDIO_FILE_CHUNK_SIZE;
+    for (u64 frame = 0; frame < bufferedFrames; frame += TEST_BLOCK_FRAMES) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        CHECK_TRUE(BlockMatchesRamp(frame, TEST_BLOCK_FRAMES));
+    }
+    CHECK_TRUE(atomic_load(&player->minFillFrames) == 0);
+
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockIsSilent(TEST_BLOCK_FRAMES));
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 1);
+    CHECK_TRUE(atomic_load(&player->numUnderrunFrames) == TEST_BLOCK_FRAMES);
+
+    // Picks up where it left off once the loader catches up
+    StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(bufferedFrames, TEST_BLOCK_FRAMES));
+}
+
+TEST(WavPlayer, SeekDropsStaleChunks)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, AUDIO_FILE_CHUNK_SIZE * 8, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, 0, 0);
+
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    WavPlayer_Seek(player, 10000);
+    // Nothing from the old position plays while the new one loads
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockIsSilent(TEST_BLOCK_FRAMES));
+    StreamScheduler_RunOnce(&ctx_.streamScheduler);
+
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(10000, TEST_BLOCK_FRAMES));
+    CHECK_TRUE(atomic_load(&player->currentFrame) == 10000 + TEST_BLOCK_FRAMES);
+}
+
+TEST(WavPlayer, SeekToCueIsInstant)
+{
+    u32 numFrames = AUDIO_FILE_CHUNK_SIZE * 8;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, 0, 0);
+    u32 cue = WavPlayer_AddCue(player, 20000);
+    CHECK_TRUE(player->cues[cue].numFrames == AUDIO_FILE_CHUNK_SIZE * WAVPLAYER_CUE_CHUNKS);
+
+    // The cue plays in the very next block without the loader having run
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    WavPlayer_SeekToCue(player, cue);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(20000, TEST_BLOCK_FRAMES));
+
+    // And hands over to the stream without a gap
+    u64 frame = 20000 + TEST_BLOCK_FRAMES;
+    for (; frame + TEST_BLOCK_FRAMES <= numFrames; frame += TEST_BLOCK_FRAMES) {
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        CHECK_TRUE(BlockMatchesRamp(frame, TEST_BLOCK_FRAMES));
+    }
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    // Seeking into the middle of a cue is just as quick
+    WavPlayer_Seek(player, 21000);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    CHECK_TRUE(BlockMatchesRamp(21000, TEST_BLOCK_FRAMES));
+    CHECK_DEATH(WavPlayer_SeekToCue(player, cue + 1));
+}
+
+TEST(WavPlayer, ShortLoopsStayResident)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, AUDIO_FILE_CHUNK_SIZE * 8, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, 0, 0);
+    WavPlayer_SetLoop(player, 1000, 1100, 0);
+    CHECK_TRUE(atomic_load(&player->numCues) == 1);
+
+    // Far shorter than a block, wraps several times a cycle at the exact sample
+    CHECK_TRUE(PlaysLoop(player, id, 1000, 1100, 0, 20));
+    CHECK_TRUE(player->playing == &player->cues[0]);
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+
+    // Let go of the loop and it plays on from wherever it was
+    WavPlayer_ClearLoop(player);
+    u64 frame = atomic_load(&player->currentFrame);
+    for (u32 block = 0; block < 40; block++) {
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        CHECK_TRUE(BlockMatchesRamp(frame, TEST_BLOCK_FRAMES));
+        frame += TEST_BLOCK_FRAMES;
+    }
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+}
+
+TEST(WavPlayer, LoopsCrossfadeIntoTheStart)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, AUDIO_FILE_CHUNK_SIZE * 8, SAMPLE_RATE_DEFAULT);
+
+    // Streamed, wrapping through the ring with the loop start resident for the fade
+    WavPlayer* streamed = CoreEngine_New(&ctx_, WavPlayer);
+    u16 streamedId = WavPlayer_CreateWithReadahead(streamed, &ctx_, TEST_WAV_PATH, 0, 0);
+    WavPlayer_SetLoop(streamed, 2000, 12000, 300);
+    CHECK_TRUE(PlaysLoop(streamed, streamedId, 2000, 12000, 300, 200));
+    CHECK_TRUE(atomic_load(&streamed->numUnderruns) == 0);
+
+    // And from memory
+    WavPlayer* cached = CoreEngine_New(&ctx_, WavPlayer);
+    u16 cachedId = WavPlayer_Create(cached, &ctx_, TEST_WAV_PATH, WAVPLAYER_CACHED);
+    WavPlayer_SetLoop(cached, 2000, 12000, 300);
+    CHECK_TRUE(atomic_load(&cached->numCues) == 0);
+    CHECK_TRUE(PlaysLoop(cached, cachedId, 2000, 12000, 300, 200));
+
+    CHECK_DEATH(WavPlayer_SetLoop(cached, 2000, 2100, 100));
+    CHECK_DEATH(WavPlayer_SetLoop(cached, 0, AUDIO_FILE_CHUNK_SIZE * 8 + 1, 0));
+}
+
+TEST(WavPlayer, LoopsWithoutGaps)
+{
+    u32 numFrames = 5000;
+    TestWav_WriteRamp(TEST_WAV_PATH, numFrames, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_CreateWithReadahead(player, &ctx_, TEST_WAV_PATH, WAVPLAYER_LOOPING, 0);
+
+    for (u64 frame = 0; frame < numFrames * 3; frame += TEST_BLOCK_FRAMES) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+            CHECK_TRUE(buffer_[i * 2] == TestWav_RampSample((frame + i) % numFrames));
+        }
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    }
+
+    CHECK_TRUE(!(atomic_load(&player->flags) & WAVPLAYER_FINISHED));
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+}
+
+// The ramp is a straight line, so any interpolation reads exactly it between frames
+static f32 RampAt(f64 position)
+{
+    return (f32)(position / 32768.0);
+}
+
+TEST(WavPlayer, VarispeedReadsBetweenFrames)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, 20000, SAMPLE_RATE_DEFAULT);
+
+    for (u32 cached = 0; cached < 2; cached++) {
+        WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+        u16 id = WavPlayer_Create(player, &ctx_, TEST_WAV_PATH, cached ? WAVPLAYER_CACHED : 0);
+        WavPlayer_SetInterpolation(player, INTERPOLATION_LINEAR);
+
+        // Half speed carries on from where normal speed got to
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        WavPlayer_SetRate(player, 0.5f, 0);
+
+        f64 position = TEST_BLOCK_FRAMES;
+        bool matches = true;
+        for (u32 block = 0; block < 8; block++) {
+            StreamScheduler_RunOnce(&ctx_.streamScheduler);
+            ProcessBlock(id, TEST_BLOCK_FRAMES);
+            for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+                matches = matches && fabsf(buffer_[i * 2] - RampAt(position)) < 1e-6f;
+                position += 0.5;
+            }
+        }
+        CHECK_TRUE(matches);
+        CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+    }
+}
+
+TEST(WavPlayer, VarispeedIgnoresWhatElseWasMixed)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, 20000, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_Create(player, &ctx_, TEST_WAV_PATH, WAVPLAYER_CACHED);
+    WavPlayer_SetInterpolation(player, INTERPOLATION_CUBIC);
+
+    // Normal speed mixes straight into a buffer that already has something in it
+    for (u32 i = 0; i < TEST_BLOCK_FRAMES * 2; i++) {
+        buffer_[i] = 0.25f;
+    }
+    AudioProcessor* proc = &ctx_.processors[id];
+    proc->Process(SAMPLE_RATE_DEFAULT, TEST_BLOCK_FRAMES, buffer_, proc->procData);
+    CHECK_TRUE(buffer_[(TEST_BLOCK_FRAMES - 1) * 2] == 0.25f + TestWav_RampSample(TEST_BLOCK_FRAMES - 1));
+
+    // Cubic reads a frame back from where normal speed stopped, which has to be the file's
+    WavPlayer_SetRate(player, 0.5f, 0);
+    ProcessBlock(id, TEST_BLOCK_FRAMES);
+    f64 position = TEST_BLOCK_FRAMES;
+    bool matches = true;
+    for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+        matches = matches && fabsf(buffer_[i * 2] - RampAt(position)) < 1e-6f;
+        position += 0.5;
+    }
+    CHECK_TRUE(matches);
+}
+
+TEST(WavPlayer, PlaysBackwards)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, AUDIO_FILE_CHUNK_SIZE * 3 + 100, SAMPLE_RATE_DEFAULT);
+
+    for (u32 cached = 0; cached < 2; cached++) {
+        WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+        u16 id = WavPlayer_Create(player, &ctx_, TEST_WAV_PATH, cached ? WAVPLAYER_CACHED : 0);
+        for (u32 block = 0; block < 20; block++) {
+            StreamScheduler_RunOnce(&ctx_.streamScheduler);
+            ProcessBlock(id, TEST_BLOCK_FRAMES);
+        }
+
+        // Straight back the way it came, a stream turning round waits one cycle for its first load
+        WavPlayer_SetRate(player, -1.0f, 0);
+        u64 frame = 20 * TEST_BLOCK_FRAMES;
+        u32 silentBlocks = 0;
+        bool matches = true;
+        while (!(atomic_load(&player->flags) & WAVPLAYER_FINISHED) && silentBlocks < 2) {
+            StreamScheduler_RunOnce(&ctx_.streamScheduler);
+            ProcessBlock(id, TEST_BLOCK_FRAMES);
+            if (BlockIsSilent(TEST_BLOCK_FRAMES) && frame > TEST_BLOCK_FRAMES) {
+                silentBlocks++;
+                continue;
+            }
+            for (u16 i = 0; i < TEST_BLOCK_FRAMES && frame > 0; i++) {
+                frame--;
+                matches = matches && buffer_[i * 2] == TestWav_RampSample(frame);
+            }
+        }
+        CHECK_TRUE(matches);
+        CHECK_TRUE(frame == 0);
+        CHECK_TRUE(silentBlocks == (cached ? 0 : 1));
+        CHECK_TRUE(atomic_load(&player->flags) & WAVPLAYER_FINISHED);
+    }
+}
+
+TEST(WavPlayer, RampsThroughZeroIntoReverse)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, 20000, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_Create(player, &ctx_, TEST_WAV_PATH, WAVPLAYER_CACHED);
+    WavPlayer_SetInterpolation(player, INTERPOLATION_LINEAR);
+    for (u32 block = 0; block < 8; block++) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+    }
+
+    // Slows to a stop, then speeds up backwards, without ever jumping
+    u32 rampFrames = SAMPLE_RATE_DEFAULT / 50;
+    WavPlayer_SetRate(player, -1.0f, 20);
+    f64 position = 8 * TEST_BLOCK_FRAMES;
+    f64 rate = 1.0;
+    f64 highest = position;
+    bool matches = true;
+    for (u32 frame = 0; frame < rampFrames + TEST_BLOCK_FRAMES * 2; frame += TEST_BLOCK_FRAMES) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        for (u16 i = 0; i < TEST_BLOCK_FRAMES; i++) {
+            matches = matches && fabsf(buffer_[i * 2] - RampAt(position)) < 1e-5f;
+            highest = fmax(highest, position);
+            position += rate;
+            rate = (frame + i + 1 < rampFrames) ? 1.0 - 2.0 * (frame + i + 1) / rampFrames : -1.0;
+        }
+    }
+    CHECK_TRUE(matches);
+    CHECK_TRUE(player->reverse);
+    CHECK_TRUE(highest < 8 * TEST_BLOCK_FRAMES + rampFrames / 4 + 1);
+}
+
+TEST(WavPlayer, FastPlaybackKeepsUp)
+{
+    TestWav_WriteRamp(TEST_WAV_PATH, SAMPLE_RATE_DEFAULT, SAMPLE_RATE_DEFAULT);
+
+    WavPlayer* player = CoreEngine_New(&ctx_, WavPlayer);
+    u16 id = WavPlayer_Create(player, &ctx_, TEST_WAV_PATH, 0);
+    WavPlayer_SetRate(player, WAVPLAYER_MAX_RATE, 0);
+
+    // Four chunks a block, the ring refills whenever there's room rather than at half empty
+    for (u32 block = 0; block < 40; block++) {
+        ProcessBlock(id, TEST_BLOCK_FRAMES);
+        StreamScheduler_RunOnce(&ctx_.streamScheduler);
+    }
+    CHECK_TRUE(atomic_load(&player->numUnderruns) == 0);
+    CHECK_TRUE(atomic_load(&player->stream.source.framesPerSecond) == SAMPLE_RATE_DEFAULT * 4);
+    CHECK_TRUE(atomic_load(&player->currentFrame) > 40 * TEST_BLOCK_FRAMES * 4);
+}
+
+TEST_SETUP(WavPlayer)
+{
+    ADD_TEST(WavPlayer, StreamsWholeFile);
+    ADD_TEST(WavPlayer, ResamplesToEngineRate);
+    ADD_TEST(WavPlayer, DirectIoStreamsWholeFile);
+    ADD_TEST(WavPlayer, CachedPlayersShareOneCopy);
+    ADD_TEST(WavPlayer, LibraryPlayerStartsFromHead);
+    ADD_TEST(WavPlayer, UnderrunIsSilentAndHoldsPosition);
+    ADD_TEST(WavPlayer, SeekDropsStaleChunks);
+    ADD_TEST(WavPlayer, SeekToCueIsInstant);
+    ADD_TEST(WavPlayer, ShortLoopsStayResident);
+    ADD_TEST(WavPlayer, LoopsCrossfadeIntoTheStart);
+    ADD_TEST(WavPlayer, LoopsWithoutGaps);
+    ADD_TEST(WavPlayer, VarispeedReadsBetweenFrames);
+    ADD_TEST(WavPlayer, VarispeedIgnoresWhatElseWasMixed);
+    ADD_TEST(WavPlayer, PlaysBackwards);
+    ADD_TEST(WavPlayer, RampsThroughZeroIntoReverse);
+    ADD_TEST(WavPlayer, FastPlaybackKeepsUp);
+}
+
+TEST_BRINGUP(WavPlayer)
+{
+    CoreEngine_Init(&ctx_, 1.0f, 4096);
+}
+
+TEST_TEARDOWN(WavPlayer)
+{
+    CoreEngine_Deinit(&ctx_);
+    remove(TEST_WAV_PATH);
+}
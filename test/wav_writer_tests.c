@@ -0,0 +1,187 @@
+#include "test_framework.h"
+#include <wav_writer.h>
+#include <wav_file.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_WAV_PATH "/tmp/jamcore_wav_writer_test.wav"
+#define TEST_BLOCK_FRAMES 4096
+#define TEST_NUM_BLOCKS 40
+
+static f32 block_[TEST_BLOCK_FRAMES * 2];
+
+static f32 TestSample(u64 sampleIndex)
+{
+    return (f32)(sampleIndex % 65521) / 65521.0f - 0.5f;
+}
+
+static void FillBlock(u32 blockIndex)
+{
+    for (u32 i = 0; i < TEST_BLOCK_FRAMES * 2; i++) {
+        block_[i] = TestSample((u64)blockIndex * TEST_BLOCK_FRAMES * 2 + i);
+    }
+}
+
+static bool MatchesBlocks(const WavFile* file, u32 numBlocks)
+{
+    if (file->totalFrames != (u64)numBlocks * TEST_BLOCK_FRAMES || !WavFile_CanMap(file, 48000)) {
+        return false;
+    }
+    const f32* frames = WavFile_MapFrames(file, 0);
+    for (u64 i = 0; i < file->totalFrames * 2; i++) {
+        if (frames[i] != TestSample(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static u64 FileSize(const char* path)
+{
+    struct stat info;
+    stat(path, &info);
+    return (u64)info.st_size;
+}
+
+static void ReadHeader(u8* header)
+{
+    i32 fd = open(TEST_WAV_PATH, O_RDONLY);
+    read(fd, header, WAV_WRITER_HEADER_SIZE);
+    close(fd);
+}
+
+TEST(WavWriter, RoundTripsFloatStereo)
+{
+    WavWriter writer;
+    WavWriter_Open(&writer, TEST_WAV_PATH, PCM_FORMAT_F32, 2, 48000);
+    for (u32 b = 0; b < TEST_NUM_BLOCKS; b++) {
+        FillBlock(b);
+        CHECK_TRUE(WavWriter_Write(&writer, block_, TEST_BLOCK_FRAMES));
+    }
+    WavWriter_Close(&writer);
+    CHECK_TRUE(writer.numErrors == 0);
+
+    // Nothing preallocated is left hanging off the end
+    CHECK_TRUE(FileSize(TEST_WAV_PATH) == WAV_WRITER_HEADER_SIZE + (u64)TEST_NUM_BLOCKS * TEST_BLOCK_FRAMES * 8);
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.dataOffset == WAV_WRITER_HEADER_SIZE);
+    CHECK_TRUE(MatchesBlocks(&file, TEST_NUM_BLOCKS));
+    WavFile_Close(&file);
+}
+
+TEST(WavWriter, HeaderKeepsUpWhileRecording)
+{
+    WavWriter writer;
+    WavWriter_Open(&writer, TEST_WAV_PATH, PCM_FORMAT_F32, 2, 48000);
+    writer.headerIntervalBytes = TEST_BLOCK_FRAMES * 8 * 4;
+
+    for (u32 b = 0; b < 10; b++) {
+        FillBlock(b);
+        CHECK_TRUE(WavWriter_Write(&writer, block_, TEST_BLOCK_FRAMES));
+    }
+
+    // Still open, as if the process had died here, it plays up to the last rewrite at 8 blocks
+    CHECK_TRUE(FileSize(TEST_WAV_PATH) == WAV_WRITER_HEADER_SIZE + 10 * TEST_BLOCK_FRAMES * 8);
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(MatchesBlocks(&file, 8));
+    WavFile_Close(&file);
+
+    WavWriter_Close(&writer);
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(MatchesBlocks(&file, 10));
+    WavFile_Close(&file);
+}
+
+TEST(WavWriter, SwitchesToRf64PastFourGb)
+{
+    WavWriter writer;
+    WavWriter_Open(&writer, TEST_WAV_PATH, PCM_FORMAT_F32, 2, 48000);
+    FillBlock(0);
+    CHECK_TRUE(WavWriter_Write(&writer, block_, TEST_BLOCK_FRAMES));
+
+    // Claim 5 GB without writing it
+    u64 dataBytes = writer.dataBytes;
+    writer.dataBytes = 5ull << 30;
+    CHECK_TRUE(WavWriter_WriteHeader(&writer));
+
+    u8 header[WAV_WRITER_HEADER_SIZE];
+    ReadHeader(header);
+    u64 ds64DataBytes;
+    memcpy(&ds64DataBytes, header + 28, sizeof(ds64DataBytes));
+    CHECK_TRUE(memcmp(header, "RF64", 4) == 0);
+    CHECK_TRUE(memcmp(header + 12, "ds64", 4) == 0);
+    CHECK_TRUE(ds64DataBytes == 5ull << 30);
+    CHECK_TRUE(memcmp(header + WAV_WRITER_HEADER_SIZE - 8, "data\xFF\xFF\xFF\xFF", 8) == 0);
+
+    // Only what's really there gets read
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(MatchesBlocks(&file, 1));
+    WavFile_Close(&file);
+
+    writer.dataBytes = dataBytes;
+    WavWriter_Close(&writer);
+    ReadHeader(header);
+    CHECK_TRUE(memcmp(header, "RIFF", 4) == 0);
+    CHECK_TRUE(memcmp(header + 12, "JUNK", 4) == 0);
+}
+
+TEST(WavWriter, WritesPcmAndMultichannel)
+{
+    // Odd sized data gets padded
+    u8 samples[3 * 3] = { 0x00, 0x00, 0x40, 0x00, 0x00, 0xC0, 0xFF, 0xFF, 0x7F };
+    WavWriter writer;
+    WavWriter_Open(&writer, TEST_WAV_PATH, PCM_FORMAT_S24, 1, 44100);
+    CHECK_TRUE(WavWriter_Write(&writer, samples, 3));
+    WavWriter_Close(&writer);
+    CHECK_TRUE(FileSize(TEST_WAV_PATH) == WAV_WRITER_HEADER_SIZE + 10);
+
+    WavFile file;
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.format == PCM_FORMAT_S24);
+    CHECK_TRUE(file.numChannels == 1 && file.sampleRate == 44100);
+    CHECK_TRUE(file.totalFrames == 3);
+    f32 out[6];
+    WavFile_ReadFrames(&file, 0, 3, out);
+    CHECK_TRUE(out[0] == 0.5f && out[2] == -0.5f && out[4] == 8388607.0f / 8388608.0f);
+    WavFile_Close(&file);
+
+    // More than two channels goes out as extensible
+    i16 quad[2 * 4] = { 16384, -16384, 1, 2, -32768, 8192, 3, 4 };
+    WavWriter_Open(&writer, TEST_WAV_PATH, PCM_FORMAT_S16, 4, 48000);
+    CHECK_TRUE(WavWriter_Write(&writer, quad, 2));
+    WavWriter_Close(&writer);
+
+    u8 header[WAV_WRITER_HEADER_SIZE];
+    ReadHeader(header);
+    CHECK_TRUE(header[56] == 0xFE && header[57] == 0xFF);
+
+    WavFile_Open(&file, TEST_WAV_PATH);
+    CHECK_TRUE(file.format == PCM_FORMAT_S16 && file.numChannels == 4);
+    WavFile_ReadFrames(&file, 0, 2, out);
+    CHECK_TRUE(out[0] == 0.5f && out[1] == -0.5f && out[2] == -1.0f && out[3] == 0.25f);
+    WavFile_Close(&file);
+}
+
+TEST_SETUP(WavWriter)
+{
+    ADD_TEST(WavWriter, RoundTripsFloatStereo);
+    ADD_TEST(WavWriter, HeaderKeepsUpWhileRecording);
+    ADD_TEST(WavWriter, SwitchesToRf64PastFourGb);
+    ADD_TEST(WavWriter, WritesPcmAndMultichannel);
+}
+
+TEST_BRINGUP(WavWriter)
+{
+}
+
+TEST_TEARDOWN(WavWriter)
+{
+    remove(TEST_WAV_PATH);
+}